@@ -9,6 +9,10 @@
  * 
  * NOTE: this program assumes the SD is larger than 1GByte, and you have
  * 32KByte available in your microcontroller for the disk buffer.
+ * 
+ * The cache test only reads from the SD card, and compares the speed of
+ * single sector accesses, as done by filesystems, with and without the
+ * BlockCache used by Fat32Fs and LittleFS.
  */
 
 #include <cstdio>
@@ -16,7 +20,10 @@
 #include <cassert>
 #include <chrono>
 #include <fcntl.h>
+#include <unistd.h>
 #include <miosix.h>
+#include "filesystem/file_access.h"
+#include "filesystem/block_cache.h"
 
 using namespace std;
 using namespace std::chrono;
@@ -65,6 +72,59 @@ void testThread(void *)
     delete[] data;
 }
 
+/**
+ * Run a workload resembling the accesses of a filesystem: single sector reads
+ * of a small set of sectors, like a FAT table, interleaved with sequential
+ * single sector reads, like a directory scan or file read
+ * \param disk block device
+ * \param numLines number of cache lines, 0 to disable the cache
+ */
+void cacheTest(intrusive_ref_ptr<FileBase> disk, unsigned int numLines)
+{
+    const int startAddr=10240; ///< Start block, skip first sectors
+    const int fatBlocks=16;    ///< Blocks in the frequently accessed region
+    const int numReads=4096;
+    BlockCache cache(disk,numLines);
+    unsigned char buffer[BlockCache::blockSize];
+    int seqBlock=startAddr+fatBlocks;
+    srand(0);
+    auto t=system_clock::now();
+    for(int i=0;i<numReads;i++)
+    {
+        int block;
+        if(i%2) block=startAddr+rand()%fatBlocks;
+        else block=seqBlock++;
+        if(cache.read(buffer,block,1)!=0)
+        {
+            puts("Read error");
+            return;
+        }
+    }
+    duration<float> d=system_clock::now()-t;
+    const BlockCacheStats& s=cache.getStats();
+    unsigned int total=s.hits+s.misses+s.bypassed;
+    float hitRate= total>0 ? 100.0f*s.hits/total : 0.0f;
+    float speed=numReads*BlockCache::blockSize/1024/d.count();
+    printf("lines:%u hit rate:%0.1f%% device reads:%u speed:%0.1fKB/s\n",
+           numLines,hitRate,s.deviceReads,speed);
+}
+
+void cacheTest()
+{
+    int fd=open("/dev/sda",O_RDONLY,0);
+    if(fd<0)
+    {
+        perror("open");
+        return;
+    }
+    intrusive_ref_ptr<FileBase> disk=getFileDescriptorTable().getFile(fd);
+    cacheTest(disk,0);
+    cacheTest(disk,4);
+    cacheTest(disk,16);
+    disk.reset();
+    close(fd);
+}
+
 int main()
 {
     puts("\n====================");
@@ -74,15 +134,22 @@ int main()
     {
         writeAccess=false;
         randomAccess=false;
+        bool cache=false;
         for(;;)
         {
-            puts("Read or write access, or quit (r/w/q)?");
+            puts("Read or write access, cache test, or quit (r/w/c/q)?");
             char line[64];
             fgets(line,sizeof(line),stdin);
             if(line[0]=='q') goto quit;
+            if(line[0]=='c') cache=true;
             if(line[0]=='w') writeAccess=true;
-            if(line[0]=='w' || line[0]=='r') break;
-            puts("Error: insert 'r' or 'w' or 'q'");
+            if(line[0]=='w' || line[0]=='r' || line[0]=='c') break;
+            puts("Error: insert 'r' or 'w' or 'c' or 'q'");
+        }
+        if(cache)
+        {
+            cacheTest();
+            continue;
         }
         for(;;)
         {
@@ -8,9 +8,9 @@ rm -rf binutils-2.32 gcc-9.2.0 gdb-9.1 gdb-obj newlib-3.1.0 newlib-obj \
 	gmp-6.2.1 mpfr-4.0.2 mpc-1.1.0 make-4.2.1 expat-2.2.10 ncurses-6.1 \
 	makeself-2.4.5 lib quickfix lpc21isp.c
 
-rm -rf objdir/ log/
+rm -rf objdir/ log/ build-i686/
 if [[ $? -ne 0 ]]; then
-	sudo rm -rf objdir/ log/
+	sudo rm -rf objdir/ log/ build-i686/
 fi
 
 # Installer scripts generated by the build scripts on macOS
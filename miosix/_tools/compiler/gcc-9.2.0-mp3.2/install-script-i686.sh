@@ -0,0 +1,262 @@
+#!/usr/bin/env bash
+
+# Script to build i686-miosix-elf-gcc, the compiler for the linux_sim
+# architecture, which runs Miosix as a 32 bit Linux process.
+# Usage: ./install-script-i686.sh -j`nproc`
+# The -j parameter is passed to make for parallel compilation
+#
+# Run ./download.sh first, this script uses the same sources, and the same gcc
+# and newlib patches as install-script.sh. The only difference with respect to
+# arm-miosix-eabi-gcc is the target, that is based on the i[34567]86-*-elf*
+# targets of binutils and gcc, plus the definitions in
+# patches/i386-miosix-elf.h. There are no multilibs, and gdb and the other
+# tools are not built, as the host ones can be used.
+#
+# This script will install i686-miosix-elf-gcc in /opt, creating links to
+# binaries in /usr/bin. It builds in the build-i686 directory, that can be
+# removed with cleanup.sh
+
+#### Configuration tunables -- begin ####
+
+# Uncomment if installing globally on this system
+PREFIX=/opt/i686-miosix-elf
+SUDO=sudo
+# Uncomment if installing locally on this system, sudo isn't necessary
+#PREFIX=`pwd`/gcc/i686-miosix-elf
+#SUDO=
+
+#### Configuration tunables -- end ####
+
+TARGET=i686-miosix-elf
+
+# Libraries are compiled statically, so they are never installed in the system
+LIB_DIR=`pwd`/build-i686/lib
+
+# Program versions, must match install-script.sh
+BINUTILS=binutils-2.32
+GCC=gcc-9.2.0
+NEWLIB=newlib-3.1.0
+GMP=gmp-6.2.1
+MPFR=mpfr-4.0.2
+MPC=mpc-1.1.0
+
+quit() {
+	echo $1
+	exit 1
+}
+
+if [[ $1 == '' ]]; then
+	PARALLEL="-j1"
+else
+	PARALLEL=$1;
+fi
+
+# Ensure tools are available as soon as we build them
+export PATH=$PREFIX/bin:$PATH
+
+#
+# Part 1: extract data, apply patches
+#
+
+mkdir -p build-i686/log || quit ":: Error creating build-i686"
+cd build-i686
+
+extract()
+{
+	label=$1
+	filename=$2
+	shift 2
+	directory=${filename%.tar*}
+
+	if [[ -e $directory ]]; then
+		echo "Skipping extraction/patching of $label, directory $directory exists"
+	else
+		echo "Extracting $label..."
+		tar -xf "../downloaded/$filename" || quit ":: Error extracting $label"
+		for patchfile in $@; do
+			echo "Applying ${patchfile}..."
+			patch -p0 < "../$patchfile" || quit ":: Failed patching $label"
+		done
+	fi
+}
+
+# binutils.patch only affects ARM, the unpatched binutils are used
+extract 'binutils' $BINUTILS.tar.xz
+extract 'gcc' $GCC.tar.xz patches/gcc.patch
+extract 'newlib' $NEWLIB.tar.gz patches/newlib.patch
+extract 'gmp' $GMP.tar.xz
+extract 'mpfr' $MPFR.tar.xz
+extract 'mpc' $MPC.tar.gz
+
+# Add the i686-miosix-elf target to gcc. config.gcc and libatomic's
+# configure.tgt are shell fragments sourced by configure, so the additions are
+# appended, and take effect after the generic i[34567]86-*-elf* settings
+if [[ ! -e $GCC/gcc/config/i386/miosix-elf.h ]]; then
+	cp ../patches/i386-miosix-elf.h $GCC/gcc/config/i386/miosix-elf.h \
+		|| quit ":: Error adding the i686-miosix-elf target"
+	cat >> $GCC/gcc/config.gcc <<'EOT'
+
+# Miosix: i686-miosix-elf, added by install-script-i686.sh
+case ${target} in
+i[34567]86-miosix-elf*)
+	tm_file="${tm_file} i386/miosix-elf.h"
+	;;
+esac
+EOT
+	cat >> $GCC/libatomic/configure.tgt <<'EOT'
+
+# Miosix: i686-miosix-elf, added by install-script-i686.sh
+case "${target}" in
+  i[34567]86-miosix-elf*)
+	UNSUPPORTED=
+	config_path="miosix"
+	try_ifunc=no
+	;;
+esac
+EOT
+fi
+
+#
+# Part 2: compile libraries
+#
+
+build_lib()
+{
+	dir=$1
+	shift
+	cd $dir
+	./configure \
+		--prefix=$LIB_DIR \
+		--enable-static --disable-shared \
+		$@ 2> ../log/z.$dir.a.txt		|| quit ":: Error configuring $dir"
+	make all $PARALLEL 2>../log/z.$dir.b.txt	|| quit ":: Error compiling $dir"
+	make install 2>../log/z.$dir.d.txt		|| quit ":: Error installing $dir"
+	cd ..
+}
+
+build_lib $GMP
+build_lib $MPFR --with-gmp=$LIB_DIR
+build_lib $MPC --with-gmp=$LIB_DIR --with-mpfr=$LIB_DIR
+
+#
+# Part 3: compile and install binutils
+#
+
+cd $BINUTILS
+
+./configure \
+	--target=$TARGET \
+	--prefix=$PREFIX \
+	--disable-multilib \
+	--enable-lto \
+	--disable-werror 2>../log/a.txt			|| quit ":: Error configuring binutils"
+
+make all $PARALLEL 2>../log/b.txt			|| quit ":: Error compiling binutils"
+
+$SUDO make install 2>../log/c.txt			|| quit ":: Error installing binutils"
+
+cd ..
+
+#
+# Part 4: compile and install gcc-start
+#
+
+mkdir -p objdir
+cd objdir
+
+$SUDO ../$GCC/configure \
+	--target=$TARGET \
+	--with-gmp=$LIB_DIR \
+	--with-mpfr=$LIB_DIR \
+	--with-mpc=$LIB_DIR \
+	MAKEINFO=missing \
+	--prefix=$PREFIX \
+	--disable-shared \
+	--disable-multilib \
+	--disable-libssp \
+	--disable-nls \
+	--disable-libgomp \
+	--disable-libquadmath \
+	--disable-libstdcxx-pch \
+	--disable-libstdcxx-dual-abi \
+	--disable-libstdcxx-filesystem-ts \
+	--enable-threads=miosix \
+	--enable-languages="c,c++" \
+	--enable-lto \
+	--disable-wchar_t \
+	--with-newlib \
+	--with-headers=../$NEWLIB/newlib/libc/include \
+	2>../log/d.txt							|| quit ":: Error configuring gcc-start"
+
+$SUDO make all-gcc $PARALLEL 2>../log/e.txt || quit ":: Error compiling gcc-start"
+
+$SUDO make install-gcc 2>../log/f.txt		|| quit ":: Error installing gcc-start"
+
+# See install-script.sh for why sys-include must be removed
+$SUDO rm -rf $PREFIX/$TARGET/sys-include
+
+if [[ $SUDO ]]; then
+	$SUDO rm $PREFIX/bin/$TARGET-$GCC
+	$SUDO ln -s $PREFIX/bin/* /usr/bin
+fi
+
+cd ..
+
+#
+# Part 5: compile and install newlib
+#
+
+mkdir -p newlib-obj
+cd newlib-obj
+
+../$NEWLIB/configure \
+	--target=$TARGET \
+	--prefix=$PREFIX \
+	--disable-multilib \
+	--enable-newlib-reent-small \
+	--enable-newlib-multithread \
+	--enable-newlib-io-long-long \
+	--disable-newlib-io-c99-formats \
+	--disable-newlib-io-long-double \
+	--disable-newlib-io-pos-args \
+	--disable-newlib-mb \
+	--disable-newlib-supplied-syscalls \
+	2>../log/g.txt							|| quit ":: Error configuring newlib"
+
+make $PARALLEL 2>../log/h.txt				|| quit ":: Error compiling newlib"
+
+$SUDO make install 2>../log/i.txt			|| quit ":: Error installing newlib"
+
+cd ..
+
+#
+# Part 6: compile and install gcc-end
+#
+
+cd objdir
+
+$SUDO make all $PARALLEL 2>../log/j.txt		|| quit ":: Error compiling gcc-end"
+
+$SUDO make install 2>../log/k.txt			|| quit ":: Error installing gcc-end"
+
+cd ..
+
+#
+# Part 7: check the installed libraries and the Miosix defines
+#
+
+for lib in libc.a libm.a libatomic.a libstdc++.a libsupc++.a; do
+	if [[ ! -f $PREFIX/$TARGET/lib/$lib ]]; then
+		quit "::Error, $PREFIX/$TARGET/lib/$lib not installed"
+	fi
+done
+
+$PREFIX/bin/$TARGET-gcc -dM -E - < /dev/null | grep -q '_MIOSIX_GCC_PATCH_MAJOR 3' \
+	|| quit "::Error, $TARGET-gcc does not define _MIOSIX_GCC_PATCH_MAJOR"
+
+if [[ $SUDO ]]; then
+	# Links for the tools installed after gcc-start
+	$SUDO ln -sf $PREFIX/bin/* /usr/bin
+fi
+
+echo "::Successfully installed $TARGET-gcc in $PREFIX"
@@ -0,0 +1,18 @@
+
+/*
+ * RATIONALE: target definition for i686-miosix-elf, the compiler used by the
+ * linux_sim architecture. Copied as gcc/config/i386/miosix-elf.h by
+ * install-script-i686.sh, and appended to the tm_file list of the existing
+ * i[34567]86-*-elf* target. As in arm/miosix-eabi.h, always define _MIOSIX
+ * and the compiler patch version, as libgcc/libstdc++/newlib and the kernel
+ * rely on them.
+ */
+
+#undef TARGET_OS_CPP_BUILTINS
+#define TARGET_OS_CPP_BUILTINS()         \
+    do {                                 \
+        builtin_define("_MIOSIX");       \
+        builtin_define("_MIOSIX_GCC_PATCH_MAJOR=3"); \
+        builtin_define("_MIOSIX_GCC_PATCH_MINOR=2"); \
+        builtin_assert("system=miosix"); \
+    } while(false)
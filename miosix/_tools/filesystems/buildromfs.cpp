@@ -32,8 +32,8 @@ int main(int argc, char *argv[])
 {
     if(argc<4)
     {
-        cerr<<"Miosix buildromfs utility v2.00"<<endl
-            <<"use: buildromfs <target file> --from-directory <source directory>"<<endl;
+        cerr<<"Miosix buildromfs utility v2.01"<<endl
+            <<"use: buildromfs <target file> --from-directory <source directory> [--no-index]"<<endl;
         return 1;
     }
 
@@ -49,6 +49,17 @@ int main(int argc, char *argv[])
         return 1;
     }
 
+    // Directory index is generated by default, unless disabled
+    bool directoryIndex=true;
+    if(argc>4)
+    {
+        if(string(argv[4])=="--no-index") directoryIndex=false;
+        else {
+            cerr<<argv[4]<<": unsupported option"<<endl;
+            return 1;
+        }
+    }
+
     // Open the output image
     fstream io(argv[1], ios::in | ios::out | ios::trunc | ios::binary);
     if(!io)
@@ -58,7 +69,7 @@ int main(int argc, char *argv[])
     }
 
     // Build the image and write it to file
-    MkRomFs img(io,root);
+    MkRomFs img(io,root,directoryIndex);
     cout<<"RomFs size "<<img.size()<<endl;
     return 0;
 }
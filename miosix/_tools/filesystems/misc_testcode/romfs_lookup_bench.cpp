@@ -0,0 +1,95 @@
+// Compile with g++ -O2 -std=c++17 -D_ARCH_LINUX_SIM -I.. -I../../.. -I../../../arch/common -I../../../filesystem/romfs -I../../../kernel -o lb romfs_lookup_bench.cpp
+// Benchmark RomFs path lookup with and without the directory index.
+// Directories are searched with romFsFindInDirectory, the same function used
+// by MemoryMappedRomFs::findEntry.
+
+#include <iostream>
+#include <sstream>
+#include <chrono>
+#include <vector>
+#include <random>
+#include <cstring>
+#include "tree.h"
+#include "mkromfs.h"
+#include "romfs_lookup.h"
+
+using namespace std;
+
+/**
+ * Build a tree with the given number of directories each containing the given
+ * number of (empty) files
+ */
+FilesystemEntry buildTree(int numDirs, int filesPerDir, vector<string>& paths)
+{
+    FilesystemEntry root;
+    root.mode=S_IFDIR | 0755;
+    for(int i=0;i<numDirs;i++)
+    {
+        FilesystemEntry dir;
+        dir.mode=S_IFDIR | 0755;
+        dir.name="dir"+to_string(i);
+        for(int j=0;j<filesPerDir;j++)
+        {
+            FilesystemEntry file;
+            file.mode=S_IFREG | 0644;
+            file.name="file_"+to_string(j*7919 % filesPerDir)+".bin";
+            file.path="/dev/null";
+            paths.push_back(dir.name+"/"+file.name);
+            dir.addEntryToDirectory(std::move(file));
+        }
+        root.addEntryToDirectory(std::move(dir));
+    }
+    return root;
+}
+
+/**
+ * Look up a path, walking it one component at a time like
+ * MemoryMappedRomFs::findEntry
+ */
+const RomFsDirectoryEntry *findEntry(const char *base, const string& path)
+{
+    auto header=reinterpret_cast<const RomFsHeader*>(base);
+    bool indexed=header->flags & romFsFlagDirectoryIndex;
+    auto entry=reinterpret_cast<const RomFsDirectoryEntry*>(base+sizeof(RomFsHeader));
+    stringstream ss(path);
+    string element;
+    while(entry && getline(ss,element,'/'))
+        entry=romFsFindInDirectory(base,entry,element.c_str(),indexed);
+    return entry;
+}
+
+/**
+ * \return average lookup time in ns
+ */
+double benchmark(const string& image, const vector<string>& paths, int rounds)
+{
+    const char *base=image.data();
+    auto start=chrono::steady_clock::now();
+    for(int i=0;i<rounds;i++)
+        for(auto& p : paths)
+            if(findEntry(base,p)==nullptr) throw runtime_error(p+": not found");
+    auto end=chrono::steady_clock::now();
+    double ns=chrono::duration_cast<chrono::nanoseconds>(end-start).count();
+    return ns/(rounds*paths.size());
+}
+
+int main()
+{
+    cout<<"files/dir   size(noidx)  size(idx)  lookup(noidx)  lookup(idx)"<<endl;
+    for(int filesPerDir : {8,32,128,512,2048})
+    {
+        vector<string> paths;
+        auto root=buildTree(4,filesPerDir,paths);
+        shuffle(paths.begin(),paths.end(),mt19937(0));
+        stringstream linear, indexed;
+        MkRomFs a(linear,root,false);
+        MkRomFs b(indexed,root,true);
+        string la=linear.str(), lb=indexed.str();
+        if(findEntry(la.data(),"dir0/nonexistent") || findEntry(lb.data(),"dir0/nonexistent"))
+            throw runtime_error("found nonexistent file");
+        int rounds=max(1,200000/(int)paths.size());
+        cout<<filesPerDir<<"\t\t"<<a.size()<<"\t\t"<<b.size()<<"\t"
+            <<benchmark(la,paths,rounds)<<"ns\t\t"
+            <<benchmark(lb,paths,rounds)<<"ns"<<endl;
+    }
+}
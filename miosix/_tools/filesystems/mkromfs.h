@@ -20,6 +20,7 @@
 #include <cstring>
 #include <fstream>
 #include <list>
+#include <vector>
 #include <cassert>
 #include <algorithm>
 #include <stdexcept>
@@ -71,8 +72,11 @@ public:
      * Everything is done in the constructor, the class exists as a convenience
      * \param io iostream where the image will be built
      * \param root root of the directory tree
+     * \param directoryIndex if true, add a sorted index after each directory
+     * to speed up path lookup
      */
-    MkRomFs(std::iostream& io, const FilesystemEntry& root) : img(io)
+    MkRomFs(std::iostream& io, const FilesystemEntry& root,
+            bool directoryIndex=true) : img(io), directoryIndex(directoryIndex)
     {
         // Construct the filesystem header
         RomFsHeader header;
@@ -80,6 +84,7 @@ public:
         strncpy(header.marker,"wwwww",6);
         strncpy(header.fsName,"RomFs 2.01",11);
         strncpy(header.osName,"Miosix",7);
+        if(directoryIndex) header.flags=toLittleEndian32(romFsFlagDirectoryIndex);
         //header.imageSize still unknown at this point
         auto headerOffset=img.append(header,romFsStructAlignment);
 
@@ -145,6 +150,7 @@ private:
 
         // Write entries
         list<unsigned int> entryOffsets;
+        vector<pair<string,unsigned int>> sortedEntries;
         for(auto& d : dir.directoryEntries)
         {
             RomFsDirectoryEntry de;
@@ -155,6 +161,7 @@ private:
             de.uid=toLittleEndian16(d.uid);
             de.gid=toLittleEndian16(d.gid);
             entryOffsets.push_back(img.append(de,romFsStructAlignment));
+            sortedEntries.push_back(make_pair(d.name,entryOffsets.back()));
             img.appendString(d.name);
         }
 
@@ -162,6 +169,20 @@ private:
         // NOTE: Must be done before we recursively add the directory content!
         auto size=img.size()-inode; //inode is also address of first byte
 
+        // Write the index, not included in the directory inode size.
+        // Entries are sorted as strcmp would, that is by unsigned char
+        if(directoryIndex)
+        {
+            sort(begin(sortedEntries),end(sortedEntries),
+                 [](const pair<string,unsigned int>& a,
+                    const pair<string,unsigned int>& b)
+                 {
+                     return strcmp(a.first.c_str(),b.first.c_str())<0;
+                 });
+            img.append(toLittleEndian32(sortedEntries.size()),romFsStructAlignment);
+            for(auto& e : sortedEntries) img.append(toLittleEndian32(e.second));
+        }
+
         // Then for each entry, recursively add the content
         list<InodeInfo> entryContent;
         for(auto& d : dir.directoryEntries)
@@ -276,4 +297,5 @@ private:
     }
 
     Image<unsigned int> img; ///< Backing storage
+    bool directoryIndex;     ///< Add a RomFsDirectoryIndex after directories
 };
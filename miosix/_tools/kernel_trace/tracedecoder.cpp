@@ -0,0 +1,334 @@
+/***************************************************************************
+ *   Copyright (C) 2024 by Terraneo Federico                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+/*
+ * Converts a binary trace written by miosix::KernelTrace::drain() to the
+ * Chrome trace JSON format, that can be opened with https://ui.perfetto.dev
+ * or chrome://tracing
+ */
+
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <stdexcept>
+#include "../../kernel/trace_types.h"
+
+using namespace std;
+using namespace miosix;
+
+/**
+ * Converts event timestamps to nanoseconds using the Sync events
+ */
+class TimeBase
+{
+public:
+    /**
+     * Unwrap the 32 bit timestamps, and collect the Sync events
+     * \param events the trace events
+     */
+    TimeBase(const vector<TraceEvent>& events)
+    {
+        long long t=events.empty() ? 0 : events.front().timestamp;
+        for(size_t i=0;i<events.size();i++)
+        {
+            //Timestamps may be slightly out of order as events are not
+            //reserved and timestamped atomically, so use signed differences
+            if(i>0) t+=static_cast<int>(events[i].timestamp-events[i-1].timestamp);
+            ticks.push_back(t);
+            if(events[i].type!=TraceEventType::Sync) continue;
+            long long ns=static_cast<long long>(events[i].b)<<32 | events[i].a;
+            syncs.push_back(make_pair(t,ns));
+        }
+        if(syncs.empty()) throw runtime_error("no sync events in trace");
+    }
+
+    /**
+     * \param i event index
+     * \return the time of the event in nanoseconds
+     */
+    double ns(size_t i) const
+    {
+        long long t=ticks.at(i);
+        //With a single sync point, assume timestamps are in nanoseconds
+        if(syncs.size()==1) return syncs[0].second+(t-syncs[0].first);
+        //Interpolate between the two closest sync points, extrapolate past
+        //the first and last one
+        auto it=upper_bound(syncs.begin(),syncs.end(),make_pair(t,0LL),
+            [](const pair<long long,long long>& a,
+               const pair<long long,long long>& b){ return a.first<b.first; });
+        if(it==syncs.begin()) ++it;
+        if(it==syncs.end()) --it;
+        auto prev=it-1;
+        double scale=static_cast<double>(it->second-prev->second)/
+                     static_cast<double>(it->first-prev->first);
+        return prev->second+(t-prev->first)*scale;
+    }
+
+private:
+    vector<long long> ticks;                 ///< Unwrapped timestamps
+    vector<pair<long long,long long>> syncs; ///< Timestamp, time in ns
+};
+
+/**
+ * Writes Chrome trace JSON events
+ */
+class ChromeTraceWriter
+{
+public:
+    /// Track where the running thread is shown
+    static const int cpuTrack=0;
+    /// Track where interrupts are shown
+    static const int irqTrack=1;
+
+    ChromeTraceWriter(ostream& os) : os(os)
+    {
+        os<<"{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n";
+        metadata(cpuTrack,"CPU");
+        metadata(irqTrack,"Interrupts");
+    }
+
+    /**
+     * \param thread a thread pointer
+     * \return the track of the thread, allocating a new one the first time
+     */
+    int track(unsigned int thread)
+    {
+        auto it=tracks.find(thread);
+        if(it!=tracks.end()) return it->second;
+        int result=tracks.size()+irqTrack+1;
+        tracks[thread]=result;
+        metadata(result,threadName(thread));
+        return result;
+    }
+
+    /**
+     * \param thread a thread pointer
+     * \return the thread name
+     */
+    static string threadName(unsigned int thread)
+    {
+        return "thread "+hex(thread);
+    }
+
+    /**
+     * \param x a number
+     * \return the number formatted as 0x%08x
+     */
+    static string hex(unsigned int x)
+    {
+        ostringstream ss;
+        ss<<"0x"<<std::hex<<setw(8)<<setfill('0')<<x;
+        return ss.str();
+    }
+
+    /// A complete event, a slice with a start time and duration
+    void complete(int tid, const string& name, double ns, double durNs)
+    {
+        begin("X",tid,name,ns);
+        os<<",\"dur\":"<<fixed<<setprecision(3)<<durNs/1000.0;
+        end();
+    }
+
+    /// Start of a slice
+    void sliceBegin(int tid, const string& name, double ns)
+    {
+        begin("B",tid,name,ns);
+        end();
+    }
+
+    /// End of the last slice started on a track
+    void sliceEnd(int tid, const string& name, double ns)
+    {
+        begin("E",tid,name,ns);
+        end();
+    }
+
+    /// An instant event, with optional arguments already formatted as JSON
+    void instant(int tid, const string& name, double ns, const string& args="")
+    {
+        begin("i",tid,name,ns);
+        os<<",\"s\":\"t\"";
+        if(!args.empty()) os<<",\"args\":{"<<args<<"}";
+        end();
+    }
+
+    /// An instant event shown on all tracks
+    void globalInstant(const string& name, double ns)
+    {
+        begin("i",cpuTrack,name,ns);
+        os<<",\"s\":\"g\"";
+        end();
+    }
+
+    ~ChromeTraceWriter()
+    {
+        os<<"\n]}\n";
+    }
+
+private:
+    void metadata(int tid, const string& name)
+    {
+        separator();
+        os<<"{\"ph\":\"M\",\"pid\":1,\"tid\":"<<tid
+          <<",\"name\":\"thread_name\",\"args\":{\"name\":\""<<name<<"\"}}";
+    }
+
+    void begin(const char *ph, int tid, const string& name, double ns)
+    {
+        separator();
+        os<<"{\"ph\":\""<<ph<<"\",\"pid\":1,\"tid\":"<<tid<<",\"name\":\""
+          <<name<<"\",\"ts\":"<<fixed<<setprecision(3)<<ns/1000.0;
+    }
+
+    void end() { os<<"}"; }
+
+    void separator()
+    {
+        if(first) first=false; else os<<",\n";
+    }
+
+    ostream& os;
+    map<unsigned int,int> tracks; ///< Thread pointer to track id
+    bool first=true;
+};
+
+/**
+ * \param id interrupt id of an IrqEnter or IrqExit event
+ * \return the interrupt name
+ */
+static string irqName(unsigned short id)
+{
+    if(id==traceOsTimerIrq) return "os timer";
+    return "irq "+to_string(id);
+}
+
+int main(int argc, char *argv[])
+try {
+    if(argc!=3)
+    {
+        cerr<<"usage: tracedecoder trace.bin trace.json"<<endl;
+        return 1;
+    }
+    ifstream in(argv[1],ios::binary);
+    if(!in) throw runtime_error("can't open input file");
+    vector<TraceEvent> events;
+    TraceEvent e;
+    while(in.read(reinterpret_cast<char*>(&e),sizeof(e))) events.push_back(e);
+    if(events.empty() || events[0].type!=TraceEventType::Header
+        || events[0].a!=traceMagic || events[0].b!=sizeof(TraceEvent))
+        throw runtime_error("not a Miosix kernel trace");
+    if(events[0].arg16!=traceVersion)
+        throw runtime_error("unsupported trace version");
+    TimeBase tb(events);
+
+    ofstream out(argv[2]);
+    if(!out) throw runtime_error("can't open output file");
+    ChromeTraceWriter w(out);
+
+    //The running thread is only known from context switches, the first one
+    //also tells which thread was running since the beginning
+    unsigned int running=0;
+    bool runningKnown=false;
+    for(auto& ev : events)
+    {
+        if(ev.type!=TraceEventType::ContextSwitch) continue;
+        running=ev.a;
+        runningKnown=true;
+        break;
+    }
+    double runningSince=tb.ns(0);
+    int lost=0;
+
+    for(size_t i=0;i<events.size();i++)
+    {
+        const TraceEvent& ev=events[i];
+        double ns=tb.ns(i);
+        switch(ev.type)
+        {
+            case TraceEventType::ContextSwitch:
+                w.track(ev.a);
+                w.complete(ChromeTraceWriter::cpuTrack,
+                    ChromeTraceWriter::threadName(ev.a),runningSince,
+                    ns-runningSince);
+                w.track(ev.b);
+                running=ev.b;
+                runningSince=ns;
+                break;
+            case TraceEventType::Wakeup:
+                w.instant(w.track(ev.a),"wakeup",ns,runningKnown ?
+                    "\"by\":\""+ChromeTraceWriter::threadName(running)+"\"" : "");
+                break;
+            case TraceEventType::Sleep:
+                w.instant(w.track(ev.a),"sleep",ns);
+                break;
+            case TraceEventType::Wait:
+                w.instant(w.track(ev.a),"wait",ns);
+                break;
+            case TraceEventType::MutexBlock:
+                if(!runningKnown) break;
+                w.instant(w.track(running),"mutex block",ns,
+                    "\"mutex\":\""+ChromeTraceWriter::hex(ev.a)+"\",\"owner\":\""
+                    +ChromeTraceWriter::threadName(ev.b)+"\"");
+                break;
+            case TraceEventType::SyscallEnter:
+                if(!runningKnown) break;
+                w.sliceBegin(w.track(running),"syscall "+to_string(ev.arg16),ns);
+                break;
+            case TraceEventType::SyscallExit:
+                if(!runningKnown) break;
+                w.sliceEnd(w.track(running),"syscall "+to_string(ev.arg16),ns);
+                break;
+            case TraceEventType::IrqEnter:
+                w.sliceBegin(ChromeTraceWriter::irqTrack,irqName(ev.arg16),ns);
+                break;
+            case TraceEventType::IrqExit:
+                w.sliceEnd(ChromeTraceWriter::irqTrack,irqName(ev.arg16),ns);
+                break;
+            case TraceEventType::Lost:
+                lost+=ev.a;
+                w.globalInstant("lost "+to_string(ev.a)+" events",ns);
+                break;
+            default:
+                break;
+        }
+    }
+    if(runningKnown)
+        w.complete(ChromeTraceWriter::cpuTrack,
+            ChromeTraceWriter::threadName(running),runningSince,
+            tb.ns(events.size()-1)-runningSince);
+    if(lost>0)
+        cerr<<"warning: "<<lost<<" events were lost, increase "
+              "KERNEL_TRACE_EVENTS or drain more often"<<endl;
+    return 0;
+} catch(exception& e) {
+    cerr<<"error: "<<e.what()<<endl;
+    return 1;
+}
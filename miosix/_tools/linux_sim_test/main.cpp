@@ -0,0 +1,381 @@
+/***************************************************************************
+ *   Copyright (C) 2024 by Terraneo Federico                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+/*
+ * Test of the linux_sim architecture port, built with the stock host gcc.
+ * The real stage 1 boot, context switch, interrupt disable, sleepCpu, os timer
+ * and fault handlers are linked with the linux_sim linker script, but the
+ * kernel is replaced by the small round robin scheduler below, so neither
+ * newlib nor the i686-miosix-elf toolchain are needed. See Readme.txt
+ */
+
+#include "interfaces/portability.h"
+#include "interfaces/arch_registers.h"
+#include "interfaces/delays.h"
+#include "interfaces/os_timer.h"
+#include "interfaces/bsp.h"
+#include "kernel/kernel.h"
+#include "kernel/error.h"
+#include "kernel/logging.h"
+#include "kernel/scheduler/scheduler.h"
+#include "kernel/stage_2_boot.h"
+
+using namespace miosix;
+using namespace miosix_private;
+
+//
+// Output
+//
+
+static void print(const char *s)
+{
+    unsigned int len=0;
+    while(s[len]) len++;
+    host::write(1,s,len);
+}
+
+static void printNumber(long long x)
+{
+    char buf[24];
+    int i=sizeof(buf);
+    buf[--i]='\0';
+    bool negative=x<0;
+    unsigned long long u=negative ? -x : x;
+    do {
+        buf[--i]='0'+u%10;
+        u/=10;
+    } while(u);
+    if(negative) buf[--i]='-';
+    print(buf+i);
+}
+
+static void __attribute__((noreturn)) fail(const char *s)
+{
+    print("Test failed: ");
+    print(s);
+    print("\n");
+    host::exitGroup(1);
+}
+
+//
+// What the port uses from the kernel
+//
+
+namespace miosix {
+
+const char *simDiskImage=simDefaultDiskImage;
+const char *simRomFsImage=simDefaultRomFsImage;
+
+void errorHandler(Error)
+{
+    fail("errorHandler() called");
+}
+
+} //namespace miosix
+
+void IRQerrorLog(const char *string)
+{
+    unsigned int len=0;
+    while(string[len]) len++;
+    host::write(2,string,len);
+}
+
+extern "C" {
+
+volatile unsigned int *ctxsave;
+
+//Used by the compiler for struct copies and __builtin_memcpy
+void *memcpy(void *dest, const void *src, unsigned int n)
+{
+    auto d=reinterpret_cast<unsigned char*>(dest);
+    auto s=reinterpret_cast<const unsigned char*>(src);
+    for(unsigned int i=0;i<n;i++) d[i]=s[i];
+    return dest;
+}
+
+void *memset(void *dest, int c, unsigned int n)
+{
+    auto d=reinterpret_cast<unsigned char*>(dest);
+    for(unsigned int i=0;i<n;i++) d[i]=c;
+    return dest;
+}
+
+//64 bit division, from libgcc on a real toolchain, but a stock gcc without
+//32 bit multilib support has no 32 bit libgcc
+unsigned long long __udivmoddi4(unsigned long long n, unsigned long long d,
+                                unsigned long long *rem)
+{
+    unsigned long long q=0, r=0;
+    for(int i=63;i>=0;i--)
+    {
+        r=(r<<1) | ((n>>i) & 1);
+        if(r>=d) { r-=d; q|=1ull<<i; }
+    }
+    if(rem) *rem=r;
+    return q;
+}
+
+unsigned long long __udivdi3(unsigned long long n, unsigned long long d)
+{
+    return __udivmoddi4(n,d,nullptr);
+}
+
+unsigned long long __umoddi3(unsigned long long n, unsigned long long d)
+{
+    unsigned long long r;
+    __udivmoddi4(n,d,&r);
+    return r;
+}
+
+long long __divdi3(long long n, long long d)
+{
+    bool negative=(n<0)!=(d<0);
+    unsigned long long q=__udivdi3(n<0 ? -n : n,d<0 ? -d : d);
+    return negative ? -q : q;
+}
+
+long long __moddi3(long long n, long long d)
+{
+    unsigned long long r=__umoddi3(n<0 ? -n : n,d<0 ? -d : d);
+    return n<0 ? -r : r;
+}
+
+long long __divmoddi4(long long n, long long d, long long *rem)
+{
+    if(rem) *rem=__moddi3(n,d);
+    return __divdi3(n,d);
+}
+
+} //extern "C"
+
+//
+// Scheduler
+//
+
+/// Threads 1 to numThreads-1 are the test threads, 0 is the idle thread
+const int numThreads=4;
+const long long tick=1000000; //1ms
+const int stackSize=16*1024;
+
+struct TestThread
+{
+    unsigned int ctxsave[CTXSAVE_SIZE];
+    bool runnable;
+    bool done;
+    long long wakeup;
+};
+
+static TestThread threads[numThreads];
+static unsigned int stacks[numThreads][stackSize/4] __attribute__((aligned(16)));
+static volatile int current=0;
+static volatile int preemptions=0;
+static volatile int ticks=0;
+
+void Thread::yield()
+{
+    doYield();
+}
+
+void Thread::IRQstackOverflowCheck() {}
+
+void Scheduler::IRQfindNextThread()
+{
+    for(int i=1;i<=numThreads;i++)
+    {
+        int next=(current+i)%numThreads;
+        if(next==0 || threads[next].runnable==false) continue;
+        current=next;
+        ctxsave=threads[next].ctxsave;
+        return;
+    }
+    current=0;
+    ctxsave=threads[0].ctxsave;
+}
+
+void Thread::threadLauncher(void *(*threadfunc)(void*), void *argv)
+{
+    threadfunc(argv);
+    doDisableInterrupts();
+    threads[current].runnable=false;
+    threads[current].done=true;
+    doEnableInterrupts();
+    doYield();
+    fail("a terminated thread was scheduled");
+}
+
+void miosix::IRQtimerInterrupt(long long currentTime)
+{
+    ticks++;
+    for(int i=1;i<numThreads;i++)
+    {
+        if(threads[i].done || threads[i].runnable) continue;
+        if(threads[i].wakeup<=currentTime) threads[i].runnable=true;
+    }
+    internal::IRQosTimerSetInterrupt(currentTime+tick);
+    int old=current;
+    Scheduler::IRQfindNextThread();
+    if(current!=old && old!=0) preemptions++;
+}
+
+static void sleepUntil(long long when)
+{
+    doDisableInterrupts();
+    threads[current].wakeup=when;
+    threads[current].runnable=false;
+    doEnableInterrupts();
+    doYield();
+    long long now=getTime();
+    if(now<when) fail("woken up early");
+    if(now>when+100*tick) fail("woken up too late");
+    //The idle thread may have been interrupted while waiting in sleepCpu with
+    //interrupts disabled, and that must not leak to the next thread
+    if(checkAreInterruptsEnabled()==false)
+        fail("interrupts disabled after a context switch");
+}
+
+//
+// Tests
+//
+
+/**
+ * Keep values in SSE and x87 registers while being preempted and while
+ * yielding, if the FPU state is not saved the results are wrong
+ */
+static void *fpuTest(void *argv)
+{
+    const int id=reinterpret_cast<int>(argv);
+    for(int i=0;i<20;i++)
+    {
+        double a=id+0.5, s=0.0;
+        long double b=id+0.25, t=0.0;
+        for(int j=0;j<1000000;j++) { s+=a; t+=b; }
+        if(s!=a*1000000.0) fail("SSE state corrupted");
+        if(t!=b*1000000.0L) fail("x87 state corrupted");
+        if(i%4==0) doYield();
+        if(i%5==0) sleepUntil(getTime()+2*tick);
+    }
+    return nullptr;
+}
+
+/**
+ * Disabling interrupts blocks the timer, and the pending interrupt is taken
+ * when they are enabled again
+ */
+static void *irqTest(void *)
+{
+    for(int i=0;i<5;i++)
+    {
+        doDisableInterrupts();
+        if(checkAreInterruptsEnabled()) fail("checkAreInterruptsEnabled()");
+        int p=preemptions;
+        int t=ticks;
+        delayMs(20);
+        if(p!=preemptions || t!=ticks) fail("interrupted with interrupts disabled");
+        doEnableInterrupts();
+        long long end=getTime()+100*tick;
+        while(ticks==t) if(getTime()>end) fail("timer interrupt lost");
+        sleepUntil(getTime()+5*tick);
+    }
+    return nullptr;
+}
+
+/**
+ * The idle thread sleeps with interrupts enabled and disabled, as the kernel
+ * idle thread does without and with WITH_DEEP_SLEEP. Also waits for the test
+ * threads, and ends the test
+ */
+static void *idle(void *)
+{
+    int enabledSleeps=0, disabledSleeps=0;
+    for(int i=0;;i++)
+    {
+        bool done=true;
+        for(int j=1;j<numThreads;j++) if(threads[j].done==false) done=false;
+        if(done) break;
+        if(i & 1)
+        {
+            doDisableInterrupts();
+            sleepCpu();
+            if(checkAreInterruptsEnabled())
+                fail("sleepCpu() enabled interrupts");
+            doEnableInterrupts();
+            disabledSleeps++;
+        } else {
+            sleepCpu();
+            if(checkAreInterruptsEnabled()==false)
+                fail("sleepCpu() disabled interrupts");
+            enabledSleeps++;
+        }
+    }
+    if(enabledSleeps==0 || disabledSleeps==0) fail("idle thread never slept");
+    if(preemptions==0) fail("no preemption");
+    print("ticks ");
+    printNumber(ticks);
+    print(", preemptions ");
+    printNumber(preemptions);
+    print(", idle sleeps ");
+    printNumber(enabledSleeps);
+    print(" with interrupts enabled, ");
+    printNumber(disabledSleeps);
+    print(" disabled\n");
+    print("Test passed\n");
+    host::exitGroup(0);
+}
+
+/**
+ * Host system calls used by the block device and RomFs drivers, on the file
+ * passed with -d
+ */
+static void fileTest()
+{
+    int fd=host::open(simDiskImage,host::O_RDONLY_);
+    if(fd<0) fail("open");
+    long long size=host::fileSize(fd);
+    if(size<4) fail("fileSize");
+    unsigned char head[4];
+    if(host::pread(fd,head,4,0)!=4) fail("pread");
+    const unsigned char *m=reinterpret_cast<const unsigned char*>(
+        host::mmap(size,host::PROT_READ_,host::MAP_PRIVATE_,fd));
+    if(reinterpret_cast<unsigned int>(m)>=0xfffff000u) fail("mmap");
+    for(int i=0;i<4;i++) if(m[i]!=head[i]) fail("mmap content");
+    if(host::close(fd)!=0) fail("close");
+}
+
+void _init()
+{
+    fileTest();
+    internal::IRQosTimerInit();
+    internal::IRQosTimerSetInterrupt(getTime()+tick);
+    for(int i=0;i<numThreads;i++)
+    {
+        void *(*f)(void*)=i==0 ? idle : i==numThreads-1 ? irqTest : fpuTest;
+        threads[i].runnable=true;
+        initCtxsave(threads[i].ctxsave,f,stacks[i]+stackSize/4,
+                    reinterpret_cast<void*>(i));
+    }
+    IRQportableStartKernel();
+}
@@ -0,0 +1,10 @@
+//Stand-in for interfaces/bsp.h, only what the linux_sim port needs
+
+#pragma once
+
+namespace miosix {
+
+extern const char *simDiskImage;
+extern const char *simRomFsImage;
+
+} //namespace miosix
@@ -0,0 +1,20 @@
+//Stand-in for interfaces/os_timer.h, only what the linux_sim port needs
+
+#pragma once
+
+namespace miosix {
+
+namespace internal {
+
+void IRQosTimerInit();
+void IRQosTimerSetInterrupt(long long ns) noexcept;
+void IRQosTimerSetTime(long long ns) noexcept;
+unsigned int osTimerGetFrequency();
+void IRQtimerInterruptHandler();
+
+} //namespace internal
+
+/// Called by the os timer, the test has its own implementation
+void IRQtimerInterrupt(long long currentTime);
+
+} //namespace miosix
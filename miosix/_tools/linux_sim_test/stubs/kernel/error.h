@@ -0,0 +1,14 @@
+//Stand-in for kernel/error.h, only what the linux_sim port needs
+
+#pragma once
+
+namespace miosix {
+
+enum Error
+{
+    UNEXPECTED
+};
+
+void errorHandler(Error e);
+
+} //namespace miosix
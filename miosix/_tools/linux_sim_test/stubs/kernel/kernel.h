@@ -0,0 +1,22 @@
+//Stand-in for kernel/kernel.h, only what the linux_sim port needs
+
+#pragma once
+
+#include "config/miosix_settings.h"
+#include "interfaces/portability.h"
+
+namespace miosix {
+
+class Thread
+{
+public:
+    static void yield();
+    static void IRQstackOverflowCheck();
+    static void threadLauncher(void *(*threadfunc)(void*), void *argv);
+};
+
+long long getTime() noexcept;
+
+long long IRQgetTime() noexcept;
+
+} //namespace miosix
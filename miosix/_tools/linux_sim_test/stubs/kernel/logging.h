@@ -0,0 +1,5 @@
+//Stand-in for kernel/logging.h, only what the linux_sim port needs
+
+#pragma once
+
+void IRQerrorLog(const char *string);
@@ -0,0 +1,13 @@
+//Stand-in for kernel/scheduler/scheduler.h, the test has its own scheduler
+
+#pragma once
+
+namespace miosix {
+
+class Scheduler
+{
+public:
+    static void IRQfindNextThread();
+};
+
+} //namespace miosix
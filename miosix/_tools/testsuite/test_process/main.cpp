@@ -59,8 +59,15 @@ int main(int argc, char *argv[], char *envp[])
     {
         if(strcmp("sys_test_getpid_child", argv[1])==0)
             return sys_test_getpid_child(argc, argv);
+        if(strcmp("proc_test_shm_child", argv[1])==0)
+            return proc_test_shm_child();
         if(strcmp("exit_123", argv[1])==0)
             exit(123);
+        if(strcmp("pipe_benchmark_writer", argv[1])==0)
+        {
+            pipeBenchmarkWriter(STDOUT_FILENO);
+            return 0;
+        }
         if(strcmp("sleep_and_exit_234", argv[1])==0)
         {
             sleep(1);
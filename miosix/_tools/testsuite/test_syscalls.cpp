@@ -37,7 +37,11 @@ static void fs_test_4();
 static void fs_test_5();
 static void fs_test_6();
 static void fs_test_7();
+static void fs_test_8();
+static void fs_test_9();
 static void sys_test_pipe();
+static void sys_test_poll();
+static void sys_test_mmap();
 #endif //WITH_FILESYSTEM
 static void sys_test_time();
 static void sys_test_getpid();
@@ -46,6 +50,8 @@ static void sys_test_isatty();
 static void sys_test_spawn();
 #ifdef IN_PROCESS
 static void proc_test_global_ctor_dtor();
+static void proc_test_threads();
+static void proc_test_shm();
 #endif
 #endif
 
@@ -62,7 +68,11 @@ void test_syscalls()
     fs_test_5();
     fs_test_6();
     fs_test_7();
+    fs_test_8();
+    fs_test_9();
     sys_test_pipe();
+    sys_test_poll();
+    sys_test_mmap();
     #else //WITH_FILESYSTEM
     iprintf("Filesystem tests skipped, filesystem support is disabled\n");
     #endif //WITH_FILESYSTEM
@@ -73,6 +83,8 @@ void test_syscalls()
     sys_test_spawn();
     #ifdef IN_PROCESS
     proc_test_global_ctor_dtor();
+    proc_test_threads();
+    proc_test_shm();
     #endif
     #endif
     #ifndef IN_PROCESS
@@ -126,6 +138,14 @@ pid_t spawnWithPipe(const char *arg[], int& pipeFdOut)
     return pid;
 }
 
+void pipeBenchmarkWriter(int fd)
+{
+    const int chunkSize=1024;
+    static char chunk[chunkSize];
+    for(int i=0;i<pipeBenchmarkSize;i+=chunkSize)
+        if(write(fd,chunk,chunkSize)!=chunkSize) break;
+}
+
 #ifdef WITH_FILESYSTEM
 //
 // Filesystem test 1
@@ -980,6 +1000,84 @@ static void fs_test_7()
     pass();
 }
 
+//
+// Filesystem test 8
+//
+/*
+tests:
+pread
+pwrite
+*/
+
+static void fs_test_8()
+{
+    test_name("pread/pwrite");
+    const char name[]="/sd/testdir/file_p.txt";
+    const char data[]="0123456789abcdef";
+    int fd=open(name,O_RDWR|O_CREAT|O_TRUNC,0);
+    if(fd<0) fail("open");
+    if(write(fd,data,16)!=16) fail("write");
+    if(pwrite(fd,"XY",2,4)!=2) fail("pwrite");
+    if(lseek(fd,0,SEEK_CUR)!=16) fail("pwrite moved the file pointer");
+    char buf[16];
+    if(pread(fd,buf,6,2)!=6) fail("pread");
+    if(memcmp(buf,"23XY67",6)) fail("pread data");
+    if(lseek(fd,0,SEEK_CUR)!=16) fail("pread moved the file pointer");
+    if(pread(fd,buf,16,12)!=4) fail("pread past end of file");
+    if(memcmp(buf,"cdef",4)) fail("pread data at end of file");
+    if(pread(fd,buf,4,-1)!=-1 || errno!=EINVAL) fail("pread negative offset");
+    //Data must be visible to plain read as well
+    if(lseek(fd,0,SEEK_SET)!=0) fail("lseek");
+    if(read(fd,buf,16)!=16) fail("read");
+    if(memcmp(buf,"0123XY6789abcdef",16)) fail("read data");
+    if(close(fd)) fail("close");
+    if(unlink(name)) fail("unlink");
+    int fds[2];
+    if(pipe(fds)) fail("pipe");
+    if(pread(fds[0],buf,1,0)!=-1 || errno!=ESPIPE) fail("pread on pipe");
+    close(fds[0]);
+    close(fds[1]);
+    pass();
+}
+
+//
+// Filesystem test 9
+//
+/*
+tests:
+readv
+writev
+*/
+
+static void fs_test_9()
+{
+    test_name("readv/writev");
+    const char name[]="/sd/testdir/file_v.txt";
+    int fd=open(name,O_RDWR|O_CREAT|O_TRUNC,0);
+    if(fd<0) fail("open");
+    char hdr[]="header:";
+    char payload[]="payload";
+    struct iovec wr[3];
+    wr[0].iov_base=hdr;     wr[0].iov_len=7;
+    wr[1].iov_base=nullptr; wr[1].iov_len=0; //Empty buffers are allowed
+    wr[2].iov_base=payload; wr[2].iov_len=7;
+    if(writev(fd,wr,3)!=14) fail("writev");
+    if(lseek(fd,0,SEEK_CUR)!=14) fail("writev file pointer");
+    if(writev(fd,wr,-1)!=-1 || errno!=EINVAL) fail("writev negative count");
+    if(lseek(fd,0,SEEK_SET)!=0) fail("lseek");
+    char a[5], b[16];
+    struct iovec rd[2];
+    rd[0].iov_base=a; rd[0].iov_len=sizeof(a);
+    rd[1].iov_base=b; rd[1].iov_len=sizeof(b);
+    //Reaching end of file while filling the second buffer
+    if(readv(fd,rd,2)!=14) fail("readv");
+    if(memcmp(a,"heade",5) || memcmp(b,"r:payload",9)) fail("readv data");
+    if(readv(fd,rd,2)!=0) fail("readv at end of file");
+    if(close(fd)) fail("close");
+    if(unlink(name)) fail("unlink");
+    pass();
+}
+
 //
 // Pipe test
 //
@@ -988,6 +1086,8 @@ tests:
 dup
 dup2
 pipe
+fcntl(F_GETPIPE_SZ)
+fcntl(F_SETPIPE_SZ)
 */
 
 static void sys_test_pipe_tryReadAndWrite(int readFd, int writeFd, char c)
@@ -1085,6 +1185,23 @@ static void sys_test_pipe()
     if(close(dupReadFd)!=0) fail("close (4)");
     if(close(dupWriteFd)!=0) fail("close (5)");
 
+    //Changing the pipe capacity
+    if(pipe(pipeFds)!=0) fail("pipe (2)");
+    if(fcntl(pipeFds[0],F_GETPIPE_SZ)<=0) fail("F_GETPIPE_SZ");
+    const int bufSize=512;
+    if(fcntl(pipeFds[1],F_SETPIPE_SZ,bufSize)!=bufSize) fail("F_SETPIPE_SZ");
+    if(fcntl(pipeFds[0],F_GETPIPE_SZ)!=bufSize) fail("F_GETPIPE_SZ (2)");
+    char buf[bufSize];
+    memset(buf,'a',bufSize);
+    //Would block forever if the pipe had not grown, as there is no reader
+    if(write(pipeFds[1],buf,bufSize)!=bufSize) fail("write (resized)");
+    if(fcntl(pipeFds[0],F_SETPIPE_SZ,bufSize/2)!=-1 || errno!=EBUSY)
+        fail("F_SETPIPE_SZ (EBUSY)");
+    memset(buf,0,bufSize);
+    if(read(pipeFds[0],buf,bufSize)!=bufSize) fail("read (resized)");
+    for(int i=0;i<bufSize;i++) if(buf[i]!='a') fail("read (resized) data");
+    if(close(pipeFds[0])!=0 || close(pipeFds[1])!=0) fail("close (6)");
+
     #ifndef IN_PROCESS
     sys_test_pipe_tryLargeReadAndWrite(100, 512);
     sys_test_pipe_tryLargeReadAndWrite(512, 512);
@@ -1094,6 +1211,152 @@ static void sys_test_pipe()
     pass();
 }
 
+//
+// Poll test
+//
+/*
+tests:
+poll
+*/
+
+static void sys_test_poll()
+{
+    test_name("poll");
+    int fds[2];
+    if(pipe(fds)!=0) fail("pipe");
+    struct pollfd pfd[2];
+    pfd[0].fd=fds[0];
+    pfd[0].events=POLLIN;
+    pfd[1].fd=-1; //Negative file descriptors are ignored
+    pfd[1].events=POLLIN;
+    if(poll(pfd,2,0)!=0) fail("poll on empty pipe");
+    pfd[0].events=POLLIN | POLLOUT;
+    if(poll(pfd,2,0)!=1 || pfd[0].revents!=POLLOUT || pfd[1].revents!=0)
+        fail("POLLOUT");
+    pfd[0].events=POLLIN;
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC,&t0);
+    if(poll(pfd,1,50)!=0) fail("poll timeout");
+    clock_gettime(CLOCK_MONOTONIC,&t1);
+    long long dt=(t1.tv_sec-t0.tv_sec)*1000000000LL+(t1.tv_nsec-t0.tv_nsec);
+    if(dt<45000000) fail("poll returned before timeout");
+    char c;
+    if(write(fds[1],"x",1)!=1) fail("write");
+    if(poll(pfd,1,-1)!=1 || pfd[0].revents!=POLLIN) fail("POLLIN");
+    if(read(fds[0],&c,1)!=1 || c!='x') fail("read");
+    #ifndef IN_PROCESS
+    //Wakeup from another thread while blocked in poll
+    std::thread t([&]{ usleep(20000); write(fds[1],"y",1); });
+    if(poll(pfd,1,1000)!=1 || pfd[0].revents!=POLLIN) fail("poll wakeup");
+    t.join();
+    if(read(fds[0],&c,1)!=1 || c!='y') fail("read (2)");
+    #endif
+    pfd[1].fd=1000; //Way past the file descriptor table size
+    if(poll(pfd,2,0)!=1 || pfd[1].revents!=POLLNVAL) fail("POLLNVAL");
+    if(close(fds[0])!=0 || close(fds[1])!=0) fail("close");
+    pass();
+}
+
+//
+// mmap test
+//
+/*
+tests:
+mmap
+munmap
+*/
+
+/**
+ * Map a file and check that the mapping matches the file content
+ * \param fd file descriptor
+ * \param off offset into the file
+ * \param len mapping length
+ * \return the mapping
+ */
+static const char *mmapAndCheck(int fd, off_t off, size_t len)
+{
+    void *p=mmap(nullptr,len,PROT_READ,MAP_PRIVATE,fd,off);
+    if(p==MAP_FAILED) fail("mmap");
+    char *buf=new char[len];
+    if(pread(fd,buf,len,off)!=static_cast<ssize_t>(len)) fail("pread");
+    if(memcmp(p,buf,len)!=0) fail("mmap content");
+    delete[] buf;
+    return reinterpret_cast<const char*>(p);
+}
+
+static void sys_test_mmap()
+{
+    test_name("mmap");
+    int fds[2];
+    if(pipe(fds)!=0) fail("pipe");
+    //Pipes have no content that can be mapped
+    if(mmap(nullptr,16,PROT_READ,MAP_PRIVATE,fds[0],0)!=MAP_FAILED
+        || errno!=ENXIO) fail("mmap pipe");
+    if(mmap(nullptr,16,PROT_READ,MAP_PRIVATE,1000,0)!=MAP_FAILED
+        || errno!=EBADF) fail("mmap bad fd");
+    if(mmap(nullptr,16,PROT_READ|PROT_WRITE,MAP_SHARED,fds[0],0)!=MAP_FAILED
+        || errno!=ENOTSUP) fail("mmap PROT_WRITE");
+    if(close(fds[0])!=0 || close(fds[1])!=0) fail("close");
+    //Find a file in RomFs, that can be mapped without copying it
+    DIR *d=opendir("/bin");
+    if(d==nullptr)
+    {
+        iprintf("No /bin directory, mmap of files not tested\n");
+        pass();
+        return;
+    }
+    std::string name;
+    struct stat st;
+    while(struct dirent *de=readdir(d))
+    {
+        if(de->d_type!=DT_REG) continue;
+        std::string path=std::string("/bin/")+de->d_name;
+        if(stat(path.c_str(),&st)!=0) fail("stat");
+        if(st.st_size<256) continue;
+        name=path;
+        break;
+    }
+    closedir(d);
+    if(name.empty())
+    {
+        iprintf("No files in /bin, mmap of files not tested\n");
+        pass();
+        return;
+    }
+    int fd=open(name.c_str(),O_RDONLY);
+    if(fd<0) fail("open");
+    if(mmap(nullptr,st.st_size+1,PROT_READ,MAP_PRIVATE,fd,0)!=MAP_FAILED
+        || errno!=ENXIO) fail("mmap past the end");
+    const char *p1=mmapAndCheck(fd,0,st.st_size);
+    #ifdef IN_PROCESS
+    //Files in RomFs are mapped in place by the kernel, the first mapping must
+    //not be a copy in the process heap
+    extern char _end asm("_end"); //Heap start, defined in the linker script
+    if(p1>=&_end && p1<reinterpret_cast<char*>(sbrk(0)))
+        fail("mmap of a file in RomFs is a heap copy");
+    #endif //IN_PROCESS
+    //Processes have only one memory protection region for mapped files, so
+    //the second mapping is a copy, but it must behave in the same way
+    const char *p2=mmapAndCheck(fd,128,st.st_size-128);
+    //The mapping outlives the file descriptor
+    if(close(fd)!=0) fail("close");
+    //Syscalls accept buffers in mapped files
+    if(pipe(fds)!=0) fail("pipe");
+    if(write(fds[1],p1,16)!=16) fail("write from mapping");
+    char buf[16];
+    if(read(fds[0],buf,16)!=16 || memcmp(buf,p1,16)!=0) fail("read");
+    if(close(fds[0])!=0 || close(fds[1])!=0) fail("close");
+    if(munmap(const_cast<char*>(p2),st.st_size-128)!=0) fail("munmap 2");
+    if(munmap(const_cast<char*>(p1),st.st_size)!=0) fail("munmap 1");
+    //The region for mapped files is available again
+    fd=open(name.c_str(),O_RDONLY);
+    if(fd<0) fail("open");
+    p1=mmapAndCheck(fd,0,st.st_size);
+    if(munmap(const_cast<char*>(p1),st.st_size)!=0) fail("munmap 3");
+    if(close(fd)!=0) fail("close");
+    pass();
+}
+
 #endif //WITH_FILESYSTEM
 
 //
@@ -1414,6 +1677,220 @@ static void proc_test_global_ctor_dtor()
     pass();
 }
 
+//
+// Threads in processes
+//
+/*
+tests:
+pthread_create
+pthread_join
+pthread_mutex_lock/unlock with contention
+per-thread errno
+pthread_once and static objects initialized by concurrent threads
+*/
+
+static pthread_mutex_t pt_mutex=PTHREAD_MUTEX_INITIALIZER;
+static volatile int pt_counter;
+
+static void *pt_thread(void *arg)
+{
+    errno=reinterpret_cast<int>(arg);
+    for(int i=0;i<1000;i++)
+    {
+        pthread_mutex_lock(&pt_mutex);
+        int c=pt_counter;
+        //Yield while holding the mutex to make other threads block on it
+        if((i % 100)==0) pthread_yield();
+        pt_counter=c+1;
+        pthread_mutex_unlock(&pt_mutex);
+    }
+    if(errno!=reinterpret_cast<int>(arg)) fail("errno not per-thread");
+    return reinterpret_cast<void*>(reinterpret_cast<int>(arg)+1);
+}
+
+static pthread_once_t pt_once=PTHREAD_ONCE_INIT;
+static volatile int pt_onceCalls;
+static volatile bool pt_onceDone;
+static volatile int pt_staticCtors;
+
+static void pt_onceFunc()
+{
+    pt_onceCalls++;
+    //Yield while initializing to make other threads wait for us
+    for(int i=0;i<10;i++) pthread_yield();
+    pt_onceDone=true;
+}
+
+struct PtStatic
+{
+    PtStatic()
+    {
+        pt_staticCtors++;
+        for(int i=0;i<10;i++) pthread_yield();
+        value=42;
+    }
+    volatile int value;
+};
+
+static void *pt_initThread(void *)
+{
+    pthread_once(&pt_once,pt_onceFunc);
+    if(pt_onceDone==false) fail("pthread_once returned before func");
+    static PtStatic s;
+    if(s.value!=42) fail("static object used before being constructed");
+    return nullptr;
+}
+
+static void proc_test_threads()
+{
+    test_name("Threads in processes");
+    const int numThreads=4;
+    pthread_t threads[numThreads];
+    pt_counter=0;
+    errno=0;
+    for(int i=0;i<numThreads;i++)
+        if(pthread_create(&threads[i],nullptr,pt_thread,
+            reinterpret_cast<void*>(100+i))!=0) fail("pthread_create");
+    for(int i=0;i<numThreads;i++)
+    {
+        void *result;
+        if(pthread_join(threads[i],&result)!=0) fail("pthread_join");
+        if(result!=reinterpret_cast<void*>(101+i)) fail("thread return value");
+    }
+    if(pt_counter!=numThreads*1000) fail("mutex");
+    if(errno!=0) fail("errno changed by other threads");
+    //Joining the same thread twice or the calling thread must fail
+    if(pthread_join(threads[0],nullptr)!=ESRCH) fail("pthread_join (2)");
+    if(pthread_join(pthread_self(),nullptr)!=ESRCH) fail("pthread_join (3)");
+
+    //Threads can be created again once the previous ones were joined
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr,4096);
+    pthread_t t;
+    if(pthread_create(&t,&attr,pt_thread,reinterpret_cast<void*>(5))!=0)
+        fail("pthread_create (2)");
+    pthread_attr_destroy(&attr);
+    void *result;
+    if(pthread_join(t,&result)!=0) fail("pthread_join (4)");
+    if(result!=reinterpret_cast<void*>(6)) fail("thread return value (2)");
+
+    //pthread_once and static objects are initialized by one thread, while
+    //the others wait for the initialization to complete
+    for(int i=0;i<numThreads;i++)
+        if(pthread_create(&threads[i],nullptr,pt_initThread,nullptr)!=0)
+            fail("pthread_create (3)");
+    for(int i=0;i<numThreads;i++)
+        if(pthread_join(threads[i],nullptr)!=0) fail("pthread_join (5)");
+    if(pt_onceCalls!=1) fail("pthread_once called func more than once");
+    if(pt_staticCtors!=1) fail("static object constructed more than once");
+    pass();
+}
+
+//
+// Shared memory
+//
+/*
+tests:
+shmget
+shmat
+shmdt
+shmctl
+sharing a segment with another process, and a futex in it
+SHM_RDONLY
+*/
+
+static const key_t shmTestKey=0x6d696f;
+static const int shmTestSize=1000;
+
+/**
+ * Runs in a process spawned by proc_test_shm(). Attaches the segment, writes
+ * a value and wakes the parent with a futex in the segment
+ */
+static int proc_test_shm_child()
+{
+    int id=shmget(shmTestKey,shmTestSize,0);
+    if(id<0) fail("shmget (child)");
+    auto s=reinterpret_cast<volatile int*>(shmat(id,nullptr,0));
+    if(s==reinterpret_cast<volatile int*>(-1)) fail("shmat (child)");
+    s[1]=0x12345678;
+    s[0]=1;
+    if(__futex_wake(&s[0],1)<0) fail("futex wake");
+    if(shmdt(const_cast<int*>(s))!=0) fail("shmdt (child)");
+    return 0;
+}
+
+static void proc_test_shm()
+{
+    test_name("Shared memory");
+    const key_t key=shmTestKey;
+    const int size=shmTestSize;
+    int id=shmget(key,size,IPC_CREAT | IPC_EXCL | 0600);
+    if(id<0) fail("shmget");
+    if(shmget(key,size,IPC_CREAT | IPC_EXCL | 0600)!=-1 || errno!=EEXIST)
+        fail("shmget (IPC_EXCL)");
+    if(shmget(key,size,0)!=id) fail("shmget (lookup)");
+    if(shmget(key,2*size*size,0)!=-1 || errno!=EINVAL) fail("shmget (size)");
+
+    auto p=reinterpret_cast<unsigned char*>(shmat(id,nullptr,0));
+    if(p==reinterpret_cast<unsigned char*>(-1)) fail("shmat");
+    for(int i=0;i<size;i++) if(p[i]!=0) fail("segment not zeroed");
+    for(int i=0;i<size;i++) p[i]=i & 0xff;
+    //Only one segment can be attached at a time
+    if(shmat(id,nullptr,0)!=reinterpret_cast<void*>(-1) || errno!=EMFILE)
+        fail("shmat (2)");
+    //Syscalls accept buffers in shared memory
+    int fd[2];
+    if(pipe(fd)!=0) fail("pipe");
+    if(write(fd[1],p,100)!=100) fail("write from shared memory");
+    if(read(fd[0],p+100,100)!=100) fail("read to shared memory");
+    close(fd[0]);
+    close(fd[1]);
+    if(memcmp(p,p+100,100)!=0) fail("pipe data");
+    if(shmdt(p)!=0) fail("shmdt");
+    if(shmdt(p)!=-1 || errno!=EINVAL) fail("shmdt (2)");
+
+    //Content is preserved across attachments
+    auto q=reinterpret_cast<unsigned char*>(shmat(id,nullptr,SHM_RDONLY));
+    if(q!=p) fail("shmat (3)");
+    for(int i=100;i<size;i++) if(q[i]!=(i & 0xff)) fail("segment content");
+    if(shmctl(id,IPC_RMID,nullptr)!=0) fail("shmctl");
+    //Removed segments are no longer found, but stay attached
+    if(shmget(key,size,0)!=-1 || errno!=ENOENT) fail("shmget (removed)");
+    if(q[size-1]!=((size-1) & 0xff)) fail("segment content (2)");
+    if(shmdt(q)!=0) fail("shmdt (3)");
+
+    //Another process attaching the segment sees the same memory, and can
+    //wake us with a futex in it
+    id=shmget(key,size,IPC_CREAT | IPC_EXCL | 0600);
+    if(id<0) fail("shmget (2)");
+    auto s=reinterpret_cast<volatile int*>(shmat(id,nullptr,0));
+    if(s==reinterpret_cast<volatile int*>(-1)) fail("shmat (4)");
+    const char *args[]={"/bin/test_process","proc_test_shm_child",nullptr};
+    const char *env[]={nullptr};
+    pid_t pid;
+    if(posix_spawn(&pid,args[0],NULL,NULL,(char* const*)args,
+        (char* const*)env)!=0) fail("posix_spawn");
+    while(s[0]==0) __futex_wait(&s[0],0);
+    if(s[1]!=0x12345678) fail("value written by the other process");
+    int pstat;
+    if(waitpid(pid,&pstat,0)!=pid) fail("waitpid");
+    if(!WIFEXITED(pstat) || WEXITSTATUS(pstat)!=0) fail("child process");
+    if(shmdt(const_cast<int*>(s))!=0) fail("shmdt (4)");
+
+    //Syscalls can't write to a read only attachment
+    auto r=reinterpret_cast<unsigned char*>(shmat(id,nullptr,SHM_RDONLY));
+    if(r==reinterpret_cast<unsigned char*>(-1)) fail("shmat (5)");
+    if(pipe(fd)!=0) fail("pipe (2)");
+    if(write(fd[1],"x",1)!=1) fail("write (2)");
+    if(read(fd[0],r,1)!=-1 || errno!=EFAULT) fail("read to SHM_RDONLY");
+    close(fd[0]);
+    close(fd[1]);
+    if(shmdt(r)!=0) fail("shmdt (5)");
+    if(shmctl(id,IPC_RMID,nullptr)!=0) fail("shmctl (2)");
+    pass();
+}
+
 #endif // IN_PROCESS
 
 #endif // WITH_PROCESSES
@@ -44,17 +44,38 @@
 #include <sys/time.h>
 #include <unistd.h>
 #include <sys/times.h>
+#include <pthread.h>
 #include <spawn.h>
 #include <sys/wait.h>
-#ifndef IN_PROCESS
+#ifdef IN_PROCESS
+#include <sys/uio.h>
+#include <poll.h>
+#include <sys/shm.h>
+#include <sys/mman.h>
+#else //IN_PROCESS
+//The kernel build does not have libsyscalls/include in the include path
+#include "libsyscalls/include/fcntl.h"
+#include "libsyscalls/include/sys/uio.h"
+#include "libsyscalls/include/poll.h"
+#include "libsyscalls/include/sys/shm.h"
+#include "libsyscalls/include/sys/mman.h"
 #include <thread>
-#endif
+#endif //IN_PROCESS
 
 int spawnAndWait(const char *arg[]);
 pid_t spawnWithPipe(const char *arg[], int& pipeFdOut);
 
+/// Number of bytes written by pipeBenchmarkWriter()
+const int pipeBenchmarkSize=256*1024;
+void pipeBenchmarkWriter(int fd);
+
 void test_syscalls();
 
 #ifdef IN_PROCESS
 static int sys_test_getpid_child(int argc, char *argv[]);
+static int proc_test_shm_child();
+
+//Nonstandard syscalls, defined in libsyscalls
+extern "C" int __futex_wait(volatile int *addr, int expected);
+extern "C" int __futex_wake(volatile int *addr, int count);
 #endif
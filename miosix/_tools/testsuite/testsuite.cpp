@@ -59,6 +59,7 @@
 #include "e20/e20.h"
 #include "kernel/intrusive.h"
 #include "util/crc16.h"
+#include "filesystem/file_access.h"
 
 #if defined(_ARCH_CORTEXM7_STM32F7) || defined(_ARCH_CORTEXM7_STM32H7)
 #include <kernel/scheduler/scheduler.h>
@@ -120,6 +121,9 @@ static void test_24();
 static void test_25();
 static void test_26();
 static void test_27();
+#ifdef WITH_TIMERS
+static void test_28();
+#endif //WITH_TIMERS
 #if defined(_ARCH_CORTEXM7_STM32F7) || defined(_ARCH_CORTEXM7_STM32H7)
 void testCacheAndDMA();
 #endif //_ARCH_CORTEXM7_STM32F7/H7
@@ -131,6 +135,18 @@ static void benchmark_1();
 static void benchmark_2();
 static void benchmark_3();
 static void benchmark_4();
+static void benchmark_5();
+#ifdef WITH_FILESYSTEM
+static void benchmark_6();
+#endif //WITH_FILESYSTEM
+static void benchmark_7();
+#ifdef WITH_PROCESSES
+static void benchmark_8();
+#endif //WITH_PROCESSES
+#ifdef WITH_FILESYSTEM
+static void benchmark_9();
+static void benchmark_10();
+#endif //WITH_FILESYSTEM
 //Exception thread safety test
 #ifndef __NO_EXCEPTIONS
 static void exception_test();
@@ -191,6 +207,9 @@ int main()
                 test_25();
                 test_26();
                 test_27();
+                #ifdef WITH_TIMERS
+                test_28();
+                #endif //WITH_TIMERS
                 #if defined(_ARCH_CORTEXM7_STM32F7) || defined(_ARCH_CORTEXM7_STM32H7)
                 testCacheAndDMA();
                 #endif //_ARCH_CORTEXM7_STM32F7/H7
@@ -223,6 +242,18 @@ int main()
                 benchmark_2();
                 benchmark_3();
                 benchmark_4();
+                benchmark_5();
+                #ifdef WITH_FILESYSTEM
+                benchmark_6();
+                #endif //WITH_FILESYSTEM
+                benchmark_7();
+                #ifdef WITH_PROCESSES
+                benchmark_8();
+                #endif //WITH_PROCESSES
+                #ifdef WITH_FILESYSTEM
+                benchmark_9();
+                benchmark_10();
+                #endif //WITH_FILESYSTEM
 
                 ledOff();
                 Thread::sleep(500);//Ensure all threads are deleted.
@@ -506,6 +537,17 @@ static void t3_p2(void *argv)
     }
 }
 
+#ifdef WITH_TIMER_SLACK
+static long long t3_v3;//Wakeup time of t3_p3
+
+static void t3_p3(void *argv)
+{
+    Thread::setTimerSlack(5000000);
+    Thread::nanoSleepUntil(*reinterpret_cast<long long*>(argv));
+    t3_v3=getTime();
+}
+#endif //WITH_TIMER_SLACK
+
 static void test_3()
 {
     test_name("time and sleep");
@@ -581,6 +623,22 @@ static void test_3()
         if(llabs(t2-time)/1000000>0) fail("Thread::nanoSleepUntil()");
         time+=period;
     }
+    #ifdef WITH_TIMER_SLACK
+    //Testing timer slack. t3_p3 sleeps until time with 5ms of slack, we sleep
+    //until time+3ms with no slack, so a single interrupt should wake both
+    if(Thread::getTimerSlack()!=DEFAULT_TIMER_SLACK) fail("getTimerSlack");
+    Thread::setTimerSlack(0);
+    time=getTime()+period;
+    auto stats=getTimerSlackStats();
+    p=Thread::create(t3_p3,STACK_SMALL,0,&time,Thread::JOINABLE);
+    if(!p) fail("thread creation (3)");
+    Thread::nanoSleepUntil(time+3000000);
+    p->join();
+    if(t3_v3<time || t3_v3>time+6000000) fail("timer slack (1)");
+    if(getTimerSlackStats().avoidedIrqs==stats.avoidedIrqs)
+        fail("timer slack (2)");
+    Thread::setTimerSlack(DEFAULT_TIMER_SLACK);
+    #endif //WITH_TIMER_SLACK
     pass();
 }
 
@@ -1357,11 +1415,17 @@ Queue::IRQput()
 Queue::IRQputBlocking()
 Queue::IRQget()
 Queue::IRQgetBlocking()
+SpscQueue::tryPut()
+SpscQueue::putMany()
+SpscQueue::tryGetMany()
+SpscQueue::get()
+SpscQueue::getMany()
 FIXME: The overloaded versions of IRQput and IRQget are not tested
 */
 
 static Queue<char,4> t8_q1;
 static Queue<char,4> t8_q2;
+static SpscQueue<char,5> t8_q3;
 
 static void t8_p1(void *argv)
 {
@@ -1374,6 +1438,21 @@ static void t8_p1(void *argv)
     }
 }
 
+static void t8_p2(void *argv)
+{
+    //Produce 'A' to 'Z' in chunks of varying size, so as to wrap around
+    const char alphabet[]="ABCDEFGHIJKLMNOPQRSTUVWXYZ";
+    unsigned int written=0, chunk=1;
+    while(written<26)
+    {
+        unsigned int n=min(chunk,26-written);
+        if(n==1) { if(t8_q3.tryPut(alphabet[written])) written++; }
+        else written+=t8_q3.putMany(alphabet+written,n);
+        Thread::yield();
+        if(++chunk>7) chunk=1;
+    }
+}
+
 static void test_8()
 {
     test_name("Queue class");
@@ -1480,6 +1559,28 @@ static void test_8()
     Thread::sleep(5);
     t8_q1.reset();
     t8_q2.reset();
+    //Test SpscQueue
+    t8_q3.reset();
+    if(t8_q3.isEmpty()==false || t8_q3.capacity()!=5) fail("SpscQueue empty");
+    if(t8_q3.putMany("abcdefg",7)!=5) fail("SpscQueue putMany");
+    if(t8_q3.isFull()==false || t8_q3.tryPut('h')) fail("SpscQueue full");
+    char buf[8];
+    if(t8_q3.tryGetMany(buf,3)!=3 || memcmp(buf,"abc",3)) fail("tryGetMany");
+    if(t8_q3.putMany("hij",3)!=3) fail("SpscQueue putMany (wrap)");
+    if(t8_q3.tryGetMany(buf,8)!=5 || memcmp(buf,"dehij",5)) fail("tryGetMany (wrap)");
+    if(t8_q3.isEmpty()==false || t8_q3.tryGetMany(buf,1)!=0) fail("SpscQueue empty (2)");
+    //Blocking get, between threads
+    p=Thread::create(t8_p2,STACK_SMALL,0,NULL,Thread::JOINABLE);
+    read='A';
+    while(read<='Z')
+    {
+        unsigned int n;
+        if(read & 1) n=t8_q3.getMany(buf,8);
+        else { t8_q3.get(buf[0]); n=1; }
+        for(unsigned int k=0;k<n;k++) if(buf[k]!=read++) fail("SpscQueue order");
+    }
+    p->join();
+    if(t8_q3.isEmpty()==false) fail("SpscQueue empty (3)");
     pass();
 }
 
@@ -3991,6 +4092,91 @@ static void test_27()
     pass();
 }
 
+#ifdef WITH_TIMERS
+//
+// Test 28
+//
+/*
+tests:
+Timer class
+EventTimer class
+*/
+
+static volatile int t28_v1;
+
+static void t28_f1(void *arg)
+{
+    t28_v1++;
+    if(arg) static_cast<Timer*>(arg)->IRQstop(); //Stop from the callback
+}
+
+static void t28_f2() { t28_v1+=10; }
+
+static void test_28()
+{
+    test_name("Timer class");
+    //One shot timer, callback in interrupt
+    t28_v1=0;
+    Timer t1(t28_f1,nullptr,TimerContext::Interrupt);
+    if(t1.isActive()) fail("isActive (1)");
+    t1.start(10000000);
+    if(t1.isActive()==false) fail("isActive (2)");
+    Thread::sleep(5);
+    if(t28_v1!=0) fail("expired too early (1)");
+    Thread::sleep(10);
+    if(t28_v1!=1) fail("not expired (1)");
+    if(t1.isActive()) fail("isActive (3)");
+    if(t1.stop()) fail("stop (1)");
+    //Periodic timer, callback in the service thread
+    t28_v1=0;
+    Timer t2(t28_f1);
+    long long start=getTime();
+    t2.startAt(start+5000000,5000000);
+    Thread::nanoSleepUntil(start+52000000);
+    if(t2.stop()==false) fail("stop (2)");
+    if(t28_v1!=10) fail("periodic");
+    Thread::sleep(20);
+    if(t28_v1!=10) fail("expired after stop");
+    //Restart as a watchdog, it should never expire while restarted
+    t28_v1=0;
+    t1.start(20000000);
+    for(int i=0;i<5;i++)
+    {
+        Thread::sleep(10);
+        t1.restart();
+    }
+    if(t28_v1!=0) fail("restart");
+    Thread::sleep(30);
+    if(t28_v1!=1) fail("not expired (2)");
+    //A periodic timer stopped from its own callback
+    t28_v1=0;
+    Timer t3(t28_f1,&t3,TimerContext::Interrupt);
+    t3.start(1000000,1000000);
+    Thread::sleep(10);
+    if(t28_v1!=1 || t3.isActive()) fail("stop from callback");
+    //Many timers expiring in any order
+    t28_v1=0;
+    Timer many[8]={{t28_f1},{t28_f1},{t28_f1},{t28_f1},
+                   {t28_f1},{t28_f1},{t28_f1},{t28_f1}};
+    for(int i=0;i<8;i++) many[i].start(1000000*((i*5)%8+1));
+    many[3].stop();
+    Thread::sleep(15);
+    if(t28_v1!=7) fail("multiple timers");
+    //EventTimer posting to a FixedEventQueue
+    t28_v1=0;
+    FixedEventQueue<2> queue;
+    EventTimer<2> et(queue,t28_f2);
+    et.start(1000000,2000000);
+    Thread::sleep(6);
+    et.stop();
+    if(queue.size()!=2 || et.getLostEvents()==0) fail("EventTimer (1)");
+    queue.runOne();
+    queue.runOne();
+    if(t28_v1!=20) fail("EventTimer (2)");
+    pass();
+}
+#endif //WITH_TIMERS
+
 #if defined(_ARCH_CORTEXM7_STM32F7) || defined(_ARCH_CORTEXM7_STM32H7)
 static Thread *waiting=nullptr; /// Thread waiting on DMA completion IRQ
 
@@ -4258,9 +4444,10 @@ static void benchmark_1()
     auto d=system_clock::now()-t;
     //every line dumps 16 bytes, and is 81 char long (considering \r\n)
     //so (2048/16)*81=10368
-    iprintf("Time required to print 10368 char is %lldms\n",
-        duration_cast<milliseconds>(d).count());
-    unsigned int baudrate=10368*10000/duration_cast<milliseconds>(d).count();
+    //At least 1ms, as on the Linux simulator printing may take less
+    long long ms=max<long long>(1,duration_cast<milliseconds>(d).count());
+    iprintf("Time required to print 10368 char is %lldms\n",ms);
+    unsigned int baudrate=10368*10000/ms;
     iprintf("Effective baud rate =%u\n",baudrate);
 }
 
@@ -4269,7 +4456,7 @@ static void benchmark_1()
 //
 /*
 tests:
-context switch speed
+context switch speed, also with many blocked threads
 */
 
 static bool b2_v1;
@@ -4285,8 +4472,24 @@ static void b2_p1(void *argv)
     }
 }
 
-static int b2_f1(int priority)
+static void b2_p2(void *argv)
 {
+    //Blocked thread, only wakes up when terminated
+    while(Thread::testTerminate()==false) Thread::wait();
+}
+
+static int b2_f1(int priority, int numBlocked=0)
+{
+    const int maxBlocked=32;
+    Thread *blocked[maxBlocked];
+    numBlocked=std::min(numBlocked,maxBlocked);
+    #ifndef SCHED_TYPE_EDF
+    //Blocked threads have the highest priority, so they are the first ones
+    //the scheduler would have to skip when looking for a ready thread
+    for(int i=0;i<numBlocked;i++)
+        blocked[i]=Thread::create(b2_p2,STACK_MIN,PRIORITY_MAX-1,NULL,
+                                  Thread::JOINABLE);
+    #endif //SCHED_TYPE_EDF
     Thread::setPriority(priority);
     b2_v1=false;
     b2_v2=0;
@@ -4299,16 +4502,84 @@ static int b2_f1(int priority)
     t2->terminate();
     t1->join();
     t2->join();
+    for(int i=0;i<numBlocked;i++)
+    {
+        if(blocked[i]==nullptr) continue;
+        blocked[i]->terminate();
+        blocked[i]->join();
+    }
     return b2_v2;
 }
 
+#ifdef SCHED_TYPE_EDF
+static Thread *b2_v3[2];
+
+static void b2_p3(void *argv)
+{
+    //With EDF yield() does not switch between threads with the same deadline,
+    //so two threads wake each other and then wait
+    Thread *other=*reinterpret_cast<Thread**>(argv);
+    for(;;)
+    {
+        {
+            FastInterruptDisableLock dLock;
+            other->IRQwakeup();
+            if(Thread::testTerminate()) break;
+            Thread::IRQenableIrqAndWait(dLock);
+        }
+        if(b2_v1) b2_v2++;
+    }
+}
+
+static int b2_f2(int numBlocked=0)
+{
+    const int maxBlocked=32;
+    Thread *blocked[maxBlocked];
+    numBlocked=std::min(numBlocked,maxBlocked);
+    long long deadline=getTime()+10000000000LL;
+    //Blocked threads have earlier deadlines than the benchmark threads, so
+    //they are the ones the scheduler would have to skip
+    for(int i=0;i<numBlocked;i++)
+        blocked[i]=Thread::create(b2_p2,STACK_MIN,Priority(deadline-1000*i),
+                                  NULL,Thread::JOINABLE);
+    b2_v1=false;
+    b2_v2=0;
+    //The threads only start when we sleep, as our deadline is earlier
+    b2_v3[0]=Thread::create(b2_p3,STACK_SMALL,Priority(deadline),&b2_v3[1],
+                            Thread::JOINABLE);
+    b2_v3[1]=Thread::create(b2_p3,STACK_SMALL,Priority(deadline),&b2_v3[0],
+                            Thread::JOINABLE);
+    b2_v1=true; //Start counting
+    Thread::sleep(1000);
+    b2_v1=false; //Stop counting
+    b2_v3[0]->terminate();
+    b2_v3[1]->terminate();
+    b2_v3[0]->join();
+    b2_v3[1]->join();
+    for(int i=0;i<numBlocked;i++)
+    {
+        if(blocked[i]==nullptr) continue;
+        blocked[i]->terminate();
+        blocked[i]->join();
+    }
+    return b2_v2;
+}
+#endif //SCHED_TYPE_EDF
+
 static void benchmark_2()
 {
+    const int numBlocked[]={8,16,32};
     #ifndef SCHED_TYPE_EDF
     iprintf("%d context switch per second (max priority)\n",b2_f1(3));
     iprintf("%d context switch per second (min priority)\n",b2_f1(0));
+    for(int n : numBlocked)
+        iprintf("%d context switch per second (min priority, %d blocked threads)\n",
+                b2_f1(0,n),n);
     #else //SCHED_TYPE_EDF
-    iprintf("Context switch benchmark not possible with EDF\n");
+    iprintf("%d context switch per second (EDF)\n",b2_f2());
+    for(int n : numBlocked)
+        iprintf("%d context switch per second (EDF, %d blocked threads)\n",
+                b2_f2(n),n);
     #endif //SCHED_TYPE_EDF
 }
 
@@ -4401,6 +4672,7 @@ static void benchmark_3()
 /*
 tests:
 Mutex lock/unlock time
+FastMutex lock/unlock time, with and without contention
 */
 
 volatile bool b4_end=false;
@@ -4412,6 +4684,19 @@ void b4_t1(void *argv)
     b4_end=true;
 }
 
+static FastMutex b4_m;
+static volatile int b4_count;
+
+static void b4_t2(void *argv)
+{
+    while(b4_end==false)
+    {
+        b4_m.lock();
+        b4_count++;
+        b4_m.unlock();
+    }
+}
+
 static void benchmark_4()
 {
     Mutex m;
@@ -4448,6 +4733,44 @@ static void benchmark_4()
     }
     iprintf("%d pthread_mutex lock/unlock pairs per second\n",i);
 
+    b4_end=false;
+    #ifndef SCHED_TYPE_EDF
+    Thread::create(b4_t1,STACK_SMALL);
+    #else
+    Thread::create(b4_t1,STACK_SMALL,0);
+    #endif
+    Thread::yield();
+    i=0;
+    while(b4_end==false)
+    {
+        b4_m.lock();
+        b4_m.unlock();
+        i++;
+    }
+    iprintf("%d FastMutex lock/unlock pairs per second\n",i);
+
+    //A second thread with the same priority contends for the mutex, whenever
+    //one is preempted while holding it the two threads alternate on each lock
+    b4_end=false;
+    b4_count=0;
+    #ifndef SCHED_TYPE_EDF
+    Thread::create(b4_t1,STACK_SMALL);
+    #else
+    Thread::create(b4_t1,STACK_SMALL,0);
+    #endif
+    Thread::yield();
+    Thread *t=Thread::create(b4_t2,STACK_SMALL,
+            Thread::getCurrentThread()->getPriority(),nullptr,Thread::JOINABLE);
+    while(b4_end==false)
+    {
+        b4_m.lock();
+        b4_count++;
+        b4_m.unlock();
+    }
+    if(t) t->join();
+    iprintf("%d FastMutex lock/unlock pairs per second, two threads\n",
+            b4_count);
+
     b4_end=false;
     #ifndef SCHED_TYPE_EDF
     Thread::create(b4_t1,STACK_SMALL);
@@ -4496,3 +4819,406 @@ static void benchmark_4()
     }
     iprintf("%d fast disable/enable interrupts pairs per second\n",i);
 }
+
+//
+// Benchmark 5
+//
+/*
+tests:
+Queue vs SpscQueue throughput
+*/
+
+static void b5_startTimer()
+{
+    b4_end=false;
+    #ifndef SCHED_TYPE_EDF
+    Thread::create(b4_t1,STACK_SMALL);
+    #else
+    Thread::create(b4_t1,STACK_SMALL,0);
+    #endif
+    Thread::yield();
+}
+
+static void benchmark_5()
+{
+    //Static, to avoid filling the stack
+    static Queue<char,64> q1;
+    static SpscQueue<char,64> q2;
+    char buf[16]={0};
+    char c=0;
+
+    b5_startTimer();
+    int i=0;
+    while(b4_end==false)
+    {
+        q1.put(c);
+        q1.get(c);
+        i++;
+    }
+    iprintf("%d Queue put/get per second\n",i);
+
+    b5_startTimer();
+    i=0;
+    while(b4_end==false)
+    {
+        q2.tryPut(c);
+        q2.get(c);
+        i++;
+    }
+    iprintf("%d SpscQueue put/get per second\n",i);
+
+    b5_startTimer();
+    i=0;
+    while(b4_end==false)
+    {
+        {
+            FastInterruptDisableLock dLock;
+            for(unsigned int j=0;j<sizeof(buf);j++) q1.IRQput(buf[j]);
+        }
+        for(unsigned int j=0;j<sizeof(buf);j++) q1.get(buf[j]);
+        i+=sizeof(buf);
+    }
+    iprintf("%d Queue bytes per second (%d byte bursts)\n",i,int(sizeof(buf)));
+
+    b5_startTimer();
+    i=0;
+    while(b4_end==false)
+    {
+        {
+            FastInterruptDisableLock dLock;
+            q2.IRQputMany(buf,sizeof(buf));
+        }
+        i+=q2.getMany(buf,sizeof(buf));
+    }
+    iprintf("%d SpscQueue bytes per second (%d byte bursts)\n",i,int(sizeof(buf)));
+}
+
+//
+// Benchmark 6
+//
+/*
+tests:
+Pipe throughput, between threads and between processes
+*/
+
+#ifdef WITH_FILESYSTEM
+static void b6_writer(void *argv)
+{
+    pipeBenchmarkWriter(reinterpret_cast<int>(argv));
+}
+
+/**
+ * Read pipeBenchmarkSize bytes from a pipe
+ * \param fd read end of the pipe
+ * \return the throughput in KB/s, not counting the time to the first read
+ * so that thread or process creation is not measured
+ */
+static int b6_reader(int fd)
+{
+    static char buf[1024];
+    ssize_t r=read(fd,buf,sizeof(buf));
+    if(r<=0) return 0;
+    int first=r, total=r;
+    long long start=getTime();
+    while(total<pipeBenchmarkSize)
+    {
+        r=read(fd,buf,sizeof(buf));
+        if(r<=0) break;
+        total+=r;
+    }
+    long long elapsed=getTime()-start;
+    if(elapsed<=0) return 0;
+    return (total-first)*1000000000LL/elapsed/1024;
+}
+
+static void benchmark_6()
+{
+    const int pipeSizes[]={0,4096}; //0 is the default size
+    for(int size : pipeSizes)
+    {
+        int fds[2];
+        if(pipe(fds)!=0)
+        {
+            iprintf("Pipe benchmark not made. Can't create pipe\n");
+            return;
+        }
+        if(size>0) fcntl(fds[0],F_SETPIPE_SZ,size);
+        Thread *t=Thread::create(b6_writer,STACK_DEFAULT_FOR_PTHREAD,0,
+                reinterpret_cast<void*>(fds[1]),Thread::JOINABLE);
+        int speed=b6_reader(fds[0]);
+        t->join();
+        iprintf("%dKB/s pipe throughput between threads (%d bytes pipe)\n",
+                speed,fcntl(fds[0],F_GETPIPE_SZ));
+        close(fds[0]);
+        close(fds[1]);
+    }
+    #ifdef WITH_PROCESSES
+    const char *arg[]={"/bin/test_process","pipe_benchmark_writer",nullptr};
+    int fd;
+    pid_t pid=spawnWithPipe(arg,fd);
+    int speed=b6_reader(fd);
+    waitpid(pid,nullptr,0);
+    close(fd);
+    iprintf("%dKB/s pipe throughput between processes\n",speed);
+    #endif //WITH_PROCESSES
+}
+#endif //WITH_FILESYSTEM
+
+//
+// Benchmark 7
+//
+/*
+tests:
+Mutex lock/unlock time with contention
+*/
+
+static Mutex b7_m;
+static volatile bool b7_end;
+static volatile int b7_count;
+
+static void *b7_t1(void *argv)
+{
+    while(b7_end==false)
+    {
+        b7_m.lock();
+        b7_count++;
+        b7_m.unlock();
+    }
+    return nullptr;
+}
+
+static void benchmark_7()
+{
+    //Every unlock hands the mutex over to a waiting thread, so with n threads
+    //each lock() queues behind the other n-1
+    const int numThreads[]={2,8,32};
+    Thread *threads[32];
+    for(int n : numThreads)
+    {
+        b7_end=false;
+        b7_count=0;
+        b7_m.lock();
+        int created=0;
+        for(;created<n;created++)
+        {
+            threads[created]=Thread::create(b7_t1,STACK_SMALL,0,nullptr,
+                                            Thread::JOINABLE);
+            if(threads[created]==nullptr) break;
+        }
+        Thread::sleep(10); //Let all threads block on the mutex
+        b7_m.unlock();
+        Thread::sleep(1000);
+        b7_end=true;
+        for(int i=0;i<created;i++) threads[i]->join();
+        if(created<n)
+        {
+            iprintf("Mutex contention benchmark not made. Can't create "
+                    "%d threads\n",n);
+            break;
+        }
+        iprintf("%d Mutex lock/unlock pairs per second, %d threads\n",
+                b7_count,n);
+    }
+}
+
+#ifdef WITH_PROCESSES
+//
+// Benchmark 8
+//
+/*
+tests:
+Process spawn latency
+*/
+
+static void benchmark_8()
+{
+    //The processes are reaped only after all were spawned, so all but the
+    //first spawn find the program already cached
+    const int numSpawns=8;
+    const char *arg[]={"/bin/test_execve",nullptr};
+    const char *env[]={nullptr};
+    long long times[numSpawns];
+    pid_t pids[numSpawns];
+    int spawned=0;
+    for(;spawned<numSpawns;spawned++)
+    {
+        long long start=getTime();
+        int ec=posix_spawn(&pids[spawned],arg[0],NULL,NULL,
+                           (char* const*)arg,(char* const*)env);
+        times[spawned]=getTime()-start;
+        if(ec!=0) break;
+    }
+    for(int i=0;i<spawned;i++) waitpid(pids[i],nullptr,0);
+    if(spawned<2)
+    {
+        iprintf("Spawn benchmark not made. Can't spawn processes\n");
+        return;
+    }
+    iprintf("First spawn took %dus\n",static_cast<int>(times[0]/1000));
+    sort(times+1,times+spawned);
+    iprintf("Median spawn time %dus, %d processes\n",
+            static_cast<int>(times[1+(spawned-1)/2]/1000),spawned-1);
+}
+#endif //WITH_PROCESSES
+
+#ifdef WITH_FILESYSTEM
+//
+// Benchmark 9
+//
+/*
+tests:
+stat() time, with and without the path cache
+*/
+
+static const int b9Calls=10000;
+
+/**
+ * Time stat() calls on a path
+ * \param path path to stat, must exist
+ * \param uncached if true, clear the path cache before each call
+ * \return the time in microseconds of b9Calls calls, or -1 on failure
+ */
+static int b9_stat(const char *path, bool uncached)
+{
+    FilesystemManager& fsm=FilesystemManager::instance();
+    struct stat st;
+    long long start=getTime();
+    for(int i=0;i<b9Calls;i++)
+    {
+        if(uncached) fsm.invalidatePathCache();
+        if(stat(path,&st)!=0) return -1;
+    }
+    return (getTime()-start)/1000;
+}
+
+static void b9_benchmark(const char *path)
+{
+    FilesystemManager& fsm=FilesystemManager::instance();
+    int uncached=b9_stat(path,true);
+    fsm.resetPathCacheStats();
+    int cached=b9_stat(path,false);
+    PathCacheStats s=fsm.getPathCacheStats();
+    if(uncached<0 || cached<0)
+    {
+        iprintf("stat() benchmark not made. Can't stat %s\n",path);
+        return;
+    }
+    iprintf("%d stat(\"%s\") %dus uncached, %dus cached (%u hits %u misses)\n",
+            b9Calls,path,uncached,cached,s.hits,s.misses);
+}
+
+static void benchmark_9()
+{
+    //The filesystem mounted on /sd is the first of FAT32 and LittleFS that
+    //basicFilesystemSetup() could mount, RomFs is mounted on /bin
+    struct stat st;
+    if(stat("/sd",&st)==0)
+    {
+        mkdir("/sd/b9",0755);
+        mkdir("/sd/b9/config",0755);
+        int fd=open("/sd/b9/config/settings.txt",O_CREAT|O_WRONLY,0644);
+        if(fd>=0)
+        {
+            close(fd);
+            b9_benchmark("/sd/b9/config/settings.txt");
+            unlink("/sd/b9/config/settings.txt");
+        }
+        rmdir("/sd/b9/config");
+        rmdir("/sd/b9");
+    }
+    DIR *d=opendir("/bin");
+    if(d==nullptr) return;
+    string path;
+    while(struct dirent *de=readdir(d))
+    {
+        if(de->d_type!=DT_REG) continue;
+        path=string("/bin/")+de->d_name; //Last file, the slowest to find by linear scan
+    }
+    closedir(d);
+    if(!path.empty()) b9_benchmark(path.c_str());
+}
+
+//
+// Benchmark 10
+//
+/*
+tests:
+Lookup table access through mmap compared to read into a buffer
+*/
+
+/**
+ * Perform random lookups into a table
+ * \param table table data
+ * \param size table size
+ * \return the sum of the looked up bytes, so that they are not optimized away
+ */
+static unsigned int b10_lookups(const unsigned char *table, unsigned int size)
+{
+    const int numLookups=100000;
+    unsigned int index=0, sum=0;
+    for(int i=0;i<numLookups;i++)
+    {
+        index=(index*1103515245+12345) & 0x7fffffff;
+        sum+=table[index % size];
+    }
+    return sum;
+}
+
+static void benchmark_10()
+{
+    //Use the largest file in /bin, RomFs files can be mapped without a copy
+    DIR *d=opendir("/bin");
+    if(d==nullptr)
+    {
+        iprintf("mmap benchmark not made. No /bin directory\n");
+        return;
+    }
+    string path;
+    struct stat st;
+    off_t size=0;
+    while(struct dirent *de=readdir(d))
+    {
+        if(de->d_type!=DT_REG) continue;
+        string p=string("/bin/")+de->d_name;
+        if(stat(p.c_str(),&st)!=0 || st.st_size<=size) continue;
+        size=st.st_size;
+        path=p;
+    }
+    closedir(d);
+    if(path.empty())
+    {
+        iprintf("mmap benchmark not made. No files in /bin\n");
+        return;
+    }
+    int fd=open(path.c_str(),O_RDONLY);
+    if(fd<0) return;
+    long long start=getTime();
+    void *p=mmap(nullptr,size,PROT_READ,MAP_PRIVATE,fd,0);
+    if(p==MAP_FAILED)
+    {
+        close(fd);
+        iprintf("mmap benchmark not made. mmap failed\n");
+        return;
+    }
+    unsigned int sum1=b10_lookups(reinterpret_cast<unsigned char*>(p),size);
+    munmap(p,size);
+    int mmapTime=(getTime()-start)/1000;
+    start=getTime();
+    unsigned char *buffer=new (nothrow) unsigned char[size];
+    if(buffer==nullptr)
+    {
+        close(fd);
+        iprintf("mmap %dus, read() benchmark not made. Can't allocate %d bytes\n",
+                mmapTime,static_cast<int>(size));
+        return;
+    }
+    bool ok=pread(fd,buffer,size,0)==size;
+    unsigned int sum2=b10_lookups(buffer,size);
+    delete[] buffer;
+    int readTime=(getTime()-start)/1000;
+    close(fd);
+    if(!ok || sum1!=sum2) fail("mmap benchmark, content mismatch");
+    iprintf("100000 lookups in a %d byte table: mmap %dus, read() %dus\n",
+            static_cast<int>(size),mmapTime,readTime);
+}
+#endif //WITH_FILESYSTEM
@@ -0,0 +1,80 @@
+//This benchmark measures the effect of timer slack on the number of timer
+//interrupts and on the time spent in (deep) sleep. A number of low priority
+//periodic threads with slightly different periods run first with no slack,
+//then with increasing slack. Requires WITH_TIMER_SLACK, and WITH_CPU_TIME_COUNTER
+//to also print the idle time. Enable WITH_DEEP_SLEEP to measure deep sleep.
+
+#include <cstdio>
+#include "miosix.h"
+
+using namespace std;
+using namespace miosix;
+
+#ifndef WITH_TIMER_SLACK
+#error "This benchmark requires WITH_TIMER_SLACK"
+#endif
+
+const int numThreads=16;
+const long long basePeriod=100000000ll; //100ms
+const long long periodStep=1300000ll;   //1.3ms
+const long long testDuration=10000000000ll; //10s
+static volatile unsigned int slack=0;
+
+void periodicThread(void *arg)
+{
+    const long long period=basePeriod+periodStep*reinterpret_cast<intptr_t>(arg);
+    long long t=getTime();
+    while(!Thread::testTerminate())
+    {
+        Thread::setTimerSlack(slack);
+        t+=period;
+        Thread::nanoSleepUntil(t);
+    }
+}
+
+#ifdef WITH_CPU_TIME_COUNTER
+static long long idleTime()
+{
+    PauseKernelLock pk;
+    //The first item is always the idle thread
+    return (*CPUTimeCounter::PKbegin()).usedCpuTime;
+}
+#endif //WITH_CPU_TIME_COUNTER
+
+void runTest(unsigned int slackNs)
+{
+    slack=slackNs;
+    Thread::sleep(500); //Let all threads pick up the new slack
+    auto before=getTimerSlackStats();
+    #ifdef WITH_CPU_TIME_COUNTER
+    long long idleBefore=idleTime();
+    #endif //WITH_CPU_TIME_COUNTER
+    Thread::nanoSleep(testDuration);
+    auto after=getTimerSlackStats();
+    unsigned int batches=after.batches-before.batches;
+    unsigned int sleeps=after.idleSleeps-before.idleSleeps;
+    iprintf("slack %7uns: %4u wakeups, %4u batches, %4u IRQs avoided, "
+            "%4u idle sleeps",slackNs,after.wakeups-before.wakeups,batches,
+            after.avoidedIrqs-before.avoidedIrqs,sleeps);
+    #ifdef WITH_CPU_TIME_COUNTER
+    long long idle=idleTime()-idleBefore;
+    iprintf(", idle %3d%%, avg sleep %lldus",
+            static_cast<int>(100*idle/testDuration),
+            sleeps ? idle/sleeps/1000 : 0);
+    #endif //WITH_CPU_TIME_COUNTER
+    iprintf("\n");
+}
+
+int main()
+{
+    Thread *threads[numThreads];
+    for(int i=0;i<numThreads;i++)
+        threads[i]=Thread::create(periodicThread,1024,1,
+                reinterpret_cast<void*>(i),Thread::JOINABLE);
+    Thread::setPriority(2); //Don't let the periodic threads delay the test
+    const unsigned int slacks[]={0,1000000,5000000,20000000};
+    for(auto s : slacks) runTest(s);
+    for(int i=0;i<numThreads;i++) threads[i]->terminate();
+    for(int i=0;i<numThreads;i++) threads[i]->join();
+    iprintf("done\n");
+}
@@ -0,0 +1,88 @@
+/***************************************************************************
+ *   Copyright (C) 2024 by Terraneo Federico                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+#ifndef ATOMIC_OPS_IMPL_X86_H
+#define	ATOMIC_OPS_IMPL_X86_H
+
+/**
+ * The Linux simulator runs all threads on a single host thread, and
+ * interrupts are signals, which are only delivered between instructions, so
+ * the x86 read-modify-write instructions the compiler builtins expand to are
+ * atomic also with respect to interrupts.
+ */
+
+namespace miosix {
+
+// Can't include kernel.h as it would cause an include loop
+void disableInterrupts();
+void enableInterrupts();
+
+inline int atomicSwap(volatile int *p, int v)
+{
+    return __atomic_exchange_n(p,v,__ATOMIC_SEQ_CST);
+}
+
+inline void atomicAdd(volatile int *p, int incr)
+{
+    __atomic_add_fetch(p,incr,__ATOMIC_SEQ_CST);
+}
+
+inline int atomicAddExchange(volatile int *p, int incr)
+{
+    return __atomic_fetch_add(p,incr,__ATOMIC_SEQ_CST);
+}
+
+inline int atomicCompareAndSwap(volatile int *p, int prev, int next)
+{
+    __atomic_compare_exchange_n(p,&prev,next,false,__ATOMIC_SEQ_CST,
+                                __ATOMIC_SEQ_CST);
+    return prev; //On failure prev is updated with the value of *p
+}
+
+inline void *atomicFetchAndIncrement(void * const volatile * p, int offset,
+        int incr)
+{
+    //Loading the pointer and incrementing the pointed value need to be a
+    //single atomic operation, which x86 can't do without disabling interrupts
+    disableInterrupts();
+    void *result = *p;
+    if(result == 0)
+    {
+        enableInterrupts();
+        return 0;
+    }
+    volatile unsigned int *pt = reinterpret_cast<unsigned int*>(result) + offset;
+    *pt += incr;
+    enableInterrupts();
+    asm volatile("":::"memory");
+
+    return result;
+}
+
+} //namespace miosix
+
+#endif //ATOMIC_OPS_IMPL_X86_H
@@ -41,8 +41,10 @@ static const unsigned int cacheLine=32; //Cortex-M7 cache line size
  * - non-shareable
  * - readable/writable/executable only by privileged code (for compatibility
  *   with the way processes use the MPU)
- * \param region MPU region. Note that region 6 and 7 are used by processes, and
- * should be avoided here
+ * \param region MPU region. Note that regions 4 to 7 are used by processes, and
+ * should be avoided here: 6 and 7 for the process code and data, 5 for the
+ * shared memory segment and 4 for the memory mapped file. Only regions 0 to 3
+ * are available, and 3 is currently unused
  * \param base base address, aligned to a 32Byte cache line
  * \param size size, must be at least 32 and a power of 2, or it is rounded to
  * the next power of 2
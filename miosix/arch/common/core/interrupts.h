@@ -11,6 +11,8 @@
    || defined(_ARCH_CORTEXM4_ATSAM4L) || defined(_ARCH_CORTEXM3_EFM32G) \
    || defined(_ARCH_CORTEXM0PLUS_STM32L0) || defined(_ARCH_CORTEXM0PLUS_RP2040)
 #include "interrupts_cortexMx.h"
+#elif defined(_ARCH_LINUX_SIM)
+#include "interrupts_linux_sim.h"
 #else
 #error "Unknown arch"
 #endif
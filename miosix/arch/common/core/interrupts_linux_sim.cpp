@@ -0,0 +1,123 @@
+/***************************************************************************
+ *   Copyright (C) 2024 by Terraneo Federico                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+#include "kernel/logging.h"
+#include "kernel/kernel.h"
+#include "config/miosix_settings.h"
+#include "interfaces/portability.h"
+#include "interfaces/arch_registers.h"
+#include "interrupts.h"
+
+using namespace miosix;
+
+#ifdef WITH_ERRLOG
+
+/**
+ * \internal
+ * Used to print an unsigned int in hexadecimal format, and to reboot the system
+ * Note that printf/iprintf cannot be used inside an IRQ, so that's why there's
+ * this function.
+ * \param x number to print
+ */
+static void printUnsignedInt(unsigned int x)
+{
+    static const char hexdigits[]="0123456789abcdef";
+    char result[]="0x........\r\n";
+    for(int i=9;i>=2;i--)
+    {
+        result[i]=hexdigits[x & 0xf];
+        x>>=4;
+    }
+    IRQerrorLog(result);
+}
+
+#endif //WITH_ERRLOG
+
+/**
+ * \internal
+ * Common code of the fault handlers, prints where the fault occurred and
+ * reboots, which for the simulator means exiting
+ * \param name fault name
+ * \param info host signal information
+ * \param uc host signal context
+ */
+static void __attribute__((noreturn)) faultImpl(const char *name, void *info,
+        void *uc)
+{
+    #ifdef WITH_ERRLOG
+    auto si=reinterpret_cast<host::SigInfo*>(info);
+    auto ctx=reinterpret_cast<host::UContext*>(uc);
+    IRQerrorLog("\r\n***Unexpected ");
+    IRQerrorLog(name);
+    IRQerrorLog(" @ ");
+    printUnsignedInt(ctx->mcontext.eip);
+    IRQerrorLog("Fault caused by attempted access to ");
+    printUnsignedInt(reinterpret_cast<unsigned int>(si->addr));
+    #endif //WITH_ERRLOG
+    miosix_private::IRQsystemReboot();
+    for(;;) ;
+}
+
+/**
+ * \internal SIGSEGV handler
+ */
+void SEGV_Handler(int, void *info, void *uc)
+{
+    faultImpl("SIGSEGV",info,uc);
+}
+
+/**
+ * \internal SIGBUS handler
+ */
+void BUS_Handler(int, void *info, void *uc)
+{
+    faultImpl("SIGBUS",info,uc);
+}
+
+/**
+ * \internal SIGILL handler
+ */
+void ILL_Handler(int, void *info, void *uc)
+{
+    faultImpl("SIGILL",info,uc);
+}
+
+/**
+ * \internal SIGFPE handler
+ */
+void FPE_Handler(int, void *info, void *uc)
+{
+    faultImpl("SIGFPE",info,uc);
+}
+
+void unexpectedInterrupt()
+{
+    #ifdef WITH_ERRLOG
+    IRQerrorLog("\r\n***Unexpected host signal\r\n");
+    #endif //WITH_ERRLOG
+    miosix_private::IRQsystemReboot();
+}
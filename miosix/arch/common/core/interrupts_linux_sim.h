@@ -0,0 +1,52 @@
+/***************************************************************************
+ *   Copyright (C) 2024 by Terraneo Federico                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+#pragma once
+
+/**
+ * Called when an unexpected interrupt occurs.
+ * In the Linux simulator interrupts are host signals, and this is called for
+ * signals the simulator does not expect.
+ */
+void unexpectedInterrupt();
+
+namespace fault {
+/**
+ * Possible kind of faults that the Linux simulator can report, from the
+ * signals the host raises. This is a regular enum enclosed in a namespace
+ * instead of an enum class for consistency with the other architectures.
+ */
+enum FaultType
+{
+    SEGV=1,          //Invalid memory access (SIGSEGV)
+    BUS=2,           //Misaligned or nonexistent physical address (SIGBUS)
+    ILL=3,           //Invalid instruction (SIGILL)
+    FPE=4,           //Arithmetic exception, such as division by zero (SIGFPE)
+    STACKOVERFLOW=14 //Stack overflow
+};
+
+} //namespace fault
@@ -0,0 +1,143 @@
+/***************************************************************************
+ *   Copyright (C) 2024 by Terraneo Federico                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+#include "kernel/kernel.h"
+#include "kernel/error.h"
+#include "interfaces/os_timer.h"
+#include "interfaces/arch_registers.h"
+
+/*
+ * The os timer of the simulator is a POSIX timer on the host monotonic clock
+ * that raises SIGALRM. Time is read directly from the host clock, which is
+ * already 64 bit and in nanoseconds, so TimerAdapter is not needed.
+ */
+
+namespace miosix {
+
+namespace internal {
+
+static int timerId;              ///< Id of the host POSIX timer
+static long long hostTimeOffset; ///< Host time corresponding to time zero
+static long long nextIrqNs;      ///< Time of the next interrupt
+
+/**
+ * \internal
+ * Arm the host timer so that it fires at nextIrqNs
+ */
+static void IRQarmHostTimer()
+{
+    long long t=nextIrqNs+hostTimeOffset;
+    host::ITimerSpec its;
+    its.interval.sec=its.interval.nsec=0;
+    its.value.sec=static_cast<int>(t/1000000000LL);
+    its.value.nsec=static_cast<int>(t%1000000000LL);
+    //A time in the past makes the timer fire immediately, and an all zero
+    //value would disarm it instead
+    if(its.value.sec==0 && its.value.nsec==0) its.value.nsec=1;
+    host::timerSettime(timerId,host::TIMER_ABSTIME_,&its);
+}
+
+void IRQosTimerInit()
+{
+    hostTimeOffset=host::monotonicTime();
+    host::SigEvent sev;
+    __builtin_memset(&sev,0,sizeof(sev));
+    sev.signo=host::SIGALRM_;
+    sev.notify=host::SIGEV_SIGNAL_;
+    if(host::timerCreate(host::CLOCK_MONOTONIC_,&sev,&timerId)<0)
+        errorHandler(UNEXPECTED);
+}
+
+void IRQosTimerSetInterrupt(long long ns) noexcept
+{
+    nextIrqNs=ns;
+    IRQarmHostTimer();
+}
+
+/**
+ * \internal
+ * Handles the timer interrupt. A SIGALRM left pending from a previous
+ * IRQosTimerSetInterrupt() may arrive before the current deadline, in that
+ * case the timer is already armed for the new deadline and there is nothing
+ * to do.
+ */
+void IRQtimerInterruptHandler()
+{
+    long long t=IRQgetTime();
+    if(t<nextIrqNs) return;
+    #ifdef WITH_KERNEL_TRACE
+    KernelTrace::IRQrecord(TraceEventType::IrqEnter,traceOsTimerIrq,0,0);
+    #endif //WITH_KERNEL_TRACE
+    #ifdef WITH_LATENCY_STATS
+    LatencyStats::IRQtimerLatency(t-nextIrqNs);
+    #endif //WITH_LATENCY_STATS
+    miosix::IRQtimerInterrupt(t);
+    #ifdef WITH_KERNEL_TRACE
+    KernelTrace::IRQrecord(TraceEventType::IrqExit,traceOsTimerIrq,0,0);
+    #endif //WITH_KERNEL_TRACE
+}
+
+void IRQosTimerSetTime(long long ns) noexcept
+{
+    long long delta=ns-IRQgetTime();
+    if(delta<=0) return; //Time can only move forward
+    hostTimeOffset-=delta;
+    //The interrupt deadline is in the os time, so rearm the host timer
+    IRQarmHostTimer();
+}
+
+unsigned int osTimerGetFrequency()
+{
+    return 1000000000;
+}
+
+} // namespace internal
+
+long long getTime() noexcept
+{
+    //Reading the host clock is a single system call, no need to disable
+    //interrupts
+    return IRQgetTime();
+}
+
+long long IRQgetTime() noexcept
+{
+    return host::monotonicTime()-internal::hostTimeOffset;
+}
+
+} // namespace miosix
+
+/**
+ * \internal
+ * SIGALRM handler
+ */
+void TIMER_Handler(int, void *, void *uc)
+{
+    saveContext(uc);
+    miosix::internal::IRQtimerInterruptHandler();
+    restoreContext(uc);
+}
@@ -71,6 +71,8 @@ MPUConfiguration::MPUConfiguration(const unsigned int *elfBase, unsigned int elf
                | MPU_RASR_C_Msk
                | 1 //Enable bit
                | sizeToMpu(imageSize)<<1;
+    clearSharedRegion();
+    clearMappedRegion();
     #else //__MPU_PRESENT==1
     #warning architecture lacks MPU, memory protection for processes unsupported
     //Although we have no MPU, store enough information to still enable checking
@@ -79,9 +81,68 @@ MPUConfiguration::MPUConfiguration(const unsigned int *elfBase, unsigned int elf
     regValues[2]=(reinterpret_cast<unsigned int>(imageBase) & (~0x1f));
     regValues[1]=sizeToMpu(elfSize)<<1;
     regValues[3]=sizeToMpu(imageSize)<<1;
+    clearSharedRegion();
+    clearMappedRegion();
     #endif //__MPU_PRESENT==1
 }
 
+void MPUConfiguration::setSharedRegion(const unsigned int *base,
+        unsigned int size, bool writable)
+{
+    #if __MPU_PRESENT==1
+    regValues[4]=(reinterpret_cast<unsigned int>(base) & (~0x1f))
+               | MPU_RBAR_VALID_Msk | 5; //Region 5
+    regValues[5]=(writable ? 3 : 2)<<MPU_RASR_AP_Pos
+               | MPU_RASR_XN_Msk
+               | MPU_RASR_C_Msk
+               | 1 //Enable bit
+               | sizeToMpu(size)<<1;
+    #else //__MPU_PRESENT==1
+    regValues[4]=(reinterpret_cast<unsigned int>(base) & (~0x1f));
+    regValues[5]=(writable ? 1<<24 : 0) | 1 | sizeToMpu(size)<<1;
+    #endif //__MPU_PRESENT==1
+}
+
+void MPUConfiguration::clearSharedRegion()
+{
+    #if __MPU_PRESENT==1
+    //Region 5 has still to be selected when switching to the process, so that
+    //a shared region of the previously running process is disabled
+    regValues[4]=MPU_RBAR_VALID_Msk | 5;
+    #else //__MPU_PRESENT==1
+    regValues[4]=0;
+    #endif //__MPU_PRESENT==1
+    regValues[5]=0;
+}
+
+void MPUConfiguration::setMappedRegion(const unsigned int *base,
+        unsigned int size)
+{
+    #if __MPU_PRESENT==1
+    regValues[6]=(reinterpret_cast<unsigned int>(base) & (~0x1f))
+               | MPU_RBAR_VALID_Msk | 4; //Region 4
+    regValues[7]=2<<MPU_RASR_AP_Pos //Privileged: RW, unprivileged: RO
+               | MPU_RASR_XN_Msk
+               | MPU_RASR_C_Msk
+               | 1 //Enable bit
+               | sizeToMpu(size)<<1;
+    #else //__MPU_PRESENT==1
+    regValues[6]=(reinterpret_cast<unsigned int>(base) & (~0x1f));
+    regValues[7]=1 | sizeToMpu(size)<<1;
+    #endif //__MPU_PRESENT==1
+}
+
+void MPUConfiguration::clearMappedRegion()
+{
+    #if __MPU_PRESENT==1
+    //Like region 5, region 4 has to be selected anyway to disable it
+    regValues[6]=MPU_RBAR_VALID_Msk | 4;
+    #else //__MPU_PRESENT==1
+    regValues[6]=0;
+    #endif //__MPU_PRESENT==1
+    regValues[7]=0;
+}
+
 void MPUConfiguration::dumpConfiguration()
 {
     #if __MPU_PRESENT==1
@@ -93,6 +154,19 @@ void MPUConfiguration::dumpConfiguration()
         char x=regValues[2*i+1] & MPU_RASR_XN_Msk ? '-' : 'x';
         iprintf("* MPU region %d 0x%08x-0x%08x r%c%c\n",i+6,base,end,w,x);
     }
+    if(regValues[5] & 1)
+    {
+        unsigned int base=regValues[4] & (~0x1f);
+        unsigned int end=base+(1<<(((regValues[5]>>1) & 31)+1));
+        char w=regValues[5] & (1<<MPU_RASR_AP_Pos) ? 'w' : '-';
+        iprintf("* MPU region 5 0x%08x-0x%08x r%c- (shared)\n",base,end,w);
+    }
+    if(regValues[7] & 1)
+    {
+        unsigned int base=regValues[6] & (~0x1f);
+        unsigned int end=base+(1<<(((regValues[7]>>1) & 31)+1));
+        iprintf("* MPU region 4 0x%08x-0x%08x r-- (mapped)\n",base,end);
+    }
     #else //__MPU_PRESENT==1
     iprintf("* Architecture lacks MPU\n");
     for(int i=0;i<2;i++)
@@ -101,6 +175,18 @@ void MPUConfiguration::dumpConfiguration()
         unsigned int end=base+(1<<(((regValues[2*i+1]>>1) & 31)+1));
         iprintf("* MPU region %d 0x%08x-0x%08x rwx\n",i+6,base,end);
     }
+    if(regValues[5] & 1)
+    {
+        unsigned int base=regValues[4] & (~0x1f);
+        unsigned int end=base+(1<<(((regValues[5]>>1) & 31)+1));
+        iprintf("* MPU region 5 0x%08x-0x%08x rwx (shared)\n",base,end);
+    }
+    if(regValues[7] & 1)
+    {
+        unsigned int base=regValues[6] & (~0x1f);
+        unsigned int end=base+(1<<(((regValues[7]>>1) & 31)+1));
+        iprintf("* MPU region 4 0x%08x-0x%08x rwx (mapped)\n",base,end);
+    }
     #endif //__MPU_PRESENT==1
 }
 
@@ -140,6 +226,20 @@ pair<const unsigned int*, unsigned int> MPUConfiguration::roundRegionForMPU(
     }
 }
 
+bool MPUConfiguration::withinOptional(int i, size_t base, size_t size,
+                                      bool write) const
+{
+    if((regValues[i+1] & 1)==0) return false;
+    #if __MPU_PRESENT==1
+    if(write && (regValues[i+1] & (1<<MPU_RASR_AP_Pos))==0) return false;
+    #else //__MPU_PRESENT==1
+    if(write && (regValues[i+1] & (1<<24))==0) return false;
+    #endif //__MPU_PRESENT==1
+    size_t regionStart=regValues[i] & (~0x1f);
+    size_t regionEnd=regionStart+(1<<(((regValues[i+1]>>1) & 31)+1));
+    return base>=regionStart && base+size<regionEnd;
+}
+
 bool MPUConfiguration::withinForReading(const void *ptr, size_t size) const
 {
     size_t codeStart=regValues[0] & (~0x1f);
@@ -149,7 +249,8 @@ bool MPUConfiguration::withinForReading(const void *ptr, size_t size) const
     size_t base=reinterpret_cast<size_t>(ptr);
     //The last check is to prevent a wraparound to be considered valid
     return (   (base>=codeStart && base+size<codeEnd)
-            || (base>=dataStart && base+size<dataEnd)) && base+size>=base;
+            || (base>=dataStart && base+size<dataEnd)
+            || withinOptional(base,size,false)) && base+size>=base;
 }
 
 bool MPUConfiguration::withinForWriting(const void *ptr, size_t size) const
@@ -158,7 +259,8 @@ bool MPUConfiguration::withinForWriting(const void *ptr, size_t size) const
     size_t dataEnd=dataStart+(1<<(((regValues[3]>>1) & 31)+1));
     size_t base=reinterpret_cast<size_t>(ptr);
     //The last check is to prevent a wraparound to be considered valid
-    return base>=dataStart && base+size<dataEnd && base+size>=base;
+    return ((base>=dataStart && base+size<dataEnd)
+            || withinOptional(base,size,true)) && base+size>=base;
 }
 
 bool MPUConfiguration::withinForReading(const char* str) const
@@ -172,6 +274,13 @@ bool MPUConfiguration::withinForReading(const char* str) const
         return strnlen(str,codeEnd-base)<codeEnd-base;
     if((base>=dataStart) && (base<dataEnd))
         return strnlen(str,dataEnd-base)<dataEnd-base;
+    for(int i : {4,6})
+    {
+        if(withinOptional(i,base,0,false)==false) continue;
+        size_t regionEnd=(regValues[i] & (~0x1f))
+                        +(1<<(((regValues[i+1]>>1) & 31)+1));
+        return strnlen(str,regionEnd-base)<regionEnd-base;
+    }
     return false;
 }
 
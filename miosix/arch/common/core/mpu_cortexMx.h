@@ -89,6 +89,10 @@ public:
         MPU->RASR=regValues[1];
         MPU->RBAR=regValues[2];
         MPU->RASR=regValues[3];
+        MPU->RBAR=regValues[4];
+        MPU->RASR=regValues[5];
+        MPU->RBAR=regValues[6];
+        MPU->RASR=regValues[7];
         __set_CONTROL(3);
         #endif //__MPU_PRESENT==1
     }
@@ -106,6 +110,38 @@ public:
         #endif //__MPU_PRESENT==1
     }
     
+    /**
+     * \internal
+     * Configure the additional region used to give a process access to a
+     * shared memory segment. Only one such region is available.
+     * \param base base address of the region, must be aligned to its size
+     * \param size size of the region, must be a power of 2 and at least 32
+     * \param writable true if the process can write to the region
+     */
+    void setSharedRegion(const unsigned int *base, unsigned int size,
+                         bool writable);
+
+    /**
+     * \internal
+     * Disable the shared memory region
+     */
+    void clearSharedRegion();
+
+    /**
+     * \internal
+     * Configure the additional region used to give a process read-only access
+     * to a memory mapped file. Only one such region is available.
+     * \param base base address of the region, must be aligned to its size
+     * \param size size of the region, must be a power of 2 and at least 32
+     */
+    void setMappedRegion(const unsigned int *base, unsigned int size);
+
+    /**
+     * \internal
+     * Disable the memory mapped file region
+     */
+    void clearMappedRegion();
+
     /**
      * Print the MPU configuration for debugging purposes
      */
@@ -159,8 +195,33 @@ public:
 
     //Uses default copy constructor and operator=
 private:
-    ///These value are copied into the MPU registers to configure them
-    unsigned int regValues[4]; 
+    /**
+     * \param i index into regValues of the region, 4 for the shared memory
+     * region, 6 for the memory mapped file region
+     * \param base base address of the buffer to check
+     * \param size buffer size
+     * \param write true to check for write access
+     * \return true if the buffer is within the given optional region
+     */
+    bool withinOptional(int i, size_t base, size_t size, bool write) const;
+
+    /**
+     * \param base base address of the buffer to check
+     * \param size buffer size
+     * \param write true to check for write access
+     * \return true if the buffer is within the shared memory or memory mapped
+     * file regions
+     */
+    bool withinOptional(size_t base, size_t size, bool write) const
+    {
+        return withinOptional(4,base,size,write)
+            || withinOptional(6,base,size,write);
+    }
+
+    ///These value are copied into the MPU registers to configure them.
+    ///Region 6 is the elf, 7 the process image, 5 an optional shared memory
+    ///and 4 an optional memory mapped file
+    unsigned int regValues[8];
 };
 
 #endif //WITH_PROCESSES
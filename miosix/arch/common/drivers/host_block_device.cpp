@@ -0,0 +1,93 @@
+/***************************************************************************
+ *   Copyright (C) 2024 by Terraneo Federico                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+#include <errno.h>
+#include "host_block_device.h"
+#include "interfaces/arch_registers.h"
+#include "filesystem/ioctl.h"
+
+namespace miosix {
+
+//
+// class HostBlockDevice
+//
+
+intrusive_ref_ptr<HostBlockDevice> HostBlockDevice::open(const char *path)
+{
+    int fd=host::open(path,host::O_RDWR_);
+    if(fd<0) return intrusive_ref_ptr<HostBlockDevice>();
+    long long size=host::fileSize(fd);
+    if(size<=0)
+    {
+        host::close(fd);
+        return intrusive_ref_ptr<HostBlockDevice>();
+    }
+    return intrusive_ref_ptr<HostBlockDevice>(new HostBlockDevice(fd,size));
+}
+
+ssize_t HostBlockDevice::readBlock(void *buffer, size_t size, off_t where)
+{
+    if(where<0 || where+static_cast<long long>(size)>this->size) return -EIO;
+    //A host system call is atomic with respect to the simulator threads, as
+    //signals are only delivered when it returns, so no locking is needed
+    char *buf=reinterpret_cast<char*>(buffer);
+    for(size_t done=0;done<size;)
+    {
+        int result=host::pread(fd,buf+done,size-done,where+done);
+        if(result==-host::EINTR_) continue;
+        if(result<=0) return -EIO;
+        done+=result;
+    }
+    return size;
+}
+
+ssize_t HostBlockDevice::writeBlock(const void *buffer, size_t size, off_t where)
+{
+    if(where<0 || where+static_cast<long long>(size)>this->size) return -EIO;
+    const char *buf=reinterpret_cast<const char*>(buffer);
+    for(size_t done=0;done<size;)
+    {
+        int result=host::pwrite(fd,buf+done,size-done,where+done);
+        if(result==-host::EINTR_) continue;
+        if(result<=0) return -EIO;
+        done+=result;
+    }
+    return size;
+}
+
+int HostBlockDevice::ioctl(int cmd, void *arg)
+{
+    if(cmd!=IOCTL_SYNC) return -ENOTTY;
+    return host::fsync(fd)<0 ? -EIO : 0;
+}
+
+HostBlockDevice::~HostBlockDevice()
+{
+    host::close(fd);
+}
+
+} //namespace miosix
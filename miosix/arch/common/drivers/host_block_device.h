@@ -0,0 +1,74 @@
+/***************************************************************************
+ *   Copyright (C) 2024 by Terraneo Federico                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+#pragma once
+
+#include "kernel/sync.h"
+#include "filesystem/devfs/devfs.h"
+
+namespace miosix {
+
+/**
+ * Block device of the Linux simulator, backed by a disk image file on the
+ * host. The image is a plain array of 512 byte sectors, such as one created
+ * with dd, so it can be formatted and inspected with host tools.
+ */
+class HostBlockDevice : public Device
+{
+public:
+    /**
+     * Open a disk image
+     * \param path host path of the image file
+     * \return the block device, or nullptr if the image can't be opened
+     */
+    static intrusive_ref_ptr<HostBlockDevice> open(const char *path);
+
+    virtual ssize_t readBlock(void *buffer, size_t size, off_t where);
+
+    virtual ssize_t writeBlock(const void *buffer, size_t size, off_t where);
+
+    virtual int ioctl(int cmd, void *arg);
+
+    /**
+     * Destructor, closes the image file
+     */
+    ~HostBlockDevice();
+
+private:
+    /**
+     * Constructor
+     * \param fd host file descriptor of the image
+     * \param size image size in bytes
+     */
+    HostBlockDevice(int fd, long long size)
+        : Device(Device::BLOCK), fd(fd), size(size) {}
+
+    const int fd;         ///< Host file descriptor of the image
+    const long long size; ///< Image size in bytes
+};
+
+} //namespace miosix
@@ -0,0 +1,177 @@
+/***************************************************************************
+ *   Copyright (C) 2024 by Terraneo Federico                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+#include <cstring>
+#include <errno.h>
+#include <termios.h>
+#include "host_console.h"
+#include "kernel/error.h"
+#include "kernel/scheduler/scheduler.h"
+#include "interfaces/portability.h"
+#include "interfaces/arch_registers.h"
+#include "filesystem/ioctl.h"
+
+using namespace miosix;
+
+/// Pointer to console class to let interrupts access the class
+static HostConsole *console=nullptr;
+
+/**
+ * \internal SIGIO handler, the host tells that the console has input
+ */
+void SIGIO_Handler(int, void *, void *uc)
+{
+    saveContext(uc);
+    if(console) console->IRQhandleInterrupt();
+    restoreContext(uc);
+}
+
+namespace miosix {
+
+//
+// class HostConsole
+//
+
+HostConsole::HostConsole(int inFd, int outFd) : Device(Device::TTY),
+        rxWaiting(0), inFd(inFd), outFd(outFd)
+{
+    InterruptDisableLock dLock;
+    if(console) errorHandler(UNEXPECTED);
+    console=this;
+    //Reads must not block the whole simulator, and the host shall raise SIGIO
+    //when input is available
+    oldInFlags=host::fcntl(inFd,host::F_GETFL_,0);
+    host::fcntl(inFd,host::F_SETOWN_,miosix_private::hostPid);
+    if(oldInFlags>=0) host::fcntl(inFd,host::F_SETFL_,
+        oldInFlags | host::O_NONBLOCK_ | host::O_ASYNC_);
+}
+
+ssize_t HostConsole::readBlock(void *buffer, size_t size, off_t where)
+{
+    Lock<FastMutex> l(rxMutex);
+    FastInterruptDisableLock dLock;
+    for(;;)
+    {
+        //With SIGIO masked, a signal raised after this read stays pending
+        //until we wait, so no wakeup can be lost
+        int result=host::read(inFd,buffer,size);
+        if(result>=0) return result;
+        if(result!=-host::EAGAIN_ && result!=-host::EINTR_) return -EIO;
+        do {
+            rxWaiting=Thread::IRQgetCurrentThread();
+            Thread::IRQwait();
+            {
+                FastInterruptEnableLock eLock(dLock);
+                Thread::yield();
+            }
+        } while(rxWaiting);
+    }
+}
+
+ssize_t HostConsole::writeBlock(const void *buffer, size_t size, off_t where)
+{
+    Lock<FastMutex> l(txMutex);
+    if(writeAll(reinterpret_cast<const char*>(buffer),size)==false) return -EIO;
+    return size;
+}
+
+void HostConsole::IRQwrite(const char *str)
+{
+    writeAll(str,strlen(str));
+}
+
+int HostConsole::ioctl(int cmd, void* arg)
+{
+    if(reinterpret_cast<unsigned>(arg) & 0b11) return -EFAULT; //Unaligned
+    termios *t=reinterpret_cast<termios*>(arg);
+    switch(cmd)
+    {
+        case IOCTL_SYNC:
+            return 0; //Host writes are never buffered by the simulator
+        case IOCTL_TCGETATTR:
+            t->c_iflag=IGNBRK | IGNPAR;
+            t->c_oflag=0;
+            t->c_cflag=CS8;
+            t->c_lflag=0;
+            return 0;
+        case IOCTL_TCSETATTR_NOW:
+        case IOCTL_TCSETATTR_DRAIN:
+        case IOCTL_TCSETATTR_FLUSH:
+            //Changing things at runtime unsupported, so do nothing, but don't
+            //return error as console_device.h implements some attribute changes
+            return 0;
+        default:
+            return -ENOTTY; //Means the operation does not apply to this descriptor
+    }
+}
+
+int HostConsole::poll(short events, PollEntry *entry)
+{
+    FastInterruptDisableLock dLock;
+    rxPollQueue.IRQadd(entry);
+    int result=events & (POLLOUT | POLLWRNORM); //Writes never fail to start
+    if(host::readable(inFd)) result|=events & (POLLIN | POLLRDNORM);
+    return result;
+}
+
+void HostConsole::IRQhandleInterrupt()
+{
+    bool hppw=false;
+    rxPollQueue.IRQwakeup(hppw);
+    if(rxWaiting)
+    {
+        rxWaiting->IRQwakeup();
+        if(rxWaiting->IRQgetPriority()>
+            Thread::IRQgetCurrentThread()->IRQgetPriority()) hppw=true;
+        rxWaiting=0;
+    }
+    if(hppw) Scheduler::IRQfindNextThread();
+}
+
+HostConsole::~HostConsole()
+{
+    InterruptDisableLock dLock;
+    console=nullptr;
+    if(oldInFlags>=0) host::fcntl(inFd,host::F_SETFL_,oldInFlags);
+}
+
+bool HostConsole::writeAll(const char *buf, size_t size)
+{
+    //The output may share the nonblocking flag with the input if both are
+    //the same terminal, so retry when the host is not ready
+    while(size>0)
+    {
+        int result=host::write(outFd,buf,size);
+        if(result==-host::EAGAIN_ || result==-host::EINTR_) continue;
+        if(result<0) return false;
+        buf+=result;
+        size-=result;
+    }
+    return true;
+}
+
+} //namespace miosix
@@ -0,0 +1,130 @@
+/***************************************************************************
+ *   Copyright (C) 2024 by Terraneo Federico                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+#pragma once
+
+#include "filesystem/console/console_device.h"
+#include "kernel/sync.h"
+
+namespace miosix {
+
+/**
+ * Console of the Linux simulator, connected to the standard input and output
+ * of the host process. Input is read with nonblocking host reads, and the
+ * SIGIO signal, which is the simulator equivalent of an RX interrupt, wakes
+ * threads waiting for data.
+ * Classes of this type are reference counted, must be allocated on the heap
+ * and managed through intrusive_ref_ptr<FileBase>
+ */
+class HostConsole : public Device
+{
+public:
+    /**
+     * Constructor. Only one instance of this class can exist.
+     * \param inFd host file descriptor to read from
+     * \param outFd host file descriptor to write to
+     */
+    HostConsole(int inFd=0, int outFd=1);
+
+    /**
+     * Read a block of data
+     * \param buffer buffer where read data will be stored
+     * \param size buffer size
+     * \param where where to read from
+     * \return number of bytes read or a negative number on failure. Note that
+     * it is normal for this function to return less character than the amount
+     * asked, and zero is returned when the host input is closed
+     */
+    ssize_t readBlock(void *buffer, size_t size, off_t where);
+
+    /**
+     * Write a block of data
+     * \param buffer buffer where take data to write
+     * \param size buffer size
+     * \param where where to write to
+     * \return number of bytes written or a negative number on failure
+     */
+    ssize_t writeBlock(const void *buffer, size_t size, off_t where);
+
+    /**
+     * Write a string.
+     * An extension to the Device interface that adds a new member function,
+     * which is used by the kernel on console devices to write debug information
+     * before the kernel is started or in case of serious errors, right before
+     * rebooting.
+     * Can ONLY be called when the kernel is not yet started, paused or within
+     * an interrupt.
+     * \param str the string to write. The string must be NUL terminated.
+     */
+    void IRQwrite(const char *str);
+
+    /**
+     * Performs device-specific operations
+     * \param cmd specifies the operation to perform
+     * \param arg optional argument that some operation require
+     * \return the exact return value depends on CMD, -1 is returned on error
+     */
+    int ioctl(int cmd, void *arg);
+
+    /**
+     * Check whether the console is ready for reading or writing
+     * \param events requested events, such as POLLIN or POLLOUT
+     * \param entry if not nullptr, registered in the RX PollQueue
+     * \return the events that are currently ready
+     */
+    int poll(short events, PollEntry *entry);
+
+    /**
+     * \internal the SIGIO handler calls this member function.
+     * Never call this from user code.
+     */
+    void IRQhandleInterrupt();
+
+    /**
+     * Destructor
+     */
+    ~HostConsole();
+
+private:
+    /**
+     * Write all the given data to the host, retrying on partial writes
+     * \param buf data to write
+     * \param size data size
+     * \return true on success
+     */
+    bool writeAll(const char *buf, size_t size);
+
+    FastMutex txMutex;                ///< Mutex locked during transmission
+    FastMutex rxMutex;                ///< Mutex locked during reception
+    Thread *rxWaiting;                ///< Thread waiting for rx, or 0
+    PollQueue rxPollQueue;            ///< Threads polling for rx
+    const int inFd;                   ///< Host file descriptor for input
+    const int outFd;                  ///< Host file descriptor for output
+    int oldInFlags;                   ///< Host file flags of inFd to restore
+};
+
+} //namespace miosix
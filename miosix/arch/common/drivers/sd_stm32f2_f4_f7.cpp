@@ -1198,6 +1198,96 @@ static bool multipleBlockWrite(const unsigned char *buffer, unsigned int nblk,
     return true;
 }
 
+/**
+ * \internal
+ * Read sectors with a single multiple block command, or one sector at a time
+ * if the buffer is in the CCM, which the DMA can't access
+ * \param buffer buffer where to store read data, size must be nblk*512
+ * \param nblk number of blocks to read
+ * \param lba logical block address of the first block to read
+ * \return true on success
+ */
+static bool readSectors(unsigned char *buffer, unsigned int nblk,
+        unsigned int lba)
+{
+    if(BufferConverter::isGoodBuffer(buffer))
+        return multipleBlockRead(buffer,nblk,lba);
+    //Fallback code to work around CCM
+    DBG("Buffer inside CCM\n");
+    for(unsigned int j=0;j<nblk;j++)
+    {
+        unsigned char* b=BufferConverter::toWordAlignedWithoutCopy(buffer);
+        if(multipleBlockRead(b,1,lba)==false) return false;
+        BufferConverter::toOriginalBuffer();
+        buffer+=512;
+        lba++;
+    }
+    return true;
+}
+
+/**
+ * \internal
+ * Write sectors with a single multiple block command, or one sector at a time
+ * if the buffer is in the CCM, which the DMA can't access
+ * \param buffer buffer with the data to write, size must be nblk*512
+ * \param nblk number of blocks to write
+ * \param lba logical block address of the first block to write
+ * \return true on success
+ */
+static bool writeSectors(const unsigned char *buffer, unsigned int nblk,
+        unsigned int lba)
+{
+    if(BufferConverter::isGoodBuffer(buffer))
+        return multipleBlockWrite(buffer,nblk,lba);
+    //Fallback code to work around CCM
+    DBG("Buffer inside CCM\n");
+    for(unsigned int j=0;j<nblk;j++)
+    {
+        const unsigned char* b=BufferConverter::toWordAligned(buffer);
+        if(multipleBlockWrite(b,1,lba)==false) return false;
+        buffer+=512;
+        lba++;
+    }
+    return true;
+}
+
+/**
+ * \internal
+ * Check that a vectored transfer is made of whole sectors
+ * \param iov array of buffers
+ * \param iovcnt number of elements in iov
+ * \return the total transfer size in bytes, or -1 if a buffer size is not a
+ * multiple of the sector size
+ */
+static ssize_t sectorTransferSize(const struct iovec *iov, int iovcnt)
+{
+    size_t size=0;
+    for(int i=0;i<iovcnt;i++)
+    {
+        if(iov[i].iov_len % 512) return -1;
+        size+=iov[i].iov_len;
+    }
+    return size;
+}
+
+/**
+ * \internal
+ * Find a run of buffers that are contiguous in memory, so that they can be
+ * transferred with a single multiple block command
+ * \param iov array of buffers
+ * \param iovcnt number of elements in iov
+ * \param i index of the first buffer of the run, on return is the index of
+ * the first buffer after the run
+ * \return the size of the run in bytes
+ */
+static size_t contiguousRun(const struct iovec *iov, int iovcnt, int& i)
+{
+    const char *start=reinterpret_cast<const char*>(iov[i].iov_base);
+    size_t size=iov[i].iov_len;
+    for(i++;i<iovcnt && start+size==iov[i].iov_base;i++) size+=iov[i].iov_len;
+    return size;
+}
+
 //
 // Class CardSelector
 //
@@ -1434,13 +1524,22 @@ intrusive_ref_ptr<SDIODriver> SDIODriver::instance()
 
 ssize_t SDIODriver::readBlock(void* buffer, size_t size, off_t where)
 {
-    if(where % 512 || size % 512) return -EFAULT;
-    unsigned int lba=where/512;
-    unsigned int nSectors=size/512;
+    struct iovec iov={buffer,size};
+    return readBlockv(&iov,1,where);
+}
+
+ssize_t SDIODriver::writeBlock(const void* buffer, size_t size, off_t where)
+{
+    struct iovec iov={const_cast<void*>(buffer),size};
+    return writeBlockv(&iov,1,where);
+}
+
+ssize_t SDIODriver::readBlockv(const struct iovec *iov, int iovcnt, off_t where)
+{
+    ssize_t size=sectorTransferSize(iov,iovcnt);
+    if(where % 512 || size<0) return -EFAULT;
     Lock<FastMutex> l(mutex);
-    DBG("SDIODriver::readBlock(): nSectors=%d\n",nSectors);
-    bool goodBuffer=BufferConverter::isGoodBuffer(buffer);
-    if(goodBuffer==false) DBG("Buffer inside CCM\n");
+    DBG("SDIODriver::readBlockv(): nSectors=%d\n",size/512);
     
     for(int i=0;i<ClockController::getRetryCount();i++)
     {
@@ -1449,27 +1548,15 @@ ssize_t SDIODriver::readBlock(void* buffer, size_t size, off_t where)
         if(selector.succeded()==false) continue;
         #endif //SD_KEEP_CARD_SELECTED
         bool error=false;
-        
-        if(goodBuffer)
+        unsigned int lba=where/512;
+        for(int j=0;j<iovcnt && error==false;)
         {
-            if(multipleBlockRead(reinterpret_cast<unsigned char*>(buffer),
-                nSectors,lba)==false) error=true;
-        } else {
-            //Fallback code to work around CCM
-            unsigned char *tempBuffer=reinterpret_cast<unsigned char*>(buffer);
-            unsigned int tempLba=lba;
-            for(unsigned int j=0;j<nSectors;j++)
-            {
-                unsigned char* b=BufferConverter::toWordAlignedWithoutCopy(tempBuffer);
-                if(multipleBlockRead(b,1,tempLba)==false)
-                {
-                    error=true;
-                    break;
-                }
-                BufferConverter::toOriginalBuffer();
-                tempBuffer+=512;
-                tempLba++;
-            }
+            unsigned char *buffer=
+                reinterpret_cast<unsigned char*>(iov[j].iov_base);
+            unsigned int nSectors=contiguousRun(iov,iovcnt,j)/512;
+            if(nSectors==0) continue;
+            if(readSectors(buffer,nSectors,lba)==false) error=true;
+            lba+=nSectors;
         }
         
         if(error==false)
@@ -1481,15 +1568,13 @@ ssize_t SDIODriver::readBlock(void* buffer, size_t size, off_t where)
     return -EBADF;
 }
 
-ssize_t SDIODriver::writeBlock(const void* buffer, size_t size, off_t where)
+ssize_t SDIODriver::writeBlockv(const struct iovec *iov, int iovcnt,
+                                off_t where)
 {
-    if(where % 512 || size % 512) return -EFAULT;
-    unsigned int lba=where/512;
-    unsigned int nSectors=size/512;
+    ssize_t size=sectorTransferSize(iov,iovcnt);
+    if(where % 512 || size<0) return -EFAULT;
     Lock<FastMutex> l(mutex);
-    DBG("SDIODriver::writeBlock(): nSectors=%d\n",nSectors);
-    bool goodBuffer=BufferConverter::isGoodBuffer(buffer);
-    if(goodBuffer==false) DBG("Buffer inside CCM\n");
+    DBG("SDIODriver::writeBlockv(): nSectors=%d\n",size/512);
     
     for(int i=0;i<ClockController::getRetryCount();i++)
     {
@@ -1498,27 +1583,15 @@ ssize_t SDIODriver::writeBlock(const void* buffer, size_t size, off_t where)
         if(selector.succeded()==false) continue;
         #endif //SD_KEEP_CARD_SELECTED
         bool error=false;
-        
-        if(goodBuffer)
+        unsigned int lba=where/512;
+        for(int j=0;j<iovcnt && error==false;)
         {
-            if(multipleBlockWrite(reinterpret_cast<const unsigned char*>(buffer),
-                nSectors,lba)==false) error=true;
-        } else {
-            //Fallback code to work around CCM
-            const unsigned char *tempBuffer=
-                reinterpret_cast<const unsigned char*>(buffer);
-            unsigned int tempLba=lba;
-            for(unsigned int j=0;j<nSectors;j++)
-            {
-                const unsigned char* b=BufferConverter::toWordAligned(tempBuffer);
-                if(multipleBlockWrite(b,1,tempLba)==false)
-                {
-                    error=true;
-                    break;
-                }
-                tempBuffer+=512;
-                tempLba++;
-            }
+            const unsigned char *buffer=
+                reinterpret_cast<const unsigned char*>(iov[j].iov_base);
+            unsigned int nSectors=contiguousRun(iov,iovcnt,j)/512;
+            if(nSectors==0) continue;
+            if(writeSectors(buffer,nSectors,lba)==false) error=true;
+            lba+=nSectors;
         }
         
         if(error==false)
@@ -48,6 +48,11 @@ public:
     virtual ssize_t readBlock(void *buffer, size_t size, off_t where);
     
     virtual ssize_t writeBlock(const void *buffer, size_t size, off_t where);
+
+    virtual ssize_t readBlockv(const struct iovec *iov, int iovcnt, off_t where);
+
+    virtual ssize_t writeBlockv(const struct iovec *iov, int iovcnt,
+                                off_t where);
     
     virtual int ioctl(int cmd, void *arg);
 private:
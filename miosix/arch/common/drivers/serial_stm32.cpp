@@ -844,19 +844,17 @@ ssize_t STM32Serial::readBlock(void *buffer, size_t size, off_t where)
     Lock<FastMutex> l(rxMutex);
     char *buf=reinterpret_cast<char*>(buffer);
     size_t result=0;
-    FastInterruptDisableLock dLock;
     DeepSleepLock dpLock;
     for(;;)
     {
-        //Try to get data from the queue
-        for(;result<size;result++)
-        {
-            if(rxQueue.tryGet(buf[result])==false) break;
-            //This is here just not to keep IRQ disabled for the whole loop
-            FastInterruptEnableLock eLock(dLock);
-        }
-        if(idle && result>0) break;
+        //Try to get data from the queue, being lock-free no need to disable
+        //interrupts while copying
+        result+=rxQueue.tryGetMany(buf+result,size-result);
         if(result==size) break;
+        FastInterruptDisableLock dLock;
+        //Data that arrived after tryGetMany() must be consumed before waiting
+        if(rxQueue.isEmpty()==false) continue;
+        if(idle && result>0) break;
         //Wait for data in the queue
         do {
             rxWaiting=Thread::IRQgetCurrentThread();
@@ -870,39 +868,76 @@ ssize_t STM32Serial::readBlock(void *buffer, size_t size, off_t where)
     return result;
 }
 
+int STM32Serial::poll(short events, PollEntry *entry)
+{
+    FastInterruptDisableLock dLock;
+    rxPollQueue.IRQadd(entry);
+    int result=events & (POLLOUT | POLLWRNORM); //Writes never fail to start
+    if(rxQueue.isEmpty()==false) result|=events & (POLLIN | POLLRDNORM);
+    return result;
+}
+
 ssize_t STM32Serial::writeBlock(const void *buffer, size_t size, off_t where)
+{
+    struct iovec iov={const_cast<void*>(buffer),size};
+    return writeBlockv(&iov,1,where);
+}
+
+ssize_t STM32Serial::writeBlockv(const struct iovec *iov, int iovcnt,
+                                 off_t where)
 {
     Lock<FastMutex> l(txMutex);
     DeepSleepLock dpLock;
-    const char *buf=reinterpret_cast<const char*>(buffer);
+    size_t size=0;
+    for(int i=0;i<iovcnt;i++) size+=iov[i].iov_len;
     #ifdef SERIAL_DMA
     if(dmaTx)
     {
-        size_t remaining=size;
-        if(isInCCMarea(buf)==false)
+        //The last txBufferSize bytes are always copied to txBuffer so that we
+        //can return while the DMA is still in progress. Before that point,
+        //large buffers are sent zero copy, if possible, while small ones are
+        //gathered in txBuffer and sent with a single DMA transfer
+        size_t zeroCopyEnd= size>txBufferSize ? size-txBufferSize : 0;
+        size_t pos=0;
+        size_t fill=0;
+        for(int i=0;i<iovcnt;i++)
         {
-            //Use zero copy for all but the last txBufferSize bytes, if possible
-            while(remaining>txBufferSize)
+            const char *buf=reinterpret_cast<const char*>(iov[i].iov_base);
+            size_t remaining=iov[i].iov_len;
+            while(remaining>0)
             {
-                //DMA is limited to 64K
-                size_t transferSize=min<size_t>(remaining-txBufferSize,65535);
-                waitDmaTxCompletion();
-                writeDma(buf,transferSize);
+                size_t zeroCopy=0;
+                if(pos<zeroCopyEnd && remaining>=txBufferSize
+                    && isInCCMarea(buf)==false)
+                    zeroCopy=min(remaining,zeroCopyEnd-pos);
+                size_t transferSize;
+                if(zeroCopy>0)
+                {
+                    if(fill>0) writeDma(txBuffer,fill);
+                    fill=0;
+                    //DMA is limited to 64K
+                    transferSize=min<size_t>(zeroCopy,65535);
+                    waitDmaTxCompletion();
+                    writeDma(buf,transferSize);
+                } else {
+                    //Copy to txBuffer only after DMA xfer completed, as the
+                    //previous xfer may be using the same buffer
+                    if(fill==0) waitDmaTxCompletion();
+                    transferSize=min<size_t>(remaining,txBufferSize-fill);
+                    memcpy(txBuffer+fill,buf,transferSize);
+                    fill+=transferSize;
+                    if(fill==txBufferSize)
+                    {
+                        writeDma(txBuffer,fill);
+                        fill=0;
+                    }
+                }
                 buf+=transferSize;
                 remaining-=transferSize;
+                pos+=transferSize;
             }
         }
-        while(remaining>0)
-        {
-            size_t transferSize=min(remaining,static_cast<size_t>(txBufferSize));
-            waitDmaTxCompletion();
-            //Copy to txBuffer only after DMA xfer completed, as the previous
-            //xfer may be using the same buffer
-            memcpy(txBuffer,buf,transferSize);
-            writeDma(txBuffer,transferSize);
-            buf+=transferSize;
-            remaining-=transferSize;
-        }
+        if(fill>0) writeDma(txBuffer,fill);
         #ifdef WITH_DEEP_SLEEP
         //The serial driver by default can return even though the last part of
         //the data is still being transmitted by the DMA. When using deep sleep
@@ -914,20 +949,24 @@ ssize_t STM32Serial::writeBlock(const void *buffer, size_t size, off_t where)
         return size;
     }
     #endif //SERIAL_DMA
-    for(size_t i=0;i<size;i++)
+    for(int i=0;i<iovcnt;i++)
     {
-        #if !defined(_ARCH_CORTEXM7_STM32F7) && !defined(_ARCH_CORTEXM7_STM32H7) \
-         && !defined(_ARCH_CORTEXM0_STM32F0) && !defined(_ARCH_CORTEXM4_STM32F3) \
-         && !defined(_ARCH_CORTEXM4_STM32L4) && !defined(_ARCH_CORTEXM0PLUS_STM32L0)
-        while((port->SR & USART_SR_TXE)==0) ;
-        port->DR=*buf++;
-        #elif defined(_ARCH_CORTEXM7_STM32H7)
-        while((port->ISR & USART_ISR_TXE_TXFNF)==0) ;
-        port->TDR=*buf++;
-        #else //_ARCH_CORTEXM7_STM32F7/H7
-        while((port->ISR & USART_ISR_TXE)==0) ;
-        port->TDR=*buf++;
-        #endif //_ARCH_CORTEXM7_STM32F7/H7
+        const char *buf=reinterpret_cast<const char*>(iov[i].iov_base);
+        for(size_t j=0;j<iov[i].iov_len;j++)
+        {
+            #if !defined(_ARCH_CORTEXM7_STM32F7) && !defined(_ARCH_CORTEXM7_STM32H7) \
+             && !defined(_ARCH_CORTEXM0_STM32F0) && !defined(_ARCH_CORTEXM4_STM32F3) \
+             && !defined(_ARCH_CORTEXM4_STM32L4) && !defined(_ARCH_CORTEXM0PLUS_STM32L0)
+            while((port->SR & USART_SR_TXE)==0) ;
+            port->DR=*buf++;
+            #elif defined(_ARCH_CORTEXM7_STM32H7)
+            while((port->ISR & USART_ISR_TXE_TXFNF)==0) ;
+            port->TDR=*buf++;
+            #else //_ARCH_CORTEXM7_STM32F7/H7
+            while((port->ISR & USART_ISR_TXE)==0) ;
+            port->TDR=*buf++;
+            #endif //_ARCH_CORTEXM7_STM32F7/H7
+        }
     }
     return size;
 }
@@ -1009,6 +1048,11 @@ int STM32Serial::ioctl(int cmd, void* arg)
 
 void STM32Serial::IRQhandleInterrupt()
 {
+    #ifdef WITH_KERNEL_TRACE
+    //IPSR holds the exception number, peripheral interrupts start from 16
+    unsigned short irq=__get_IPSR()-16;
+    KernelTrace::IRQrecord(TraceEventType::IrqEnter,irq,0,0);
+    #endif //WITH_KERNEL_TRACE
     #if !defined(_ARCH_CORTEXM7_STM32F7) && !defined(_ARCH_CORTEXM7_STM32H7) \
      && !defined(_ARCH_CORTEXM0_STM32F0)   && !defined(_ARCH_CORTEXM4_STM32F3) \
      && !defined(_ARCH_CORTEXM4_STM32L4) && !defined(_ARCH_CORTEXM0PLUS_STM32L0)
@@ -1041,7 +1085,7 @@ void STM32Serial::IRQhandleInterrupt()
         #endif //_ARCH_CORTEXM7_STM32F7/H7
         //If no error put data in buffer
         if((status & USART_SR_FE)==0)
-            if(rxQueue.tryPut(c)==false) /*fifo overflow*/;
+            if(rxQueue.IRQput(c)==false) /*fifo overflow*/;
         idle=false;
     }
     if(status & USART_SR_IDLE)
@@ -1069,7 +1113,11 @@ void STM32Serial::IRQhandleInterrupt()
                     Scheduler::IRQfindNextThread();
             rxWaiting=0;
         }
+        if(rxQueue.isEmpty()==false) rxPollQueue.IRQwakeup();
     }
+    #ifdef WITH_KERNEL_TRACE
+    KernelTrace::IRQrecord(TraceEventType::IrqExit,irq,0,0);
+    #endif //WITH_KERNEL_TRACE
 }
 
 #ifdef SERIAL_DMA
@@ -1087,6 +1135,7 @@ void STM32Serial::IRQhandleDMArx()
 {
     IRQreadDma();
     idle=false;
+    rxPollQueue.IRQwakeup();
     if(rxWaiting==0) return;
     rxWaiting->IRQwakeup();
     if(rxWaiting->IRQgetPriority()>Thread::IRQgetCurrentThread()->IRQgetPriority())
@@ -1295,8 +1344,7 @@ void STM32Serial::IRQreadDma()
 {
     int elem=IRQdmaReadStop();
     markBufferAfterDmaRead(rxBuffer,rxQueueMin);
-    for(int i=0;i<elem;i++)
-        if(rxQueue.tryPut(rxBuffer[i])==false) /*fifo overflow*/;
+    if(rxQueue.IRQputMany(rxBuffer,elem)<unsigned(elem)) /*fifo overflow*/;
     IRQdmaReadStart();
 }
 
@@ -153,6 +153,17 @@ public:
      * \return number of bytes written or a negative number on failure
      */
     ssize_t writeBlock(const void *buffer, size_t size, off_t where);
+
+    /**
+     * Write data from multiple buffers. When using DMA, small buffers are
+     * gathered into a single transfer and large ones are sent zero copy, with
+     * the transmission mutex taken only once.
+     * \param iov array of buffers where take data to write
+     * \param iovcnt number of elements in iov
+     * \param where where to write to
+     * \return number of bytes written or a negative number on failure
+     */
+    ssize_t writeBlockv(const struct iovec *iov, int iovcnt, off_t where);
     
     /**
      * Write a string.
@@ -173,6 +184,15 @@ public:
      * \return the exact return value depends on CMD, -1 is returned on error
      */
     int ioctl(int cmd, void *arg);
+
+    /**
+     * Check whether the serial port is ready for reading or writing. Writing
+     * is always possible, reading is possible when received data is queued.
+     * \param events requested events, such as POLLIN or POLLOUT
+     * \param entry if not nullptr, registered to be woken when data arrives
+     * \return the events that are currently ready
+     */
+    int poll(short events, PollEntry *entry);
     
     /**
      * \internal the serial port interrupts call this member function.
@@ -260,9 +280,10 @@ private:
     FastMutex txMutex;                ///< Mutex locked during transmission
     FastMutex rxMutex;                ///< Mutex locked during reception
     
-    DynUnsyncQueue<char> rxQueue;     ///< Receiving queue
+    DynSpscQueue<char> rxQueue;       ///< Receiving queue
     static const unsigned int rxQueueMin=16; ///< Minimum queue size
     Thread *rxWaiting=0;              ///< Thread waiting for rx, or 0
+    PollQueue rxPollQueue;            ///< Threads polling for rx
     
     USART_TypeDef *port;              ///< Pointer to USART peripheral
     #ifdef SERIAL_DMA
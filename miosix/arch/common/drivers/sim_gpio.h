@@ -0,0 +1,119 @@
+/***************************************************************************
+ *   Copyright (C) 2024 by Terraneo Federico                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+#pragma once
+
+/*
+ * The simulator has no pins, so gpios are simulated by keeping their state in
+ * memory. This is enough to run code written for real boards, for example
+ * blinking a led, and reading back an output returns the last written value.
+ */
+
+const unsigned int GPIOA_BASE=0;
+const unsigned int GPIOB_BASE=1;
+const unsigned int GPIOC_BASE=2;
+const unsigned int GPIOD_BASE=3;
+
+namespace miosix {
+
+/**
+ * State of a simulated gpio port
+ */
+struct SimGpioPort
+{
+    volatile unsigned int out;  ///< Output value of each pin
+    volatile unsigned int mode; ///< One bit per pin, 1 if output
+};
+
+/// Simulated gpio ports, indexed by GPIOx_BASE
+extern SimGpioPort simGpio[4];
+
+class Mode
+{
+public:
+    enum Mode_
+    {
+        INPUT  = 0, ///< Input, reads the simulated output value
+        OUTPUT = 1  ///< Output
+    };
+private:
+    Mode(); //Just a wrapper class, disallow creating instances
+};
+
+class GpioPin
+{
+public:
+    GpioPin(unsigned int p, unsigned char n) : p(p), n(n) {}
+
+    void mode(Mode::Mode_ m)
+    {
+        if(m==Mode::OUTPUT) simGpio[p].mode|=1<<n;
+        else simGpio[p].mode&=~(1<<n);
+    }
+
+    void high() { simGpio[p].out|=1<<n; }
+
+    void low() { simGpio[p].out&=~(1<<n); }
+
+    void toggle() { simGpio[p].out^=1<<n; }
+
+    int value() { return (simGpio[p].out & 1<<n) ? 1 : 0; }
+
+    unsigned int getPort() const { return p; }
+
+    unsigned char getNumber() const { return n; }
+
+private:
+    unsigned int p;  ///< Port index
+    unsigned char n; ///< Number of the GPIO within the port
+};
+
+template<unsigned int P, unsigned char N>
+class Gpio
+{
+public:
+    static void mode(Mode::Mode_ m) { getPin().mode(m); }
+
+    static void high() { simGpio[P].out|=1<<N; }
+
+    static void low() { simGpio[P].out&=~(1<<N); }
+
+    static void toggle() { simGpio[P].out^=1<<N; }
+
+    static int value() { return (simGpio[P].out & 1<<N) ? 1 : 0; }
+
+    static GpioPin getPin() { return GpioPin(P,N); }
+
+    unsigned int getPort() const { return P; }
+
+    unsigned char getNumber() const { return N; }
+
+private:
+    Gpio();//Only static member functions, disallow creating instances
+};
+
+} //namespace miosix
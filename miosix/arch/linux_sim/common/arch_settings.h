@@ -0,0 +1,65 @@
+/***************************************************************************
+ *   Copyright (C) 2024 by Terraneo Federico                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+#pragma once
+
+namespace miosix {
+
+/**
+ * \addtogroup Settings
+ * \{
+ */
+
+/// \internal Size of vector to store registers during ctx switch
+/// ((11+156)*4=668Bytes). esp, ebp, ebx, esi, edi, eax, ecx, edx, eip,
+/// eflags and the interrupt signals in the thread signal mask are followed by
+/// the x87 and SSE state. The simulator switches context from within signal
+/// handlers, so all registers are saved here from the signal frame, and the
+/// thread stack is not used.
+const unsigned char CTXSAVE_SIZE=11+156;
+
+/// \internal some architectures save part of the context on their stack.
+/// Signal frames are on a separate stack (sigaltstack), but the stack of a
+/// new thread starts with the arguments of threadLauncher and a null return
+/// address, aligned as the ABI requires, so 32 bytes are reserved for them.
+/// MUST be divisible by 4.
+const unsigned int CTXSAVE_ON_STACK=32;
+
+/// \internal stack alignment for this specific architecture. The i386 ABI
+/// used by gcc requires 16 byte alignment for SSE spills
+const unsigned int CTXSAVE_STACK_ALIGNMENT=16;
+
+/// \internal Size of the stack used by signal handlers, that play the role of
+/// interrupts in the simulator. A signal frame with the full xsave state can
+/// take a few KB on recent CPUs, hence the size.
+const unsigned int IRQ_STACK_SIZE=32*1024;
+
+/**
+ * \}
+ */
+
+} //namespace miosix
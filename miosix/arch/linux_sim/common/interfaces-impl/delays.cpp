@@ -0,0 +1,52 @@
+/***************************************************************************
+ *   Copyright (C) 2024 by Terraneo Federico                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+#include "interfaces/delays.h"
+#include "interfaces/arch_registers.h"
+
+namespace miosix {
+
+/*
+ * There is no cycle accurate way to busy wait on the host, as the simulator
+ * may be preempted by other host processes at any time, so delays poll the
+ * host monotonic clock. This guarantees that the delay is never shorter than
+ * requested, which is what code using delays relies on.
+ */
+
+void delayMs(unsigned int mseconds)
+{
+    long long end=host::monotonicTime()+mseconds*1000000LL;
+    while(host::monotonicTime()<end) ;
+}
+
+void delayUs(unsigned int useconds)
+{
+    long long end=host::monotonicTime()+useconds*1000LL;
+    while(host::monotonicTime()<end) ;
+}
+
+} //namespace miosix
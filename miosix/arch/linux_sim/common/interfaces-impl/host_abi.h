@@ -0,0 +1,388 @@
+/***************************************************************************
+ *   Copyright (C) 2024 by Terraneo Federico                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+#pragma once
+
+/*
+ * The "hardware" of the simulator is the Linux i386 system call interface.
+ * The kernel is linked with the same newlib used on the real targets, so
+ * there is no host C library: this file provides the few Linux system calls,
+ * constants and data structures the simulator needs, the same way the
+ * CMSIS headers describe the peripherals of a microcontroller.
+ * Everything here follows the Linux i386 ABI, and the simulator can only be
+ * built for 32 bit x86 as the kernel stores pointers in unsigned int.
+ */
+
+namespace host {
+
+/// System call numbers
+enum Syscall
+{
+    SYS_exit_group=252,
+    SYS_read=3,
+    SYS_write=4,
+    SYS_open=5,
+    SYS_close=6,
+    SYS_getpid=20,
+    SYS_kill=37,
+    SYS_mmap=90,
+    SYS_munmap=91,
+    SYS_fsync=118,
+    SYS_llseek=140,
+    SYS_poll=168,
+    SYS_rt_sigreturn=173,
+    SYS_rt_sigaction=174,
+    SYS_rt_sigprocmask=175,
+    SYS_rt_sigsuspend=179,
+    SYS_pread64=180,
+    SYS_pwrite64=181,
+    SYS_sigaltstack=186,
+    SYS_fcntl64=221,
+    SYS_timer_create=259,
+    SYS_timer_settime=260,
+    SYS_clock_gettime=265
+};
+
+/// Signals. The simulator uses them as interrupts
+enum Signal
+{
+    SIGILL_=4,
+    SIGTRAP_=5,
+    SIGBUS_=7,
+    SIGFPE_=8,
+    SIGUSR1_=10,
+    SIGSEGV_=11,
+    SIGALRM_=14,
+    SIGIO_=29
+};
+
+// Other constants. Names match the Linux ones with a trailing underscore, as
+// newlib headers define some of them with different values
+const int EINTR_=4;
+const int EAGAIN_=11;
+const int O_RDONLY_=0;
+const int O_RDWR_=2;
+const int O_NONBLOCK_=04000;
+const int O_ASYNC_=020000;
+const int O_LARGEFILE_=0100000;
+const int F_GETFL_=3;
+const int F_SETFL_=4;
+const int F_SETOWN_=8;
+const int SEEK_END_=2;
+const int SIG_BLOCK_=0;
+const int SIG_UNBLOCK_=1;
+const int SIG_SETMASK_=2;
+const int CLOCK_MONOTONIC_=1;
+const int TIMER_ABSTIME_=1;
+const int SIGEV_SIGNAL_=0;
+const short POLLIN_=1;
+const int PROT_READ_=1;
+const int MAP_PRIVATE_=2;
+const unsigned int SA_SIGINFO_=0x00000004;
+const unsigned int SA_ONSTACK_=0x08000000;
+const unsigned int SA_RESTORER_=0x04000000;
+const unsigned int SA_RESTART_=0x10000000;
+
+/// Signal mask, as seen by rt_sigprocmask. Bit n-1 is signal n
+typedef unsigned long long SigSet;
+
+/**
+ * \param sig a signal number
+ * \return the signal mask bit corresponding to that signal
+ */
+constexpr SigSet sigBit(int sig) { return 1ull<<(sig-1); }
+
+/// Argument of rt_sigaction
+struct SigAction
+{
+    void (*handler)(int, void *, void *);
+    unsigned int flags;
+    void (*restorer)();
+    SigSet mask;
+};
+
+/// Argument of sigaltstack
+struct SigStack
+{
+    void *sp;
+    int flags;
+    unsigned int size;
+};
+
+/// Saved registers in a signal frame (struct sigcontext_32)
+struct SigContext
+{
+    unsigned short gs, gsh, fs, fsh, es, esh, ds, dsh;
+    unsigned int edi, esi, ebp, esp, ebx, edx, ecx, eax;
+    unsigned int trapno, err, eip;
+    unsigned short cs, csh;
+    unsigned int eflags, espAtSignal;
+    unsigned short ss, ssh;
+    unsigned char *fpstate; ///< Points to the FPU state, nullptr if none
+    unsigned int oldmask, cr2;
+};
+
+/// Third argument of an SA_SIGINFO signal handler (struct ucontext)
+struct UContext
+{
+    unsigned int flags;
+    UContext *link;
+    SigStack stack;
+    SigContext mcontext;
+    SigSet sigmask;
+};
+
+/// Second argument of an SA_SIGINFO signal handler, only the used fields
+struct SigInfo
+{
+    int signo;
+    int errnum;
+    int code;
+    void *addr; ///< Faulting address, for SIGSEGV, SIGBUS, SIGILL and SIGFPE
+};
+
+/// Legacy FPU state followed by the fxsave image, as found in a signal frame.
+/// The xsave extension that may follow is not saved, the simulator only uses
+/// x87 and SSE registers
+const unsigned int fpstateSize=112+512;
+/// Offset within the FPU state of the word telling that an xsave extension
+/// follows (FP_XSTATE_MAGIC1)
+const unsigned int fpstateMagicOffset=112+464;
+
+/// 32 bit struct timespec
+struct TimeSpec
+{
+    int sec;
+    int nsec;
+};
+
+/// Argument of timer_settime
+struct ITimerSpec
+{
+    TimeSpec interval;
+    TimeSpec value;
+};
+
+/// Argument of timer_create
+struct SigEvent
+{
+    int value;
+    int signo;
+    int notify;
+    int pad[13];
+};
+
+/// Argument of poll
+struct PollFd
+{
+    int fd;
+    short events;
+    short revents;
+};
+
+/// Argument of the old mmap system call, the only one taking 6 parameters
+struct MmapArgs
+{
+    void *addr;
+    unsigned int len;
+    int prot;
+    int flags;
+    int fd;
+    unsigned int offset;
+};
+
+inline int syscall(int n)
+{
+    int r;
+    asm volatile("int $0x80":"=a"(r):"a"(n):"memory");
+    return r;
+}
+
+inline int syscall(int n, int a)
+{
+    int r;
+    asm volatile("int $0x80":"=a"(r):"a"(n),"b"(a):"memory");
+    return r;
+}
+
+inline int syscall(int n, int a, int b)
+{
+    int r;
+    asm volatile("int $0x80":"=a"(r):"a"(n),"b"(a),"c"(b):"memory");
+    return r;
+}
+
+inline int syscall(int n, int a, int b, int c)
+{
+    int r;
+    asm volatile("int $0x80":"=a"(r):"a"(n),"b"(a),"c"(b),"d"(c):"memory");
+    return r;
+}
+
+inline int syscall(int n, int a, int b, int c, int d)
+{
+    int r;
+    asm volatile("int $0x80":"=a"(r):"a"(n),"b"(a),"c"(b),"d"(c),"S"(d)
+                 :"memory");
+    return r;
+}
+
+inline int syscall(int n, int a, int b, int c, int d, int e)
+{
+    int r;
+    asm volatile("int $0x80":"=a"(r):"a"(n),"b"(a),"c"(b),"d"(c),"S"(d),"D"(e)
+                 :"memory");
+    return r;
+}
+
+//
+// Wrappers. They return a negative errno on failure, as the system calls do
+//
+
+inline int write(int fd, const void *buf, unsigned int size)
+{
+    return syscall(SYS_write,fd,reinterpret_cast<int>(buf),size);
+}
+
+inline int read(int fd, void *buf, unsigned int size)
+{
+    return syscall(SYS_read,fd,reinterpret_cast<int>(buf),size);
+}
+
+inline int open(const char *path, int flags, int mode=0)
+{
+    return syscall(SYS_open,reinterpret_cast<int>(path),flags|O_LARGEFILE_,mode);
+}
+
+inline int close(int fd) { return syscall(SYS_close,fd); }
+
+inline int pread(int fd, void *buf, unsigned int size, long long where)
+{
+    return syscall(SYS_pread64,fd,reinterpret_cast<int>(buf),size,
+                   static_cast<int>(where),static_cast<int>(where>>32));
+}
+
+inline int pwrite(int fd, const void *buf, unsigned int size, long long where)
+{
+    return syscall(SYS_pwrite64,fd,reinterpret_cast<int>(buf),size,
+                   static_cast<int>(where),static_cast<int>(where>>32));
+}
+
+/**
+ * \return the file size, or a negative errno on failure
+ */
+inline long long fileSize(int fd)
+{
+    long long result;
+    int r=syscall(SYS_llseek,fd,0,0,reinterpret_cast<int>(&result),SEEK_END_);
+    return r<0 ? r : result;
+}
+
+/**
+ * Check whether a file descriptor is readable, without blocking
+ * \return true if a read would not block
+ */
+inline bool readable(int fd)
+{
+    PollFd pfd={fd,POLLIN_,0};
+    return syscall(SYS_poll,reinterpret_cast<int>(&pfd),1,0)>0;
+}
+
+inline int fsync(int fd) { return syscall(SYS_fsync,fd); }
+
+inline int fcntl(int fd, int cmd, int arg)
+{
+    return syscall(SYS_fcntl64,fd,cmd,arg);
+}
+
+inline void *mmap(unsigned int size, int prot, int flags, int fd)
+{
+    MmapArgs args={nullptr,size,prot,flags,fd,0};
+    return reinterpret_cast<void*>(syscall(SYS_mmap,reinterpret_cast<int>(&args)));
+}
+
+inline int getpid() { return syscall(SYS_getpid); }
+
+inline int kill(int pid, int sig) { return syscall(SYS_kill,pid,sig); }
+
+
+inline void __attribute__((noreturn)) exitGroup(int status)
+{
+    syscall(SYS_exit_group,status);
+    for(;;) ;
+}
+
+inline int sigaction(int sig, const SigAction *act)
+{
+    return syscall(SYS_rt_sigaction,sig,reinterpret_cast<int>(act),0,
+                   sizeof(SigSet));
+}
+
+inline int sigprocmask(int how, const SigSet *set, SigSet *old)
+{
+    return syscall(SYS_rt_sigprocmask,how,reinterpret_cast<int>(set),
+                   reinterpret_cast<int>(old),sizeof(SigSet));
+}
+
+/**
+ * Atomically replace the signal mask and wait for a signal handler to run.
+ * The previous mask is restored before returning
+ * \param mask signal mask to use while waiting
+ */
+inline int sigsuspend(const SigSet *mask)
+{
+    return syscall(SYS_rt_sigsuspend,reinterpret_cast<int>(mask),
+                   sizeof(SigSet));
+}
+
+inline int sigaltstack(const SigStack *ss)
+{
+    return syscall(SYS_sigaltstack,reinterpret_cast<int>(ss),0);
+}
+
+inline int timerCreate(int clock, SigEvent *sev, int *id)
+{
+    return syscall(SYS_timer_create,clock,reinterpret_cast<int>(sev),
+                   reinterpret_cast<int>(id));
+}
+
+inline int timerSettime(int id, int flags, const ITimerSpec *value)
+{
+    return syscall(SYS_timer_settime,id,flags,reinterpret_cast<int>(value),0);
+}
+
+/**
+ * \return the time of the host monotonic clock in nanoseconds
+ */
+inline long long monotonicTime()
+{
+    TimeSpec ts;
+    syscall(SYS_clock_gettime,CLOCK_MONOTONIC_,reinterpret_cast<int>(&ts));
+    return static_cast<long long>(ts.sec)*1000000000LL+ts.nsec;
+}
+
+} //namespace host
@@ -0,0 +1,128 @@
+/***************************************************************************
+ *   Copyright (C) 2024 by Terraneo Federico                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+#include "interfaces/portability.h"
+#include "kernel/kernel.h"
+#include "kernel/error.h"
+#include "interfaces/bsp.h"
+#include "kernel/scheduler/scheduler.h"
+
+namespace miosix_private {
+
+int hostPid;
+
+/**
+ * \internal
+ * Called by the software interrupt, yield to next thread
+ */
+void ISR_yield()
+{
+    miosix::Thread::IRQstackOverflowCheck();
+    miosix::Scheduler::IRQfindNextThread();
+}
+
+void IRQsystemReboot()
+{
+    //There is no way to reboot a simulator, so end it with an error status
+    host::exitGroup(1);
+}
+
+/**
+ * \internal
+ * Fill the x87 and SSE part of a ctxsave with the state of a freshly reset
+ * FPU, in the format of a signal frame
+ * \param f pointer to the FPU state
+ */
+static void initFpuState(unsigned char *f)
+{
+    __builtin_memset(f,0,host::fpstateSize);
+    //Legacy fsave header: control word, status word, all registers empty
+    *reinterpret_cast<unsigned int*>(f+0)=0xffff037f;
+    *reinterpret_cast<unsigned int*>(f+4)=0xffff0000;
+    *reinterpret_cast<unsigned int*>(f+8)=0xffffffff;
+    //fxsave image: control word and SSE control/status register
+    *reinterpret_cast<unsigned short*>(f+112)=0x037f;
+    *reinterpret_cast<unsigned int*>(f+112+24)=0x1f80;
+}
+
+void initCtxsave(unsigned int *ctxsave, void *(*pc)(void *), unsigned int *sp,
+        void *argv)
+{
+    //At function entry the i386 ABI requires esp+4 to be 16 byte aligned
+    unsigned int top=reinterpret_cast<unsigned int>(sp) & ~15u;
+    unsigned int *stackPtr=reinterpret_cast<unsigned int*>(top-20);
+    stackPtr[0]=0;                                               //--> ret addr
+    stackPtr[1]=reinterpret_cast<unsigned int>(pc);              //--> arg 1
+    stackPtr[2]=reinterpret_cast<unsigned int>(argv);            //--> arg 2
+
+    ctxsave[0]=reinterpret_cast<unsigned int>(stackPtr);         //--> esp
+    for(int i=1;i<8;i++) ctxsave[i]=0;                           //--> ebp...edx
+    ctxsave[8]=reinterpret_cast<unsigned int>(
+            &miosix::Thread::threadLauncher);                    //--> eip
+    ctxsave[9]=0x202;                                            //--> eflags
+    ctxsave[10]=0;                            //--> interrupts enabled
+    initFpuState(reinterpret_cast<unsigned char*>(ctxsave+fpuOffsetInCtxsave));
+}
+
+void IRQportableStartKernel()
+{
+    //create a temporary space to save current registers. This data is useless
+    //since there's no way to stop the sheduler, but we need to save it anyway.
+    unsigned int s_ctxsave[miosix::CTXSAVE_SIZE];
+    ctxsave=s_ctxsave;//make global ctxsave point to it
+    //Note, we can't use enableInterrupts() now since the call is not mathced
+    //by a call to disableInterrupts()
+    host::sigprocmask(host::SIG_UNBLOCK_,&irqSignals,nullptr);
+    miosix::Thread::yield();
+    //Never reaches here
+}
+
+void sleepCpu()
+{
+    //Returns after a signal handler has run, as the wfi instruction. The
+    //interrupt signals are unblocked atomically with the wait, so one that
+    //arrives after the caller decided to sleep is not lost even if it is
+    //called with interrupts disabled. sigsuspend restores the caller's mask
+    host::SigSet mask;
+    host::sigprocmask(host::SIG_BLOCK_,nullptr,&mask);
+    mask&=~irqSignals;
+    host::sigsuspend(&mask);
+}
+
+} //namespace miosix_private
+
+/**
+ * \internal
+ * SIGUSR1 handler, the simulator equivalent of the software interrupt.
+ * doYield() sends SIGUSR1 to the simulator itself.
+ */
+void SVC_Handler(int, void *, void *uc)
+{
+    saveContext(uc);
+    miosix_private::ISR_yield();
+    restoreContext(uc);
+}
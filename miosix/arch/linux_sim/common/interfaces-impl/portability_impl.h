@@ -0,0 +1,191 @@
+/***************************************************************************
+ *   Copyright (C) 2024 by Terraneo Federico                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+//Miosix kernel
+
+#ifndef PORTABILITY_IMPL_H
+#define PORTABILITY_IMPL_H
+
+#include "interfaces/arch_registers.h"
+#include "interfaces/portability.h"
+#include "config/miosix_settings.h"
+
+#ifdef WITH_PROCESSES
+#error "Processes are not supported by the linux_sim architecture"
+#endif //WITH_PROCESSES
+
+/**
+ * \addtogroup Drivers
+ * \{
+ */
+
+/*
+ * This pointer is used by the kernel, and should not be used by end users.
+ * this is a pointer to a location where to store the thread's registers during
+ * context switch. It requires C linkage to be used inside asm statement.
+ * Registers are saved in the following order:
+ * *ctxsave+44  --> x87 and SSE state (host::fpstateSize bytes)
+ * *ctxsave+40  --> interrupt signals blocked in the thread signal mask
+ * *ctxsave+36  --> eflags
+ * *ctxsave+32  --> eip
+ * *ctxsave+28  --> edx
+ * *ctxsave+24  --> ecx
+ * *ctxsave+20  --> eax
+ * *ctxsave+16  --> edi
+ * *ctxsave+12  --> esi
+ * *ctxsave+8   --> ebx
+ * *ctxsave+4   --> ebp
+ * *ctxsave+0   --> esp
+ */
+extern "C" {
+extern volatile unsigned int *ctxsave;
+}
+const int stackPtrOffsetInCtxsave=0; ///< Allows to locate the stack pointer
+const int fpuOffsetInCtxsave=11;     ///< Allows to locate the FPU state
+
+namespace miosix_private {
+
+/// \internal Signals used as interrupts. They are blocked to disable
+/// interrupts, and while any of their handlers runs
+const host::SigSet irqSignals=host::sigBit(host::SIGUSR1_)
+                             | host::sigBit(host::SIGALRM_)
+                             | host::sigBit(host::SIGIO_);
+
+} //namespace miosix_private
+
+/**
+ * \internal
+ * Save context from an interrupt<br>
+ * In the simulator interrupts are signal handlers, and the registers of the
+ * interrupted thread are in the signal frame. Must be the first line of a
+ * signal handler where a context switch can happen.
+ * \param uc the third argument of the signal handler
+ */
+inline void saveContext(void *uc)
+{
+    host::UContext *u=reinterpret_cast<host::UContext*>(uc);
+    host::SigContext& r=u->mcontext;
+    volatile unsigned int *c=ctxsave;
+    c[0]=r.esp;
+    c[1]=r.ebp;
+    c[2]=r.ebx;
+    c[3]=r.esi;
+    c[4]=r.edi;
+    c[5]=r.eax;
+    c[6]=r.ecx;
+    c[7]=r.edx;
+    c[8]=r.eip;
+    c[9]=r.eflags;
+    //The signal mask is restored by rt_sigreturn too. It is part of the
+    //context as a thread may be interrupted with interrupts disabled, while
+    //it waits in sleepCpu()
+    c[10]=static_cast<unsigned int>(u->sigmask & miosix_private::irqSignals);
+    if(r.fpstate) __builtin_memcpy(const_cast<unsigned int*>(c+fpuOffsetInCtxsave),
+                                   r.fpstate,host::fpstateSize);
+}
+
+/**
+ * \internal
+ * Restore context in a signal handler where saveContext() is used. Must be the
+ * last line of the signal handler. The registers are written back in the
+ * signal frame, and rt_sigreturn loads them when the handler returns.
+ * \param uc the third argument of the signal handler
+ */
+inline void restoreContext(void *uc)
+{
+    host::UContext *u=reinterpret_cast<host::UContext*>(uc);
+    host::SigContext& r=u->mcontext;
+    volatile unsigned int *c=ctxsave;
+    r.esp=c[0];
+    r.ebp=c[1];
+    r.ebx=c[2];
+    r.esi=c[3];
+    r.edi=c[4];
+    r.eax=c[5];
+    r.ecx=c[6];
+    r.edx=c[7];
+    r.eip=c[8];
+    r.eflags=c[9];
+    u->sigmask=(u->sigmask & ~miosix_private::irqSignals) | c[10];
+    if(r.fpstate)
+    {
+        __builtin_memcpy(r.fpstate,const_cast<unsigned int*>(c+fpuOffsetInCtxsave),
+                         host::fpstateSize);
+        //The xsave extension that follows the fxsave image in the frame
+        //belongs to the interrupted thread, clearing the magic number makes
+        //Linux restore only the x87 and SSE state we copied
+        __builtin_memset(r.fpstate+host::fpstateMagicOffset,0,4);
+    }
+}
+
+/**
+ * \}
+ */
+
+namespace miosix_private {
+    
+/**
+ * \addtogroup Drivers
+ * \{
+ */
+
+/// \internal Process id of the simulator, to send signals to itself
+extern int hostPid;
+
+inline void doYield()
+{
+    //Like the svc instruction, the signal is delivered before kill() returns
+    host::kill(hostPid,host::SIGUSR1_);
+}
+
+inline void doDisableInterrupts()
+{
+    host::sigprocmask(host::SIG_BLOCK_,&irqSignals,nullptr);
+    //The new fastDisableInterrupts/fastEnableInterrupts are inline, so there's
+    //the need for a memory barrier to avoid aggressive reordering
+    asm volatile("":::"memory");
+}
+
+inline void doEnableInterrupts()
+{
+    asm volatile("":::"memory");
+    host::sigprocmask(host::SIG_UNBLOCK_,&irqSignals,nullptr);
+}
+
+inline bool checkAreInterruptsEnabled()
+{
+    host::SigSet mask;
+    host::sigprocmask(host::SIG_BLOCK_,nullptr,&mask);
+    return (mask & irqSignals)==0;
+}
+
+/**
+ * \}
+ */
+
+} //namespace miosix_private
+
+#endif //PORTABILITY_IMPL_H
@@ -0,0 +1,191 @@
+/***************************************************************************
+ *   Copyright (C) 2024 by Terraneo Federico                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+/*
+ * Boot code for the Linux simulator.
+ * The simulator is a static i386 Linux executable that does not use the host
+ * C library. The host kernel loads .text and .data and zeroes .bss, so what
+ * is left to do is the simulator equivalent of setting up the vector table:
+ * install the signal handlers that play the role of interrupts.
+ */
+
+#include "interfaces/arch_registers.h"
+#include "interfaces/portability.h"
+#include "interfaces/bsp.h"
+#include "core/interrupts.h" //For the unexpected interrupt call
+#include "kernel/stage_2_boot.h"
+#include "board_settings.h"
+
+extern "C" void _start() __attribute__((naked, noreturn));
+extern "C" void programStartup(unsigned int *sp) __attribute__((noreturn));
+extern "C" void signalReturn() __attribute__((naked));
+
+/**
+ * ELF entry point. The host kernel starts us with argc, argv and environment
+ * on the stack, which is not aligned as the ABI requires for a function call
+ */
+void _start()
+{
+    asm volatile(
+        "xorl %ebp, %ebp        \n" //Outermost stack frame
+        "movl %esp, %eax        \n" //Pointer to argc
+        "andl $-16, %esp        \n"
+        "subl $12, %esp         \n"
+        "pushl %eax             \n"
+        "call programStartup    \n");
+}
+
+/**
+ * Signal handlers return here, as with SA_RESTORER the restorer is ours
+ */
+void signalReturn()
+{
+    asm volatile(
+        "movl $173, %eax        \n" //SYS_rt_sigreturn
+        "int $0x80              \n");
+}
+
+/// Stack used by signal handlers, like the main stack used by interrupts
+/// on the Cortex-M
+static unsigned char irqStack[miosix::IRQ_STACK_SIZE]
+    __attribute__((aligned(16)));
+
+/**
+ * \internal
+ * Parse the simulator command line
+ * \param argc number of arguments
+ * \param argv arguments
+ */
+static void parseCommandLine(int argc, char *argv[])
+{
+    for(int i=1;i<argc;i++)
+    {
+        const char *arg=argv[i];
+        if(arg[0]=='-' && (arg[1]=='d' || arg[1]=='r') && arg[2]=='\0'
+            && i+1<argc)
+        {
+            if(arg[1]=='d') miosix::simDiskImage=argv[++i];
+            else miosix::simRomFsImage=argv[++i];
+        } else {
+            static const char usage[]="Usage: main.elf [-d disk.img]"
+                " [-r romfs.bin]\n";
+            host::write(2,usage,sizeof(usage)-1);
+            host::exitGroup(2);
+        }
+    }
+}
+
+/**
+ * For signals the simulator does not expect
+ */
+extern "C" void Default_Handler(int, void *, void *)
+{
+    unexpectedInterrupt();
+}
+
+//Signal handlers
+void SVC_Handler(int, void *, void *);   //These handlers are not weak
+void TIMER_Handler(int, void *, void *); //because they are surely defined
+void SEGV_Handler(int, void *, void *);  //by Miosix
+void BUS_Handler(int, void *, void *);
+void ILL_Handler(int, void *, void *);
+void FPE_Handler(int, void *, void *);
+void __attribute__((weak)) SIGIO_Handler(int, void *, void *);
+
+#pragma weak SIGIO_Handler = Default_Handler
+
+/// Signal handlers, the simulator equivalent of the interrupt vector table
+static const struct
+{
+    int signal;
+    void (*handler)(int, void *, void *);
+} vectors[]=
+{
+    {host::SIGUSR1_, SVC_Handler},
+    {host::SIGALRM_, TIMER_Handler},
+    {host::SIGIO_,   SIGIO_Handler},
+    {host::SIGSEGV_, SEGV_Handler},
+    {host::SIGBUS_,  BUS_Handler},
+    {host::SIGILL_,  ILL_Handler},
+    {host::SIGFPE_,  FPE_Handler},
+    {host::SIGTRAP_, Default_Handler}
+};
+
+#ifndef __NO_EXCEPTIONS
+/// Defined in libgcc, registers the unwind tables used by C++ exceptions.
+/// On ARM exceptions use the .ARM.exidx section that libgcc finds by itself
+extern "C" void __register_frame_info(const void *begin, void *object);
+/// Storage libgcc needs for each registered table (struct object)
+static void *ehObject[8];
+#endif //__NO_EXCEPTIONS
+
+/**
+ * Called by _start, performs initialization and calls main.
+ * Never returns.
+ * \param sp initial host stack pointer, pointing to argc
+ */
+void programStartup(unsigned int *sp)
+{
+    //Interrupts are disabled at boot, until the kernel is started
+    const host::SigSet all=~0ull;
+    host::sigprocmask(host::SIG_SETMASK_,&all,nullptr);
+    miosix_private::hostPid=host::getpid();
+
+    parseCommandLine(sp[0],reinterpret_cast<char**>(sp+1));
+
+    host::SigStack ss={irqStack,0,sizeof(irqStack)};
+    host::sigaltstack(&ss);
+    for(auto& v : vectors)
+    {
+        //Like on a microcontroller with a single interrupt priority, handlers
+        //can't interrupt each other. Interrupted system calls are restarted
+        //when the thread that called them runs again
+        host::SigAction sa;
+        sa.handler=v.handler;
+        sa.flags=host::SA_SIGINFO_ | host::SA_ONSTACK_ | host::SA_RESTORER_
+                | host::SA_RESTART_;
+        sa.restorer=signalReturn;
+        sa.mask=miosix_private::irqSignals;
+        host::sigaction(v.signal,&sa);
+    }
+    //Faults must not stay blocked, or the host would kill us without letting
+    //the handlers print where the fault occurred
+    host::SigSet faults=~miosix_private::irqSignals;
+    host::sigprocmask(host::SIG_UNBLOCK_,&faults,nullptr);
+
+    #ifndef __NO_EXCEPTIONS
+    extern char __eh_frame_start asm("__eh_frame_start");
+    __register_frame_info(&__eh_frame_start,ehObject);
+    #endif //__NO_EXCEPTIONS
+
+    //Move on to stage 2
+    _init();
+
+    //If main returns, reboot
+    miosix_private::IRQsystemReboot();
+    for(;;) ;
+}
@@ -0,0 +1,132 @@
+/***************************************************************************
+ *   Copyright (C) 2024 by Terraneo Federico                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+/***********************************************************************
+* bsp.cpp Part of the Miosix Embedded OS.
+* Board support package, this file initializes hardware.
+************************************************************************/
+
+#include <cstdlib>
+#include <sys/ioctl.h>
+#include "interfaces/bsp.h"
+#include "kernel/kernel.h"
+#include "kernel/sync.h"
+#include "interfaces/portability.h"
+#include "interfaces/arch_registers.h"
+#include "config/miosix_settings.h"
+#include "kernel/logging.h"
+#include "filesystem/file_access.h"
+#include "filesystem/console/console_device.h"
+#include "filesystem/romfs/romfs.h"
+#include "drivers/host_console.h"
+#include "drivers/host_block_device.h"
+#include "board_settings.h"
+
+namespace miosix {
+
+const char *simDiskImage=simDefaultDiskImage;
+const char *simRomFsImage=simDefaultRomFsImage;
+
+//
+// Initialization
+//
+
+void IRQbspInit()
+{
+    led::mode(Mode::OUTPUT);
+    DefaultConsole::instance().IRQset(intrusive_ref_ptr<Device>(
+        new HostConsole));
+}
+
+void bspInit2()
+{
+    #ifdef WITH_FILESYSTEM
+    //If the disk image does not exist the simulator runs without /sd
+    basicFilesystemSetup(HostBlockDevice::open(simDiskImage));
+    #endif //WITH_FILESYSTEM
+}
+
+#ifdef WITH_ROMFS
+/**
+ * The simulator can't append the RomFs image to the kernel as there is no
+ * flash, so the image is a host file mapped in memory
+ */
+const void *getRomFsAddressAfterKernel()
+{
+    int fd=host::open(simRomFsImage,host::O_RDONLY_);
+    if(fd<0)
+    {
+        errorLog("Error opening RomFs image %s\n",simRomFsImage);
+        return nullptr;
+    }
+    long long size=host::fileSize(fd);
+    void *result=nullptr;
+    if(size>0)
+    {
+        //The host mmap returns page aligned memory, which satisfies
+        //romFsImageAlignment. Failures are returned as a negative errno
+        result=host::mmap(size,host::PROT_READ_,host::MAP_PRIVATE_,fd);
+        if(reinterpret_cast<unsigned int>(result)>=-4095u) result=nullptr;
+    }
+    host::close(fd); //The mapping stays valid after closing the file
+    if(result==nullptr) errorLog("Error mapping RomFs image %s\n",simRomFsImage);
+    return result;
+}
+#endif //WITH_ROMFS
+
+//
+// Shutdown and reboot
+//
+
+/**
+This function disables filesystem (if enabled) and ends the simulator with
+a successful exit status.<br>
+This function does not return.<br>
+WARNING: close all files before using this function, since it unmounts the
+filesystem.<br>
+*/
+void shutdown()
+{
+    ioctl(STDOUT_FILENO,IOCTL_SYNC,0);
+
+    #ifdef WITH_FILESYSTEM
+    FilesystemManager::instance().umountAll();
+    #endif //WITH_FILESYSTEM
+
+    disableInterrupts();
+    host::exitGroup(0);
+}
+
+/**
+The simulator can't reboot, so this is the same as shutdown()
+*/
+void reboot()
+{
+    shutdown();
+}
+
+} //namespace miosix
@@ -45,6 +45,7 @@
  */
 #include "arch_settings.h"
 #include "board_settings.h"
+#include "libsyscalls/include/miosix_limits.h"
 
 /**
  * \internal
@@ -75,12 +76,69 @@ namespace miosix {
 //#define SCHED_TYPE_CONTROL_BASED
 //#define SCHED_TYPE_EDF
 
+/// \def SLEEP_QUEUE_TYPE_LIST
+/// If uncommented sleeping threads are kept in a sorted list. Adding a thread
+/// is O(n) in the number of sleeping threads, waking it is O(1). Best choice
+/// when only a few threads sleep at the same time
+/// \def SLEEP_QUEUE_TYPE_HEAP
+/// If uncommented sleeping threads are kept in a pairing heap. Adding a thread
+/// is O(1), waking it is O(log(n)) amortized. Best choice when hundreds of
+/// threads sleep at the same time
+//Uncomment only *one* of those
+
+#define SLEEP_QUEUE_TYPE_LIST
+//#define SLEEP_QUEUE_TYPE_HEAP
+
+/// \def WITH_TIMER_SLACK
+/// Allows to enable/disable per-thread timer slack. A thread with a nonzero
+/// slack accepts to be woken up to that many nanoseconds after the requested
+/// time, allowing the kernel to serve wakeups falling within the slack window
+/// of each other with a single timer interrupt. See Thread::setTimerSlack().
+/// By default it is not defined (timer slack is disabled).
+//#define WITH_TIMER_SLACK
+
+/// Timer slack in nanoseconds that threads have when they are created.
+/// Only used if WITH_TIMER_SLACK is defined
+constexpr unsigned int DEFAULT_TIMER_SLACK=0;
+
+/// \def WITH_TIMERS
+/// Allows to enable/disable miosix::Timer, software timers that share the
+/// sleep queue with sleeping threads and run their callback either from the
+/// OS timer interrupt or from a timer service thread. With many timers,
+/// consider selecting SLEEP_QUEUE_TYPE_HEAP. By default it is not defined
+/// (timers are disabled).
+//#define WITH_TIMERS
+
+/// Stack size of the timer service thread, which is created the first time a
+/// Timer running its callback in thread context is constructed. Only used if
+/// WITH_TIMERS is defined (MUST be divisible by 4)
+constexpr unsigned int TIMER_SERVICE_STACK_SIZE=1024;
+
+/// Priority of the timer service thread. Only used if WITH_TIMERS is defined
+constexpr unsigned char TIMER_SERVICE_PRIORITY=1;
+
 /// \def WITH_CPU_TIME_COUNTER
 /// Allows to enable/disable CPUTimeCounter to save code size and remove its
 /// overhead from the scheduling process. By default it is not defined
 /// (CPUTimeCounter is disabled).
 //#define WITH_CPU_TIME_COUNTER
 
+/// \def WITH_LATENCY_STATS
+/// Allows to enable/disable LatencyStats, histograms of the kernel interrupt
+/// entry, wakeup-to-run and context switch latencies, readable from
+/// /dev/kstat. By default it is not defined (LatencyStats is disabled).
+//#define WITH_LATENCY_STATS
+
+/// \def WITH_KERNEL_TRACE
+/// Allows to enable/disable KernelTrace, a binary trace of context switches,
+/// wakeups, mutex contention, syscalls and interrupts. By default it is not
+/// defined (KernelTrace is disabled).
+//#define WITH_KERNEL_TRACE
+
+/// Number of events in the KernelTrace ring buffer, must be a power of two.
+/// Each event takes 20 bytes of RAM
+constexpr unsigned int KERNEL_TRACE_EVENTS=256;
+
 //
 // Filesystem options
 //
@@ -112,6 +170,24 @@ constexpr unsigned char FATFS_MAX_OPEN_FILES=8;
 /// occurs.
 constexpr unsigned int FATFS_EXTEND_BUFFER=512;
 
+/// Number of lines of the block cache that FATFS and LittleFS use to access
+/// the underlying block device. Each mounted partition has its own cache of
+/// FS_BLOCK_CACHE_LINES*FS_BLOCK_CACHE_LINE_BLOCKS*512 bytes. Written blocks
+/// are only written to the device on sync or when evicted from the cache, so
+/// enabling the cache trades RAM and durability for speed.
+/// By default it is 0 (the cache is disabled)
+constexpr unsigned int FS_BLOCK_CACHE_LINES=0;
+/// Number of consecutive 512 byte blocks in a cache line, between 1 and 32.
+/// A read miss loads the whole line, so this is also the read ahead size
+constexpr unsigned int FS_BLOCK_CACHE_LINE_BLOCKS=2;
+
+/// Maximum memory in bytes used by the cache of path resolutions, which allows
+/// open(), stat() and other calls to skip walking the mountpoints and looking
+/// up symlinks when the same paths are used over and over. Each cached path
+/// takes roughly 70 bytes plus twice the path length. Set to 0 to disable
+/// the cache
+constexpr unsigned int FS_PATH_CACHE_SIZE=1024;
+
 /// \def WITH_LITTLEFS
 /// Allows to enable/disable LittleFS support to save code size
 /// By default it is not defined (LittleFS is disabled)
@@ -185,6 +261,14 @@ const unsigned char MAX_OPEN_FILES=8;
 // #error Deep sleep cannot work together with jtag
 #endif //defined(WITH_PROCESSES) && !defined(WITH_DEVFS)
 
+/// \def WITH_TLSF_HEAP
+/// If uncommented replaces newlib's malloc with a TLSF allocator, whose
+/// operations take constant time, so that threads allocating memory pause the
+/// kernel for a bounded time. It also allows to add heaps in other memories
+/// with TlsfHeap::addHeap() and reports per heap statistics through
+/// MemoryProfiling. By default it is not defined (newlib's malloc is used)
+//#define WITH_TLSF_HEAP
+
 /// Minimum stack size (MUST be divisible by 4)
 const unsigned int STACK_MIN=256;
 
@@ -211,6 +295,13 @@ const unsigned int MIN_PROCESS_STACK_SIZE=1024;
 /// thread is running in kernelspace (MUST be divisible by 4)
 const unsigned int SYSTEM_MODE_PROCESS_STACK_SIZE=2048;
 
+/// Maximum number of threads in a process, including the main thread. Every
+/// thread other than the main one also has a kernelspace stack of
+/// SYSTEM_MODE_PROCESS_STACK_SIZE bytes allocated from the kernel heap.
+/// The value is shared with libsyscalls, change it in
+/// libsyscalls/include/miosix_limits.h
+const unsigned int MAX_THREADS_PER_PROCESS=MIOSIX_MAX_THREADS_PER_PROCESS;
+
 /// Maximum number of arguments passed through argv to a process
 /// Also maximum number of environment variables passed through envp to a process
 const unsigned int MAX_PROCESS_ARGS=16;
@@ -230,7 +321,7 @@ static_assert(SYSTEM_MODE_PROCESS_STACK_SIZE>=STACK_MIN,"");
 /// the priority of the idle thread.
 /// The meaning of a thread's priority depends on the chosen scheduler.
 #ifdef SCHED_TYPE_PRIORITY
-//Can be modified, but a high value makes context switches more expensive
+//Can be modified, up to a maximum of 32
 const short int PRIORITY_MAX=4;
 #elif defined(SCHED_TYPE_CONTROL_BASED)
 //Don't touch, the limit is due to the fixed point implementation
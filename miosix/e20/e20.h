@@ -435,4 +435,57 @@ private:
     Callback<SlotSize> events[NumSlots]; ///< Fixed size queue of events
 };
 
+#ifdef WITH_TIMERS
+
+/**
+ * A Timer that posts an event to a FixedEventQueue when it expires, so that
+ * the event is run by the thread that calls run() or runOne() on the queue.
+ * Like Timer it can be one shot or periodic, and never allocates memory.
+ * The event is posted from the OS timer interrupt, see FixedEventQueue::IRQpost()
+ * for the restrictions this poses on the bound parameters.
+ *
+ * \code
+ * FixedEventQueue<4> queue;
+ * EventTimer<4> timer(queue,bind(sample,&sensor));
+ * timer.start(0,10000000); //Sample every 10ms
+ * queue.run();
+ * \endcode
+ */
+template<unsigned NumSlots, unsigned SlotSize=20>
+class EventTimer : public Timer
+{
+public:
+    /**
+     * Constructor, the timer is initially stopped
+     * \param queue queue where the event is posted
+     * \param event event posted every time the timer expires
+     */
+    EventTimer(FixedEventQueue<NumSlots,SlotSize>& queue,
+               Callback<SlotSize> event)
+        : Timer(post,this,TimerContext::Interrupt), queue(queue), event(event) {}
+
+    /**
+     * \return the number of events that were not posted because the queue
+     * was full
+     */
+    unsigned int getLostEvents() const { return lost; }
+
+private:
+    /**
+     * Timer callback, posts the event
+     * \param arg pointer to the EventTimer
+     */
+    static void post(void *arg)
+    {
+        auto *t=static_cast<EventTimer*>(arg);
+        if(t->queue.IRQpost(t->event)==false) t->lost++;
+    }
+
+    FixedEventQueue<NumSlots,SlotSize>& queue; ///< Where events are posted
+    Callback<SlotSize> event;                  ///< Event to post
+    unsigned int lost=0;                       ///< Events lost, queue full
+};
+
+#endif //WITH_TIMERS
+
 } //namespace miosix
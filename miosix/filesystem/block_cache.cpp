@@ -0,0 +1,251 @@
+/***************************************************************************
+ *   Copyright (C) 2024 by Terraneo Federico                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+#include "block_cache.h"
+#include <cstring>
+#include <algorithm>
+#include <errno.h>
+#include "filesystem/ioctl.h"
+
+using namespace std;
+
+namespace miosix {
+
+#ifdef WITH_FILESYSTEM
+
+static_assert(FS_BLOCK_CACHE_LINE_BLOCKS>=1 && FS_BLOCK_CACHE_LINE_BLOCKS<=32,
+              "FS_BLOCK_CACHE_LINE_BLOCKS must be between 1 and 32");
+
+//
+// class BlockCache
+//
+
+BlockCache::BlockCache(intrusive_ref_ptr<FileBase> disk, unsigned int numLines,
+                       unsigned int lineBlocks) : disk(disk), lines(nullptr),
+        data(nullptr), numLines(numLines), lineBlocks(min(max(lineBlocks,1u),32u))
+{
+    if(numLines==0) return;
+    lines=new Line[numLines];
+    data=new unsigned char[numLines*this->lineBlocks*blockSize];
+    for(unsigned int i=0;i<numLines;i++)
+        lines[i].data=data+i*this->lineBlocks*blockSize;
+}
+
+int BlockCache::read(void *buffer, unsigned int block, unsigned int count)
+{
+    unsigned char *buf=reinterpret_cast<unsigned char*>(buffer);
+    if(numLines==0 || count>lineBlocks)
+    {
+        if(int res=deviceRead(buf,block,count)) return res;
+        stats.bypassed+=count;
+        //Dirty blocks in the cache are more recent than the device content
+        for(unsigned int i=0;i<numLines;i++)
+        {
+            Line& l=lines[i];
+            for(unsigned int j=0;j<lineBlocks;j++)
+            {
+                unsigned int b=l.first+j;
+                if((l.dirty & (1u<<j))==0 || b<block || b>=block+count) continue;
+                memcpy(buf+(b-block)*blockSize,l.data+j*blockSize,blockSize);
+            }
+        }
+        return 0;
+    }
+    for(;count>0;count--,block++,buf+=blockSize)
+    {
+        Line *line=lookup(block);
+        if(line==nullptr)
+            if(int res=allocate(block,line)) return res;
+        unsigned int i=block-line->first;
+        if(line->valid & (1u<<i)) stats.hits++;
+        else {
+            stats.misses++;
+            if(int res=fill(line,i)) return res;
+        }
+        memcpy(buf,line->data+i*blockSize,blockSize);
+    }
+    return 0;
+}
+
+int BlockCache::write(const void *buffer, unsigned int block, unsigned int count)
+{
+    const unsigned char *buf=reinterpret_cast<const unsigned char*>(buffer);
+    if(numLines==0 || count>lineBlocks)
+    {
+        if(int res=deviceWrite(buf,block,count)) return res;
+        stats.bypassed+=count;
+        //Cached copies of the written blocks need to be updated, and are
+        //now clean
+        for(unsigned int i=0;i<numLines;i++)
+        {
+            Line& l=lines[i];
+            for(unsigned int j=0;j<lineBlocks;j++)
+            {
+                unsigned int b=l.first+j;
+                if((l.valid & (1u<<j))==0 || b<block || b>=block+count) continue;
+                memcpy(l.data+j*blockSize,buf+(b-block)*blockSize,blockSize);
+                l.dirty&=~(1u<<j);
+            }
+        }
+        return 0;
+    }
+    for(;count>0;count--,block++,buf+=blockSize)
+    {
+        Line *line=lookup(block);
+        if(line) stats.hits++;
+        else {
+            stats.misses++;
+            if(int res=allocate(block,line)) return res;
+        }
+        unsigned int i=block-line->first;
+        memcpy(line->data+i*blockSize,buf,blockSize);
+        line->valid|=1u<<i;
+        line->dirty|=1u<<i;
+    }
+    return 0;
+}
+
+int BlockCache::sync()
+{
+    int result=0;
+    for(unsigned int i=0;i<numLines;i++)
+        if(int res=writeBack(&lines[i])) result=res;
+    if(disk->ioctl(IOCTL_SYNC,0)!=0) result=-EIO;
+    return result;
+}
+
+void BlockCache::discard(unsigned int block, unsigned int count)
+{
+    for(unsigned int i=0;i<numLines;i++)
+    {
+        Line& l=lines[i];
+        for(unsigned int j=0;j<lineBlocks;j++)
+        {
+            unsigned int b=l.first+j;
+            if(b<block || b>=block+count) continue;
+            l.valid&=~(1u<<j);
+            l.dirty&=~(1u<<j);
+        }
+    }
+}
+
+BlockCache::~BlockCache()
+{
+    for(unsigned int i=0;i<numLines;i++) writeBack(&lines[i]);
+    delete[] lines;
+    delete[] data;
+}
+
+BlockCache::Line *BlockCache::lookup(unsigned int block)
+{
+    unsigned int first=block-block%lineBlocks;
+    for(unsigned int i=0;i<numLines;i++)
+    {
+        if(lines[i].lastUse==0 || lines[i].first!=first) continue;
+        if(++useCounter==0) useCounter=1; //0 is reserved for unused lines
+        lines[i].lastUse=useCounter;
+        return &lines[i];
+    }
+    return nullptr;
+}
+
+int BlockCache::allocate(unsigned int block, Line *& result)
+{
+    Line *victim=&lines[0];
+    for(unsigned int i=1;i<numLines;i++)
+        if(lines[i].lastUse<victim->lastUse) victim=&lines[i];
+    if(int res=writeBack(victim)) return res;
+    victim->first=block-block%lineBlocks;
+    victim->valid=0;
+    if(++useCounter==0) useCounter=1; //0 is reserved for unused lines
+    victim->lastUse=useCounter;
+    result=victim;
+    return 0;
+}
+
+int BlockCache::fill(Line *line, unsigned int needed)
+{
+    //Read each run of consecutive invalid blocks with a single device access
+    for(unsigned int i=0;i<lineBlocks;)
+    {
+        if(line->valid & (1u<<i)) { i++; continue; }
+        unsigned int j=i+1;
+        while(j<lineBlocks && (line->valid & (1u<<j))==0) j++;
+        unsigned int mask=(j-i==32) ? ~0u : ((1u<<(j-i))-1)<<i;
+        if(deviceRead(line->data+i*blockSize,line->first+i,j-i)==0)
+            line->valid|=mask;
+        i=j;
+    }
+    if(line->valid & (1u<<needed)) return 0;
+    //The read ahead may fail if the line crosses the end of the device, so
+    //retry reading only the needed block
+    if(int res=deviceRead(line->data+needed*blockSize,line->first+needed,1))
+        return res;
+    line->valid|=1u<<needed;
+    return 0;
+}
+
+int BlockCache::writeBack(Line *line)
+{
+    //Write each run of consecutive dirty blocks with a single device access
+    for(unsigned int i=0;i<lineBlocks;)
+    {
+        if((line->dirty & (1u<<i))==0) { i++; continue; }
+        unsigned int j=i+1;
+        while(j<lineBlocks && (line->dirty & (1u<<j))) j++;
+        if(int res=deviceWrite(line->data+i*blockSize,line->first+i,j-i))
+            return res;
+        unsigned int mask=(j-i==32) ? ~0u : ((1u<<(j-i))-1)<<i;
+        line->dirty&=~mask;
+        stats.writebacks+=j-i;
+        i=j;
+    }
+    return 0;
+}
+
+int BlockCache::deviceRead(void *buffer, unsigned int block, unsigned int count)
+{
+    stats.deviceReads++;
+    ssize_t size=static_cast<ssize_t>(count)*blockSize;
+    if(disk->pread(buffer,size,static_cast<off_t>(block)*blockSize)!=size)
+        return -EIO;
+    return 0;
+}
+
+int BlockCache::deviceWrite(const void *buffer, unsigned int block,
+                            unsigned int count)
+{
+    stats.deviceWrites++;
+    ssize_t size=static_cast<ssize_t>(count)*blockSize;
+    if(disk->pwrite(buffer,size,static_cast<off_t>(block)*blockSize)!=size)
+        return -EIO;
+    return 0;
+}
+
+#endif //WITH_FILESYSTEM
+
+} //namespace miosix
@@ -0,0 +1,201 @@
+/***************************************************************************
+ *   Copyright (C) 2024 by Terraneo Federico                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+#pragma once
+
+#include "filesystem/file.h"
+#include "config/miosix_settings.h"
+
+namespace miosix {
+
+#ifdef WITH_FILESYSTEM
+
+/**
+ * Statistics of a BlockCache
+ */
+struct BlockCacheStats
+{
+    unsigned int hits=0;         ///< Blocks found in the cache
+    unsigned int misses=0;       ///< Blocks not found in the cache
+    unsigned int bypassed=0;     ///< Blocks of large transfers, not cached
+    unsigned int writebacks=0;   ///< Dirty blocks written back to the device
+    unsigned int deviceReads=0;  ///< Read operations performed on the device
+    unsigned int deviceWrites=0; ///< Write operations performed on the device
+};
+
+/**
+ * A write-back cache of the 512 byte blocks of a block device, used by
+ * filesystems such as Fat32Fs and LittleFS to avoid accessing the device
+ * every time the same sectors are read or written.
+ *
+ * The cache is made of lines, each holding a fixed number of consecutive
+ * blocks, replaced with a least recently used policy. A read miss loads the
+ * whole line with a single device access, thus reading ahead the blocks that
+ * follow. Written blocks are marked dirty and only written to the device when
+ * the line is evicted or when sync() is called. Transfers larger than a line
+ * bypass the cache, to avoid evicting its whole content.
+ *
+ * This class is not thread safe, concurrent accesses must be serialized by the
+ * caller, as filesystems already do.
+ */
+class BlockCache
+{
+public:
+    /**
+     * Constructor
+     * \param disk block device to cache
+     * \param numLines number of cache lines, 0 disables caching
+     * \param lineBlocks number of blocks per cache line, up to 32
+     */
+    BlockCache(intrusive_ref_ptr<FileBase> disk,
+               unsigned int numLines=FS_BLOCK_CACHE_LINES,
+               unsigned int lineBlocks=FS_BLOCK_CACHE_LINE_BLOCKS);
+
+    /**
+     * Read blocks
+     * \param buffer buffer where read data will be stored
+     * \param block first block to read
+     * \param count number of blocks to read
+     * \return 0 on success, or a negative number on failure
+     */
+    int read(void *buffer, unsigned int block, unsigned int count);
+
+    /**
+     * Write blocks. Data is written to the device when the blocks are
+     * evicted from the cache or when sync() is called
+     * \param buffer data to write
+     * \param block first block to write
+     * \param count number of blocks to write
+     * \return 0 on success, or a negative number on failure
+     */
+    int write(const void *buffer, unsigned int block, unsigned int count);
+
+    /**
+     * Write all dirty blocks to the device, then sync the device
+     * \return 0 on success, or a negative number on failure
+     */
+    int sync();
+
+    /**
+     * Drop blocks from the cache without writing them back, to be called
+     * when the device content changes behind the cache, such as when a
+     * flash memory is erased
+     * \param block first block to drop
+     * \param count number of blocks to drop
+     */
+    void discard(unsigned int block, unsigned int count);
+
+    /**
+     * \return the cached device
+     */
+    FileBase *getDevice() const { return disk.get(); }
+
+    /**
+     * \return the cache statistics
+     */
+    const BlockCacheStats& getStats() const { return stats; }
+
+    /**
+     * Reset the cache statistics
+     */
+    void resetStats() { stats=BlockCacheStats(); }
+
+    /**
+     * Destructor, writes dirty blocks back to the device
+     */
+    ~BlockCache();
+
+    BlockCache(const BlockCache&)=delete;
+    BlockCache& operator=(const BlockCache&)=delete;
+
+    static const unsigned int blockSize=512; ///< Size of a block in bytes
+
+private:
+    /**
+     * A cache line
+     */
+    struct Line
+    {
+        unsigned char *data;    ///< Line data, lineBlocks*blockSize bytes
+        unsigned int first=0;   ///< First block in the line
+        unsigned int valid=0;   ///< Bitmask of blocks holding valid data
+        unsigned int dirty=0;   ///< Bitmask of blocks to be written back
+        unsigned int lastUse=0; ///< For LRU replacement, 0 if line unused
+    };
+
+    /**
+     * \param block a block
+     * \return the line caching block, or nullptr if not in the cache
+     */
+    Line *lookup(unsigned int block);
+
+    /**
+     * Allocate a line to cache the given block, evicting the least recently
+     * used one if needed
+     * \param block a block
+     * \param result the allocated line, whose blocks are all invalid
+     * \return 0 on success, or a negative number on failure
+     */
+    int allocate(unsigned int block, Line *& result);
+
+    /**
+     * Read the invalid blocks of a line from the device
+     * \param line line to fill
+     * \param needed index of the block in the line that the caller needs
+     * \return 0 on success, or a negative number on failure
+     */
+    int fill(Line *line, unsigned int needed);
+
+    /**
+     * Write the dirty blocks of a line to the device
+     * \param line line to write back
+     * \return 0 on success, or a negative number on failure
+     */
+    int writeBack(Line *line);
+
+    /**
+     * Read blocks from the device
+     */
+    int deviceRead(void *buffer, unsigned int block, unsigned int count);
+
+    /**
+     * Write blocks to the device
+     */
+    int deviceWrite(const void *buffer, unsigned int block, unsigned int count);
+
+    intrusive_ref_ptr<FileBase> disk; ///< Cached device
+    Line *lines;                      ///< Cache lines
+    unsigned char *data;              ///< Memory for all the cache lines
+    unsigned int numLines;            ///< Number of cache lines
+    unsigned int lineBlocks;          ///< Blocks per cache line
+    unsigned int useCounter=0;        ///< For LRU replacement
+    BlockCacheStats stats;            ///< Cache statistics
+};
+
+#endif //WITH_FILESYSTEM
+
+} //namespace miosix
@@ -38,6 +38,8 @@ namespace miosix {
 // class TerminalDevice
 //
 
+static const char crlf[]="\r\n";
+
 TerminalDevice::TerminalDevice(intrusive_ref_ptr<Device> device)
         : FileBase(intrusive_ref_ptr<FilesystemBase>(),O_RDWR), device(device),
           mutex(), echo(true), binary(false), skipNewline(false) {}
@@ -46,27 +48,37 @@ ssize_t TerminalDevice::write(const void *data, size_t length)
 {
     if(binary) return device->writeBlock(data,length,0);
     //No mutex here to avoid blocking writes while reads are in progress
-    const char *buffer=static_cast<const char*>(data);
-    const char *start=buffer;
-    //Try to write data in chunks, stop at every \n to replace with \r\n
+    char *buffer=const_cast<char*>(static_cast<const char*>(data));
+    char *start=buffer;
+    //Split data in chunks, stop at every \n to replace with \r\n. Chunks are
+    //passed to the device in batches, so that devices which can chain
+    //transfers perform one transaction per batch and not one per line.
     //Although it may be tempting to call echoBack() from here since it performs
     //a similar task, it is not possible, as echoBack() uses a class field,
     //chunkStart, and write is not mutexed to allow concurrent writing
+    const int maxChunks=16;
+    struct iovec chunks[maxChunks];
+    int numChunks=0;
     for(size_t i=0;i<length;i++,buffer++)
     {
         if(*buffer!='\n') continue;
         if(buffer>start)
+            chunks[numChunks++]={start,static_cast<size_t>(buffer-start)};
+        chunks[numChunks++]={const_cast<char*>(crlf),2}; //Add \r\n
+        start=buffer+1;
+        //A line can add up to two chunks, flush if there may not be room
+        if(numChunks>maxChunks-2)
         {
-            ssize_t r=device->writeBlock(start,buffer-start,0);
+            ssize_t r=device->writeBlockv(chunks,numChunks,0);
             if(r<=0) return r;
+            numChunks=0;
         }
-        ssize_t r=device->writeBlock("\r\n",2,0);//Add \r\n
-        if(r<=0) return r;
-        start=buffer+1;
     }
     if(buffer>start)
+        chunks[numChunks++]={start,static_cast<size_t>(buffer-start)};
+    if(numChunks>0)
     {
-        ssize_t r=device->writeBlock(start,buffer-start,0);
+        ssize_t r=device->writeBlockv(chunks,numChunks,0);
         if(r<=0) return r;
     }
     return length;
@@ -106,6 +118,11 @@ int TerminalDevice::fstat(struct stat *pstat) const
 
 int TerminalDevice::isatty() const { return device->isatty(); }
 
+int TerminalDevice::poll(short events, PollEntry *entry)
+{
+    return device->poll(events,entry);
+}
+
 #endif //WITH_FILESYSTEM
 
 int TerminalDevice::ioctl(int cmd, void *arg)
@@ -97,6 +97,16 @@ public:
      * case of errors
      */
     virtual int isatty() const;
+
+    /**
+     * Check whether the terminal is ready for reading or writing. Note that
+     * when not in binary mode, a read may still block until a whole line has
+     * been received.
+     * \param events requested events, such as POLLIN or POLLOUT
+     * \param entry if not nullptr, registered in the device PollQueue
+     * \return the events that are currently ready
+     */
+    virtual int poll(short events, PollEntry *entry);
     
     #endif //WITH_FILESYSTEM
     
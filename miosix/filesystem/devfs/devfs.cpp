@@ -30,6 +30,7 @@
 #include <errno.h>
 #include <fcntl.h>
 #include "filesystem/stringpart.h"
+#include "kernel/latency_stats.h"
 
 using namespace std;
 
@@ -94,6 +95,44 @@ public:
      */
     virtual off_t lseek(off_t pos, int whence);
 
+    /**
+     * Write data at the given position, without changing the file pointer.
+     * \param data the data to write
+     * \param len the number of bytes to write
+     * \param pos offset from the beginning of the file
+     * \return the number of written characters, or a negative number in
+     * case of errors
+     */
+    virtual ssize_t pwrite(const void *data, size_t len, off_t pos);
+
+    /**
+     * Read data from the given position, without changing the file pointer.
+     * \param data buffer to store read data
+     * \param len the number of bytes to read
+     * \param pos offset from the beginning of the file
+     * \return the number of read characters, or a negative number in
+     * case of errors
+     */
+    virtual ssize_t pread(void *data, size_t len, off_t pos);
+
+    /**
+     * Write data from multiple buffers to the file.
+     * \param iov array of buffers to write
+     * \param iovcnt number of elements in iov
+     * \return the number of written characters, or a negative number in
+     * case of errors
+     */
+    virtual ssize_t writev(const struct iovec *iov, int iovcnt);
+
+    /**
+     * Read data from the file into multiple buffers.
+     * \param iov array of buffers to store read data
+     * \param iovcnt number of elements in iov
+     * \return the number of read characters, or a negative number in
+     * case of errors
+     */
+    virtual ssize_t readv(const struct iovec *iov, int iovcnt);
+
     /**
      * Truncate the file
      * \param size new file size
@@ -123,6 +162,14 @@ public:
      */
     virtual int ioctl(int cmd, void *arg);
 
+    /**
+     * Check whether the file is ready for reading or writing
+     * \param events requested events, such as POLLIN or POLLOUT
+     * \param entry if not nullptr, registered in the device PollQueue
+     * \return the events that are currently ready
+     */
+    virtual int poll(short events, PollEntry *entry);
+
 private:
     intrusive_ref_ptr<Device> dev; ///< Device file
     off_t seekPoint;               ///< Seek point (note that off_t is 64bit)
@@ -169,6 +216,40 @@ off_t DevFsFile::lseek(off_t pos, int whence)
     return seekPoint;
 }
 
+ssize_t DevFsFile::pwrite(const void *data, size_t len, off_t pos)
+{
+    if((flags & _FWRITE)==0) return -EINVAL;
+    if(flags & _NOSEEK) return -ESPIPE;
+    if(pos<0) return -EINVAL;
+    if(pos+static_cast<off_t>(len)<0) len=numeric_limits<off_t>::max()-pos;
+    return dev->writeBlock(data,len,pos);
+}
+
+ssize_t DevFsFile::pread(void *data, size_t len, off_t pos)
+{
+    if((flags & _FREAD)==0) return -EINVAL;
+    if(flags & _NOSEEK) return -ESPIPE;
+    if(pos<0) return -EINVAL;
+    if(pos+static_cast<off_t>(len)<0) len=numeric_limits<off_t>::max()-pos;
+    return dev->readBlock(data,len,pos);
+}
+
+ssize_t DevFsFile::writev(const struct iovec *iov, int iovcnt)
+{
+    if((flags & _FWRITE)==0) return -EINVAL;
+    ssize_t result=dev->writeBlockv(iov,iovcnt,seekPoint);
+    if(result>0 && ((flags & _NOSEEK)==0)) seekPoint+=result;
+    return result;
+}
+
+ssize_t DevFsFile::readv(const struct iovec *iov, int iovcnt)
+{
+    if((flags & _FREAD)==0) return -EINVAL;
+    ssize_t result=dev->readBlockv(iov,iovcnt,seekPoint);
+    if(result>0 && ((flags & _NOSEEK)==0)) seekPoint+=result;
+    return result;
+}
+
 int DevFsFile::ftruncate(off_t size) { return -EINVAL; }
 
 int DevFsFile::fstat(struct stat *pstat) const
@@ -186,6 +267,13 @@ int DevFsFile::ioctl(int cmd, void *arg)
     return dev->ioctl(cmd,arg);
 }
 
+int DevFsFile::poll(short events, PollEntry *entry)
+{
+    if((flags & _FREAD)==0) events&=~(POLLIN | POLLRDNORM);
+    if((flags & _FWRITE)==0) events&=~(POLLOUT | POLLWRNORM);
+    return dev->poll(events,entry);
+}
+
 //
 // class Device
 //
@@ -224,6 +312,34 @@ ssize_t Device::writeBlock(const void *buffer, size_t size, off_t where)
     return size; //Act as /dev/null
 }
 
+ssize_t Device::readBlockv(const struct iovec *iov, int iovcnt, off_t where)
+{
+    ssize_t total=0;
+    for(int i=0;i<iovcnt;i++)
+    {
+        if(iov[i].iov_len==0) continue;
+        ssize_t result=readBlock(iov[i].iov_base,iov[i].iov_len,where+total);
+        if(result<0) return total>0 ? total : result;
+        total+=result;
+        if(static_cast<size_t>(result)<iov[i].iov_len) break;
+    }
+    return total;
+}
+
+ssize_t Device::writeBlockv(const struct iovec *iov, int iovcnt, off_t where)
+{
+    ssize_t total=0;
+    for(int i=0;i<iovcnt;i++)
+    {
+        if(iov[i].iov_len==0) continue;
+        ssize_t result=writeBlock(iov[i].iov_base,iov[i].iov_len,where+total);
+        if(result<0) return total>0 ? total : result;
+        total+=result;
+        if(static_cast<size_t>(result)<iov[i].iov_len) break;
+    }
+    return total;
+}
+
 void Device::IRQwrite(const char *str) {}
 
 int Device::ioctl(int cmd, void *arg)
@@ -231,6 +347,11 @@ int Device::ioctl(int cmd, void *arg)
     return -ENOTTY; //Means the operation does not apply to this descriptor
 }
 
+int Device::poll(short events, PollEntry *entry)
+{
+    return events & (POLLIN | POLLRDNORM | POLLOUT | POLLWRNORM);
+}
+
 Device::~Device() {}
 
 #ifdef WITH_DEVFS
@@ -325,6 +446,9 @@ DevFs::DevFs() : mutex(FastMutex::RECURSIVE), inodeCount(rootDirInode+1)
 {
     addDevice("null",intrusive_ref_ptr<Device>(new Device(Device::STREAM)));
     addDevice("zero",intrusive_ref_ptr<Device>(new Device(Device::STREAM)));
+    #ifdef WITH_LATENCY_STATS
+    addDevice("kstat",intrusive_ref_ptr<Device>(LatencyStats::createDevice()));
+    #endif //WITH_LATENCY_STATS
 }
 
 bool DevFs::addDevice(const char *name, intrusive_ref_ptr<Device> dev)
@@ -131,6 +131,29 @@ public:
      * \return number of bytes written or a negative number on failure
      */
     virtual ssize_t writeBlock(const void *buffer, size_t size, off_t where);
+
+    /**
+     * Read data into multiple buffers, as if they were a single contiguous
+     * buffer. The default implementation calls readBlock() for each buffer,
+     * devices that can chain transfers should override it.
+     * \param iov array of buffers where read data will be stored
+     * \param iovcnt number of elements in iov
+     * \param where where to read from
+     * \return number of bytes read or a negative number on failure
+     */
+    virtual ssize_t readBlockv(const struct iovec *iov, int iovcnt, off_t where);
+
+    /**
+     * Write data from multiple buffers, as if they were a single contiguous
+     * buffer. The default implementation calls writeBlock() for each buffer,
+     * devices that can chain transfers should override it.
+     * \param iov array of buffers where take data to write
+     * \param iovcnt number of elements in iov
+     * \param where where to write to
+     * \return number of bytes written or a negative number on failure
+     */
+    virtual ssize_t writeBlockv(const struct iovec *iov, int iovcnt,
+                                off_t where);
     
     /**
      * Write a string.
@@ -151,6 +174,18 @@ public:
      * \return the exact return value depends on CMD, -1 is returned on error
      */
     virtual int ioctl(int cmd, void *arg);
+
+    /**
+     * Check whether the device is ready for reading or writing, used to
+     * implement poll(). Devices whose readiness changes over time own a
+     * PollQueue, and wake it whenever they may have become ready. The default
+     * implementation reports the device as always readable and writable.
+     * \param events requested events, such as POLLIN or POLLOUT
+     * \param entry if not nullptr, the device registers it in its PollQueue
+     * before checking readiness, so that no wakeup can be lost
+     * \return the events that are currently ready
+     */
+    virtual int poll(short events, PollEntry *entry);
     
     /**
      * Destructor
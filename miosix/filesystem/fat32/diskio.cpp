@@ -46,14 +46,13 @@ using namespace miosix;
  * Read one or more sectors from drive
  */
 DRESULT disk_read (
-    intrusive_ref_ptr<FileBase> pdrv,		/* Physical drive nmuber (0..) */
+    BlockCache *pdrv,		/* Physical drive cache */
 	BYTE *buff,		/* Data buffer to store read data */
 	DWORD sector,           /* Sector address (LBA) */
 	UINT count		/* Number of sectors to read (1..255) */
 )
 {
-    if(pdrv->lseek(static_cast<off_t>(sector)*512,SEEK_SET)<0) return RES_ERROR;
-    if(pdrv->read(buff,count*512)!=static_cast<ssize_t>(count)*512) return RES_ERROR;
+    if(pdrv->read(buff,sector,count)!=0) return RES_ERROR;
     return RES_OK;
 }
 
@@ -62,14 +61,13 @@ DRESULT disk_read (
  * Write one or more sectors to drive
  */
 DRESULT disk_write (
-    intrusive_ref_ptr<FileBase> pdrv,		/* Physical drive nmuber (0..) */
+    BlockCache *pdrv,		/* Physical drive cache */
 	const BYTE *buff,	/* Data to be written */
 	DWORD sector,		/* Sector address (LBA) */
 	UINT count		/* Number of sectors to write (1..255) */
 )
 {
-    if(pdrv->lseek(static_cast<off_t>(sector)*512,SEEK_SET)<0) return RES_ERROR;
-    if(pdrv->write(buff,count*512)!=static_cast<ssize_t>(count)*512) return RES_ERROR;
+    if(pdrv->write(buff,sector,count)!=0) return RES_ERROR;
     return RES_OK;
 }
 
@@ -78,7 +76,7 @@ DRESULT disk_write (
  * To perform disk functions other thar read/write
  */
 DRESULT disk_ioctl (
-    intrusive_ref_ptr<FileBase> pdrv,		/* Physical drive nmuber (0..) */
+    BlockCache *pdrv,		/* Physical drive cache */
 	BYTE ctrl,		/* Control code */
 	void *buff		/* Buffer to send/receive control data */
 )
@@ -86,7 +84,7 @@ DRESULT disk_ioctl (
     switch(ctrl)
     {
         case CTRL_SYNC:
-            if(pdrv->ioctl(IOCTL_SYNC,0)==0) return RES_OK; else return RES_ERROR;
+            if(pdrv->sync()==0) return RES_OK; else return RES_ERROR;
         case GET_SECTOR_COUNT:
             return RES_ERROR; //unimplemented, so f_mkfs() does not work
         case GET_BLOCK_SIZE:
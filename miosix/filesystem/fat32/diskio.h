@@ -14,6 +14,7 @@
 
 #include "integer.h"
 #include <filesystem/file.h>
+#include <filesystem/block_cache.h>
 #include "config/miosix_settings.h"
 
 #ifdef WITH_FILESYSTEM
@@ -36,13 +37,13 @@ typedef enum {
 /* Prototypes for disk control functions */
 
 
-DSTATUS disk_initialize (miosix::intrusive_ref_ptr<miosix::FileBase> pdrv);
-DSTATUS disk_status (miosix::intrusive_ref_ptr<miosix::FileBase> pdrv);
-DRESULT disk_read (miosix::intrusive_ref_ptr<miosix::FileBase> pdrv,
+DSTATUS disk_initialize (miosix::BlockCache *pdrv);
+DSTATUS disk_status (miosix::BlockCache *pdrv);
+DRESULT disk_read (miosix::BlockCache *pdrv,
         BYTE*buff, DWORD sector, UINT count);
-DRESULT disk_write (miosix::intrusive_ref_ptr<miosix::FileBase> pdrv,
+DRESULT disk_write (miosix::BlockCache *pdrv,
         const BYTE* buff, DWORD sector, UINT count);
-DRESULT disk_ioctl (miosix::intrusive_ref_ptr<miosix::FileBase> pdrv,
+DRESULT disk_ioctl (miosix::BlockCache *pdrv,
         BYTE cmd, void* buff);
 
 
@@ -220,6 +220,26 @@ public:
      */
     virtual off_t lseek(off_t pos, int whence);
 
+    /**
+     * Write data at the given position, without changing the file pointer.
+     * \param data the data to write
+     * \param len the number of bytes to write
+     * \param pos offset from the beginning of the file
+     * \return the number of written characters, or a negative number in case
+     * of errors
+     */
+    virtual ssize_t pwrite(const void *data, size_t len, off_t pos);
+
+    /**
+     * Read data from the given position, without changing the file pointer.
+     * \param data buffer to store read data
+     * \param len the number of bytes to read
+     * \param pos offset from the beginning of the file
+     * \return the number of read characters, or a negative number in case
+     * of errors
+     */
+    virtual ssize_t pread(void *data, size_t len, off_t pos);
+
     /**
      * Truncate the file
      * \param size new file size
@@ -354,6 +374,20 @@ off_t Fat32File::lseek(off_t pos, int whence)
     return offset+seekPastEnd;
 }
 
+ssize_t Fat32File::pwrite(const void *data, size_t len, off_t pos)
+{
+    //The mutex is recursive, holding it makes the seek, write and seek back
+    //atomic with respect to other accesses to the filesystem
+    Lock<FastMutex> l(mutex);
+    return FileBase::pwrite(data,len,pos);
+}
+
+ssize_t Fat32File::pread(void *data, size_t len, off_t pos)
+{
+    Lock<FastMutex> l(mutex);
+    return FileBase::pread(data,len,pos);
+}
+
 int Fat32File::ftruncate(off_t size)
 {
     Lock<FastMutex> l(mutex);
@@ -411,9 +445,9 @@ Fat32File::~Fat32File()
 //
 
 Fat32Fs::Fat32Fs(intrusive_ref_ptr<FileBase> disk)
-        : mutex(FastMutex::RECURSIVE), failed(true)
+        : cache(disk), mutex(FastMutex::RECURSIVE), failed(true)
 {
-    filesystem.drv=disk;
+    filesystem.drv=&cache;
     failed=f_mount(&filesystem,1,false)!=FR_OK;
 }
 
@@ -566,8 +600,7 @@ Fat32Fs::~Fat32Fs()
 {
     if(failed) return;
     f_mount(&filesystem,0,true); //TODO: what to do with error code?
-    filesystem.drv->ioctl(IOCTL_SYNC,0);
-    filesystem.drv.reset();
+    cache.sync();
 }
 
 int Fat32Fs::unlinkRmdirHelper(StringPart& name, bool delDir)
@@ -121,6 +121,7 @@ private:
     
     int unlinkRmdirHelper(StringPart& name, bool delDir);
     
+    BlockCache cache;
     FATFS filesystem;
     FastMutex mutex;
     bool failed; ///< Failed to mount
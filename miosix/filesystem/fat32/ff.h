@@ -36,6 +36,7 @@
 //#endif
 
 #include <filesystem/file.h>
+#include <filesystem/block_cache.h>
 #include "config/miosix_settings.h"
 
 #include "integer.h"	/* Basic integer types */
@@ -143,7 +144,7 @@ struct FATFS {
 #ifdef _FS_LOCK
     FILESEM	Files[miosix::FATFS_MAX_OPEN_FILES];/* Open object lock semaphores */
 #endif
-    miosix::intrusive_ref_ptr<miosix::FileBase> drv; /* drive device */
+    miosix::BlockCache *drv; /* drive device, accessed through its cache */
 };
 
 
@@ -56,6 +56,60 @@ FileBase::~FileBase()
     if(parent) parent->fileCloseHook();
 }
 
+ssize_t FileBase::pwrite(const void *data, size_t len, off_t pos)
+{
+    if(pos<0) return -EINVAL;
+    off_t saved=lseek(0,SEEK_CUR);
+    if(saved<0) return saved;
+    off_t res=lseek(pos,SEEK_SET);
+    if(res<0) return res;
+    ssize_t result=write(data,len);
+    lseek(saved,SEEK_SET);
+    return result;
+}
+
+ssize_t FileBase::pread(void *data, size_t len, off_t pos)
+{
+    if(pos<0) return -EINVAL;
+    off_t saved=lseek(0,SEEK_CUR);
+    if(saved<0) return saved;
+    off_t res=lseek(pos,SEEK_SET);
+    if(res<0) return res;
+    ssize_t result=read(data,len);
+    lseek(saved,SEEK_SET);
+    return result;
+}
+
+ssize_t FileBase::writev(const struct iovec *iov, int iovcnt)
+{
+    ssize_t total=0;
+    for(int i=0;i<iovcnt;i++)
+    {
+        if(iov[i].iov_len==0) continue;
+        ssize_t result=write(iov[i].iov_base,iov[i].iov_len);
+        //Report errors only if nothing has been written yet
+        if(result<0) return total>0 ? total : result;
+        total+=result;
+        if(static_cast<size_t>(result)<iov[i].iov_len) break;
+    }
+    return total;
+}
+
+ssize_t FileBase::readv(const struct iovec *iov, int iovcnt)
+{
+    ssize_t total=0;
+    for(int i=0;i<iovcnt;i++)
+    {
+        if(iov[i].iov_len==0) continue;
+        ssize_t result=read(iov[i].iov_base,iov[i].iov_len);
+        if(result<0) return total>0 ? total : result;
+        total+=result;
+        //Short read, don't block waiting to fill the next buffer
+        if(static_cast<size_t>(result)<iov[i].iov_len) break;
+    }
+    return total;
+}
+
 int FileBase::isatty() const
 {
     return 0;
@@ -77,6 +131,11 @@ int FileBase::ioctl(int cmd, void *arg)
     return -ENOTTY; //Means the operation does not apply to this descriptor
 }
 
+int FileBase::poll(short events, PollEntry *entry)
+{
+    return events & (POLLIN | POLLRDNORM | POLLOUT | POLLWRNORM);
+}
+
 int FileBase::getdents(void *dp, int len)
 {
     return -EBADF;
@@ -25,9 +25,11 @@
  *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
  ***************************************************************************/
 
-#include <fcntl.h>
+#include "libsyscalls/include/fcntl.h"
 #include <dirent.h>
 #include <sys/stat.h>
+#include "libsyscalls/include/sys/uio.h"
+#include "libsyscalls/include/poll.h"
 #include "kernel/intrusive.h"
 #include "config/miosix_settings.h"
 
@@ -38,6 +40,7 @@ namespace miosix {
 // Forward decls
 class FilesystemBase;
 class StringPart;
+class PollEntry;
 
 /**
  * Return value of FileBase::getFileFromMemory()
@@ -125,6 +128,56 @@ public:
      * completed, or a negative number in case of errors
      */
     virtual off_t lseek(off_t pos, int whence)=0;
+
+    /**
+     * Write data at the given position, without changing the file pointer.
+     * The default implementation saves the file pointer, calls lseek() and
+     * write(), then restores the file pointer, and is thus not atomic with
+     * respect to other operations on the same file. Files that can access data
+     * by position should override it.
+     * \param data the data to write
+     * \param len the number of bytes to write
+     * \param pos offset from the beginning of the file
+     * \return the number of written characters, or a negative number in case
+     * of errors
+     */
+    virtual ssize_t pwrite(const void *data, size_t len, off_t pos);
+
+    /**
+     * Read data from the given position, without changing the file pointer.
+     * The default implementation saves the file pointer, calls lseek() and
+     * read(), then restores the file pointer, and is thus not atomic with
+     * respect to other operations on the same file. Files that can access data
+     * by position should override it.
+     * \param data buffer to store read data
+     * \param len the number of bytes to read
+     * \param pos offset from the beginning of the file
+     * \return the number of read characters, or a negative number in case
+     * of errors
+     */
+    virtual ssize_t pread(void *data, size_t len, off_t pos);
+
+    /**
+     * Write data from multiple buffers to the file, as if they were a single
+     * contiguous buffer. The default implementation calls write() for each
+     * buffer, files that can coalesce the transfer should override it.
+     * \param iov array of buffers to write
+     * \param iovcnt number of elements in iov
+     * \return the number of written characters, or a negative number in case
+     * of errors
+     */
+    virtual ssize_t writev(const struct iovec *iov, int iovcnt);
+
+    /**
+     * Read data from the file into multiple buffers, filling them in order.
+     * The default implementation calls read() for each buffer, files that can
+     * coalesce the transfer should override it.
+     * \param iov array of buffers to store read data
+     * \param iovcnt number of elements in iov
+     * \return the number of read characters, or a negative number in case
+     * of errors
+     */
+    virtual ssize_t readv(const struct iovec *iov, int iovcnt);
     
     /**
      * Truncate the file
@@ -162,6 +215,20 @@ public:
      * \return the exact return value depends on CMD, -1 is returned on error
      */
     virtual int ioctl(int cmd, void *arg);
+
+    /**
+     * Check whether the file is ready for reading or writing, used to
+     * implement poll(). Files whose readiness changes over time own a
+     * PollQueue, and wake it whenever they may have become ready. The default
+     * implementation reports the file as always readable and writable, which
+     * is correct for regular files.
+     * \param events requested events, such as POLLIN or POLLOUT
+     * \param entry if not nullptr, the file registers it in its PollQueue
+     * before checking readiness, so that no wakeup can be lost
+     * \return the events that are currently ready, can also contain POLLERR
+     * or POLLHUP even if not requested
+     */
+    virtual int poll(short events, PollEntry *entry);
     
     /**
      * Also directories can be opened as files. In this case, this system call
@@ -28,6 +28,7 @@
 #include "file_access.h"
 #include <vector>
 #include <climits>
+#include <algorithm>
 #include <fcntl.h>
 #include "console/console_device.h"
 #include "mountpointfs/mountpointfs.h"
@@ -153,6 +154,56 @@ int FileDescriptorTable::fcntl(int fd, int cmd, int opt)
     } else return file->fcntl(cmd,opt);
 }
 
+int FileDescriptorTable::poll(struct pollfd *fds, nfds_t nfds, int timeout)
+{
+    if(nfds>MAX_OPEN_FILES) return -EINVAL;
+    if(nfds>0 && fds==nullptr) return -EFAULT;
+    //Hold a reference to the files, so that they can't be deleted while the
+    //poll entries are registered in their poll queues
+    intrusive_ref_ptr<FileBase> polled[MAX_OPEN_FILES];
+    PollWaiter waiter;
+    PollEntry entries[MAX_OPEN_FILES];
+    for(nfds_t i=0;i<nfds;i++)
+    {
+        if(fds[i].fd>=0) polled[i]=getFile(fds[i].fd);
+        entries[i].setWaiter(&waiter);
+    }
+    long long deadline=numeric_limits<long long>::max();
+    if(timeout>0) deadline=getTime()+static_cast<long long>(timeout)*1000000;
+    bool timedOut=false;
+    int result;
+    for(;;)
+    {
+        //Reset before scanning, a wakeup during the scan is not lost
+        waiter.reset();
+        result=0;
+        for(nfds_t i=0;i<nfds;i++)
+        {
+            short revents=0;
+            if(fds[i].fd>=0)
+            {
+                if(!polled[i]) revents=POLLNVAL;
+                else {
+                    //No need to register entries if we won't wait
+                    PollEntry *entry= timeout==0 ? nullptr : &entries[i];
+                    revents=polled[i]->poll(fds[i].events,entry);
+                    revents&=fds[i].events | POLLERR | POLLHUP;
+                }
+            }
+            fds[i].revents=revents;
+            if(revents) result++;
+        }
+        if(result>0 || timeout==0 || timedOut) break;
+        long long wakeAt=min(deadline,waiter.getRecheckTime());
+        if(wakeAt==numeric_limits<long long>::max()) waiter.wait();
+        else if(waiter.timedWait(wakeAt)==TimedWaitResult::Timeout)
+            timedOut= getTime()>=deadline; //Scan one last time on timeout
+    }
+    //The PollEntry destructor unregisters the entries from the poll queues,
+    //the entries are destroyed before the references to the files
+    return result;
+}
+
 int FileDescriptorTable::getcwd(char *buf, size_t len)
 {
     if(buf==0 || len<2) return -EINVAL; //We don't support the buf==0 extension
@@ -204,7 +255,9 @@ int FileDescriptorTable::mkdir(const char *name, int mode)
     ResolvedPath openData=FilesystemManager::instance().resolvePath(path,true);
     if(openData.result<0) return openData.result;
     StringPart sp(path,string::npos,openData.off);
-    return openData.fs->mkdir(sp,mode);
+    int result=openData.fs->mkdir(sp,mode);
+    if(result==0) FilesystemManager::instance().invalidatePathCache();
+    return result;
 }
 
 int FileDescriptorTable::rmdir(const char *name)
@@ -215,7 +268,9 @@ int FileDescriptorTable::rmdir(const char *name)
     ResolvedPath openData=FilesystemManager::instance().resolvePath(path,true);
     if(openData.result<0) return openData.result;
     StringPart sp(path,string::npos,openData.off);
-    return openData.fs->rmdir(sp);
+    int result=openData.fs->rmdir(sp);
+    if(result==0) FilesystemManager::instance().invalidatePathCache();
+    return result;
 }
 
 int FileDescriptorTable::unlink(const char *name)
@@ -625,8 +680,8 @@ int FilesystemManager::kmount(const char* path, intrusive_ref_ptr<FilesystemBase
     }
     if(filesystems.insert(make_pair(StringPart(temp),fs)).second==false)
         return -EBUSY; //Means already mounted
-    else
-        return 0;
+    pathCache.invalidate();
+    return 0;
 }
 
 int FilesystemManager::umount(const char* path, bool force)
@@ -715,6 +770,7 @@ int FilesystemManager::umount(const char* path, bool force)
     //It is now safe to umount all filesystems
     for(it5=fsToUmount.begin();it5!=fsToUmount.end();++it5)
         filesystems.erase(*it5);
+    pathCache.invalidate();
     return 0;
 }
 
@@ -728,6 +784,7 @@ void FilesystemManager::umountAll()
     getFileDescriptorTable().closeAll();
     #endif //WITH_PROCESSES
     filesystems.clear();
+    pathCache.invalidate();
 }
 
 ResolvedPath FilesystemManager::resolvePath(string& path, bool followLastSymlink)
@@ -738,8 +795,17 @@ ResolvedPath FilesystemManager::resolvePath(string& path, bool followLastSymlink
     if(path.empty() || path[0]!='/') return ResolvedPath(-ENOENT);
 
     Lock<FastMutex> l(mutex);
+    intrusive_ref_ptr<FilesystemBase> fs;
+    size_t off;
+    if(pathCache.lookup(path,followLastSymlink,fs,off))
+        return ResolvedPath(fs,off);
     PathResolution pr(filesystems);
-    return pr.resolvePath(path,followLastSymlink);
+    if(!pathCache.enabled()) return pr.resolvePath(path,followLastSymlink);
+    string unresolved(path); //resolvePath() modifies path in-place
+    ResolvedPath result=pr.resolvePath(path,followLastSymlink);
+    if(result.result==0)
+        pathCache.insert(unresolved,followLastSymlink,path,result.fs,result.off);
+    return result;
 }
 
 int FilesystemManager::unlinkHelper(string& path)
@@ -752,7 +818,9 @@ int FilesystemManager::unlinkHelper(string& path)
     //After resolvePath() so path is in canonical form and symlinks are followed
     if(filesystems.find(StringPart(path))!=filesystems.end()) return -EBUSY;
     StringPart sp(path,string::npos,openData.off);
-    return openData.fs->unlink(sp);
+    int result=openData.fs->unlink(sp);
+    if(result==0) pathCache.invalidate();
+    return result;
 }
 
 int FilesystemManager::statHelper(string& path, struct stat *pstat, bool f)
@@ -784,7 +852,9 @@ int FilesystemManager::renameHelper(string& oldPath, string& newPath)
     
     //Can't rename a directory into a subdirectory of itself
     if(newSp.startsWith(oldSp)) return -EINVAL;
-    return oldOpenData.fs->rename(oldSp,newSp);
+    int result=oldOpenData.fs->rename(oldSp,newSp);
+    if(result==0) pathCache.invalidate();
+    return result;
 }
 
 short int FilesystemManager::getFilesystemId()
@@ -31,10 +31,12 @@
 #include <list>
 #include <string>
 #include <bitset>
+#include <limits>
 #include <errno.h>
 #include <sys/stat.h>
 #include "file.h"
 #include "stringpart.h"
+#include "path_cache.h"
 #include "devfs/devfs.h"
 #include "kernel/sync.h"
 #include "kernel/intrusive.h"
@@ -166,6 +168,72 @@ public:
         if(!file) return -EBADF;
         return file->read(data,len);
     }
+
+    /**
+     * Write data at the given position, without changing the file pointer.
+     * \param data the data to write
+     * \param len the number of bytes to write
+     * \param pos offset from the beginning of the file
+     * \return the number of written characters, or a negative number in case
+     * of errors
+     */
+    ssize_t pwrite(int fd, const void *data, size_t len, off_t pos)
+    {
+        if(data==0) return -EFAULT;
+        if(static_cast<ssize_t>(len)<0) return -EINVAL;
+        intrusive_ref_ptr<FileBase> file=getFile(fd);
+        if(!file) return -EBADF;
+        return file->pwrite(data,len,pos);
+    }
+
+    /**
+     * Read data from the given position, without changing the file pointer.
+     * \param data buffer to store read data
+     * \param len the number of bytes to read
+     * \param pos offset from the beginning of the file
+     * \return the number of read characters, or a negative number in case
+     * of errors
+     */
+    ssize_t pread(int fd, void *data, size_t len, off_t pos)
+    {
+        if(data==0) return -EFAULT;
+        if(static_cast<ssize_t>(len)<0) return -EINVAL;
+        intrusive_ref_ptr<FileBase> file=getFile(fd);
+        if(!file) return -EBADF;
+        return file->pread(data,len,pos);
+    }
+
+    /**
+     * Write data from multiple buffers to a file.
+     * \param iov array of buffers to write
+     * \param iovcnt number of elements in iov
+     * \return the number of written characters, or a negative number in case
+     * of errors
+     */
+    ssize_t writev(int fd, const struct iovec *iov, int iovcnt)
+    {
+        int result=checkIovec(iov,iovcnt);
+        if(result<0) return result;
+        intrusive_ref_ptr<FileBase> file=getFile(fd);
+        if(!file) return -EBADF;
+        return file->writev(iov,iovcnt);
+    }
+
+    /**
+     * Read data from a file into multiple buffers.
+     * \param iov array of buffers to store read data
+     * \param iovcnt number of elements in iov
+     * \return the number of read characters, or a negative number in case
+     * of errors
+     */
+    ssize_t readv(int fd, const struct iovec *iov, int iovcnt)
+    {
+        int result=checkIovec(iov,iovcnt);
+        if(result<0) return result;
+        intrusive_ref_ptr<FileBase> file=getFile(fd);
+        if(!file) return -EBADF;
+        return file->readv(iov,iovcnt);
+    }
     
     /**
      * Move file pointer, if the file supports random-access.
@@ -236,6 +304,19 @@ public:
      * \return the exact return value depends on CMD, -1 is returned on error
      */
     int fcntl(int fd, int cmd, int opt);
+
+    /**
+     * Wait until one of a set of file descriptors is ready for I/O
+     * \param fds array of file descriptors and requested events, the revents
+     * field is filled with the events that are ready
+     * \param nfds number of elements in fds, can't be larger than
+     * MAX_OPEN_FILES
+     * \param timeout timeout in milliseconds, 0 to return immediately or a
+     * negative number to wait forever
+     * \return the number of file descriptors with nonzero revents, 0 if the
+     * timeout expired, or a negative number on failure
+     */
+    int poll(struct pollfd *fds, nfds_t nfds, int timeout);
     
     /**
      * Perform various operations on a file descriptor
@@ -411,6 +492,28 @@ private:
      * \return a file descriptor, or -EMFILE if all file descriptors are used
      */
     int getAvailableFd();
+
+    /**
+     * Validate the buffer array passed to readv() and writev()
+     * \param iov array of buffers
+     * \param iovcnt number of elements in iov
+     * \return 0 on success, or a negative number on failure
+     */
+    static int checkIovec(const struct iovec *iov, int iovcnt)
+    {
+        if(iovcnt<0 || iovcnt>IOV_MAX) return -EINVAL;
+        if(iovcnt>0 && iov==0) return -EFAULT;
+        //The total size must be representable in the ssize_t return value
+        size_t available=std::numeric_limits<ssize_t>::max();
+        for(int i=0;i<iovcnt;i++)
+        {
+            if(iov[i].iov_len==0) continue;
+            if(iov[i].iov_base==0) return -EFAULT;
+            if(iov[i].iov_len>available) return -EINVAL;
+            available-=iov[i].iov_len;
+        }
+        return 0;
+    }
     
     mutable FastMutex mutex; ///< Locks on writes to file object pointers, not on accesses
     
@@ -491,6 +594,36 @@ public:
      * \return the resolved path
      */
     ResolvedPath resolvePath(std::string& path, bool followLastSymlink=true);
+
+    /**
+     * \return the statistics of the cache of path resolutions
+     */
+    PathCacheStats getPathCacheStats()
+    {
+        Lock<FastMutex> l(mutex);
+        return pathCache.getStats();
+    }
+
+    /**
+     * Reset the statistics of the cache of path resolutions
+     */
+    void resetPathCacheStats()
+    {
+        Lock<FastMutex> l(mutex);
+        pathCache.resetStats();
+    }
+
+    /**
+     * \internal
+     * Clear the cache of path resolutions. Must be called after operations
+     * that may change how a path resolves, such as creating or removing
+     * directories
+     */
+    void invalidatePathCache()
+    {
+        Lock<FastMutex> l(mutex);
+        pathCache.invalidate();
+    }
     
     /**
      * \internal
@@ -576,6 +709,8 @@ private:
     
     /// Mounted filesystem
     std::map<StringPart,intrusive_ref_ptr<FilesystemBase> > filesystems;
+
+    PathCache pathCache; ///< Cache of path resolutions
     
     #ifdef WITH_PROCESSES
     std::list<FileDescriptorTable*> fileTables; ///< Process file tables
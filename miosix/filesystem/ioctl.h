@@ -36,7 +36,29 @@ enum Ioctl
     IOCTL_TCSETATTR_NOW=102,
     IOCTL_TCSETATTR_FLUSH=103,
     IOCTL_TCSETATTR_DRAIN=104,
-    IOCTL_FLUSH=105
+    IOCTL_FLUSH=105,
+    IOCTL_GET_GEOMETRY=106, ///< arg is a FlashGeometry*
+    IOCTL_ERASE=107         ///< arg is a const FlashEraseRange*
+};
+
+/**
+ * Geometry of a flash memory device, returned by IOCTL_GET_GEOMETRY.
+ * Block devices that don't need erasing, such as SD cards, don't support it
+ */
+struct FlashGeometry
+{
+    unsigned int eraseSize;  ///< Size in bytes of an erase block
+    unsigned int progSize;   ///< Minimum size in bytes of a write
+    unsigned int blockCount; ///< Number of erase blocks in the device
+};
+
+/**
+ * Range of erase blocks to erase with IOCTL_ERASE. Erased bytes read as 0xff
+ */
+struct FlashEraseRange
+{
+    unsigned int block; ///< First erase block
+    unsigned int count; ///< Number of erase blocks
 };
 
 }
@@ -31,6 +31,7 @@
 #include "kernel/logging.h"
 #include <fcntl.h>
 #include <memory>
+#include <algorithm>
 
 namespace miosix {
 
@@ -50,6 +51,17 @@ static int lfsErrorToPosix(int lfs_err);
  */
 static int posixOpenToLfsFlags(int posix_flags);
 
+/**
+ * Fill the geometry and cache sizes of a LittleFS configuration
+ * \param config configuration to fill
+ * \param disk device holding the filesystem
+ * \param cacheSize requested cache size, 0 to choose automatically
+ * \param lookaheadSize requested lookahead size, 0 to choose automatically
+ * \return true if the device is a flash memory that supports erase
+ */
+static bool configureGeometry(lfs_config& config, FileBase *disk,
+                              unsigned int cacheSize, unsigned int lookaheadSize);
+
 // * Wrappers for LFS block device operations
 static int miosixBlockDeviceRead(const struct lfs_config *c, lfs_block_t block,
                              lfs_off_t off, void *buffer, lfs_size_t size);
@@ -155,23 +167,19 @@ private:
     int addLastLFSDirEntry(char **pos, char *end);
 };
 
-LittleFS::LittleFS(intrusive_ref_ptr<FileBase> disk)
-    : // Put the drive instance into the config context. Note that a raw pointer
-      // is passed, but the object is kept alive by the intrusive_ref_ptr in the
-      // drv member variable. Hence, the object is deleted when the LittleFS
-      // object is deleted.
-      context(disk.get())
+LittleFS::LittleFS(intrusive_ref_ptr<FileBase> disk, unsigned int cacheSize,
+                   unsigned int lookaheadSize)
+    : // Put the block cache of the drive into the config context, all accesses
+      // to the drive go through it
+      context(disk)
 {
     int err;
     drv = disk;
 
     config = {};
-    config.read_size = 512;
-    config.prog_size = 512;
-    config.block_size = 512;
+    context.eraseSupported = configureGeometry(config, disk.get(), cacheSize,
+                                               lookaheadSize);
     config.block_cycles = 500;
-    config.cache_size = 512;
-    config.lookahead_size = 512;
 
     config.context = &context;
 
@@ -473,20 +481,69 @@ int LittleFSDirectory::addLastLFSDirEntry(char **pos, char *end)
     return addEntry(pos, end, ino, type, dirInfo.name);
 }
 
-#define GET_DRIVER_FROM_LFS_CONTEXT(config)                                    \
-  static_cast<FileBase *>(                                                     \
-      static_cast<lfs_driver_context *>(config->context)->disk);
+bool configureGeometry(lfs_config& config, FileBase *disk,
+                       unsigned int cacheSize, unsigned int lookaheadSize)
+{
+    const unsigned int bs = BlockCache::blockSize;
+    FlashGeometry g;
+    bool flash = disk->ioctl(IOCTL_GET_GEOMETRY, &g) == 0 && g.eraseSize > 0
+              && g.progSize > 0 && g.blockCount > 0;
+    if(flash)
+    {
+        // All accesses go through the BlockCache, so they are rounded to
+        // whole cache blocks
+        unsigned int ioSize = (std::max(g.progSize, bs) + bs - 1) / bs * bs;
+        if(g.eraseSize % ioSize == 0)
+        {
+            config.read_size = ioSize;
+            config.prog_size = ioSize;
+            config.block_size = g.eraseSize;
+            config.block_count = g.blockCount;
+        } else flash = false;
+    }
+    if(!flash)
+    {
+        // Block count is zero, so it is read from the superblock
+        config.read_size = bs;
+        config.prog_size = bs;
+        config.block_size = bs;
+    }
+
+    // The cache size must be a multiple of the program size and a factor of
+    // the block size
+    const unsigned int prog = config.prog_size;
+    cacheSize = std::min((cacheSize + prog - 1) / prog * prog,
+                         static_cast<unsigned int>(config.block_size));
+    if(cacheSize == 0 || config.block_size % cacheSize != 0) cacheSize = prog;
+    config.cache_size = cacheSize;
+
+    // One lookahead bit per block, in multiples of 8 bytes
+    if(lookaheadSize == 0)
+    {
+        if(config.block_count == 0) lookaheadSize = 512;
+        else lookaheadSize = std::min((config.block_count + 63) / 64 * 8, 512u);
+    }
+    config.lookahead_size = (lookaheadSize + 7) / 8 * 8;
+    return flash;
+}
+
+#define GET_CACHE_FROM_LFS_CONTEXT(config)                                     \
+  static_cast<BlockCache *>(                                                   \
+      &static_cast<lfs_driver_context *>(config->context)->cache);
 
 int miosixBlockDeviceRead(const lfs_config *c, lfs_block_t block,
                           lfs_off_t off, void *buffer, lfs_size_t size)
 {
-    FileBase *drv = GET_DRIVER_FROM_LFS_CONTEXT(c);
+    BlockCache *cache = GET_CACHE_FROM_LFS_CONTEXT(c);
 
-    if(drv->lseek(static_cast<off_t>(c->block_size * block + off), SEEK_SET) < 0)
+    off_t pos = static_cast<off_t>(c->block_size) * block + off;
+    // Geometry must be a multiple of the block size of the cache
+    if(pos % BlockCache::blockSize != 0 || size % BlockCache::blockSize != 0)
     {
-        return LFS_ERR_IO;
+        return LFS_ERR_INVAL;
     }
-    if(drv->read(buffer, size) != static_cast<ssize_t>(size))
+    if(cache->read(buffer, pos / BlockCache::blockSize,
+                   size / BlockCache::blockSize) != 0)
     {
         return LFS_ERR_IO;
     }
@@ -496,13 +553,16 @@ int miosixBlockDeviceRead(const lfs_config *c, lfs_block_t block,
 int miosixBlockDeviceProg(const lfs_config *c, lfs_block_t block,
                           lfs_off_t off, const void *buffer, lfs_size_t size)
 {
-    FileBase *drv = GET_DRIVER_FROM_LFS_CONTEXT(c);
+    BlockCache *cache = GET_CACHE_FROM_LFS_CONTEXT(c);
 
-    if(drv->lseek(static_cast<off_t>(c->block_size * block + off), SEEK_SET) < 0)
+    off_t pos = static_cast<off_t>(c->block_size) * block + off;
+    // Geometry must be a multiple of the block size of the cache
+    if(pos % BlockCache::blockSize != 0 || size % BlockCache::blockSize != 0)
     {
-        return LFS_ERR_IO;
+        return LFS_ERR_INVAL;
     }
-    if(drv->write(buffer, size) != static_cast<ssize_t>(size))
+    if(cache->write(buffer, pos / BlockCache::blockSize,
+                    size / BlockCache::blockSize) != 0)
     {
         return LFS_ERR_IO;
     }
@@ -511,14 +571,27 @@ int miosixBlockDeviceProg(const lfs_config *c, lfs_block_t block,
 
 int miosixBlockDeviceErase(const lfs_config *c, lfs_block_t block)
 {
+    auto context = static_cast<lfs_driver_context *>(c->context);
+    // Devices such as SD cards don't need to be erased before writing
+    if(!context->eraseSupported) return LFS_ERR_OK;
+
+    // The erased blocks may be in the cache, drop them or they would be
+    // written back over the erased flash
+    const unsigned int cacheBlocks = c->block_size / BlockCache::blockSize;
+    context->cache.discard(block * cacheBlocks, cacheBlocks);
+    FlashEraseRange range = { block, 1 };
+    if(context->cache.getDevice()->ioctl(IOCTL_ERASE, &range) != 0)
+    {
+        return LFS_ERR_IO;
+    }
     return LFS_ERR_OK;
 }
 
 int miosixBlockDeviceSync(const lfs_config *c)
 {
-    FileBase *drv = GET_DRIVER_FROM_LFS_CONTEXT(c);
+    BlockCache *cache = GET_CACHE_FROM_LFS_CONTEXT(c);
 
-    if (drv->ioctl(IOCTL_SYNC, nullptr) != 0) return LFS_ERR_IO;
+    if (cache->sync() != 0) return LFS_ERR_IO;
     return -LFS_ERR_OK;
 }
 
@@ -30,6 +30,7 @@
 #include "config/miosix_settings.h"
 #include "filesystem/file.h"
 #include "filesystem/stringpart.h"
+#include "filesystem/block_cache.h"
 #include "kernel/sync.h"
 #include "lfs.h"
 #include <memory>
@@ -43,10 +44,12 @@ class LittleFSDirectory;
 struct lfs_driver_context
 {
 public:
-    lfs_driver_context(FileBase *disk) : disk(disk), mutex(Mutex::DEFAULT) {}
+    lfs_driver_context(intrusive_ref_ptr<FileBase> disk)
+        : cache(disk), mutex(Mutex::DEFAULT) {}
 
-    FileBase *disk;
+    BlockCache cache;
     Mutex mutex;
+    bool eraseSupported=false; ///< True if the device supports IOCTL_ERASE
 };
 
 /**
@@ -56,9 +59,21 @@ class LittleFS : public FilesystemBase
 {
 public:
     /**
-     * Constructor
+     * Constructor.
+     * If the device supports IOCTL_GET_GEOMETRY, as flash memories do, the
+     * filesystem blocks match the device erase blocks and are erased through
+     * IOCTL_ERASE. Otherwise 512 byte blocks are used and never erased, as
+     * needed by devices such as SD cards.
+     * \param disk device holding the filesystem
+     * \param cacheSize size in bytes of the LittleFS read, program and per
+     * file caches, rounded to a multiple of the program size. 0 selects the
+     * program size, which minimizes RAM usage
+     * \param lookaheadSize size in bytes of the block allocator lookahead
+     * buffer, rounded to a multiple of 8. Each byte tracks 8 blocks. 0 selects
+     * a size that covers the whole device, up to 512 bytes
      */
-    LittleFS(intrusive_ref_ptr<FileBase> disk);
+    LittleFS(intrusive_ref_ptr<FileBase> disk, unsigned int cacheSize=0,
+             unsigned int lookaheadSize=0);
 
     /**
      * Open a file
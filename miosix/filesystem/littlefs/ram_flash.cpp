@@ -0,0 +1,283 @@
+/***************************************************************************
+ *   Copyright (C) 2024 by Terraneo Federico                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+#include "ram_flash.h"
+#include <cstring>
+#include <errno.h>
+
+#ifdef TEST_ALGORITHM
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+#include <algorithm>
+#include "lfs.h"
+#endif //TEST_ALGORITHM
+
+namespace miosix {
+
+//
+// class RamFlashMemory
+//
+
+RamFlashMemory::RamFlashMemory(unsigned int eraseSize, unsigned int progSize,
+                               unsigned int blockCount)
+    : geometry{eraseSize,progSize,blockCount},
+      data(new unsigned char[eraseSize*blockCount]),
+      eraseCounts(new unsigned int[blockCount])
+{
+    memset(data,0xff,eraseSize*blockCount);
+    memset(eraseCounts,0,blockCount*sizeof(unsigned int));
+}
+
+int RamFlashMemory::read(void *buffer, unsigned int addr, unsigned int size)
+{
+    if(addr>this->size() || size>this->size()-addr) return -EINVAL;
+    memcpy(buffer,data+addr,size);
+    stats.reads++;
+    stats.bytesRead+=size;
+    return 0;
+}
+
+int RamFlashMemory::prog(const void *buffer, unsigned int addr,
+                         unsigned int size)
+{
+    if(addr>this->size() || size>this->size()-addr) return -EINVAL;
+    if(addr%geometry.progSize || size%geometry.progSize) return -EINVAL;
+    //Programming can only turn ones into zeros
+    auto buf=reinterpret_cast<const unsigned char*>(buffer);
+    for(unsigned int i=0;i<size;i++) data[addr+i]&=buf[i];
+    stats.progs++;
+    stats.bytesProgrammed+=size;
+    return 0;
+}
+
+int RamFlashMemory::erase(unsigned int block, unsigned int count)
+{
+    if(block>geometry.blockCount || count>geometry.blockCount-block)
+        return -EINVAL;
+    memset(data+block*geometry.eraseSize,0xff,count*geometry.eraseSize);
+    for(unsigned int i=block;i<block+count;i++) eraseCounts[i]++;
+    stats.erases+=count;
+    return 0;
+}
+
+RamFlashMemory::~RamFlashMemory()
+{
+    delete[] data;
+    delete[] eraseCounts;
+}
+
+#if defined(WITH_FILESYSTEM) && !defined(TEST_ALGORITHM)
+
+//
+// class RamFlash
+//
+
+RamFlash::RamFlash(unsigned int eraseSize, unsigned int progSize,
+                   unsigned int blockCount)
+    : Device(Device::BLOCK), memory(eraseSize,progSize,blockCount) {}
+
+ssize_t RamFlash::readBlock(void *buffer, size_t size, off_t where)
+{
+    //Check before narrowing the 64 bit offset to the flash address type
+    if(where<0 || where+size>memory.size()) return -EINVAL;
+    Lock<FastMutex> l(mutex);
+    if(int res=memory.read(buffer,where,size)) return res;
+    return size;
+}
+
+ssize_t RamFlash::writeBlock(const void *buffer, size_t size, off_t where)
+{
+    //Check before narrowing the 64 bit offset to the flash address type
+    if(where<0 || where+size>memory.size()) return -EINVAL;
+    Lock<FastMutex> l(mutex);
+    if(int res=memory.prog(buffer,where,size)) return res;
+    return size;
+}
+
+int RamFlash::ioctl(int cmd, void *arg)
+{
+    Lock<FastMutex> l(mutex);
+    switch(cmd)
+    {
+        case IOCTL_SYNC:
+            return 0;
+        case IOCTL_GET_GEOMETRY:
+            *reinterpret_cast<FlashGeometry*>(arg)=memory.getGeometry();
+            return 0;
+        case IOCTL_ERASE:
+        {
+            auto range=reinterpret_cast<const FlashEraseRange*>(arg);
+            return memory.erase(range->block,range->count);
+        }
+        default:
+            return -ENOTTY;
+    }
+}
+
+RamFlashStats RamFlash::getStats()
+{
+    Lock<FastMutex> l(mutex);
+    return memory.getStats();
+}
+
+void RamFlash::resetStats()
+{
+    Lock<FastMutex> l(mutex);
+    memory.resetStats();
+}
+
+#endif //defined(WITH_FILESYSTEM) && !defined(TEST_ALGORITHM)
+
+} //namespace miosix
+
+//Benchmark of LittleFS mount, write and garbage collection on a 1MB flash,
+//comparing the 512 byte blocks that were hardcoded in the past with 4KB
+//blocks, as typical of NOR flash erase sizes. Build with
+//gcc -O2 -c lfs.c lfs_util.c
+//g++ -DTEST_ALGORITHM -std=c++14 -O2 -I../.. -o bench ram_flash.cpp lfs.o lfs_util.o
+//./bench
+#ifdef TEST_ALGORITHM
+
+using namespace std;
+using namespace std::chrono;
+using namespace miosix;
+
+static int simRead(const lfs_config *c, lfs_block_t block, lfs_off_t off,
+                   void *buffer, lfs_size_t size)
+{
+    auto m=reinterpret_cast<RamFlashMemory*>(c->context);
+    return m->read(buffer,block*c->block_size+off,size) ? LFS_ERR_IO : 0;
+}
+
+static int simProg(const lfs_config *c, lfs_block_t block, lfs_off_t off,
+                   const void *buffer, lfs_size_t size)
+{
+    auto m=reinterpret_cast<RamFlashMemory*>(c->context);
+    return m->prog(buffer,block*c->block_size+off,size) ? LFS_ERR_IO : 0;
+}
+
+static int simErase(const lfs_config *c, lfs_block_t block)
+{
+    auto m=reinterpret_cast<RamFlashMemory*>(c->context);
+    return m->erase(block,1) ? LFS_ERR_IO : 0;
+}
+
+static int simSync(const lfs_config *) { return 0; }
+static int simLock(const lfs_config *) { return 0; }
+
+static double elapsedMs(steady_clock::time_point start)
+{
+    return duration<double,milli>(steady_clock::now()-start).count();
+}
+
+static void fail(const char *what)
+{
+    printf("Failed: %s\n",what);
+    exit(1);
+}
+
+static void benchmark(const char *name, unsigned int blockSize)
+{
+    const unsigned int flashSize=1024*1024;
+    const unsigned int fileSize=16*1024;
+    const unsigned int chunkSize=512;
+    RamFlashMemory flash(blockSize,512,flashSize/blockSize);
+    lfs_config c={};
+    c.context=&flash;
+    c.read=simRead;
+    c.prog=simProg;
+    c.erase=simErase;
+    c.sync=simSync;
+    c.lock=simLock;
+    c.unlock=simLock;
+    c.read_size=512;
+    c.prog_size=512;
+    c.block_size=blockSize;
+    c.block_count=flashSize/blockSize;
+    c.block_cycles=500;
+    c.cache_size=512;
+    c.lookahead_size=min((c.block_count+63)/64*8,512u);
+    lfs_t lfs;
+    lfs_file_t file;
+    static unsigned char chunk[chunkSize];
+    memset(chunk,0x55,chunkSize);
+    printf("%s (%u byte blocks)\n",name,blockSize);
+
+    auto start=steady_clock::now();
+    if(lfs_format(&lfs,&c) || lfs_mount(&lfs,&c)) fail("format");
+    printf("  format+mount  %8.2fms\n",elapsedMs(start));
+
+    //Fill 3/4 of the flash with files
+    const int numFiles=flashSize*3/4/fileSize;
+    auto writeFile=[&](int i){
+        char fname[16];
+        snprintf(fname,sizeof(fname),"f%d",i);
+        if(lfs_file_open(&lfs,&file,fname,LFS_O_WRONLY|LFS_O_CREAT|LFS_O_TRUNC))
+            fail("open");
+        for(unsigned int j=0;j<fileSize;j+=chunkSize)
+            if(lfs_file_write(&lfs,&file,chunk,chunkSize)!=chunkSize)
+                fail("write");
+        if(lfs_file_close(&lfs,&file)) fail("close");
+    };
+    flash.resetStats();
+    start=steady_clock::now();
+    for(int i=0;i<numFiles;i++) writeFile(i);
+    double t=elapsedMs(start);
+    printf("  write         %8.2fms %6.0fKB/s, %u erases, %lluKB programmed\n",
+           t,numFiles*fileSize/t*1000/1024,flash.getStats().erases,
+           flash.getStats().bytesProgrammed/1024);
+
+    //Overwrite random files, so that garbage collection has to reclaim space
+    const int rewrites=4*numFiles;
+    srand(0);
+    flash.resetStats();
+    start=steady_clock::now();
+    for(int i=0;i<rewrites;i++) writeFile(rand()%numFiles);
+    t=elapsedMs(start);
+    unsigned int maxErase=0;
+    for(unsigned int i=0;i<flash.getGeometry().blockCount;i++)
+        maxErase=max(maxErase,flash.getEraseCount(i));
+    printf("  rewrite (GC)  %8.2fms %6.0fKB/s, %u erases, %lluKB programmed, "
+           "max %u erases per block\n",t,rewrites*fileSize/t*1000/1024,
+           flash.getStats().erases,flash.getStats().bytesProgrammed/1024,
+           maxErase);
+
+    if(lfs_unmount(&lfs)) fail("unmount");
+    start=steady_clock::now();
+    if(lfs_mount(&lfs,&c)) fail("mount");
+    printf("  mount         %8.2fms\n",elapsedMs(start));
+    lfs_unmount(&lfs);
+}
+
+int main()
+{
+    benchmark("Legacy geometry",512);
+    benchmark("Erase size geometry",4096);
+}
+
+#endif //TEST_ALGORITHM
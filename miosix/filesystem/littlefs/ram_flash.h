@@ -0,0 +1,209 @@
+/***************************************************************************
+ *   Copyright (C) 2024 by Terraneo Federico                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+#pragma once
+
+#include "filesystem/ioctl.h"
+#ifndef TEST_ALGORITHM
+#include "config/miosix_settings.h"
+#include "filesystem/devfs/devfs.h"
+#include "kernel/sync.h"
+#endif //TEST_ALGORITHM
+
+namespace miosix {
+
+/**
+ * Counters of the operations performed on a RamFlashMemory
+ */
+struct RamFlashStats
+{
+    unsigned int reads=0;                 ///< Read operations
+    unsigned int progs=0;                 ///< Program operations
+    unsigned int erases=0;                ///< Erase blocks erased
+    unsigned long long bytesRead=0;       ///< Bytes read
+    unsigned long long bytesProgrammed=0; ///< Bytes programmed
+};
+
+/**
+ * A NOR flash memory simulated in RAM, to test and benchmark flash filesystems
+ * without real hardware. As on a real flash, programming can only clear bits,
+ * and erasing sets a whole erase block to 0xff. The number of times each erase
+ * block is erased is tracked, to evaluate wear leveling.
+ *
+ * This class does not depend on the kernel so it can also be used on the host,
+ * RamFlash makes it available as a Device.
+ */
+class RamFlashMemory
+{
+public:
+    /**
+     * Constructor, the memory starts fully erased
+     * \param eraseSize erase block size in bytes
+     * \param progSize program size in bytes, must divide eraseSize
+     * \param blockCount number of erase blocks
+     */
+    RamFlashMemory(unsigned int eraseSize, unsigned int progSize,
+                   unsigned int blockCount);
+
+    /**
+     * Read data
+     * \param buffer read data is stored here
+     * \param addr address of the first byte to read
+     * \param size number of bytes to read
+     * \return 0 on success, or a negative number on failure
+     */
+    int read(void *buffer, unsigned int addr, unsigned int size);
+
+    /**
+     * Program data. Address and size must be multiples of the program size
+     * \param buffer data to program
+     * \param addr address of the first byte to program
+     * \param size number of bytes to program
+     * \return 0 on success, or a negative number on failure
+     */
+    int prog(const void *buffer, unsigned int addr, unsigned int size);
+
+    /**
+     * Erase blocks
+     * \param block first erase block
+     * \param count number of erase blocks
+     * \return 0 on success, or a negative number on failure
+     */
+    int erase(unsigned int block, unsigned int count);
+
+    /**
+     * \return the flash memory geometry
+     */
+    const FlashGeometry& getGeometry() const { return geometry; }
+
+    /**
+     * \return the flash memory size in bytes
+     */
+    unsigned int size() const { return geometry.eraseSize*geometry.blockCount; }
+
+    /**
+     * \param block an erase block
+     * \return the number of times the block has been erased
+     */
+    unsigned int getEraseCount(unsigned int block) const
+    {
+        return eraseCounts[block];
+    }
+
+    /**
+     * \return the operation counters
+     */
+    const RamFlashStats& getStats() const { return stats; }
+
+    /**
+     * Reset the operation counters, erase counts of blocks are not reset
+     */
+    void resetStats() { stats=RamFlashStats(); }
+
+    /**
+     * Destructor
+     */
+    ~RamFlashMemory();
+
+    RamFlashMemory(const RamFlashMemory&)=delete;
+    RamFlashMemory& operator=(const RamFlashMemory&)=delete;
+
+private:
+    FlashGeometry geometry;    ///< Flash memory geometry
+    unsigned char *data;       ///< Flash memory content
+    unsigned int *eraseCounts; ///< Times each block has been erased
+    RamFlashStats stats;       ///< Operation counters
+};
+
+#if defined(WITH_FILESYSTEM) && !defined(TEST_ALGORITHM)
+
+/**
+ * A block device backed by a RamFlashMemory. It supports IOCTL_GET_GEOMETRY
+ * and IOCTL_ERASE, so that LittleFS can be mounted on it with the same
+ * geometry it would use on a real flash memory, for example
+ * \code
+ * intrusive_ref_ptr<Device> flash(new RamFlash(4096,256,64));
+ * FilesystemManager::instance().getDevFs()->addDevice("flash",flash);
+ * \endcode
+ */
+class RamFlash : public Device
+{
+public:
+    /**
+     * Constructor, the memory starts fully erased
+     * \param eraseSize erase block size in bytes
+     * \param progSize program size in bytes, must divide eraseSize
+     * \param blockCount number of erase blocks
+     */
+    RamFlash(unsigned int eraseSize, unsigned int progSize,
+             unsigned int blockCount);
+
+    /**
+     * Read a block of data
+     * \param buffer buffer where read data will be stored
+     * \param size buffer size
+     * \param where where to read from
+     * \return number of bytes read or a negative number on failure
+     */
+    virtual ssize_t readBlock(void *buffer, size_t size, off_t where);
+
+    /**
+     * Program a block of data, which must have been erased
+     * \param buffer buffer where take data to write
+     * \param size buffer size
+     * \param where where to write to
+     * \return number of bytes written or a negative number on failure
+     */
+    virtual ssize_t writeBlock(const void *buffer, size_t size, off_t where);
+
+    /**
+     * Performs device-specific operations, IOCTL_GET_GEOMETRY, IOCTL_ERASE and
+     * IOCTL_SYNC are supported
+     * \param cmd specifies the operation to perform
+     * \param arg optional argument that some operation require
+     * \return 0 on success, or a negative number on failure
+     */
+    virtual int ioctl(int cmd, void *arg);
+
+    /**
+     * \return the operation counters
+     */
+    RamFlashStats getStats();
+
+    /**
+     * Reset the operation counters
+     */
+    void resetStats();
+
+private:
+    FastMutex mutex;
+    RamFlashMemory memory;
+};
+
+#endif //defined(WITH_FILESYSTEM) && !defined(TEST_ALGORITHM)
+
+} //namespace miosix
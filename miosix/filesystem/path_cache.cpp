@@ -0,0 +1,85 @@
+/***************************************************************************
+ *   Copyright (C) 2024 by Terraneo Federico                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+#include "path_cache.h"
+
+using namespace std;
+
+namespace miosix {
+
+#ifdef WITH_FILESYSTEM
+
+//
+// class PathCache
+//
+
+bool PathCache::lookup(string& path, bool followLastSymlink,
+                       intrusive_ref_ptr<FilesystemBase>& fs, size_t& off)
+{
+    if(maxSize==0) return false;
+    for(auto it=entries.begin();it!=entries.end();++it)
+    {
+        if(it->followLastSymlink!=followLastSymlink || it->path!=path) continue;
+        //Move to front, for LRU replacement
+        if(it!=entries.begin()) entries.splice(entries.begin(),entries,it);
+        path=it->resolved;
+        fs=it->fs;
+        off=it->off;
+        stats.hits++;
+        return true;
+    }
+    stats.misses++;
+    return false;
+}
+
+void PathCache::insert(const string& path, bool followLastSymlink,
+                       const string& resolved,
+                       intrusive_ref_ptr<FilesystemBase> fs, size_t off)
+{
+    unsigned int needed=entrySize(path,resolved);
+    if(needed>maxSize) return; //Also handles maxSize==0
+    while(size+needed>maxSize)
+    {
+        size-=entrySize(entries.back().path,entries.back().resolved);
+        entries.pop_back();
+        stats.evictions++;
+    }
+    entries.push_front(Entry{path,resolved,fs,off,followLastSymlink});
+    size+=needed;
+}
+
+void PathCache::invalidate()
+{
+    if(entries.empty()) return;
+    entries.clear();
+    size=0;
+    stats.invalidations++;
+}
+
+#endif //WITH_FILESYSTEM
+
+} //namespace miosix
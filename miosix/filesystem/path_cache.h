@@ -0,0 +1,158 @@
+/***************************************************************************
+ *   Copyright (C) 2024 by Terraneo Federico                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+#pragma once
+
+#include <list>
+#include <string>
+#include "filesystem/file.h"
+#include "config/miosix_settings.h"
+
+namespace miosix {
+
+#ifdef WITH_FILESYSTEM
+
+/**
+ * Statistics of a PathCache
+ */
+struct PathCacheStats
+{
+    unsigned int hits=0;          ///< Paths found in the cache
+    unsigned int misses=0;        ///< Paths not found in the cache
+    unsigned int evictions=0;     ///< Entries evicted to make room
+    unsigned int invalidations=0; ///< Times the cache has been cleared
+};
+
+/**
+ * A cache of path resolutions, used by FilesystemManager to skip walking the
+ * mountpoint map and looking up symlinks in every path component when the same
+ * paths are resolved over and over, as it happens with stat() and open() of
+ * configuration and log files.
+ *
+ * Entries map an absolute path, as passed to resolvePath(), to the resolved
+ * path, the filesystem it belongs to and the offset of the path relative to
+ * the filesystem. Only successful resolutions are cached. Entries are replaced
+ * with a least recently used policy, and the memory used by the cache is kept
+ * below a given size.
+ *
+ * Any operation that may change how a path resolves, such as mount, umount,
+ * unlink, rename, mkdir and rmdir, must call invalidate().
+ *
+ * This class is not thread safe, concurrent accesses must be serialized by the
+ * caller, as FilesystemManager already does.
+ */
+class PathCache
+{
+public:
+    /**
+     * Constructor
+     * \param maxSize maximum memory in bytes used by the cache entries,
+     * 0 disables caching
+     */
+    PathCache(unsigned int maxSize=FS_PATH_CACHE_SIZE) : maxSize(maxSize) {}
+
+    /**
+     * \return true if caching is enabled
+     */
+    bool enabled() const { return maxSize>0; }
+
+    /**
+     * Look up a path in the cache
+     * \param path absolute path to look up. If found, it is replaced with the
+     * resolved path
+     * \param followLastSymlink true if the last symlink has to be followed
+     * \param fs if found, the filesystem the path belongs to is stored here
+     * \param off if found, the offset into the resolved path where the
+     * subpath relative to the filesystem starts is stored here
+     * \return true if the path was found
+     */
+    bool lookup(std::string& path, bool followLastSymlink,
+                intrusive_ref_ptr<FilesystemBase>& fs, size_t& off);
+
+    /**
+     * Add a successful path resolution to the cache
+     * \param path absolute path as passed to resolvePath()
+     * \param followLastSymlink true if the last symlink has been followed
+     * \param resolved resolved path
+     * \param fs filesystem the path belongs to
+     * \param off offset into the resolved path where the subpath relative to
+     * the filesystem starts
+     */
+    void insert(const std::string& path, bool followLastSymlink,
+                const std::string& resolved,
+                intrusive_ref_ptr<FilesystemBase> fs, size_t off);
+
+    /**
+     * Remove all entries from the cache
+     */
+    void invalidate();
+
+    /**
+     * \return the cache statistics
+     */
+    const PathCacheStats& getStats() const { return stats; }
+
+    /**
+     * Reset the cache statistics
+     */
+    void resetStats() { stats=PathCacheStats(); }
+
+    PathCache(const PathCache&)=delete;
+    PathCache& operator=(const PathCache&)=delete;
+
+private:
+    /**
+     * A cache entry
+     */
+    struct Entry
+    {
+        std::string path;                      ///< Path before resolution
+        std::string resolved;                  ///< Path after resolution
+        intrusive_ref_ptr<FilesystemBase> fs;  ///< Filesystem of the path
+        size_t off;                            ///< Subpath offset into resolved
+        bool followLastSymlink;                ///< Lookup parameter
+    };
+
+    /**
+     * \return an estimate of the memory used by an entry, including the list
+     * node and the strings
+     */
+    static unsigned int entrySize(const std::string& path,
+                                  const std::string& resolved)
+    {
+        return sizeof(Entry)+2*sizeof(void*)+path.size()+resolved.size()+2;
+    }
+
+    std::list<Entry> entries;  ///< Most recently used first
+    unsigned int size=0;       ///< Memory used by the entries
+    unsigned int maxSize;      ///< Maximum memory used by the entries
+    PathCacheStats stats;      ///< Cache statistics
+};
+
+#endif //WITH_FILESYSTEM
+
+} //namespace miosix
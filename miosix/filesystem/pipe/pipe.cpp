@@ -27,6 +27,9 @@
 
 #include "pipe.h"
 #include <algorithm>
+#include <cstring>
+#include <climits>
+#include <new>
 
 using namespace std;
 
@@ -45,21 +48,46 @@ ssize_t Pipe::write(const void *data, size_t len)
     while(len>0)
     {
         if(unconnected()) return -EPIPE;
+        if(pendingRead && size==0)
+        {
+            //A reader is blocked on the empty pipe, copy straight into its
+            //buffer instead of going through the pipe buffer
+            int copied=min<int>(len,pendingRead->len);
+            memcpy(pendingRead->data,d,copied);
+            pendingRead->filled=copied;
+            pendingRead=nullptr;
+            readCv.broadcast();
+            d+=copied;
+            len-=copied;
+            written+=copied;
+            continue;
+        }
         int writable=min<int>(len,capacity-size);
-        //HACK: if the other end of the pipe is closed after we wait on the
-        //condition variable, we'll wait forever. To fix that, we set a timeout
-        if(writable==0) cv.timedWait(l,getTime()+pollTime);
-        else {
-            for(int i=0;i<writable;i++)
-            {
-                buffer[put]=d[i];
-                if(++put>=capacity) put=0;
-            }
+        if(writable==0)
+        {
+            //HACK: if the other end of the pipe is closed after we wait on the
+            //condition variable, we'll wait forever. To fix that, we set a
+            //timeout
+            writersWaiting++;
+            writeCv.timedWait(l,getTime()+pollTime);
+            writersWaiting--;
+        } else {
+            int first=min(writable,capacity-put);
+            memcpy(buffer+put,d,first);
+            memcpy(buffer,d+first,writable-first);
+            put+=writable;
+            if(put>=capacity) put-=capacity;
+            bool wasEmpty=size==0;
             size+=writable;
             d+=writable;
             len-=writable;
             written+=writable;
-            cv.broadcast();
+            //Readers and pollers only care about the pipe becoming non empty
+            if(wasEmpty)
+            {
+                readCv.broadcast();
+                pollQueue.wakeup();
+            }
         }
     }
     return written;
@@ -74,19 +102,37 @@ ssize_t Pipe::read(void *data, size_t len)
     {
         int readable=min<int>(len,size);
         if(unconnected() && readable==0) return 0;
-        //HACK: if the other end of the pipe is closed after we wait on the
-        //condition variable, we'll wait forever. To fix that, we set a timeout
-        if(readable==0) cv.timedWait(l,getTime()+pollTime);
-        else {
-            for(int i=0;i<readable;i++)
+        if(readable>0)
+        {
+            int first=min(readable,capacity-get);
+            memcpy(d,buffer+get,first);
+            memcpy(d+first,buffer,readable-first);
+            get+=readable;
+            if(get>=capacity) get-=capacity;
+            bool wasBelowWatermark=!aboveWriteWatermark();
+            size-=readable;
+            //Batch wakeups, writers and pollers are woken only once when
+            //enough space becomes available, not at every read
+            if(wasBelowWatermark && aboveWriteWatermark())
             {
-                d[i]=buffer[get];
-                if(++get>=capacity) get=0;
+                if(writersWaiting>0) writeCv.broadcast();
+                pollQueue.wakeup();
             }
-            size-=readable;
-            cv.broadcast();
             return readable;
         }
+        //The pipe is empty. If no other reader is doing it already, let
+        //writers fill our buffer directly
+        PendingRead pending={d,static_cast<int>(min<size_t>(len,INT_MAX)),0};
+        bool direct=pendingRead==nullptr;
+        if(direct) pendingRead=&pending;
+        //HACK: if the other end of the pipe is closed after we wait on the
+        //condition variable, we'll wait forever. To fix that, we set a timeout
+        readCv.timedWait(l,getTime()+pollTime);
+        if(direct)
+        {
+            if(pendingRead==&pending) pendingRead=nullptr;
+            if(pending.filled>0) return pending.filled;
+        }
     }
 }
 
@@ -106,10 +152,40 @@ int Pipe::fcntl(int cmd, int opt)
         case F_GETFD:
         case F_GETFL: //TODO: also return file access mode
             return O_RDWR;
+        case F_GETPIPE_SZ:
+        {
+            Lock<FastMutex> l(m);
+            return capacity;
+        }
+        case F_SETPIPE_SZ:
+        {
+            Lock<FastMutex> l(m);
+            return resize(opt);
+        }
     }
     return -EBADF;
 }
 
+int Pipe::poll(short events, PollEntry *entry)
+{
+    Lock<FastMutex> l(m);
+    pollQueue.add(entry);
+    int result=0;
+    if(size>0) result|=events & (POLLIN | POLLRDNORM);
+    if(size<capacity) result|=events & (POLLOUT | POLLWRNORM);
+    if(unconnected())
+    {
+        //Reading returns end of file, writing fails with EPIPE
+        result|=POLLHUP | (events & (POLLIN | POLLRDNORM));
+        if(events & (POLLOUT | POLLWRNORM)) result|=POLLERR;
+    } else if(entry && result==0) {
+        //HACK: we can't wake the poll queue when the other end of the pipe is
+        //closed, so ask the poller to check again after a timeout
+        entry->getWaiter()->requestRecheck(getTime()+pollTime);
+    }
+    return result;
+}
+
 Pipe::~Pipe() { delete[] buffer; }
 
 bool Pipe::unconnected()
@@ -127,6 +203,32 @@ bool Pipe::unconnected()
     return shared_from_this().use_count()<=3;
 }
 
+int Pipe::resize(int newCapacity)
+{
+    if(newCapacity>maxSize) return -EINVAL;
+    newCapacity=max(newCapacity,minSize);
+    if(newCapacity==capacity) return capacity;
+    if(newCapacity<size) return -EBUSY;
+    char *newBuffer=new (nothrow) char[newCapacity];
+    if(newBuffer==nullptr) return -ENOMEM;
+    //Move the data to the start of the new buffer
+    int first=min(size,capacity-get);
+    memcpy(newBuffer,buffer+get,first);
+    memcpy(newBuffer+first,buffer,size-first);
+    delete[] buffer;
+    buffer=newBuffer;
+    capacity=newCapacity;
+    get=0;
+    put=size<capacity ? size : 0;
+    //Growing the pipe may make room for blocked writers
+    if(aboveWriteWatermark())
+    {
+        if(writersWaiting>0) writeCv.broadcast();
+        pollQueue.wakeup();
+    }
+    return capacity;
+}
+
 } //namespace miosix
 
 #endif //WITH_FILESYSTEM
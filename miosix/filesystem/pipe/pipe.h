@@ -44,6 +44,12 @@ namespace miosix {
  * reference counting to both file descriptors, which can be used
  * interchangeably as read/write end. Code that uses those file descriptor in a
  * standard compliant way won't notice the difference.
+ *
+ * When a reader is blocked on an empty pipe, writers copy data straight into
+ * its buffer instead of going through the pipe buffer, saving one copy. Also,
+ * blocked writers are only woken when at least half of the pipe capacity is
+ * free, to batch wakeups when streaming data. The pipe capacity can be changed
+ * with fcntl(F_SETPIPE_SZ).
  */
 class Pipe : public FileBase
 {
@@ -96,13 +102,24 @@ public:
     virtual int fstat(struct stat *pstat) const;
 
     /**
-     * Perform various operations on a file descriptor
+     * Perform various operations on a file descriptor.
+     * In addition to F_GETFD and F_GETFL, F_GETPIPE_SZ and F_SETPIPE_SZ are
+     * supported to get and set the pipe capacity. Setting the capacity fails
+     * with EBUSY if the pipe contains more data than the new capacity.
      * \param cmd specifies the operation to perform
      * \param opt optional argument that some operation require
      * \return the exact return value depends on CMD, -1 is returned on error
      */
     virtual int fcntl(int cmd, int opt);
 
+    /**
+     * Check whether the pipe is ready for reading or writing
+     * \param events requested events, such as POLLIN or POLLOUT
+     * \param entry if not nullptr, registered in the pipe PollQueue
+     * \return the events that are currently ready
+     */
+    virtual int poll(short events, PollEntry *entry);
+
     /**
      * Destructor
      */
@@ -115,10 +132,39 @@ private:
      */
     bool unconnected();
 
+    /**
+     * Change the pipe capacity. Must be called with mutex locked
+     * \param newCapacity new capacity in bytes
+     * \return the new capacity, or a negative number on failure
+     */
+    int resize(int newCapacity);
+
+    /**
+     * \return true if blocked writers should be woken, as enough space is
+     * free in the pipe buffer. Must be called with mutex locked
+     */
+    bool aboveWriteWatermark() const { return capacity-size>=capacity/2; }
+
+    /**
+     * A reader blocked on an empty pipe, whose buffer writers fill directly
+     */
+    struct PendingRead
+    {
+        char *data;    ///< Reader buffer
+        int len;       ///< Reader buffer size
+        int filled;    ///< Bytes written by writers, zero if none yet
+    };
+
     static const int defaultSize=256;
+    static const int minSize=16;
+    static const int maxSize=65536;
     static const int pollTime=100000000; //100ms
     FastMutex m;
-    ConditionVariable cv;
+    ConditionVariable readCv;  ///< Readers waiting for data
+    ConditionVariable writeCv; ///< Writers waiting for space
+    PollQueue pollQueue;
+    PendingRead *pendingRead=nullptr; ///< Reader accepting direct writes
+    int writersWaiting=0;
     int put, get, size, capacity;
     char *buffer;
 };
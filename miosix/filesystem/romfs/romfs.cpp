@@ -34,6 +34,7 @@
 #include "interfaces/endianness.h"
 #include "util/util.h"
 #include "romfs_types.h"
+#include "romfs_lookup.h"
 
 #ifdef WITH_FILESYSTEM
 
@@ -41,6 +42,9 @@ using namespace std;
 
 namespace miosix {
 
+//The Linux simulator has no flash to append the image to, it maps the image
+//from a host file instead, see its bsp.cpp
+#ifndef _ARCH_LINUX_SIM
 const void *getRomFsAddressAfterKernel()
 {
     // We don't (yet) have a symbol marking the end of the kernel, but we can
@@ -63,6 +67,7 @@ const void *getRomFsAddressAfterKernel()
     #endif //WITH_ERRLOG
     return nullptr;
 }
+#endif //_ARCH_LINUX_SIM
 
 /**
  * Fill a struct stat
@@ -86,19 +91,6 @@ static void fillStatHelper(struct stat* pstat, const RomFsDirectoryEntry *entry,
     pstat->st_blocks=(pstat->st_size+512-1)/512;
 }
 
-/**
- * Compute address of next RomFsDirectoryEntry entry
- * \param entry current directory entry
- * \return pointer to next entry.
- * Note, if entry was the last one, the returned pointer is one past the last one
- */
-static const RomFsDirectoryEntry *nextEntry(const RomFsDirectoryEntry *entry)
-{
-    auto last=reinterpret_cast<unsigned int>(entry->name+strlen(entry->name)+1);
-    return reinterpret_cast<const RomFsDirectoryEntry *>(
-        (last+romFsStructAlignment-1) & (0-romFsStructAlignment));
-}
-
 /**
  * File class for MemoryMappedRomFs
  */
@@ -302,10 +294,15 @@ int MemoryMappedRomFsDirectory::getdents(void *dp, int len)
 //
 
 MemoryMappedRomFs::MemoryMappedRomFs(const void *baseAddress)
-    : base(reinterpret_cast<const char*>(baseAddress)), failed(false)
+    : base(reinterpret_cast<const char*>(baseAddress)), failed(false),
+      indexed(false)
 {
     auto header=ptr<const RomFsHeader*>(0);
-    if(strncmp(header->fsName,"RomFs 2.01",11)==0) return;
+    if(strncmp(header->fsName,"RomFs 2.01",11)==0)
+    {
+        indexed=fromLittleEndian32(header->flags) & romFsFlagDirectoryIndex;
+        return;
+    }
     errorLog("Unexpected FS version %s\n",header->fsName);
     failed=true;
 }
@@ -369,16 +366,8 @@ const RomFsDirectoryEntry *MemoryMappedRomFs::findEntry(StringPart& name)
     NormalizedPathWalker pw(name);
     while(auto element=pw.next())
     {
-        if((fromLittleEndian16(entry->mode) & S_IFMT)!=S_IFDIR) return nullptr;
-        unsigned int inode=fromLittleEndian32(entry->inode);
-        const void *end=ptr(inode+fromLittleEndian32(entry->size));
-        entry=ptr<const RomFsDirectoryEntry *>(inode+sizeof(RomFsFirstEntry));
-        while(entry<end)
-        {
-            if(strcmp(element->c_str(),entry->name)==0) break;
-            entry=nextEntry(entry);
-        }
-        if(entry>=end) return nullptr; //Not found
+        entry=romFsFindInDirectory(base,entry,element->c_str(),indexed);
+        if(entry==nullptr) return nullptr; //Not found, or not a directory
     }
     return entry;
 }
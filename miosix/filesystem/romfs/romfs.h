@@ -156,7 +156,8 @@ private:
     const RomFsDirectoryEntry *findEntry(StringPart& name);
 
     const char * const base;
-    bool failed; ///< Failed to mount
+    bool failed;  ///< Failed to mount
+    bool indexed; ///< Directories are followed by a RomFsDirectoryIndex
 };
 
 } //namespace miosix
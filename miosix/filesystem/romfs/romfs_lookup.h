@@ -0,0 +1,94 @@
+/***************************************************************************
+ *   Copyright (C) 2024 by Terraneo Federico                          *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+#pragma once
+
+#include <cstring>
+#include <cstdint>
+#include <sys/stat.h>
+#include "romfs_types.h"
+#include "interfaces/endianness.h"
+
+/*
+ * RomFs directory lookup, shared by MemoryMappedRomFs and the host tools that
+ * benchmark it. It only depends on the image layout, not on the kernel.
+ */
+
+/**
+ * Compute address of next RomFsDirectoryEntry entry
+ * \param entry current directory entry
+ * \return pointer to next entry.
+ * Note, if entry was the last one, the returned pointer is one past the last one
+ */
+inline const RomFsDirectoryEntry *romFsNextEntry(const RomFsDirectoryEntry *entry)
+{
+    auto last=reinterpret_cast<uintptr_t>(entry->name+strlen(entry->name)+1);
+    return reinterpret_cast<const RomFsDirectoryEntry *>(
+        (last+romFsStructAlignment-1) & ~uintptr_t(romFsStructAlignment-1));
+}
+
+/**
+ * Look up an entry in a directory
+ * \param base filesystem image start
+ * \param dir directory entry of the directory to search
+ * \param name name of the entry to look for
+ * \param indexed true if the image has the romFsFlagDirectoryIndex flag set,
+ * in which case the directory index is used for a binary search
+ * \return corresponding entry if found, or nullptr. Also returns nullptr if
+ * dir is not a directory
+ */
+inline const RomFsDirectoryEntry *romFsFindInDirectory(const char *base,
+        const RomFsDirectoryEntry *dir, const char *name, bool indexed)
+{
+    if((fromLittleEndian16(dir->mode) & S_IFMT)!=S_IFDIR) return nullptr;
+    unsigned int inode=fromLittleEndian32(dir->inode);
+    unsigned int size=fromLittleEndian32(dir->size);
+    if(indexed)
+    {
+        unsigned int indexOffset=inode+size;
+        indexOffset=(indexOffset+romFsStructAlignment-1) & (0-romFsStructAlignment);
+        auto index=reinterpret_cast<const RomFsDirectoryIndex *>(base+indexOffset);
+        //Binary search, entries in the index are sorted by strcmp
+        unsigned int lo=0, hi=fromLittleEndian32(index->count);
+        while(lo<hi)
+        {
+            unsigned int mid=lo+(hi-lo)/2;
+            auto entry=reinterpret_cast<const RomFsDirectoryEntry *>(
+                base+fromLittleEndian32(index->offsets[mid]));
+            int cmp=strcmp(name,entry->name);
+            if(cmp==0) return entry;
+            if(cmp<0) hi=mid; else lo=mid+1;
+        }
+        return nullptr;
+    }
+    auto end=reinterpret_cast<const RomFsDirectoryEntry *>(base+inode+size);
+    auto entry=reinterpret_cast<const RomFsDirectoryEntry *>(
+        base+inode+sizeof(RomFsFirstEntry));
+    for(;entry<end;entry=romFsNextEntry(entry))
+        if(strcmp(name,entry->name)==0) return entry;
+    return nullptr;
+}
@@ -38,7 +38,7 @@ struct RomFsHeader
     char fsName[11];           ///< "RomFs 2.00", null terminated
     char osName[7];            ///< "Miosix", null terminated
     unsigned int imageSize;    ///< Size of the entire filesystem image
-    unsigned int unused;       ///< Reserved for future use, set as 0 for now
+    unsigned int flags;        ///< Optional features, see romFsFlag* constants
 };
 
 /**
@@ -61,6 +61,24 @@ struct __attribute__((packed)) RomFsDirectoryEntry
     char name[];              ///< File name, null teminated
 };
 
+/**
+ * Optional directory index, present only if the romFsFlagDirectoryIndex flag
+ * is set in the header. It is placed right after the directory inode, at the
+ * first romFsStructAlignment aligned offset after inode+size, so it is not
+ * part of the directory size and images with an index remain readable by
+ * implementations that ignore it.
+ */
+struct RomFsDirectoryIndex
+{
+    unsigned int count;       ///< Number of directory entries
+    /// Offsets from the image start of the directory entries, sorted by name
+    /// as in strcmp, allowing to look up an entry with a binary search
+    unsigned int offsets[];
+};
+
+/// Header flag, each directory inode is followed by a RomFsDirectoryIndex
+const unsigned int romFsFlagDirectoryIndex=1<<0;
+
 /// Alignment of all filesystem data structures. Must be a power of 2. Chosen as
 /// 4 bytes for compatibility to architectures without unaligned memory accesses
 const unsigned int romFsStructAlignment=4;
@@ -78,3 +96,4 @@ static_assert(romFsImageAlignment>=romFsStructAlignment,"");
 static_assert(sizeof(RomFsHeader)==32,"");
 static_assert(sizeof(RomFsFirstEntry)==4,"");
 static_assert(sizeof(RomFsDirectoryEntry)==14,"");
+static_assert(sizeof(RomFsDirectoryIndex)==4,"");
@@ -166,6 +166,8 @@ inline void *atomicFetchAndIncrement(void * const volatile * p, int offset,
 #elif defined(_ARCH_CORTEXM0_STM32F0) || defined(_ARCH_CORTEXM0PLUS_STM32L0) \
    || defined(_ARCH_CORTEXM0PLUS_RP2040)
 #include "core/atomic_ops_impl_cortexM0.h"
+#elif defined(_ARCH_LINUX_SIM)
+#include "core/atomic_ops_impl_x86.h"
 #else
 #error "No atomic ops for this architecture"
 #endif
@@ -30,6 +30,8 @@
 #include "config/miosix_settings.h"
 #include "kernel/timeconversion.h"
 #include "kernel/scheduler/timer_interrupt.h"
+#include "kernel/latency_stats.h"
+#include "kernel/trace.h"
 
 /**
  * \addtogroup Interfaces
@@ -311,12 +313,21 @@ public:
      */
     inline void IRQhandler()
     {
+        #ifdef WITH_KERNEL_TRACE
+        KernelTrace::IRQrecord(TraceEventType::IrqEnter,traceOsTimerIrq,0,0);
+        #endif //WITH_KERNEL_TRACE
         if(D::IRQgetMatchFlag() || lateIrq)
         {
             D::IRQclearMatchFlag();
             long long tick=IRQgetTimeTick();
             if(tick >= IRQgetIrqTick() || lateIrq)
             {
+                #ifdef WITH_LATENCY_STATS
+                //A late irq is forced pending as the deadline had already
+                //passed when it was set, its delay is not interrupt latency
+                if(!lateIrq) LatencyStats::IRQtimerLatency(tc.tick2ns(tick)
+                    -tc.tick2ns(IRQgetIrqTick()-quirkAdvance));
+                #endif //WITH_LATENCY_STATS
                 lateIrq=false;
                 #ifndef WITH_RTC_AS_OS_TIMER
                 IRQtimerInterrupt(tc.tick2ns(tick));
@@ -336,6 +347,9 @@ public:
             D::IRQclearOverflowFlag();
             upperTimeTick += upperIncr;
         }
+        #ifdef WITH_KERNEL_TRACE
+        KernelTrace::IRQrecord(TraceEventType::IrqExit,traceOsTimerIrq,0,0);
+        #endif //WITH_KERNEL_TRACE
     }
     
     /**
@@ -0,0 +1,100 @@
+/***************************************************************************
+ *   Copyright (C) 2024 by Terraneo Federico                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+#pragma once
+
+#if defined(_ARCH_CORTEXM3_STM32F1) || defined(_ARCH_CORTEXM3_STM32F2) \
+ || defined(_ARCH_CORTEXM4_STM32F4) || defined(_ARCH_CORTEXM3_STM32L1) \
+ || defined(_ARCH_CORTEXM7_STM32F7) || defined(_ARCH_CORTEXM7_STM32H7) \
+ || defined(_ARCH_CORTEXM3_EFM32GG) || defined(_ARCH_CORTEXM4_STM32F3) \
+ || defined(_ARCH_CORTEXM4_STM32L4) || defined(_ARCH_CORTEXM4_ATSAM4L) \
+ || defined(_ARCH_CORTEXM3_EFM32G)
+#include "interfaces/arch_registers.h"
+#define CYCLE_COUNTER_DWT
+#endif
+
+namespace miosix {
+
+// Can't include os_timer.h as it would cause an include loop
+long long IRQgetTime() noexcept;
+
+/**
+ * \internal
+ * A cheap 32 bit timestamp for kernel instrumentation, such as LatencyStats
+ * and KernelTrace. It is the DWT cycle counter on Cortex-M3 and later cores,
+ * and the lower 32 bits of IRQgetTime() on architectures lacking it.
+ * Timestamps wrap around, so only differences between close enough
+ * timestamps are meaningful.
+ */
+class CycleCounter
+{
+public:
+    /**
+     * Start the cycle counter, if used. Called by the kernel at boot
+     */
+    static inline void IRQinit()
+    {
+        #ifdef CYCLE_COUNTER_DWT
+        CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+        #if defined(_ARCH_CORTEXM7_STM32F7) || defined(_ARCH_CORTEXM7_STM32H7)
+        DWT->LAR=0xc5acce55; //The Cortex-M7 DWT is write protected after reset
+        #endif
+        DWT->CYCCNT=0;
+        DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+        #endif //CYCLE_COUNTER_DWT
+    }
+
+    /**
+     * \return the current timestamp. Can be called with interrupts disabled
+     * or within an interrupt
+     */
+    static inline unsigned int IRQget()
+    {
+        #ifdef CYCLE_COUNTER_DWT
+        return DWT->CYCCNT;
+        #else //CYCLE_COUNTER_DWT
+        return static_cast<unsigned int>(IRQgetTime());
+        #endif //CYCLE_COUNTER_DWT
+    }
+
+    /**
+     * \return the unit of timestamps, "cycles" or "ns"
+     */
+    static const char *unit()
+    {
+        #ifdef CYCLE_COUNTER_DWT
+        return "cycles";
+        #else //CYCLE_COUNTER_DWT
+        return "ns";
+        #endif //CYCLE_COUNTER_DWT
+    }
+
+private:
+    CycleCounter()=delete;
+};
+
+} //namespace miosix
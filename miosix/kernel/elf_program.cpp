@@ -33,6 +33,7 @@
 #include <cstring>
 #include <cstdio>
 #include <memory>
+#include <vector>
 
 using namespace std;
 
@@ -48,39 +49,80 @@ namespace miosix {
 static const unsigned int DATA_BASE=0x40000000;
 
 /**
- * Cache of programs loaded in RAM, to allow sharing memory for the code part
- * of loaded programs
+ * Relocated copy of the .data section of a program. Allows to initialize the
+ * .data of a new process image with a single copy, followed at most by the
+ * relocation of the pointers to .data if the image is at a different address
+ */
+class DataTemplate
+{
+public:
+    unique_ptr<unsigned int[]> data; ///< .data, relocated for ramBase
+    unsigned int size;               ///< Size of .data in bytes
+    unsigned int ramBase;            ///< Image address data is relocated for
+    vector<unsigned int> dataRelocs; ///< Word offsets of pointers to .data
+};
+
+/**
+ * Cache of running programs. Allows to share memory for the code part of
+ * programs loaded in RAM, and to share the relocated .data among all the
+ * instances of a program
  */
 class ProgramCache
 {
 public:
     /**
-     * Load a program
+     * Load a program. On success, a call to unload is required when the
+     * program is no longer needed
      * \param name file name
      * \param elf, if the load was successful, the pointer to the memory region
      * where the program is loaded is stored here
      * \param size, if the loa was successful, the memory region size in bytes
      * (despite the pointer is to unsigned in) is stored here
-     * \param needUnload if true, the requested program is in a non-XIP capable
-     * filesystem, so it was needed to load it in RAM and a call to unload is
-     * required to unload the program when no longer needed. If false, the
+     * \param copiedInRam if true, the requested program is in a non-XIP
+     * capable filesystem, so it was needed to load it in RAM. If false, the
      * requested program is in a XIP capable filesystem, so the pointer returned
-     * is to a memory area that does not need unloading, and calling unload is
-     * not required.
+     * is to the filesystem memory
      * \return 0 on success, an error code on error
      */
     static int load(const char *name, const unsigned int *& elf,
-             unsigned int& size, bool& needUnload);
+             unsigned int& size, bool& copiedInRam);
 
     /**
-     * Unload a program that was loaded in RAM
+     * Unload a program
      * \param elf pointer to the program to unload
      */
     static void unload(const unsigned int *elf);
 
+    /**
+     * Initialize the .data of a process image from the cached template of a
+     * program, creating the template the first time
+     * \param elf pointer to the program, as returned by load
+     * \param image process image
+     * \param dataSegment data segment of the program
+     * \param rel relocation table of the program
+     * \param relSize number of entries in the relocation table
+     * \return false if the program has no template, and the caller has to
+     * copy and relocate .data
+     */
+    static bool copyData(const unsigned int *elf, unsigned int *image,
+            const Elf32_Phdr *dataSegment, const Elf32_Rel *rel, int relSize);
+
 private:
     /**
-     * An entry into the cache of programs loaded in RAM
+     * Create the relocated .data template for a program
+     * \param elf pointer to the program
+     * \param image process image to relocate for
+     * \param dataSegment data segment of the program
+     * \param rel relocation table of the program
+     * \param relSize number of entries in the relocation table
+     * \return the template, or nullptr if the program can't have a template
+     */
+    static DataTemplate *createTemplate(const unsigned int *elf,
+            unsigned int *image, const Elf32_Phdr *dataSegment,
+            const Elf32_Rel *rel, int relSize);
+
+    /**
+     * An entry into the cache of running programs
      */
     class Entry
     {
@@ -89,16 +131,22 @@ private:
          * Constructor
          * \param inode inode of file on disk, used as key
          * \param device filesystem id, used as key
-         * \param elf pointer to the program RAM allocated memory region
-         * \param size memory region size
+         * \param elf pointer to the program
+         * \param size program size
+         * \param copiedInRam true if elf is allocated in the process pool
          */
-        Entry(ino_t inode, dev_t device, unsigned int *elf, unsigned int size)
-            : inode(inode), device(device), elf(elf), size(size), useCount(1) {}
+        Entry(ino_t inode, dev_t device, const unsigned int *elf,
+              unsigned int size, bool copiedInRam) : inode(inode),
+              device(device), elf(elf), size(size), useCount(1),
+              copiedInRam(copiedInRam), noTemplate(false) {}
         ino_t inode;
         dev_t device;
-        unsigned int *elf;
+        const unsigned int *elf;
         unsigned int size;
         int useCount; ///< Used for reference counting the cache entry
+        bool copiedInRam; ///< True if elf is allocated in the process pool
+        bool noTemplate; ///< True if the program can't have a DataTemplate
+        unique_ptr<DataTemplate> dataTemplate; ///< Created by the first spawn
     };
 
     static FastMutex m; ///< Protect programs against concurrent accesses
@@ -109,7 +157,7 @@ private:
 // class ProgramCache
 //
 int ProgramCache::load(const char *name, const unsigned int *& elf,
-                       unsigned int& size, bool& needUnload)
+                       unsigned int& size, bool& copiedInRam)
 {
     if(name==nullptr || name[0]=='\0') return -EFAULT;
     string path=getFileDescriptorTable().absolutePath(name);
@@ -119,16 +167,6 @@ int ProgramCache::load(const char *name, const unsigned int *& elf,
     StringPart relativePath(path,string::npos,openData.off);
     intrusive_ref_ptr<FileBase> file;
     if(int res=openData.fs->open(file,relativePath,O_RDONLY,0)) return res;
-    MemoryMappedFile mmFile=file->getFileFromMemory();
-    //Program is in a XIP-capable filesystem, pass the pointer directly
-    if(mmFile.isValid())
-    {
-        elf=reinterpret_cast<const unsigned int*>(mmFile.data);
-        size=mmFile.size;
-        needUnload=false;
-        DBG("ProgramCache::load(%s): found %p in XIP fs\n",name,elf);
-        return 0;
-    }
     //Search program in cache
     //NOTE: if the program is modified on disk in a way that the inode does not
     //change and at least one instance of the program is running, subsequent
@@ -150,11 +188,22 @@ int ProgramCache::load(const char *name, const unsigned int *& elf,
         p.useCount++;
         elf=p.elf;
         size=p.size;
-        needUnload=true;
+        copiedInRam=p.copiedInRam;
         DBG("ProgramCache::load(%s): found %p in cache use count %d\n",
             name,elf,p.useCount);
         return 0;
     }
+    MemoryMappedFile mmFile=file->getFileFromMemory();
+    //Program is in a XIP-capable filesystem, pass the pointer directly
+    if(mmFile.isValid())
+    {
+        elf=reinterpret_cast<const unsigned int*>(mmFile.data);
+        size=mmFile.size;
+        copiedInRam=false;
+        programs.push_front(Entry(s.st_ino,s.st_dev,elf,size,false));
+        DBG("ProgramCache::load(%s): found %p in XIP fs\n",name,elf);
+        return 0;
+    }
     //Not found, load program in cache
     //Seek to the end to get file size, then seek back to the start
     off_t fileSize=file->lseek(0,SEEK_END);
@@ -175,10 +224,10 @@ int ProgramCache::load(const char *name, const unsigned int *& elf,
     //Zero the eventual slack size
     memset(reinterpret_cast<unsigned char*>(ramPointer)+fileSize,0,ramSize-fileSize);
     //Success
-    programs.push_front(Entry(s.st_ino,s.st_dev,ramPointer,ramSize));
+    programs.push_front(Entry(s.st_ino,s.st_dev,ramPointer,ramSize,true));
     elf=ramPointer;
     size=ramSize;
-    needUnload=true;
+    copiedInRam=true;
     finalizer.release();
     DBG("ProgramCache::load(%s): added %p in cache\n",name,elf);
     return 0;
@@ -194,7 +243,8 @@ void ProgramCache::unload(const unsigned int *elf)
         if(--it->useCount<=0)
         {
             DBG("ProgramCache::unload(%p): deallocate\n",elf);
-            ProcessPool::instance().deallocate(it->elf);
+            if(it->copiedInRam)
+                ProcessPool::instance().deallocate(const_cast<unsigned int*>(elf));
             programs.erase(it);
         }
         return;
@@ -202,6 +252,75 @@ void ProgramCache::unload(const unsigned int *elf)
     DBG("ProgramCache::unload(%p): bug: not in cache\n",elf);
 }
 
+bool ProgramCache::copyData(const unsigned int *elf, unsigned int *image,
+        const Elf32_Phdr *dataSegment, const Elf32_Rel *rel, int relSize)
+{
+    Lock<FastMutex> l(m);
+    for(auto& p : programs)
+    {
+        if(p.elf!=elf) continue;
+        if(p.noTemplate) return false;
+        if(!p.dataTemplate)
+        {
+            try {
+                p.dataTemplate.reset(createTemplate(elf,image,dataSegment,
+                                                    rel,relSize));
+            } catch(bad_alloc&) {
+                return false; //Retry at the next spawn
+            }
+            if(!p.dataTemplate)
+            {
+                p.noTemplate=true;
+                return false;
+            }
+        }
+        DataTemplate *t=p.dataTemplate.get();
+        memcpy(image,t->data.get(),t->size);
+        const unsigned int ramBase=reinterpret_cast<unsigned int>(image);
+        if(ramBase!=t->ramBase)
+        {
+            const unsigned int delta=ramBase-t->ramBase;
+            for(auto offset : t->dataRelocs) image[offset]+=delta;
+        }
+        return true;
+    }
+    return false; //Not loaded from a file, no cache entry
+}
+
+DataTemplate *ProgramCache::createTemplate(const unsigned int *elf,
+        unsigned int *image, const Elf32_Phdr *dataSegment,
+        const Elf32_Rel *rel, int relSize)
+{
+    const unsigned int base=reinterpret_cast<unsigned int>(elf);
+    const unsigned int ramBase=reinterpret_cast<unsigned int>(image);
+    const unsigned int size=dataSegment->p_filesz;
+    //Relocations in .bss would require the template to include .bss, just
+    //don't use a template for such programs
+    for(int i=0;i<relSize;i++)
+    {
+        if(ELF32_R_TYPE(rel[i].r_info)!=R_ARM_RELATIVE) continue;
+        if(rel[i].r_offset-DATA_BASE+4>size) return nullptr;
+    }
+    unique_ptr<DataTemplate> t(new DataTemplate);
+    t->size=size;
+    t->ramBase=ramBase;
+    t->data.reset(new unsigned int[(size+3)/4]);
+    unsigned int *data=t->data.get();
+    memcpy(data,reinterpret_cast<const char*>(base+dataSegment->p_offset),size);
+    for(int i=0;i<relSize;i++,rel++)
+    {
+        if(ELF32_R_TYPE(rel->r_info)!=R_ARM_RELATIVE) continue;
+        unsigned int offset=(rel->r_offset-DATA_BASE)/4;
+        if(data[offset]>=DATA_BASE)
+        {
+            data[offset]+=ramBase-DATA_BASE;
+            t->dataRelocs.push_back(offset);
+        } else data[offset]+=base;
+    }
+    t->dataRelocs.shrink_to_fit();
+    return t.release();
+}
+
 FastMutex ProgramCache::m;
 list<ProgramCache::Entry> ProgramCache::programs;
 
@@ -210,10 +329,13 @@ list<ProgramCache::Entry> ProgramCache::programs;
 //
 
 ElfProgram::ElfProgram(const char *name)
-    : elf(nullptr), size(0), ec(-ENOEXEC), copiedInRam(false)
+    : elf(nullptr), size(0), ec(-ENOEXEC), copiedInRam(false), cached(false)
 {
     if(int ec=ProgramCache::load(name,elf,size,copiedInRam)) this->ec=ec;
-    else validateHeader();
+    else {
+        cached=true;
+        validateHeader();
+    }
 }
 
 void ElfProgram::validateHeader()
@@ -474,23 +596,25 @@ bool ElfProgram::validateDynamicSegment(const Elf32_Phdr *dynamic,
 ElfProgram& ElfProgram::operator= (ElfProgram&& rhs)
 {
     //Deallocate *this if needed
-    if(copiedInRam) ProgramCache::unload(elf);
+    if(cached) ProgramCache::unload(elf);
     //Move rhs fields into *this
     elf=rhs.elf;
     size=rhs.size;
     ec=rhs.ec;
     copiedInRam=rhs.copiedInRam;
+    cached=rhs.cached;
     //Invalidate rhs
     rhs.elf=nullptr;
     rhs.size=0;
     rhs.ec=-ENOEXEC;
     rhs.copiedInRam=false;
+    rhs.cached=false;
     return *this;
 }
 
 ElfProgram::~ElfProgram()
 {
-    if(copiedInRam) ProgramCache::unload(elf);
+    if(cached) ProgramCache::unload(elf);
 }
 
 //
@@ -548,10 +672,18 @@ void ProcessImage::load(const ElfProgram& program)
                 break;
         }
     }
-    const char *dataSegmentInFile=
-        reinterpret_cast<const char*>(base+dataSegment->p_offset);
+    const Elf32_Rel *rel=reinterpret_cast<const Elf32_Rel*>(base+dtRel);
+    const int relSize=hasRelocs ? dtRelsz/sizeof(Elf32_Rel) : 0;
+    //Programs loaded from a file have a cached, already relocated .data
+    bool relocated=ProgramCache::copyData(
+        reinterpret_cast<const unsigned int*>(base),image,dataSegment,rel,relSize);
+    if(relocated==false)
+    {
+        const char *dataSegmentInFile=
+            reinterpret_cast<const char*>(base+dataSegment->p_offset);
+        memcpy(image,dataSegmentInFile,dataSegment->p_filesz);
+    }
     char *dataSegmentInMem=reinterpret_cast<char*>(image);
-    memcpy(dataSegmentInMem,dataSegmentInFile,dataSegment->p_filesz);
     dataSegmentInMem+=dataSegment->p_filesz;
     //Zero only .bss section (faster but processes leak data to other processes)
     //memset(dataSegmentInMem,0,dataSegment->p_memsz-dataSegment->p_filesz);
@@ -562,10 +694,8 @@ void ProcessImage::load(const ElfProgram& program)
     //MAX_PROCESS_ARGS_BLOCK_SIZE bytes into the stack
     memset(dataSegmentInMem,0,size-dataSegment->p_filesz-mainStackSize-WATERMARK_LEN);
     dataBssSize=dataSegment->p_memsz;
-    if(hasRelocs)
+    if(relocated==false)
     {
-        const Elf32_Rel *rel=reinterpret_cast<const Elf32_Rel*>(base+dtRel);
-        const int relSize=dtRelsz/sizeof(Elf32_Rel);
         const unsigned int ramBase=reinterpret_cast<unsigned int>(image);
         //DBG("Relocations -- start (code base @0x%x, data base @ 0x%x)\n",base,ramBase);
         for(int i=0;i<relSize;i++,rel++)
@@ -45,7 +45,8 @@ public:
     /**
      * Default constructor
      */
-    ElfProgram() : elf(nullptr), size(0), ec(-ENOEXEC), copiedInRam(false) {}
+    ElfProgram() : elf(nullptr), size(0), ec(-ENOEXEC), copiedInRam(false),
+        cached(false) {}
 
     /**
      * Constructor from file.
@@ -78,7 +79,8 @@ public:
      * content of the elf file
      */
     ElfProgram(const unsigned int *elf, unsigned int size)
-        : elf(elf), size(size), ec(-ENOEXEC), copiedInRam(false)
+        : elf(elf), size(size), ec(-ENOEXEC), copiedInRam(false),
+          cached(false)
     {
         validateHeader();
     }
@@ -189,7 +191,8 @@ private:
     const unsigned int *elf; ///<Pointer to the content of the elf file
     unsigned int size;  ///< Size in bytes of the elf file
     int ec;             ///< Error code
-    bool copiedInRam;   ///< If true, elf is allocated in RAM and *this owns it
+    bool copiedInRam;   ///< If true, elf is allocated in RAM
+    bool cached;        ///< If true, *this holds a reference to a cached program
 };
 
 /**
@@ -820,7 +820,9 @@ public:
      */
     bool removeFast(T *item)
     {
-        if(item->prev==nullptr && IntrusiveListBase::front()!=item) return false;
+        //Qualified as T may also derive from other classes with a prev field
+        if(item->IntrusiveListItem::prev==nullptr &&
+           IntrusiveListBase::front()!=item) return false;
         IntrusiveListBase::erase(item);
         return true;
     }
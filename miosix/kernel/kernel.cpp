@@ -44,6 +44,7 @@
 #include <reent.h>
 #include "interfaces/deep_sleep.h"
 #include "core/interrupts.h"
+#include "timer.h"
 
 /*
  * Used by assembler context switch macros
@@ -65,7 +66,11 @@ volatile Thread *runningThread=nullptr;///<\internal Thread currently running
 ///\internal True if there are threads in the DELETED status. Used by idle thread
 static volatile bool existDeleted=false;
 
-IntrusiveList<SleepData> sleepingList;///list of sleeping threads
+SleepQueue<SleepData> sleepingList;///list of sleeping threads
+
+#ifdef WITH_TIMER_SLACK
+static TimerSlackStats timerSlackStats={0,0,0,0};///<\internal Wakeup counters
+#endif //WITH_TIMER_SLACK
 
 ///\internal !=0 after pauseKernel(), ==0 after restartKernel()
 volatile int kernelRunning=0;
@@ -121,10 +126,13 @@ void *idleThread(void *argv)
             {
                 if(sleepingList.empty()==false)
                 {
-                    long long wakeup=sleepingList.front()->wakeupTime;
+                    long long wakeup=sleepingList.nextWakeupTime();
                     sleep=!IRQdeepSleep(wakeup);
                 } else sleep=!IRQdeepSleep();
             } else sleep=true;
+            #ifdef WITH_TIMER_SLACK
+            timerSlackStats.idleSleeps++;
+            #endif //WITH_TIMER_SLACK
             //NOTE: going to sleep with interrupts disabled makes sure no
             //preemption occurs from when we take the decision to sleep till
             //we actually do sleep. Wakeup interrupt will be run when we enable
@@ -132,6 +140,9 @@ void *idleThread(void *argv)
             if(sleep) miosix_private::sleepCpu();
         }
         #else //WITH_DEEP_SLEEP
+        #ifdef WITH_TIMER_SLACK
+        timerSlackStats.idleSleeps++;
+        #endif //WITH_TIMER_SLACK
         miosix_private::sleepCpu();
         #endif //WITH_DEEP_SLEEP
         
@@ -255,6 +266,13 @@ void startKernel()
     // Make the C standard library use per-thread reeentrancy structure
     setCReentrancyCallback(Thread::getCReent);
     
+    #if defined(WITH_LATENCY_STATS) || defined(WITH_KERNEL_TRACE)
+    CycleCounter::IRQinit();
+    #endif //WITH_LATENCY_STATS || WITH_KERNEL_TRACE
+    #ifdef WITH_KERNEL_TRACE
+    KernelTrace::IRQinit();
+    #endif //WITH_KERNEL_TRACE
+
     // Dispatch the task to the architecture-specific function
     kernelStarted=true;
     miosix_private::IRQportableStartKernel();
@@ -265,6 +283,14 @@ bool isKernelRunning()
     return (kernelRunning==0) && kernelStarted;
 }
 
+#ifdef WITH_TIMER_SLACK
+TimerSlackStats getTimerSlackStats()
+{
+    FastInterruptDisableLock dLock;
+    return timerSlackStats;
+}
+#endif //WITH_TIMER_SLACK
+
 //These are not implemented here, but in the platform/board-specific os_timer.
 //long long getTime() noexcept
 //long long IRQgetTime() noexcept
@@ -273,19 +299,13 @@ bool isKernelRunning()
  * \internal
  * Used by Thread::sleep() and pthread_cond_timedwait() to add a thread to
  * sleeping list. The list is sorted by the wakeupTime field to reduce time
- * required to wake threads during context switch.
+ * required to wake threads during context switch. The data structure used is
+ * selected in miosix_settings.h
  * Interrupts must be disabled prior to calling this function.
  */
 static void IRQaddToSleepingList(SleepData *x)
 {
-    if(sleepingList.empty() || sleepingList.front()->wakeupTime>=x->wakeupTime)
-    {
-        sleepingList.push_front(x);
-    } else {
-        auto it=sleepingList.begin();
-        while(it!=sleepingList.end() && (*it)->wakeupTime<x->wakeupTime) ++it;
-        sleepingList.insert(it,x);
-    }
+    sleepingList.insert(x);
 }
 
 /**
@@ -297,19 +317,44 @@ static void IRQaddToSleepingList(SleepData *x)
  */
 bool IRQwakeThreads(long long currentTime)
 {
-    if(sleepingList.empty()) return false; //If no item in list, return
-    
     bool result=false;
+    #ifdef WITH_TIMER_SLACK
+    long long prevWakeupTime=-1;
+    #endif //WITH_TIMER_SLACK
     //Since list is sorted, if we don't need to wake the first element
     //we don't need to wake the other too
-    for(auto it=sleepingList.begin();it!=sleepingList.end();)
+    while(sleepingList.empty()==false)
     {
-        if(currentTime<(*it)->wakeupTime) break;
+        SleepData *d=sleepingList.front();
+        #ifndef WITH_TIMER_SLACK
+        if(currentTime<d->wakeupTime) break;
+        #else //WITH_TIMER_SLACK
+        //The list is sorted by deadline, so this may stop at a thread that
+        //is not yet due while a later one with a larger slack is. That thread
+        //is just woken later, but still within its own slack window
+        if(currentTime<d->earliestWakeupTime) break;
+        timerSlackStats.wakeups++;
+        if(prevWakeupTime<0) timerSlackStats.batches++;
+        if(currentTime<d->wakeupTime && d->earliestWakeupTime!=prevWakeupTime)
+            timerSlackStats.avoidedIrqs++;
+        prevWakeupTime=d->earliestWakeupTime;
+        #endif //WITH_TIMER_SLACK
+        sleepingList.pop_front();
+        #ifdef WITH_TIMERS
+        if(d->thread==nullptr)
+        {
+            //Not a sleeping thread but a Timer, that may be reinserted
+            if(Timer::IRQexpire(d,currentTime)) result=true;
+            continue;
+        }
+        #endif //WITH_TIMERS
         //Wake both threads doing absoluteSleep() and timedWait()
-        (*it)->thread->flags.IRQclearSleepAndWait();
-        if(const_cast<Thread*>(runningThread)->IRQgetPriority()<(*it)->thread->IRQgetPriority())
+        d->thread->flags.IRQclearSleepAndWait();
+        #ifdef WITH_LATENCY_STATS
+        if(d->thread!=runningThread) LatencyStats::IRQthreadWoken(d->thread);
+        #endif //WITH_LATENCY_STATS
+        if(const_cast<Thread*>(runningThread)->IRQgetPriority()<d->thread->IRQgetPriority())
             result=true;
-        it=sleepingList.erase(it);
     }
     return result;
 }
@@ -464,6 +509,10 @@ void Thread::PKwakeup()
 
 void Thread::IRQwakeup()
 {
+    #ifdef WITH_LATENCY_STATS
+    if(this!=runningThread && flags.isWaiting())
+        LatencyStats::IRQthreadWoken(this);
+    #endif //WITH_LATENCY_STATS
     this->flags.IRQsetWait(false);
 }
 
@@ -520,7 +569,7 @@ void Thread::setPriority(Priority pr)
         while(walk!=nullptr)
         {
             if(walk->waiting.empty()==false)
-                pr=std::max(pr,walk->waiting.front()->PKgetPriority());
+                pr=std::max(pr,walk->waiting.front()->thread->PKgetPriority());
             walk=walk->next;
         }
     }
@@ -533,6 +582,19 @@ void Thread::setPriority(Priority pr)
     #endif //SCHED_TYPE_EDF
 }
 
+#ifdef WITH_TIMER_SLACK
+void Thread::setTimerSlack(unsigned int ns)
+{
+    //Only read by the thread itself when it goes to sleep, no lock needed
+    const_cast<Thread*>(runningThread)->timerSlack=ns;
+}
+
+unsigned int Thread::getTimerSlack()
+{
+    return const_cast<Thread*>(runningThread)->timerSlack;
+}
+#endif //WITH_TIMER_SLACK
+
 void Thread::terminate()
 {
     //doing a read-modify-write operation on this->status, so pauseKernel is
@@ -541,6 +603,13 @@ void Thread::terminate()
     if(this->flags.isDeleting()) return; //Prevent sleep interruption abuse
     this->flags.IRQsetDeleting();
     this->flags.IRQclearSleepAndWait(); //Interruptibility
+    #ifdef WITH_PROCESSES
+    //A thread preempted while running userspace code would only notice at its
+    //next syscall, which may never come. Make it resume in kernelspace as if
+    //it had just made a syscall, the caller of switchToUserspace() checks
+    //testTerminate() before serving it
+    if(this!=runningThread) this->flags.IRQsetUserspace(false);
+    #endif //WITH_PROCESSES
 }
 
 bool Thread::testTerminate()
@@ -742,6 +811,21 @@ void Thread::setupUserspaceContext(unsigned int entry, int argc, void *argvSp,
         argc,argvSp,envp,gotBase,runningThread->userWatermark);
 }
 
+void Thread::setupUserspaceThreadContext(unsigned int entry, void *arg,
+    unsigned int *stackBase, unsigned int stackSize, unsigned int *gotBase)
+{
+    //Fill watermark and stack
+    char *base=reinterpret_cast<char*>(stackBase);
+    memset(base, WATERMARK_FILL, WATERMARK_LEN);
+    memset(base+WATERMARK_LEN, STACK_FILL, stackSize-WATERMARK_LEN);
+    userWatermark=stackBase;
+    //Initialize registers. The stack is full descending, so the initial stack
+    //pointer is one past its end. The environment is only passed to main()
+    void *(*startfunc)(void*)=reinterpret_cast<void *(*)(void*)>(entry);
+    miosix_private::initCtxsave(userCtxsave,startfunc,
+        reinterpret_cast<int>(arg),base+stackSize,nullptr,gotBase,userWatermark);
+}
+
 #endif //WITH_PROCESSES
 
 Thread::Thread(unsigned int *watermark, unsigned int stacksize,
@@ -920,24 +1004,37 @@ struct _reent *Thread::getCReent()
 
 void Thread::ThreadFlags::IRQsetWait(bool waiting)
 {
+    #ifdef WITH_KERNEL_TRACE
+    IRQtraceWaitChange(waiting,WAIT);
+    #endif //WITH_KERNEL_TRACE
     if(waiting) flags |= WAIT; else flags &= ~WAIT;
     Scheduler::IRQwaitStatusHook(this->t);
 }
 
 void Thread::ThreadFlags::IRQsetSleep()
 {
+    #ifdef WITH_KERNEL_TRACE
+    KernelTrace::IRQrecord(TraceEventType::Sleep,0,
+        reinterpret_cast<unsigned int>(t),0);
+    #endif //WITH_KERNEL_TRACE
     flags |= SLEEP;
     Scheduler::IRQwaitStatusHook(this->t);
 }
 
 void Thread::ThreadFlags::IRQclearSleepAndWait()
 {
+    #ifdef WITH_KERNEL_TRACE
+    IRQtraceWaitChange(false,WAIT | SLEEP);
+    #endif //WITH_KERNEL_TRACE
     flags &= ~(WAIT | SLEEP);
     Scheduler::IRQwaitStatusHook(this->t);
 }
 
 void Thread::ThreadFlags::IRQsetJoinWait(bool waiting)
 {
+    #ifdef WITH_KERNEL_TRACE
+    IRQtraceWaitChange(waiting,WAIT_JOIN);
+    #endif //WITH_KERNEL_TRACE
     if(waiting) flags |= WAIT_JOIN; else flags &= ~WAIT_JOIN;
     Scheduler::IRQwaitStatusHook(this->t);
 }
@@ -948,4 +1045,17 @@ void Thread::ThreadFlags::IRQsetDeleted()
     Scheduler::IRQwaitStatusHook(this->t);
 }
 
+#ifdef WITH_KERNEL_TRACE
+void Thread::ThreadFlags::IRQtraceWaitChange(bool waiting, unsigned int mask)
+{
+    //Only trace actual changes, as wakeup() can be called on running threads
+    if(waiting && (flags & mask)==0)
+        KernelTrace::IRQrecord(TraceEventType::Wait,0,
+            reinterpret_cast<unsigned int>(t),0);
+    else if(!waiting && (flags & mask)!=0)
+        KernelTrace::IRQrecord(TraceEventType::Wakeup,0,
+            reinterpret_cast<unsigned int>(t),0);
+}
+#endif //WITH_KERNEL_TRACE
+
 } //namespace miosix
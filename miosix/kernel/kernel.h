@@ -32,6 +32,7 @@
 #include "kernel/scheduler/sched_types.h"
 #include "stdlib_integration/libstdcpp_integration.h"
 #include "intrusive.h"
+#include "sleep_queue.h"
 #include "cpu_time_counter_types.h"
 
 /**
@@ -425,6 +426,34 @@ long long getTime() noexcept;
  */
 long long IRQgetTime() noexcept;
 
+#ifdef WITH_TIMER_SLACK
+/**
+ * Counters of the wakeups of sleeping threads, used to evaluate the
+ * effectiveness of timer slack. All counters start at zero at boot and wrap
+ * around on overflow, so take the difference of two samples.
+ */
+struct TimerSlackStats
+{
+    /// Threads woken because their sleep or timed wait expired, including
+    /// expired Timers if WITH_TIMERS is defined
+    unsigned int wakeups;
+    /// Times the kernel woke at least one sleeping thread. Each batch is
+    /// served by a single timer interrupt or context switch
+    unsigned int batches;
+    /// Wakeups served before their deadline within the same batch of a
+    /// thread with a different wakeup time. Without timer slack each of these
+    /// would have required a separate timer interrupt
+    unsigned int avoidedIrqs;
+    /// Times the idle thread put the CPU to sleep
+    unsigned int idleSleeps;
+};
+
+/**
+ * \return the timer slack statistics
+ */
+TimerSlackStats getTimerSlackStats();
+#endif //WITH_TIMER_SLACK
+
 /**
  * Possible return values of timedWait
  */
@@ -824,6 +853,25 @@ public:
      */
     static void setPriority(Priority pr);
 
+    #ifdef WITH_TIMER_SLACK
+    /**
+     * Set the timer slack of the current thread, similar to Linux
+     * PR_SET_TIMERSLACK. Subsequent calls to sleep(), nanoSleepUntil() and
+     * timedWait() of this thread may return up to slack nanoseconds later than
+     * requested, so that the kernel can wake it together with other threads
+     * using a single timer interrupt. Useful for low priority periodic threads
+     * to reduce the number of exits from deep sleep.
+     * Threads are created with a slack of DEFAULT_TIMER_SLACK.
+     * \param ns timer slack in nanoseconds, 0 for exact wakeups
+     */
+    static void setTimerSlack(unsigned int ns);
+
+    /**
+     * \return the timer slack of the current thread in nanoseconds
+     */
+    static unsigned int getTimerSlack();
+    #endif //WITH_TIMER_SLACK
+
     /**
      * Suggests a thread to terminate itself. Note that this method only makes
      * testTerminate() return true on the specified thread. If the thread does
@@ -1081,6 +1129,16 @@ private:
         ///\internal Thread is running in userspace
         static const unsigned int USERSPACE=1<<6;
 
+        #ifdef WITH_KERNEL_TRACE
+        /**
+         * \internal
+         * Record a Wait or Wakeup trace event if the flags in mask change
+         * \param waiting true if the flags are being set
+         * \param mask flags being set or cleared
+         */
+        void IRQtraceWaitChange(bool waiting, unsigned int mask);
+        #endif //WITH_KERNEL_TRACE
+
         Thread* t; ///<\internal pointer to the thread to which the flags belong
         unsigned char flags;///<\internal flags are stored here
     };
@@ -1120,6 +1178,21 @@ private:
      */
     static void setupUserspaceContext(unsigned int entry, int argc, void *argvSp,
         void *envp, unsigned int *gotBase, unsigned int stackSize);
+
+    /**
+     * Setup the userspace context of a thread created with createUserspace()
+     * to run an additional thread of an already running process. Must be
+     * called before the thread is started with wakeup()
+     * \param entry userspace entry point
+     * \param arg argument passed to the entry point
+     * \param stackBase lowest address of the userspace stack, where the
+     * watermark is placed
+     * \param stackSize size of the userspace stack, including the watermark
+     * \param gotBase base address of the GOT, also corresponding to the start
+     * of the RAM image of the process
+     */
+    void setupUserspaceThreadContext(unsigned int entry, void *arg,
+        unsigned int *stackBase, unsigned int stackSize, unsigned int *gotBase);
     
     #endif //WITH_PROCESSES
 
@@ -1230,7 +1303,16 @@ private:
     #ifdef WITH_CPU_TIME_COUNTER
     CPUTimeCounterPrivateThreadData timeCounterData;
     #endif //WITH_CPU_TIME_COUNTER
-    
+    #ifdef WITH_LATENCY_STATS
+    ///Timestamp of the last wakeup, zero if the thread has not been woken
+    ///since it was last selected by the scheduler
+    unsigned int wakeupStamp=0;
+    #endif //WITH_LATENCY_STATS
+    #ifdef WITH_TIMER_SLACK
+    ///How late in ns the thread accepts to be woken after a sleep
+    unsigned int timerSlack=DEFAULT_TIMER_SLACK;
+    #endif //WITH_TIMER_SLACK
+
     //friend functions
     //Needs access to flags
     friend bool IRQwakeThreads(long long);
@@ -1257,6 +1339,14 @@ private:
     //Needs access to timeCounterData
     friend class CPUTimeCounter;
     #endif //WITH_CPU_TIME_COUNTER
+    #ifdef WITH_LATENCY_STATS
+    //Needs access to wakeupStamp
+    friend class LatencyStats;
+    #endif //WITH_LATENCY_STATS
+    #ifdef WITH_TIMER_SLACK
+    //Needs access to timerSlack
+    friend class SleepData;
+    #endif //WITH_TIMER_SLACK
 };
 
 /**
@@ -1264,18 +1354,44 @@ private:
  * This class is used to make a list of sleeping threads.
  * It is used by the kernel, and should not be used by end users.
  */
-class SleepData : public IntrusiveListItem
+class SleepData : public SleepQueueItem
 {
 public:
+    #ifndef WITH_TIMER_SLACK
+    SleepData(Thread *thread, long long wakeupTime)
+        : SleepQueueItem(wakeupTime), thread(thread) {}
+    #else //WITH_TIMER_SLACK
+    /**
+     * With timer slack the queue is sorted by the latest acceptable wakeup
+     * time, so that the OS timer is programmed for the first deadline, while
+     * the requested time is kept in earliestWakeupTime. When the timer fires,
+     * all threads whose earliestWakeupTime has passed are woken together.
+     */
     SleepData(Thread *thread, long long wakeupTime)
-        : thread(thread), wakeupTime(wakeupTime) {}
+        : SleepQueueItem(wakeupTime>std::numeric_limits<long long>::max()-
+          thread->timerSlack ? std::numeric_limits<long long>::max() :
+          wakeupTime+thread->timerSlack),
+          thread(thread), earliestWakeupTime(wakeupTime) {}
+    #endif //WITH_TIMER_SLACK
 
-    ///\internal Thread that is sleeping
+    #ifdef WITH_TIMERS
+    /**
+     * Constructor for items that are not sleeping threads, such as Timer.
+     * The wakeup time is set when the item is inserted in the queue
+     */
+    SleepData() : SleepQueueItem(0), thread(nullptr)
+    #ifdef WITH_TIMER_SLACK
+        , earliestWakeupTime(0)
+    #endif //WITH_TIMER_SLACK
+    {}
+    #endif //WITH_TIMERS
+
+    ///\internal Thread that is sleeping, nullptr for a Timer
     Thread *thread;
-    
-    ///\internal When this number becomes equal to the kernel tick,
-    ///the thread will wake
-    long long wakeupTime;
+    #ifdef WITH_TIMER_SLACK
+    ///\internal Time requested by the thread, wakeupTime minus the slack
+    long long earliestWakeupTime;
+    #endif //WITH_TIMER_SLACK
 };
 
 /**
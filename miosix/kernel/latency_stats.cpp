@@ -0,0 +1,214 @@
+/***************************************************************************
+ *   Copyright (C) 2024 by Terraneo Federico                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+#include "latency_stats.h"
+#include "kernel/kernel.h"
+#include "interfaces/os_timer.h"
+
+#ifdef WITH_LATENCY_STATS
+
+#include <algorithm>
+
+#ifdef WITH_DEVFS
+#include <cstdio>
+#include <cstring>
+#include <errno.h>
+#include "filesystem/devfs/devfs.h"
+#endif //WITH_DEVFS
+
+using namespace std;
+
+namespace miosix {
+
+extern volatile Thread *runningThread;
+
+LatencyStats::Data LatencyStats::data[LatencyStats::NUM_KINDS];
+volatile unsigned int LatencyStats::sequence=0;
+volatile unsigned int LatencyStats::generation=0;
+
+void LatencyStats::get(Kind kind, Histogram& h)
+{
+    const Data& d=data[kind];
+    unsigned int seq;
+    do {
+        seq=sequence;
+        h.count=d.count;
+        h.min=d.min;
+        h.max=d.max;
+        for(unsigned int i=0;i<numBuckets;i++) h.bucket[i]=d.bucket[i];
+        h.generation=generation;
+    } while(seq!=sequence);
+}
+
+void LatencyStats::reset()
+{
+    FastInterruptDisableLock dLock;
+    for(auto& d : data)
+    {
+        d.count=d.min=d.max=0;
+        for(unsigned int i=0;i<numBuckets;i++) d.bucket[i]=0;
+    }
+    generation=generation+1;
+    sequence=sequence+1;
+}
+
+const char *LatencyStats::name(Kind kind)
+{
+    static const char *names[]={"irq_entry","wakeup_to_run","context_switch"};
+    return names[kind];
+}
+
+const char *LatencyStats::unit(Kind kind)
+{
+    return kind==IRQ_ENTRY ? "ns" : CycleCounter::unit();
+}
+
+void LatencyStats::IRQtimerLatency(long long ns)
+{
+    if(ns<0) ns=0;
+    if(ns>0xffffffffLL) ns=0xffffffffLL;
+    IRQaddSample(IRQ_ENTRY,static_cast<unsigned int>(ns));
+}
+
+void LatencyStats::IRQthreadWoken(Thread *thread)
+{
+    //Zero means not woken, a timestamp of zero is off by one cycle at most
+    unsigned int stamp=CycleCounter::IRQget();
+    thread->wakeupStamp=stamp!=0 ? stamp : 1;
+}
+
+void LatencyStats::IRQthreadScheduled(Thread *prev, unsigned int start)
+{
+    Thread *next=const_cast<Thread*>(runningThread);
+    if(next==prev) return;
+    unsigned int now=CycleCounter::IRQget();
+    IRQaddSample(CONTEXT_SWITCH,now-start);
+    if(next->wakeupStamp==0) return;
+    IRQaddSample(WAKEUP_TO_RUN,now-next->wakeupStamp);
+    next->wakeupStamp=0;
+}
+
+void LatencyStats::IRQaddSample(Kind kind, unsigned int value)
+{
+    Data& d=data[kind];
+    if(d.count==0 || value<d.min) d.min=value;
+    if(value>d.max) d.max=value;
+    unsigned int i=value==0 ? 0 : 32-__builtin_clz(value);
+    d.bucket[min(i,numBuckets-1)]++;
+    d.count++;
+    sequence=sequence+1;
+}
+
+#ifdef WITH_DEVFS
+
+/**
+ * \internal
+ * The /dev/kstat device. Every line has the same length so that the file
+ * can be read in chunks, even if the values change between reads
+ */
+class KstatDevice : public Device
+{
+public:
+    KstatDevice() : Device(Device::BLOCK) {}
+
+    ssize_t readBlock(void *buffer, size_t size, off_t where) override;
+
+    ssize_t writeBlock(const void *buffer, size_t size, off_t where) override;
+
+private:
+    /**
+     * Format a line
+     * \param line buffer of at least lineSize+1 bytes
+     * \param i 0 for the header line, or a histogram index plus one
+     */
+    static void formatLine(char *line, int i);
+
+    /// Name and unit columns, then count, min, max and the buckets
+    static const int lineSize=14+7+11*(3+LatencyStats::numBuckets)+1;
+    static const int numLines=LatencyStats::NUM_KINDS+1;
+};
+
+ssize_t KstatDevice::readBlock(void *buffer, size_t size, off_t where)
+{
+    if(where<0) return -EINVAL;
+    char *dest=reinterpret_cast<char*>(buffer);
+    char line[lineSize+1];
+    size_t result=0;
+    while(result<size && where<lineSize*numLines)
+    {
+        int i=where/lineSize;
+        int offset=where%lineSize;
+        formatLine(line,i);
+        size_t len=min<size_t>(lineSize-offset,size-result);
+        memcpy(dest+result,line+offset,len);
+        result+=len;
+        where+=len;
+    }
+    return result;
+}
+
+ssize_t KstatDevice::writeBlock(const void *buffer, size_t size, off_t where)
+{
+    LatencyStats::reset();
+    return size;
+}
+
+void KstatDevice::formatLine(char *line, int i)
+{
+    char *p=line;
+    if(i==0)
+    {
+        p+=siprintf(p,"%-14s %-6s %10s %10s %10s","#name","unit",
+                    "count","min","max");
+        for(unsigned int j=0;j<LatencyStats::numBuckets;j++)
+        {
+            char label[8];
+            siprintf(label,"b%u",j);
+            p+=siprintf(p," %10s",label);
+        }
+    } else {
+        auto kind=static_cast<LatencyStats::Kind>(i-1);
+        LatencyStats::Histogram h;
+        LatencyStats::get(kind,h);
+        p+=siprintf(p,"%-14s %-6s %10u %10u %10u",LatencyStats::name(kind),
+                    LatencyStats::unit(kind),h.count,h.min,h.max);
+        for(unsigned int j=0;j<LatencyStats::numBuckets;j++)
+            p+=siprintf(p," %10u",h.bucket[j]);
+    }
+    *p='\n';
+}
+
+Device *LatencyStats::createDevice()
+{
+    return new KstatDevice;
+}
+
+#endif //WITH_DEVFS
+
+} //namespace miosix
+
+#endif //WITH_LATENCY_STATS
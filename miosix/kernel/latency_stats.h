@@ -0,0 +1,197 @@
+/***************************************************************************
+ *   Copyright (C) 2024 by Terraneo Federico                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+#pragma once
+
+#include "config/miosix_settings.h"
+
+#ifdef WITH_LATENCY_STATS
+
+#include "kernel/cycle_counter.h"
+
+namespace miosix {
+
+class Thread;
+class Device;
+
+/**
+ * \addtogroup Kernel
+ * \{
+ */
+
+/**
+ * LatencyStats collects log2 histograms of the latencies the kernel adds on
+ * the path from an interrupt to a thread. It is intended for sizing control
+ * loops, and is enabled only if the symbol `WITH_LATENCY_STATS` has been
+ * defined in config/miosix_settings.h.
+ *
+ * Three histograms are kept:
+ *  - IRQ_ENTRY: delay between the deadline of the os timer and the moment
+ *    its interrupt handler reads the timer, in nanoseconds. The resolution is
+ *    that of the os timer.
+ *  - WAKEUP_TO_RUN: delay between a thread being woken, either by
+ *    Thread::IRQwakeup() or by the end of a sleep, and the scheduler selecting
+ *    it to run.
+ *  - CONTEXT_SWITCH: time spent in Scheduler::IRQfindNextThread() when it
+ *    selects a different thread. The register save and restore done by the
+ *    interrupt entry and exit code is not included.
+ *
+ * The last two are measured with CycleCounter, in CPU cycles on Cortex-M3 and
+ * later cores, and in nanoseconds on other architectures. Use unit() to know
+ * which applies. Timestamps are 32 bit, so latencies longer than 2^32 units
+ * are reported modulo 2^32.
+ *
+ * Bucket 0 of a histogram counts zero latencies, while bucket i counts
+ * latencies in the range [2^(i-1), 2^i), except for the last bucket that also
+ * counts all larger latencies.
+ *
+ * Histograms are only updated from interrupt context or with interrupts
+ * disabled, and get() reads them without disabling interrupts, retrying if
+ * an update occurred meanwhile.
+ *
+ * \note For a periodic printout, see miosix::LatencyProfiler. The same data
+ * is also available as text from /dev/kstat if DevFs is enabled.
+ */
+class LatencyStats
+{
+public:
+    /// The latencies being measured
+    enum Kind
+    {
+        IRQ_ENTRY=0,    ///< Os timer deadline to timer interrupt
+        WAKEUP_TO_RUN,  ///< Thread wakeup to thread selected by the scheduler
+        CONTEXT_SWITCH, ///< Time taken to select and switch to a new thread
+        NUM_KINDS
+    };
+
+    /// Number of buckets of each histogram
+    static const unsigned int numBuckets=32;
+
+    /**
+     * A snapshot of a latency histogram
+     */
+    struct Histogram
+    {
+        unsigned int count;               ///< Number of samples
+        unsigned int min;                 ///< Minimum latency, 0 if no samples
+        unsigned int max;                 ///< Maximum latency
+        unsigned int bucket[numBuckets];  ///< log2 buckets
+        /// Number of reset() calls before the snapshot was taken, two
+        /// snapshots can be subtracted only if their generation is the same
+        unsigned int generation;
+    };
+
+    /**
+     * Read a histogram. Can be called from any context, including with
+     * interrupts disabled.
+     * \param kind the histogram to read
+     * \param h the histogram will be copied here
+     */
+    static void get(Kind kind, Histogram& h);
+
+    /**
+     * Clear all histograms
+     */
+    static void reset();
+
+    /**
+     * \param kind a histogram
+     * \return its name, as shown in /dev/kstat
+     */
+    static const char *name(Kind kind);
+
+    /**
+     * \param kind a histogram
+     * \return the unit of the latencies it contains, "ns" or "cycles"
+     */
+    static const char *unit(Kind kind);
+
+    /**
+     * \internal
+     * Called by the os timer interrupt when a deadline expired
+     * \param ns how late the interrupt ran with respect to the deadline
+     */
+    static void IRQtimerLatency(long long ns);
+
+    /**
+     * \internal
+     * Called when a thread is woken, marks the start of its wakeup latency
+     * \param thread the woken thread, must not be the running one
+     */
+    static void IRQthreadWoken(Thread *thread);
+
+    /**
+     * \internal
+     * Called after Scheduler::IRQfindNextThread()
+     * \param prev thread that was running before the call
+     * \param start CycleCounter::IRQget() before the call
+     */
+    static void IRQthreadScheduled(Thread *prev, unsigned int start);
+
+    #ifdef WITH_DEVFS
+    /**
+     * \internal
+     * \return the /dev/kstat device, allocated with new. The device reads
+     * one fixed width text line per histogram, and writing anything to it
+     * resets them
+     */
+    static Device *createDevice();
+    #endif //WITH_DEVFS
+
+private:
+    LatencyStats()=delete;
+
+    /**
+     * Add a sample to a histogram
+     * \param kind the histogram
+     * \param value the latency
+     */
+    static void IRQaddSample(Kind kind, unsigned int value);
+
+    /// Histogram data, updated with interrupts disabled
+    struct Data
+    {
+        volatile unsigned int count;
+        volatile unsigned int min;
+        volatile unsigned int max;
+        volatile unsigned int bucket[numBuckets];
+    };
+
+    static Data data[NUM_KINDS];
+    /// Incremented on every update, allows get() to detect concurrent updates
+    static volatile unsigned int sequence;
+    /// Incremented by reset()
+    static volatile unsigned int generation;
+};
+
+/**
+ * \}
+ */
+
+} //namespace miosix
+
+#endif //WITH_LATENCY_STATS
@@ -34,13 +34,17 @@
 #include <sys/wait.h>
 #include <sys/types.h>
 #include <unistd.h>
-#include <fcntl.h>
+#include "libsyscalls/include/fcntl.h"
 #include <signal.h>
+#include "libsyscalls/include/sys/shm.h"
 #include <limits.h>
+#include <limits>
 
 #include "sync.h"
 #include "process_pool.h"
+#include "shared_memory.h"
 #include "process.h"
+#include "trace.h"
 
 using namespace std;
 
@@ -85,6 +89,61 @@ static int validateStringArray(MPUConfiguration& mpu, char* const* a)
     }
 }
 
+/**
+ * Perform a readv or writev on behalf of a process. The iovec array is in
+ * process memory, where other threads of the same process can modify it while
+ * the syscall is in progress, so it is copied in kernel memory in small
+ * batches and only the copy is validated and passed to the filesystem code.
+ * Batches are small as this runs on the kernel-side stack of the thread.
+ * \param mpu mpu object knowing the valid memory regions for the current process
+ * \param fileTable file descriptor table of the current process
+ * \param fd file descriptor
+ * \param uiov iovec array in process memory
+ * \param iovcnt number of elements in uiov
+ * \param write true for writev, false for readv
+ * \return the number of bytes transferred or a negative error code. If an
+ * error occurs after some data has been transferred, the number of bytes
+ * transferred until then is returned
+ */
+static ssize_t processVectoredIo(MPUConfiguration& mpu,
+        FileDescriptorTable& fileTable, int fd, struct iovec *uiov, int iovcnt,
+        bool write)
+{
+    if(iovcnt<0 || iovcnt>IOV_MAX) return -EINVAL;
+    if(!aligned(uiov) || !mpu.withinForReading(uiov,iovcnt*sizeof(struct iovec)))
+        return -EFAULT;
+    const int batchSize=8;
+    struct iovec iov[batchSize];
+    //Zero buffers still need to report errors such as a bad file descriptor
+    if(iovcnt==0) return write ? fileTable.writev(fd,iov,0)
+                               : fileTable.readv(fd,iov,0);
+    ssize_t total=0;
+    for(int i=0;i<iovcnt;i+=batchSize)
+    {
+        int n=min(batchSize,iovcnt-i);
+        memcpy(iov,uiov+i,n*sizeof(struct iovec));
+        size_t requested=0;
+        size_t available=numeric_limits<ssize_t>::max()-total;
+        for(int j=0;j<n;j++)
+        {
+            if(iov[j].iov_len==0) continue;
+            bool ok=write ? mpu.withinForReading(iov[j].iov_base,iov[j].iov_len)
+                          : mpu.withinForWriting(iov[j].iov_base,iov[j].iov_len);
+            if(ok==false) return total>0 ? total : -EFAULT;
+            if(iov[j].iov_len>available-requested)
+                return total>0 ? total : -EINVAL;
+            requested+=iov[j].iov_len;
+        }
+        ssize_t result=write ? fileTable.writev(fd,iov,n)
+                             : fileTable.readv(fd,iov,n);
+        if(result<0) return total>0 ? total : result;
+        total+=result;
+        //Short transfer, the next batch would not be contiguous with this one
+        if(static_cast<size_t>(result)<requested) break;
+    }
+    return total;
+}
+
 /**
  * This class contains information on all the processes in the system
  */
@@ -148,11 +207,8 @@ pid_t Process::create(ElfProgram&& program, ArgsBlock&& args)
         parent->childs.remove(proc.get());
         throw runtime_error("Thread creation failed");
     }
-    //Cannot throw bad_alloc due to the reserve in Process's constructor.
-    //This ensures we will never be in the uncomfortable situation where a
-    //thread has already been created but there's no memory to list it
-    //among the threads of a process
-    proc->threads.push_back(thr);
+    proc->threads[0].thread=thr;
+    proc->threads[0].used=true;
     thr->wakeup(); //Actually start the thread, now that everything is set up
     pid_t result=proc->pid;
     proc.release(); //Do not delete the pointer
@@ -241,11 +297,11 @@ pid_t Process::waitpid(pid_t pid, int* exit, int options)
 Process::~Process() {}
 
 Process::Process(const FileDescriptorTable& fdt, ElfProgram&& program,
-        ArgsBlock&& args) : ProcessBase(fdt), waitCount(0), zombie(false)
+        ArgsBlock&& args) : ProcessBase(fdt), liveThreads(0),
+        syscallsInProgress(0), shmBase(nullptr),
+        mappedBase(nullptr),
+        waitCount(0), zombie(false)
 {
-    //This is required so that bad_alloc can never be thrown when the first
-    //thread of the process will be stored in this vector
-    threads.reserve(1);
     load(std::move(program),std::move(args));
 }
 
@@ -302,27 +358,28 @@ void *Process::start(void *)
             miosix_private::SyscallParameters sp=Thread::switchToUserspace();
 
             bool fault=proc->fault.faultHappened();
-            //Handle svc only if no fault occurred
-            if(fault==false) svcResult=proc->handleSvc(sp);
+            //Handle svc only if no fault occurred. If another thread of the
+            //process terminated this one while in userspace there is no svc
+            if(fault==false && Thread::testTerminate()==false)
+            {
+                atomicAdd(&proc->syscallsInProgress,1);
+                svcResult=proc->handleSvc(sp);
+                atomicAdd(&proc->syscallsInProgress,-1);
+            }
 
             if(Thread::testTerminate() || svcResult==Exit) running=false;
             if(fault || svcResult==Segfault)
             {
                 running=false;
                 proc->exitCode=SIGSEGV; //Segfault
-                #ifdef WITH_ERRLOG
-                iprintf("Process %d terminated due to a fault\n"
-                        "* Code base address was 0x%x\n"
-                        "* Data base address was %p\n",proc->pid,
-                        proc->program.getElfBase(),
-                        proc->image.getProcessBasePointer());
-                proc->mpu.dumpConfiguration();
-                if(fault) proc->fault.print();
-                #endif //WITH_ERRLOG
+                proc->printFault(fault);
             }
         } while(running && svcResult!=Execve);
         if(svcResult==Execve) proc->fileTable.cloexec();
     } while(running);
+    proc->terminateOtherThreads();
+    proc->detachSharedMemory();
+    proc->unmapFile();
     proc->fileTable.closeAll();
     {
         Processes& p=Processes::instance();
@@ -347,8 +404,210 @@ void *Process::start(void *)
     return nullptr;
 }
 
+void *Process::threadStart(void *)
+{
+    //This function is never called with a kernel thread, so the cast is safe
+    Process *proc=static_cast<Process*>(Thread::getCurrentThread()->proc);
+    int tid=proc->getTid();
+    for(;;)
+    {
+        miosix_private::SyscallParameters sp=Thread::switchToUserspace();
+        //The main thread terminates this one when the process exits
+        if(Thread::testTerminate()) break;
+        bool fault=proc->fault.faultHappened();
+        SvcResult svcResult=Segfault;
+        if(fault==false)
+        {
+            atomicAdd(&proc->syscallsInProgress,1);
+            svcResult=proc->handleSvc(sp);
+            atomicAdd(&proc->syscallsInProgress,-1);
+        }
+        if(svcResult==Resume) continue;
+        if(svcResult==Segfault)
+        {
+            proc->exitCode=SIGSEGV; //Segfault
+            proc->printFault(fault);
+            //The fault was handled here, the main thread must not handle it
+            proc->fault=miosix_private::FaultData();
+        }
+        //Exit or fault in any thread terminate the whole process
+        if(svcResult!=ThreadExit) proc->terminateMainThread();
+        break;
+    }
+    Lock<FastMutex> l(proc->threadMutex);
+    proc->threads[tid].thread=nullptr;
+    proc->liveThreads--;
+    proc->threadExited.broadcast();
+    return nullptr;
+}
+
+void Process::printFault(bool memoryFault)
+{
+    #ifdef WITH_ERRLOG
+    iprintf("Process %d terminated due to a fault\n"
+            "* Code base address was 0x%x\n"
+            "* Data base address was %p\n",pid,program.getElfBase(),
+            image.getProcessBasePointer());
+    mpu.dumpConfiguration();
+    if(memoryFault) fault.print();
+    #endif //WITH_ERRLOG
+}
+
+void Process::terminateMainThread()
+{
+    Lock<FastMutex> l(threadMutex);
+    threads[0].thread->terminate();
+}
+
+void Process::terminateOtherThreads()
+{
+    Lock<FastMutex> l(threadMutex);
+    for(unsigned int i=1;i<MAX_THREADS_PER_PROCESS;i++)
+        if(threads[i].thread) threads[i].thread->terminate();
+    //NOTE: a thread blocked in a syscall that does not return when the thread
+    //is terminated delays the process termination until the syscall completes
+    while(liveThreads>0) threadExited.wait(l);
+    for(unsigned int i=1;i<MAX_THREADS_PER_PROCESS;i++)
+        threads[i]=ProcessThread();
+}
+
+int Process::getTid()
+{
+    Thread *self=Thread::getCurrentThread();
+    Lock<FastMutex> l(threadMutex);
+    for(unsigned int i=0;i<MAX_THREADS_PER_PROCESS;i++)
+        if(threads[i].thread==self) return i;
+    errorHandler(UNEXPECTED); //Thread not in its own process? impossible
+    return -1;
+}
+
+int Process::createThread(unsigned int entry, void *arg,
+                          unsigned int *stackBase, unsigned int stackSize)
+{
+    Lock<FastMutex> l(threadMutex);
+    //If the process is terminating don't create threads that would outlive it
+    if(Thread::testTerminate()) return -EAGAIN;
+    unsigned int tid=1;
+    while(tid<MAX_THREADS_PER_PROCESS && threads[tid].used) tid++;
+    if(tid>=MAX_THREADS_PER_PROCESS) return -EAGAIN;
+    Thread *thr=Thread::createUserspace(Process::threadStart,this);
+    if(thr==nullptr) return -EAGAIN;
+    thr->setupUserspaceThreadContext(entry,arg,stackBase,stackSize,
+                                     image.getProcessBasePointer());
+    threads[tid].thread=thr;
+    threads[tid].used=true;
+    liveThreads++;
+    thr->wakeup(); //Actually start the thread, now that everything is set up
+    return tid;
+}
+
+int Process::joinThread(int tid, void **result)
+{
+    if(tid<=0 || tid>=static_cast<int>(MAX_THREADS_PER_PROCESS)) return -ESRCH;
+    Lock<FastMutex> l(threadMutex);
+    ProcessThread& t=threads[tid];
+    if(t.used==false) return -ESRCH;
+    if(t.thread==Thread::getCurrentThread()) return -EDEADLK;
+    if(t.joining) return -EINVAL;
+    t.joining=true;
+    while(t.thread!=nullptr)
+    {
+        if(Thread::testTerminate())
+        {
+            t.joining=false;
+            return -EINTR;
+        }
+        threadExited.wait(l);
+    }
+    *result=t.result;
+    t=ProcessThread();
+    return 0;
+}
+
+IntrusiveList<Process::FutexWaiter> Process::futexWaiters;
+
+int Process::futexWait(volatile int *addr, int expected)
+{
+    FutexWaiter waiter(addr,Thread::getCurrentThread());
+    FastInterruptDisableLock dLock;
+    //Checking the value with interrupts disabled makes the check and the wait
+    //atomic with respect to futexWake
+    if(*addr!=expected) return -EAGAIN;
+    futexWaiters.push_back(&waiter);
+    while(waiter.thread!=nullptr)
+    {
+        if(Thread::testTerminate())
+        {
+            futexWaiters.removeFast(&waiter);
+            return -EINTR;
+        }
+        Thread::IRQenableIrqAndWait(dLock);
+    }
+    return 0;
+}
+
+int Process::futexWake(volatile int *addr, int count)
+{
+    int result=0;
+    bool hppw=false;
+    {
+        FastInterruptDisableLock dLock;
+        Thread *self=Thread::IRQgetCurrentThread();
+        for(auto it=futexWaiters.begin();it!=futexWaiters.end();)
+        {
+            if(result>=count) break;
+            if((*it)->addr!=addr)
+            {
+                ++it;
+                continue;
+            }
+            Thread *t=(*it)->thread;
+            t->IRQwakeup();
+            if(t->IRQgetPriority()>self->IRQgetPriority()) hppw=true;
+            (*it)->thread=nullptr;
+            it=futexWaiters.erase(it);
+            result++;
+        }
+    }
+    if(hppw) Thread::yield();
+    return result;
+}
+
+int Process::detachSharedMemory(bool busyCheck)
+{
+    if(shmBase==nullptr) return 0;
+    {
+        //Threads of this process may be preempted in userspace, prevent the
+        //scheduler from reading a partially updated MPU configuration
+        FastInterruptDisableLock dLock;
+        //Other threads may be in a syscall using a buffer in the segment that
+        //they validated before the detach. Checking with interrupts disabled
+        //is race-free, as syscalls started after the region is cleared fail
+        //validating such buffers. The count includes the calling thread
+        if(busyCheck && syscallsInProgress>1) return -EBUSY;
+        mpu.clearSharedRegion();
+    }
+    SharedMemoryTable::instance().detach(shmBase);
+    shmBase=nullptr;
+    return 0;
+}
+
+void Process::unmapFile()
+{
+    if(!mappedFile) return;
+    {
+        FastInterruptDisableLock dLock;
+        mpu.clearMappedRegion();
+    }
+    mappedFile.reset();
+    mappedBase=nullptr;
+}
+
 Process::SvcResult Process::handleSvc(miosix_private::SyscallParameters sp)
 {
+    #ifdef WITH_KERNEL_TRACE
+    KernelTrace::SyscallScope traceScope(sp.getSyscallId());
+    #endif //WITH_KERNEL_TRACE
     try {
         switch(static_cast<Syscall>(sp.getSyscallId()))
         {
@@ -398,6 +657,73 @@ Process::SvcResult Process::handleSvc(miosix_private::SyscallParameters sp)
                 break;
             }
 
+            case Syscall::PREAD:
+            {
+                //The 64 bit offset does not fit in the syscall parameters, so
+                //userspace passes a pointer to it
+                int fd=sp.getParameter(0);
+                void *ptr=reinterpret_cast<void*>(sp.getParameter(1));
+                size_t size=sp.getParameter(2);
+                auto pos=reinterpret_cast<off_t*>(sp.getParameter(3));
+                if(mpu.withinForWriting(ptr,size) &&
+                   mpu.withinForReading(pos,sizeof(off_t)) && aligned(pos))
+                {
+                    ssize_t result=fileTable.pread(fd,ptr,size,*pos);
+                    sp.setParameter(0,result);
+                } else sp.setParameter(0,-EFAULT);
+                break;
+            }
+
+            case Syscall::PWRITE:
+            {
+                int fd=sp.getParameter(0);
+                void *ptr=reinterpret_cast<void*>(sp.getParameter(1));
+                size_t size=sp.getParameter(2);
+                auto pos=reinterpret_cast<off_t*>(sp.getParameter(3));
+                if(mpu.withinForReading(ptr,size) &&
+                   mpu.withinForReading(pos,sizeof(off_t)) && aligned(pos))
+                {
+                    ssize_t result=fileTable.pwrite(fd,ptr,size,*pos);
+                    sp.setParameter(0,result);
+                } else sp.setParameter(0,-EFAULT);
+                break;
+            }
+
+            case Syscall::READV:
+            {
+                int fd=sp.getParameter(0);
+                auto iov=reinterpret_cast<struct iovec*>(sp.getParameter(1));
+                int iovcnt=sp.getParameter(2);
+                sp.setParameter(0,processVectoredIo(mpu,fileTable,fd,iov,
+                                                    iovcnt,false));
+                break;
+            }
+
+            case Syscall::WRITEV:
+            {
+                int fd=sp.getParameter(0);
+                auto iov=reinterpret_cast<struct iovec*>(sp.getParameter(1));
+                int iovcnt=sp.getParameter(2);
+                sp.setParameter(0,processVectoredIo(mpu,fileTable,fd,iov,
+                                                    iovcnt,true));
+                break;
+            }
+
+            case Syscall::POLL:
+            {
+                auto fds=reinterpret_cast<struct pollfd*>(sp.getParameter(0));
+                nfds_t nfds=sp.getParameter(1);
+                int timeout=sp.getParameter(2);
+                //Too large nfds is rejected by poll(), don't overflow the size
+                if(nfds==0 || nfds>MAX_OPEN_FILES || (aligned(fds) &&
+                   mpu.withinForWriting(fds,nfds*sizeof(struct pollfd))))
+                {
+                    int result=fileTable.poll(fds,nfds,timeout);
+                    sp.setParameter(0,result);
+                } else sp.setParameter(0,-EFAULT);
+                break;
+            }
+
             case Syscall::LSEEK:
             {
                 off_t pos=sp.getParameter(2);
@@ -460,6 +786,7 @@ Process::SvcResult Process::handleSvc(miosix_private::SyscallParameters sp)
                     case F_DUPFD: //Third parameter is int, no validation needed
                     case F_SETFD:
                     case F_SETFL:
+                    case F_SETPIPE_SZ:
                         result=fileTable.fcntl(sp.getParameter(0),cmd,
                                                sp.getParameter(2));
                         break;
@@ -738,6 +1065,12 @@ Process::SvcResult Process::handleSvc(miosix_private::SyscallParameters sp)
 
             case Syscall::EXECVE:
             {
+                //Only the main thread can replace the program
+                if(getTid()!=0)
+                {
+                    sp.setParameter(0,-EINVAL);
+                    break;
+                }
                 auto path=reinterpret_cast<const char*>(sp.getParameter(0));
                 auto argv=reinterpret_cast<char* const*>(sp.getParameter(1));
                 auto envp=reinterpret_cast<char* const*>(sp.getParameter(2));
@@ -751,9 +1084,12 @@ Process::SvcResult Process::handleSvc(miosix_private::SyscallParameters sp)
                         ElfProgram program(path);
                         if(program.errorCode()==0)
                         {
+                            //The new program replaces the memory image, and
+                            //with it the stacks of all other threads
+                            terminateOtherThreads();
+                            detachSharedMemory();
+                            unmapFile();
                             try {
-                                //TODO: when threads within processes are
-                                //implemented, kill all other threads
                                 load(std::move(program),std::move(args));
                             } catch(exception& e) {
                                 //TODO currently load causes the old process
@@ -879,6 +1215,215 @@ Process::SvcResult Process::handleSvc(miosix_private::SyscallParameters sp)
                 break;
             }
 
+            case Syscall::THREAD_CREATE:
+            {
+                unsigned int entry=sp.getParameter(0);
+                auto arg=reinterpret_cast<void*>(sp.getParameter(1));
+                auto stack=reinterpret_cast<unsigned int*>(sp.getParameter(2));
+                unsigned int size=sp.getParameter(3);
+                //The stack pointer must be aligned both at the start and end
+                //of the stack, which must fit at least the watermark
+                if(reinterpret_cast<unsigned int>(stack) % CTXSAVE_STACK_ALIGNMENT
+                    || size % CTXSAVE_STACK_ALIGNMENT
+                    || size<WATERMARK_LEN+MIN_PROCESS_STACK_SIZE)
+                {
+                    sp.setParameter(0,-EINVAL);
+                } else if(mpu.withinForWriting(stack,size)) {
+                    int result=createThread(entry,arg,stack,size);
+                    sp.setParameter(0,result);
+                } else sp.setParameter(0,-EFAULT);
+                break;
+            }
+
+            case Syscall::THREAD_JOIN:
+            {
+                int tid=sp.getParameter(0);
+                auto result=reinterpret_cast<void**>(sp.getParameter(1));
+                if(!result || (mpu.withinForWriting(result,sizeof(void*))
+                    && aligned(result)))
+                {
+                    void *value;
+                    int error=joinThread(tid,&value);
+                    if(error==0 && result) *result=value;
+                    sp.setParameter(0,error);
+                } else sp.setParameter(0,-EFAULT);
+                break;
+            }
+
+            case Syscall::THREAD_EXIT:
+            {
+                auto value=reinterpret_cast<void*>(sp.getParameter(0));
+                int tid=getTid();
+                Lock<FastMutex> l(threadMutex);
+                if(tid!=0)
+                {
+                    threads[tid].result=value;
+                    return ThreadExit;
+                }
+                //The main thread returns only once all other threads exited,
+                //userspace then terminates the process calling exit(0)
+                while(liveThreads>0)
+                {
+                    if(Thread::testTerminate()) return Resume;
+                    threadExited.wait(l);
+                }
+                sp.setParameter(0,0);
+                break;
+            }
+
+            case Syscall::FUTEX_WAIT:
+            {
+                auto addr=reinterpret_cast<volatile int*>(sp.getParameter(0));
+                int expected=sp.getParameter(1);
+                if(mpu.withinForReading(const_cast<int*>(addr),sizeof(int))
+                    && aligned(const_cast<int*>(addr)))
+                {
+                    int result=futexWait(addr,expected);
+                    sp.setParameter(0,result);
+                } else sp.setParameter(0,-EFAULT);
+                break;
+            }
+
+            case Syscall::FUTEX_WAKE:
+            {
+                auto addr=reinterpret_cast<volatile int*>(sp.getParameter(0));
+                int count=sp.getParameter(1);
+                if(mpu.withinForReading(const_cast<int*>(addr),sizeof(int))
+                    && aligned(const_cast<int*>(addr)))
+                {
+                    int result=futexWake(addr,count);
+                    sp.setParameter(0,result);
+                } else sp.setParameter(0,-EFAULT);
+                break;
+            }
+
+            case Syscall::SHMGET:
+            {
+                int key=sp.getParameter(0);
+                unsigned int size=sp.getParameter(1);
+                int flags=sp.getParameter(2);
+                int result=SharedMemoryTable::instance().get(key,size,flags);
+                sp.setParameter(0,result);
+                break;
+            }
+
+            case Syscall::SHMAT:
+            {
+                int id=sp.getParameter(0);
+                unsigned int addr=sp.getParameter(1);
+                int flags=sp.getParameter(2);
+                //Without virtual memory the attach address can't be chosen
+                if(addr!=0)
+                {
+                    sp.setParameter(0,-EINVAL);
+                    break;
+                }
+                //Only one MPU region is available for shared memory
+                Lock<FastMutex> l(threadMutex);
+                if(shmBase)
+                {
+                    sp.setParameter(0,-EMFILE);
+                    break;
+                }
+                unsigned int *base;
+                unsigned int size;
+                int result=SharedMemoryTable::instance().attach(id,base,size);
+                if(result==0)
+                {
+                    {
+                        FastInterruptDisableLock dLock;
+                        mpu.setSharedRegion(base,size,(flags & SHM_RDONLY)==0);
+                    }
+                    shmBase=base;
+                    sp.setParameter(1,reinterpret_cast<unsigned int>(base));
+                }
+                sp.setParameter(0,result);
+                break;
+            }
+
+            case Syscall::SHMDT:
+            {
+                auto addr=reinterpret_cast<unsigned int*>(sp.getParameter(0));
+                Lock<FastMutex> l(threadMutex);
+                if(shmBase && shmBase==addr)
+                    sp.setParameter(0,detachSharedMemory(true));
+                else sp.setParameter(0,-EINVAL);
+                break;
+            }
+
+            case Syscall::SHMCTL:
+            {
+                int id=sp.getParameter(0);
+                int cmd=sp.getParameter(1);
+                if(cmd==IPC_RMID)
+                {
+                    int result=SharedMemoryTable::instance().remove(id);
+                    sp.setParameter(0,result);
+                } else sp.setParameter(0,-EINVAL);
+                break;
+            }
+
+            case Syscall::MMAP:
+            {
+                //Read-only mapping of a file stored in memory, such as in
+                //RomFs. Other files return -ENODEV, and the userspace mmap()
+                //falls back to a copy in the process heap
+                int fd=sp.getParameter(0);
+                unsigned int off=sp.getParameter(1);
+                unsigned int len=sp.getParameter(2);
+                intrusive_ref_ptr<FileBase> file=fileTable.getFile(fd);
+                if(!file)
+                {
+                    sp.setParameter(0,-EBADF);
+                    break;
+                }
+                MemoryMappedFile mm=file->getFileFromMemory();
+                if(mm.isValid()==false)
+                {
+                    sp.setParameter(0,-ENODEV);
+                    break;
+                }
+                if(len==0 || off>=mm.size || len>mm.size-off)
+                {
+                    sp.setParameter(0,len==0 ? -EINVAL : -ENXIO);
+                    break;
+                }
+                //Only one MPU region is available for memory mapped files
+                Lock<FastMutex> l(threadMutex);
+                if(mappedFile)
+                {
+                    sp.setParameter(0,-ENOMEM);
+                    break;
+                }
+                //The region is enlarged to meet the MPU alignment constraints,
+                //so the process can also read neighbouring data, as it happens
+                //for the region of an XIP elf
+                const char *base=reinterpret_cast<const char*>(mm.data)+off;
+                auto region=MPUConfiguration::roundRegionForMPU(
+                    reinterpret_cast<const unsigned int*>(base),max(len,32u));
+                {
+                    FastInterruptDisableLock dLock;
+                    mpu.setMappedRegion(region.first,region.second);
+                }
+                mappedFile=file;
+                mappedBase=base;
+                sp.setParameter(1,reinterpret_cast<unsigned int>(base));
+                sp.setParameter(0,0);
+                break;
+            }
+
+            case Syscall::MUNMAP:
+            {
+                auto addr=reinterpret_cast<const char*>(sp.getParameter(0));
+                Lock<FastMutex> l(threadMutex);
+                if(mappedFile && mappedBase==addr)
+                {
+                    unmapFile();
+                    sp.setParameter(0,0);
+                } else sp.setParameter(0,-EINVAL);
+                break;
+            }
+
             default:
                 exitCode=SIGSYS; //Bad syscall
                 #ifdef WITH_ERRLOG
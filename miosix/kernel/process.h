@@ -193,13 +193,98 @@ private:
      */
     static void *start(void *argv);
 
+    /**
+     * Contains the main loop of the additional threads of a process, created
+     * through the THREAD_CREATE syscall
+     * \param argv unused
+     * \return null
+     */
+    static void *threadStart(void *argv);
+
     enum SvcResult
     {
         Resume=0,   ///< Process can switch to userspace and resume operation
         Exit=1,     ///< Process exited
         Execve=2,   ///< Process can resume, but the program has been switched
-        Segfault=3  ///< Unrecoverable error occurred
+        Segfault=3, ///< Unrecoverable error occurred
+        ThreadExit=4///< Only the thread that made the syscall exited
     };
+
+    /**
+     * Print information about a fault that caused the process to terminate,
+     * if error logging is enabled
+     * \param memoryFault true if the process terminated due to a memory fault,
+     * false if due to an invalid syscall
+     */
+    void printFault(bool memoryFault);
+
+    /**
+     * Called by a thread other than the main one when the whole process has to
+     * terminate, either because of an exit syscall or a fault. Makes the main
+     * thread terminate, which in turn terminates all other threads
+     */
+    void terminateMainThread();
+
+    /**
+     * Called by the main thread when the process terminates or execs, to
+     * terminate all other threads and wait for them to exit userspace
+     */
+    void terminateOtherThreads();
+
+    /**
+     * \return the tid of the calling thread, which must belong to this process
+     */
+    int getTid();
+
+    /**
+     * Create a new thread in the process
+     * \param entry userspace entry point
+     * \param arg argument passed to the entry point
+     * \param stackBase lowest address of the userspace stack, already validated
+     * \param stackSize size of the userspace stack
+     * \return the tid of the new thread, or a negative error code
+     */
+    int createThread(unsigned int entry, void *arg, unsigned int *stackBase,
+                     unsigned int stackSize);
+
+    /**
+     * Wait for a thread of the process to terminate
+     * \param tid tid of the thread to wait for
+     * \param result value passed to pthread_exit by that thread
+     * \return 0 on success, or a negative error code
+     */
+    int joinThread(int tid, void **result);
+
+    /**
+     * Wait on a futex
+     * \param addr address of the futex word, already validated
+     * \param expected the thread blocks only if *addr==expected
+     * \return 0 if woken, -EAGAIN if *addr!=expected, -EINTR if the thread was
+     * terminated
+     */
+    int futexWait(volatile int *addr, int expected);
+
+    /**
+     * Detach the shared memory segment attached to the process, if any
+     * \param busyCheck if true, fail if other threads of the process are
+     * executing a syscall, as they may be accessing buffers in the segment
+     * \return 0 on success, -EBUSY if busyCheck is true and other threads of
+     * the process are executing a syscall
+     */
+    int detachSharedMemory(bool busyCheck=false);
+
+    /**
+     * Unmap the memory mapped file of the process, if any
+     */
+    void unmapFile();
+
+    /**
+     * Wake threads waiting on a futex
+     * \param addr address of the futex word
+     * \param count maximum number of threads to wake
+     * \return the number of woken threads
+     */
+    int futexWake(volatile int *addr, int count);
     
     /**
      * Handle a supervisor call
@@ -223,7 +308,46 @@ private:
     void *argvSp; ///< Ptr to argument array within ProcessImage and initial sp
     void *envp; ///< Pointer to the environment array within the ProcessImage
     
-    std::vector<Thread *> threads; ///<Threads that belong to the process
+    /**
+     * A thread of the process, its index in the threads array is its tid.
+     * The main thread has tid 0
+     */
+    class ProcessThread
+    {
+    public:
+        Thread *thread=nullptr; ///< Kernel thread, nullptr once terminated
+        void *result=nullptr;   ///< Value passed to pthread_exit
+        bool used=false;        ///< True until the thread is joined
+        bool joining=false;     ///< True if another thread is joining it
+    };
+
+    /**
+     * A thread blocked in the FUTEX_WAIT syscall, allocated on its stack
+     */
+    class FutexWaiter : public IntrusiveListItem
+    {
+    public:
+        FutexWaiter(volatile int *addr, Thread *thread)
+            : addr(addr), thread(thread) {}
+        volatile int *addr; ///< Futex word
+        Thread *thread;     ///< Waiting thread, nullptr once woken
+    };
+
+    ProcessThread threads[MAX_THREADS_PER_PROCESS]; ///<Threads of the process
+    int liveThreads; ///< Number of threads except the main one still running
+    ///Number of threads of the process executing a syscall
+    volatile int syscallsInProgress;
+    ///Guards threads, liveThreads, shmBase and mappedFile
+    FastMutex threadMutex;
+    ConditionVariable threadExited; ///< Signaled when a thread terminates
+    ///Threads blocked on futexes. Shared among all processes, so that futexes
+    ///also work in shared memory
+    static IntrusiveList<FutexWaiter> futexWaiters;
+    unsigned int *shmBase; ///< Attached shared memory segment, or nullptr
+    ///File mapped with the MMAP syscall. Holding a reference keeps the file
+    ///open, and its filesystem mounted, as long as the mapping exists
+    intrusive_ref_ptr<FileBase> mappedFile;
+    const char *mappedBase; ///< Address returned by the MMAP syscall
     
     ///Contains the count of active wait calls which specifically requested
     ///to wait on this process
@@ -368,7 +492,10 @@ enum class Syscall
     DUP2      = 31,
     PIPE      = 32,
     ACCESS    = 33,
-    //From 34 to 37 reserved for future use
+    PREAD     = 34,
+    PWRITE    = 35,
+    READV     = 36,
+    WRITEV    = 37,
 
     // Time syscalls
     GETTIME   = 38,
@@ -396,6 +523,26 @@ enum class Syscall
     MOUNT     = 56,
     UMOUNT    = 57,
     MKFS      = 58, //Moving filesystem creation code to kernel
+
+    // I/O multiplexing syscalls
+    POLL      = 59,
+
+    // Thread syscalls
+    THREAD_CREATE = 60,
+    THREAD_JOIN   = 61,
+    THREAD_EXIT   = 62,
+    FUTEX_WAIT    = 63,
+    FUTEX_WAKE    = 64,
+
+    // Shared memory syscalls
+    SHMGET        = 65,
+    SHMAT         = 66,
+    SHMDT         = 67,
+    SHMCTL        = 68,
+
+    // Memory mapped file syscalls
+    MMAP          = 69,
+    MUNMAP        = 70,
 };
 
 } //namespace miosix
@@ -31,6 +31,10 @@
 #include <algorithm>
 #ifndef TEST_ALLOC
 #include "core/memory_protection.h"
+#else //TEST_ALLOC
+#include <vector>
+#include <random>
+#include <cstdlib>
 #endif //TEST_ALLOC
 
 using namespace std;
@@ -39,12 +43,6 @@ using namespace std;
 
 namespace miosix {
 
-///This constant specifies the size of the minimum allocatable block,
-///in bits. So for example 10 is 1KB.
-static const unsigned int blockBits=10;
-///This constant is the the size of the minimum allocatable block, in bytes.
-static const unsigned int blockSize=1<<blockBits;
-
 ProcessPool& ProcessPool::instance()
 {
     #ifndef TEST_ALLOC
@@ -56,7 +54,10 @@ ProcessPool& ProcessPool::instance()
         reinterpret_cast<unsigned int>(&_process_pool_start));
     return pool;
     #else //TEST_ALLOC
-    static ProcessPool pool(reinterpret_cast<unsigned int*>(0x20008000),96*1024);
+    //Like a pool starting at 0x20008000, not aligned to its size
+    const unsigned int size=96*1024;
+    static char *memory=static_cast<char*>(aligned_alloc(128*1024,128*1024));
+    static ProcessPool pool(reinterpret_cast<unsigned int*>(memory+32*1024),size);
     return pool;
     #endif //TEST_ALLOC
 }
@@ -67,35 +68,28 @@ pair<unsigned int *, unsigned int> ProcessPool::allocate(unsigned int size)
     miosix::Lock<miosix::FastMutex> l(mutex);
     size=MPUConfiguration::roundSizeForMPU(max(size,blockSize));
     #else //TEST_ALLOC
-    //Size adjustment not supported during test_alloc due to missing mpu header
-    if((size & (size - 1)) || size<blockSize)
-            throw runtime_error("ProcessPool::allocate unsupported size");
+    //Can't use the mpu header during test_alloc, round to a power of 2 here
+    size=max(size,blockSize);
+    if(size>1u<<maxOrder) throw bad_alloc();
+    if(size & (size-1)) size=1<<(32-__builtin_clz(size));
     #endif //TEST_ALLOC
     if(size>poolSize) throw bad_alloc();
     
-    unsigned int offset=0;
-    if(reinterpret_cast<unsigned int>(poolBase) % size)
-        offset=size-(reinterpret_cast<unsigned int>(poolBase) % size);
-    unsigned int startBit=offset/blockSize;
-    unsigned int sizeBit=size/blockSize;
-
-    for(unsigned int i=startBit;i<=poolSize/blockSize;i+=sizeBit)
+    unsigned int order=__builtin_ctz(size);
+    unsigned int i=order;
+    while(i<=maxOrder && freeLists[i-blockBits]==nullptr) i++;
+    if(i>maxOrder) throw bad_alloc();
+    unsigned int block=reinterpret_cast<unsigned int>(freeLists[i-blockBits]);
+    removeFree(block,i);
+    //Split the block, freeing the upper halves, until it is of the right size
+    while(i>order)
     {
-        bool notEmpty=false;
-        for(unsigned int j=0;j<sizeBit;j++)
-        {
-            if(testBit(i+j)==0) continue;
-            notEmpty=true;
-            break;
-        }
-        if(notEmpty) continue;
-        
-        for(unsigned int j=0;j<sizeBit;j++) setBit(i+j);
-        unsigned int *result=poolBase+i*blockSize/sizeof(unsigned int);
-        allocatedBlocks[result]=size;
-        return make_pair(result,size);
+        i--;
+        pushFree(block+(1<<i),i);
     }
-    throw bad_alloc();
+    blockInfo[blockIndex(block)]=allocatedFlag | order;
+    freeSize-=size;
+    return make_pair(reinterpret_cast<unsigned int*>(block),size);
 }
 
 void ProcessPool::deallocate(unsigned int *ptr)
@@ -103,75 +97,189 @@ void ProcessPool::deallocate(unsigned int *ptr)
     #ifndef TEST_ALLOC
     miosix::Lock<miosix::FastMutex> l(mutex);
     #endif //TEST_ALLOC
-    map<unsigned int*, unsigned int>::iterator it= allocatedBlocks.find(ptr);
-    if(it==allocatedBlocks.end())
+    unsigned int block=reinterpret_cast<unsigned int>(ptr);
+    unsigned int base=reinterpret_cast<unsigned int>(poolBase);
+    if(block<base || block>=base+poolSize || (block-base) & (blockSize-1)
+        || (blockInfo[blockIndex(block)] & allocatedFlag)==0)
     #ifndef TEST_ALLOC
         errorHandler(UNEXPECTED);
     #else //TEST_ALLOC
         throw runtime_error("ProcessPool::deallocate corrupted pointer");
     #endif //TEST_ALLOC
-    unsigned int size =(it->second)/blockSize;
-    unsigned int firstBit=(reinterpret_cast<unsigned int>(ptr)-
-                           reinterpret_cast<unsigned int>(poolBase))/blockSize;
-    for(unsigned int i=firstBit;i<firstBit+size;i++) clearBit(i);
-    allocatedBlocks.erase(it);
+    unsigned int order=blockInfo[blockIndex(block)] & orderMask;
+    blockInfo[blockIndex(block)]=0;
+    freeSize+=1<<order;
+    //Merge the block with its buddy as long as the buddy is free
+    while(order<maxOrder)
+    {
+        unsigned int buddy=block ^ (1<<order);
+        if(buddy<base || buddy+(1<<order)>base+poolSize) break;
+        if(blockInfo[blockIndex(buddy)]!=(freeFlag | order)) break;
+        removeFree(buddy,order);
+        block=min(block,buddy);
+        order++;
+    }
+    pushFree(block,order);
+}
+
+unsigned int ProcessPool::getFreeSize()
+{
+    #ifndef TEST_ALLOC
+    miosix::Lock<miosix::FastMutex> l(mutex);
+    #endif //TEST_ALLOC
+    return freeSize;
+}
+
+unsigned int ProcessPool::getLargestFreeBlockSize()
+{
+    #ifndef TEST_ALLOC
+    miosix::Lock<miosix::FastMutex> l(mutex);
+    #endif //TEST_ALLOC
+    for(int i=maxOrder;i>=static_cast<int>(blockBits);i--)
+        if(freeLists[i-blockBits]) return 1<<i;
+    return 0;
+}
+
+unsigned int ProcessPool::getFragmentation()
+{
+    unsigned int largest=getLargestFreeBlockSize();
+    unsigned int free=getFreeSize();
+    if(free==0) return 0;
+    return 100-static_cast<unsigned long long>(largest)*100/free;
+}
+
+void ProcessPool::pushFree(unsigned int block, unsigned int order)
+{
+    FreeBlock *b=reinterpret_cast<FreeBlock*>(block);
+    FreeBlock *&head=freeLists[order-blockBits];
+    b->prev=nullptr;
+    b->next=head;
+    if(head) head->prev=b;
+    head=b;
+    blockInfo[blockIndex(block)]=freeFlag | order;
+}
+
+void ProcessPool::removeFree(unsigned int block, unsigned int order)
+{
+    FreeBlock *b=reinterpret_cast<FreeBlock*>(block);
+    if(b->prev) b->prev->next=b->next;
+    else freeLists[order-blockBits]=b->next;
+    if(b->next) b->next->prev=b->prev;
+    blockInfo[blockIndex(block)]=0;
 }
 
 ProcessPool::ProcessPool(unsigned int *poolBase, unsigned int poolSize)
-    : poolBase(poolBase), poolSize(poolSize)
+    : poolBase(poolBase), poolSize(poolSize), freeSize(poolSize)
 {
-    int numBytes=poolSize/blockSize/8;
-    bitmap=new unsigned int[numBytes/sizeof(unsigned int)];
-    memset(bitmap,0,numBytes);
+    blockInfo=new unsigned char[poolSize/blockSize];
+    memset(blockInfo,0,poolSize/blockSize);
+    for(auto& l : freeLists) l=nullptr;
+    //Split the pool in the largest blocks aligned to their size
+    unsigned int block=reinterpret_cast<unsigned int>(poolBase);
+    unsigned int end=block+poolSize;
+    while(block<end)
+    {
+        unsigned int order=block ? __builtin_ctz(block) : maxOrder;
+        order=min(order,maxOrder);
+        while((1u<<order)>end-block) order--;
+        pushFree(block,order);
+        block+=1<<order;
+    }
 }
 
 ProcessPool::~ProcessPool()
 {
-    delete[] bitmap;
+    delete[] blockInfo;
 }
 
 } //namespace miosix
 
 #ifdef TEST_ALLOC
-//g++ -m32 -o pp -DTEST_ALLOC -DWITH_PROCESSES process_pool.cpp && ./pp
-int main()
+//g++ -m32 -std=c++14 -O2 -o pp -DTEST_ALLOC -DWITH_PROCESSES process_pool.cpp && ./pp
+//The -m32 option requires 32 bit multilib support (g++-multilib on Debian)
+int main(int argc, char *argv[])
 {
     using namespace miosix;
+    struct Allocation
+    {
+        unsigned char *ptr;
+        unsigned int size;
+        unsigned char fill;
+    };
     ProcessPool& pool=ProcessPool::instance();
-    while(1)
+    const unsigned int poolFree=pool.getFreeSize();
+    const unsigned int poolLargest=pool.getLargestFreeBlockSize();
+    mt19937 rng(argc>1 ? atoi(argv[1]) : 0);
+    vector<Allocation> allocations;
+    unsigned int failures=0, maxFragmentation=0;
+    const int iterations=1000000;
+    for(int i=0;i<iterations;i++)
     {
-        cout<<"a<size(exponent)>|d<addr>"<<endl;
-        unsigned int param;
-        char op;
-        string line;
-        getline(cin,line);
-        stringstream ss(line);
-        ss>>op;
-        switch(op)
+        //Random sizes, biased towards small blocks like process images
+        if(allocations.empty() || rng()%2)
         {
-            case 'a':
-                ss>>dec>>param;
-                try {
-                    pool.allocate(1<<param);
-                } catch(exception& e) {
-                    cout<<typeid(e).name();
-                }
-                pool.printAllocatedBlocks();
-                break;
-            case 'd':
-                ss>>hex>>param;
-                try {
-                    pool.deallocate(reinterpret_cast<unsigned int*>(param));
-                } catch(exception& e) {
-                    cout<<typeid(e).name();
-                }
-                pool.printAllocatedBlocks();
-                break;
-            default:
-                cout<<"Incorrect option"<<endl;
-                break;
+            unsigned int size=rng()%(1024<<(rng()%6))+1;
+            try {
+                auto p=pool.allocate(size);
+                auto ptr=reinterpret_cast<unsigned char*>(p.first);
+                auto addr=reinterpret_cast<unsigned int>(ptr);
+                if(p.second<size || (p.second & (p.second-1)))
+                    throw runtime_error("wrong size");
+                if(addr & (p.second-1)) throw runtime_error("not aligned");
+                //Fill the block so that overlapping blocks are detected
+                unsigned char fill=rng();
+                memset(ptr,fill,p.second);
+                allocations.push_back({ptr,p.second,fill});
+            } catch(bad_alloc&) {
+                failures++;
+            }
+        } else {
+            unsigned int index=rng()%allocations.size();
+            Allocation a=allocations[index];
+            allocations[index]=allocations.back();
+            allocations.pop_back();
+            for(unsigned int j=0;j<a.size;j++)
+                if(a.ptr[j]!=a.fill) throw runtime_error("block overwritten");
+            pool.deallocate(reinterpret_cast<unsigned int*>(a.ptr));
         }
+        unsigned int allocated=0;
+        for(auto& a : allocations) allocated+=a.size;
+        if(allocated+pool.getFreeSize()!=poolFree)
+            throw runtime_error("free size mismatch");
+        maxFragmentation=max(maxFragmentation,pool.getFragmentation());
+    }
+    auto invalidDetected=[&pool](unsigned char *ptr)
+    {
+        try {
+            pool.deallocate(reinterpret_cast<unsigned int*>(ptr));
+        } catch(runtime_error&) {
+            return true;
+        }
+        return false;
+    };
+    //Only the start of an allocated block can be deallocated. Note that
+    //ptr+1024 of a single 1KB block may be the start of the next allocation
+    if(invalidDetected(nullptr)==false)
+        throw runtime_error("invalid pointer not detected");
+    if(allocations.empty()==false)
+    {
+        Allocation a=allocations[0];
+        if(invalidDetected(a.ptr+1)==false)
+            throw runtime_error("unaligned pointer not detected");
+        if(a.size>1024 && invalidDetected(a.ptr+1024)==false)
+            throw runtime_error("pointer inside a block not detected");
+    }
+    for(auto& a : allocations)
+        pool.deallocate(reinterpret_cast<unsigned int*>(a.ptr));
+    //Once everything is freed, all buddies must have been merged back
+    if(pool.getFreeSize()!=poolFree ||
+       pool.getLargestFreeBlockSize()!=poolLargest)
+    {
+        pool.printAllocatedBlocks();
+        throw runtime_error("blocks not merged");
     }
+    cout<<iterations<<" iterations ok, "<<failures<<" failed allocations, "
+        <<"max fragmentation "<<maxFragmentation<<"%"<<endl;
 }
 #endif //TEST_ALLOC
 
@@ -27,7 +27,6 @@
 
 #pragma once
 
-#include <map>
 #include <utility>
 
 #ifndef TEST_ALLOC
@@ -45,6 +44,11 @@ namespace miosix {
 /**
  * This class allows to handle a memory area reserved for the allocation of
  * processes' images. This memory area is called process pool.
+ *
+ * The allocator is a buddy system working on absolute addresses, so that every
+ * block is aligned to its size as required by the memory protection unit.
+ * Free blocks are kept in per-size lists stored in the free memory itself, so
+ * allocate and deallocate take O(log n) time and never use the heap.
  */
 class ProcessPool
 {
@@ -74,6 +78,22 @@ public:
      * \throws runtime_error if the pointer is invalid
      */
     void deallocate(unsigned int *ptr);
+
+    /**
+     * \return the free memory in the pool, in bytes
+     */
+    unsigned int getFreeSize();
+
+    /**
+     * \return the size of the largest block that can be allocated, in bytes
+     */
+    unsigned int getLargestFreeBlockSize();
+
+    /**
+     * \return the external fragmentation of the pool in percent, that is the
+     * amount of free memory that can't be allocated as a single block
+     */
+    unsigned int getFragmentation();
     
     #ifdef TEST_ALLOC
     /**
@@ -82,28 +102,16 @@ public:
     void printAllocatedBlocks()
     {
         using namespace std;
-        map<unsigned int*, unsigned int>::iterator it;
         cout<<endl;
-        for(it=allocatedBlocks.begin();it!=allocatedBlocks.end();it++)
-            cout <<"block of size " << it->second
-                 << " allocated @ " << it->first<<endl;
-        
-        cout<<"Bitmap:"<<endl;
-        const int SHIFT = 8 * sizeof(unsigned int);
-        const unsigned int MASK = 1 << (SHIFT-1);
-        int bitarray[32];
-        for(int i=0; i<(poolSize/blockSize)/(sizeof(unsigned int)*8);i++)
-        {   
-            int value=bitmap[i];
-            for ( int j = 0; j < SHIFT; j++ ) 
-            {
-                bitarray[31-j]= ( value & MASK ? 1 : 0 );
-                value <<= 1;
-            }
-            for(int j=0;j<32;j++)
-                cout<<bitarray[j];
-            cout << endl;
-        }  
+        for(unsigned int i=0;i<poolSize/blockSize;i++)
+        {
+            if(blockInfo[i]==0) continue;
+            cout<<(blockInfo[i] & allocatedFlag ? "allocated" : "free")
+                <<" block of size "<<(1<<(blockInfo[i] & orderMask))
+                <<" @ "<<poolBase+i*blockSize/sizeof(unsigned int)<<endl;
+        }
+        cout<<"Free "<<getFreeSize()<<" largest "<<getLargestFreeBlockSize()
+            <<" fragmentation "<<getFragmentation()<<"%"<<endl;
     }
     #endif //TEST_ALLOC
     
@@ -122,40 +130,61 @@ private:
      * Destructor
      */
     ~ProcessPool();
-    
+
     /**
-     * \param bit bit to test, from 0 to poolSize/blockSize
-     * \return true if the bit is set
+     * Header stored at the start of each free block, to link it in the free
+     * list of its size
      */
-    bool testBit(unsigned int bit)
+    struct FreeBlock
     {
-        return (bitmap[bit/(sizeof(unsigned int)*8)] &
-            1<<(bit % (sizeof(unsigned int)*8))) ? true : false;
-    }
-    
+        FreeBlock *prev;
+        FreeBlock *next;
+    };
+
     /**
-     * \param bit bit to set, from 0 to poolSize/blockSize
+     * Add a block to the free list of its size
+     * \param block block address
+     * \param order log2 of the block size
      */
-    void setBit(unsigned int bit)
-    {
-        bitmap[(bit/(sizeof(unsigned int)*8))] |= 
-            1<<(bit % (sizeof(unsigned int)*8));
-    }
-    
+    void pushFree(unsigned int block, unsigned int order);
+
     /**
-     * \param bit bit to clear, from 0 to poolSize/blockSize
+     * Remove a block from the free list of its size
+     * \param block block address
+     * \param order log2 of the block size
      */
-    void clearBit(unsigned int bit)
+    void removeFree(unsigned int block, unsigned int order);
+
+    /**
+     * \param block address of a block within the pool
+     * \return index of the block in blockInfo
+     */
+    unsigned int blockIndex(unsigned int block) const
     {
-        bitmap[bit/(sizeof(unsigned int)*8)] &= 
-            ~(1<<(bit % (sizeof(unsigned int)*8)));
+        return (block-reinterpret_cast<unsigned int>(poolBase))>>blockBits;
     }
-    
-    unsigned int *bitmap;   ///< Pointer to the status of the allocator
+
+    ///log2 of the minimum allocatable block, so for example 10 is 1KB
+    static const unsigned int blockBits=10;
+    ///Size of the minimum allocatable block, in bytes
+    static const unsigned int blockSize=1<<blockBits;
+    ///log2 of the maximum block size
+    static const unsigned int maxOrder=31;
+    ///In blockInfo, the bits that encode the log2 of the block size
+    static const unsigned char orderMask=0x1f;
+    ///In blockInfo, the flag that marks an allocated block
+    static const unsigned char allocatedFlag=0x80;
+    ///In blockInfo, the flag that marks a free block
+    static const unsigned char freeFlag=0x40;
+
+    ///For each minimum size block in the pool, if it is the first of a free or
+    ///allocated block, its size and state, otherwise zero
+    unsigned char *blockInfo;
+    ///Free lists, one per block size from blockSize to 1<<maxOrder
+    FreeBlock *freeLists[maxOrder-blockBits+1];
     unsigned int *poolBase; ///< Base address of the entire pool
     unsigned int poolSize;  ///< Size of the pool, in bytes
-    ///Lists all allocated blocks, allows to retrieve their sizes
-    std::map<unsigned int*,unsigned int> allocatedBlocks;
+    unsigned int freeSize;  ///< Free memory, in bytes
     #ifndef TEST_ALLOC
     miosix::FastMutex mutex; ///< Mutex to guard concurrent access
     #endif //TEST_ALLOC
@@ -242,8 +242,26 @@ int pthread_mutex_destroy(pthread_mutex_t *mutex)
     return 0;
 }
 
+#ifdef PTHREAD_MUTEX_FAST_PATH
+/**
+ * \internal
+ * Try to lock a free mutex without disabling interrupts
+ * \param mutex mutex to lock
+ * \param p current thread
+ * \return true if the mutex was free and is now owned by p
+ */
+static inline bool tryLockFastPath(pthread_mutex_t *mutex, void *p)
+{
+    auto owner=reinterpret_cast<volatile int*>(&mutex->owner);
+    return atomicCompareAndSwap(owner,0,reinterpret_cast<int>(p))==0;
+}
+#endif //PTHREAD_MUTEX_FAST_PATH
+
 int pthread_mutex_lock(pthread_mutex_t *mutex)
 {
+    #ifdef PTHREAD_MUTEX_FAST_PATH
+    if(tryLockFastPath(mutex,Thread::getCurrentThread())) return 0;
+    #endif //PTHREAD_MUTEX_FAST_PATH
     FastInterruptDisableLock dLock;
     IRQdoMutexLock(mutex,dLock);
     return 0;
@@ -251,6 +269,9 @@ int pthread_mutex_lock(pthread_mutex_t *mutex)
 
 int pthread_mutex_trylock(pthread_mutex_t *mutex)
 {
+    #ifdef PTHREAD_MUTEX_FAST_PATH
+    if(tryLockFastPath(mutex,Thread::getCurrentThread())) return 0;
+    #endif //PTHREAD_MUTEX_FAST_PATH
     FastInterruptDisableLock dLock;
     void *p=reinterpret_cast<void*>(Thread::IRQgetCurrentThread());
     if(mutex->owner==0)
@@ -258,7 +279,7 @@ int pthread_mutex_trylock(pthread_mutex_t *mutex)
         mutex->owner=p;
         return 0;
     }
-    if(mutex->owner==p && mutex->recursive>=0)
+    if(mutexOwner(mutex)==p && mutex->recursive>=0)
     {
         mutex->recursive++;
         return 0;
@@ -268,6 +289,19 @@ int pthread_mutex_trylock(pthread_mutex_t *mutex)
 
 int pthread_mutex_unlock(pthread_mutex_t *mutex)
 {
+    #ifdef PTHREAD_MUTEX_FAST_PATH
+    //The recursive field is only modified by the owner, so it can be read here.
+    //If the waiters bit is set the compare and swap fails, and the slow path
+    //hands the mutex over to the first waiting thread
+    if(mutex->recursive<=0)
+    {
+        void *p=Thread::getCurrentThread();
+        auto owner=reinterpret_cast<volatile int*>(&mutex->owner);
+        asm volatile("":::"memory"); //The critical section ends here
+        if(atomicCompareAndSwap(owner,reinterpret_cast<int>(p),0)==
+           reinterpret_cast<int>(p)) return 0;
+    }
+    #endif //PTHREAD_MUTEX_FAST_PATH
     #ifndef SCHED_TYPE_EDF
     FastInterruptDisableLock dLock;
     IRQdoMutexUnlock(mutex);
@@ -31,12 +31,83 @@
 #pragma once
 
 #include <pthread.h>
+#include <cstdint>
 #include "kernel.h"
 #include "intrusive.h"
 #include "sync.h"
 
+//On architectures with LDREX/STREX an uncontended lock or unlock of a
+//pthread_mutex_t is a single compare and swap of the owner field, done with
+//interrupts enabled. On the others atomic operations are implemented by
+//disabling interrupts, so the fast path would only add overhead
+#if defined(__ARM_ARCH_7M__) || defined(__ARM_ARCH_7EM__) \
+ || defined(__ARM_ARCH_8M_MAIN__)
+#define PTHREAD_MUTEX_FAST_PATH
+#include "interfaces/atomic_ops.h"
+#endif
+
 namespace miosix {
 
+/**
+ * \internal
+ * The owner field of a pthread_mutex_t holds the owner thread, with this bit
+ * set if the waiting list is not empty. This makes the compare and swap of the
+ * unlock fast path fail when there are threads to wake up.
+ * The waiting list and this bit are only modified with interrupts disabled.
+ */
+const uintptr_t mutexWaitersBit=1;
+
+/**
+ * \internal
+ * \param mutex a pthread_mutex_t
+ * \return the thread owning the mutex, or nullptr if the mutex is free
+ */
+static inline void *mutexOwner(pthread_mutex_t *mutex)
+{
+    return reinterpret_cast<void*>(
+        reinterpret_cast<uintptr_t>(mutex->owner) & ~mutexWaitersBit);
+}
+
+/**
+ * \internal
+ * Add the current thread to the waiting list of a mutex.
+ * Must be called with interrupts disabled
+ * \param mutex a locked pthread_mutex_t
+ * \param waiting element of the waiting list, allocated on the caller's stack
+ */
+static inline void IRQmutexEnqueue(pthread_mutex_t *mutex, WaitingList *waiting)
+{
+    waiting->next=nullptr; //Putting this thread last on the list (lifo policy)
+    if(mutex->first==nullptr)
+    {
+        mutex->first=waiting;
+        mutex->last=waiting;
+    } else {
+        mutex->last->next=waiting;
+        mutex->last=waiting;
+    }
+    mutex->owner=reinterpret_cast<void*>(
+        reinterpret_cast<uintptr_t>(mutex->owner) | mutexWaitersBit);
+}
+
+/**
+ * \internal
+ * Give the mutex to the first thread in the waiting list, and wake it.
+ * Must be called with interrupts disabled, and with a non empty waiting list
+ * \param mutex a locked pthread_mutex_t
+ * \return the woken thread
+ */
+static inline Thread *IRQmutexHandOver(pthread_mutex_t *mutex)
+{
+    Thread *t=reinterpret_cast<Thread*>(mutex->first->thread);
+    t->IRQwakeup();
+    mutex->first=mutex->first->next;
+    uintptr_t owner=reinterpret_cast<uintptr_t>(t);
+    if(mutex->first!=nullptr) owner|=mutexWaitersBit;
+    mutex->owner=reinterpret_cast<void*>(owner);
+    return t;
+}
+
 /**
  * \internal
  * Implementation code to lock a mutex. Must be called with interrupts disabled
@@ -56,7 +127,7 @@ static inline void IRQdoMutexLock(pthread_mutex_t *mutex,
     //This check is very important. Without this attempting to lock the same
     //mutex twice won't cause a deadlock because the wait is enclosed in a
     //while(owner!=p) which is immeditely false.
-    if(mutex->owner==p)
+    if(mutexOwner(mutex)==p)
     {
         if(mutex->recursive>=0)
         {
@@ -67,18 +138,10 @@ static inline void IRQdoMutexLock(pthread_mutex_t *mutex,
 
     WaitingList waiting; //Element of a linked list on stack
     waiting.thread=p;
-    waiting.next=nullptr; //Putting this thread last on the list (lifo policy)
-    if(mutex->first==nullptr)
-    {
-        mutex->first=&waiting;
-        mutex->last=&waiting;
-    } else {
-        mutex->last->next=&waiting;
-        mutex->last=&waiting;
-    }
+    IRQmutexEnqueue(mutex,&waiting);
 
     //The while is necessary to protect against spurious wakeups
-    while(mutex->owner!=p) Thread::IRQenableIrqAndWait(d);
+    while(mutexOwner(mutex)!=p) Thread::IRQenableIrqAndWait(d);
 }
 
 /**
@@ -106,7 +169,7 @@ static inline void IRQdoMutexLockToDepth(pthread_mutex_t *mutex,
     //This check is very important. Without this attempting to lock the same
     //mutex twice won't cause a deadlock because the wait is enclosed in a
     //while(owner!=p) which is immeditely false.
-    if(mutex->owner==p)
+    if(mutexOwner(mutex)==p)
     {
         if(mutex->recursive>=0)
         {
@@ -117,18 +180,10 @@ static inline void IRQdoMutexLockToDepth(pthread_mutex_t *mutex,
 
     WaitingList waiting; //Element of a linked list on stack
     waiting.thread=p;
-    waiting.next=nullptr; //Putting this thread last on the list (lifo policy)
-    if(mutex->first==nullptr)
-    {
-        mutex->first=&waiting;
-        mutex->last=&waiting;
-    } else {
-        mutex->last->next=&waiting;
-        mutex->last=&waiting;
-    }
+    IRQmutexEnqueue(mutex,&waiting);
 
     //The while is necessary to protect against spurious wakeups
-    while(mutex->owner!=p) Thread::IRQenableIrqAndWait(d);
+    while(mutexOwner(mutex)!=p) Thread::IRQenableIrqAndWait(d);
     if(mutex->recursive>=0) mutex->recursive=depth;
 }
 
@@ -152,10 +207,7 @@ static inline bool IRQdoMutexUnlock(pthread_mutex_t *mutex)
     }
     if(mutex->first!=nullptr)
     {
-        Thread *t=reinterpret_cast<Thread*>(mutex->first->thread);
-        t->IRQwakeup();
-        mutex->owner=mutex->first->thread;
-        mutex->first=mutex->first->next;
+        Thread *t=IRQmutexHandOver(mutex);
 
         #ifndef SCHED_TYPE_EDF
         if(Thread::IRQgetCurrentThread()->IRQgetPriority() < t->IRQgetPriority())
@@ -183,10 +235,7 @@ static inline unsigned int IRQdoMutexUnlockAllDepthLevels(pthread_mutex_t *mutex
 //        return false;
     if(mutex->first!=nullptr)
     {
-        Thread *t=reinterpret_cast<Thread*>(mutex->first->thread);
-        t->IRQwakeup();
-        mutex->owner=mutex->first->thread;
-        mutex->first=mutex->first->next;
+        IRQmutexHandOver(mutex);
 
         if(mutex->recursive<0) return 0;
         unsigned int result=mutex->recursive;
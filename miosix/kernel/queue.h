@@ -29,6 +29,8 @@
 
 #include "kernel.h"
 #include "error.h"
+#include <atomic>
+#include <algorithm>
 
 namespace miosix {
 
@@ -68,7 +70,7 @@ public:
     DynamicQueueBuffer(int len): data(new T[len]), len(len) {}
     T *data;
     inline unsigned int size() const { return len; }
-    ~DynamicQueueBuffer() { delete data; }
+    ~DynamicQueueBuffer() { delete[] data; }
 private:
     unsigned int len;
 };
@@ -355,6 +357,361 @@ void QueueBase<T,BufferT>::IRQreset()
     putPos=getPos=numElem=0;
 }
 
+/**
+ * Base class for a lock-free single producer, single consumer queue.
+ * Put and get only rely on load/store ordering of the two positions, so
+ * neither side needs to disable interrupts to transfer data. Interrupts are
+ * only disabled by the consumer when the queue is empty and it has to block,
+ * and by a producer running in a thread when it has to wake the consumer.
+ *
+ * Positions run in [0,2*capacity) rather than [0,capacity), so that a full
+ * queue can be told apart from an empty one without wasting an element.
+ *
+ * \tparam T the type of elements in the queue
+ * \tparam BufferT the allocator for the queue
+ */
+template <typename T, typename BufferT>
+class SpscQueueBase
+{
+public:
+    /**
+     * Constructor, create a new empty queue.
+     */
+    SpscQueueBase() : waiting(nullptr), putPos(0), getPos(0) {}
+
+    /**
+     * Constructor, create a new empty queue.
+     * \param len The length of the queue.
+     */
+    SpscQueueBase(unsigned int len) : buffer(len), waiting(nullptr),
+        putPos(0), getPos(0) {}
+
+    /**
+     * \return true if the queue is empty
+     */
+    bool isEmpty() const
+    {
+        return putPos.load(std::memory_order_acquire)==
+               getPos.load(std::memory_order_acquire);
+    }
+
+    /**
+     * \return true if the queue is full
+     */
+    bool isFull() const { return size()==buffer.size(); }
+
+    /**
+     * \return the number of elements currently in the queue. If called by
+     * the producer the actual value may be lower, if called by the consumer
+     * it may be higher, as the other side keeps running concurrently
+     */
+    unsigned int size() const
+    {
+        return distance(getPos.load(std::memory_order_acquire),
+                        putPos.load(std::memory_order_acquire));
+    }
+
+    /**
+     * \return how many elements can be enqueued before the queue is full
+     */
+    unsigned int free() const { return buffer.size()-size(); }
+
+    /**
+     * \return the maximum number of elements the queue can hold
+     */
+    unsigned int capacity() const { return buffer.size(); }
+
+    /**
+     * Put an element to the queue, only if the queue is not full.
+     * Producer side, to be called from a thread with interrupts enabled.
+     * Wakes the consumer if it is blocked waiting for data.
+     * \param elem element to add. The element has been added only if the
+     * return value is true
+     * \return true if the queue was not full
+     */
+    bool tryPut(const T& elem)
+    {
+        if(putManyImpl(&elem,1)==0) return false;
+        wakeConsumer();
+        return true;
+    }
+
+    /**
+     * Put an element to the queue, only if the queue is not full.
+     * Producer side, can ONLY be used inside an IRQ, or when interrupts are
+     * disabled. Puts the consumer out of sleep state if it is waiting, but
+     * doesn't cause any preemption.
+     * \param elem element to add. The element has been added only if the
+     * return value is true
+     * \return true if the queue was not full
+     */
+    bool IRQput(const T& elem) { return IRQputMany(&elem,1,nullptr)!=0; }
+
+    /**
+     * Put an element to the queue, only if the queue is not full.
+     * Producer side, can ONLY be used inside an IRQ, or when interrupts are
+     * disabled.
+     * \param elem element to add. The element has been added only if the
+     * return value is true
+     * \param hppw is set to `true' if a scheduler update is necessary to
+     * wake up a formerly sleeping thread with `Scheduler::IRQfindNextThread()`.
+     * Otherwise it is not modified.
+     * \return true if the queue was not full
+     */
+    bool IRQput(const T& elem, bool& hppw)
+    {
+        return IRQputMany(&elem,1,&hppw)!=0;
+    }
+
+    /**
+     * Put as many elements as fit in the queue, copying them in at most two
+     * contiguous spans. Producer side, to be called from a thread with
+     * interrupts enabled. Never blocks.
+     * \param elems elements to add
+     * \param n number of elements to add
+     * \return the number of elements actually added, which is lower than n
+     * if the queue became full
+     */
+    unsigned int putMany(const T *elems, unsigned int n)
+    {
+        unsigned int result=putManyImpl(elems,n);
+        if(result>0) wakeConsumer();
+        return result;
+    }
+
+    /**
+     * Same as putMany(), but can ONLY be used inside an IRQ, or when
+     * interrupts are disabled. Puts the consumer out of sleep state if it is
+     * waiting, but doesn't cause any preemption.
+     * \param elems elements to add
+     * \param n number of elements to add
+     * \return the number of elements actually added
+     */
+    unsigned int IRQputMany(const T *elems, unsigned int n)
+    {
+        return IRQputMany(elems,n,nullptr);
+    }
+
+    /**
+     * Same as putMany(), but can ONLY be used inside an IRQ, or when
+     * interrupts are disabled.
+     * \param elems elements to add
+     * \param n number of elements to add
+     * \param hppw is set to `true' if a scheduler update is necessary to
+     * wake up a formerly sleeping thread with `Scheduler::IRQfindNextThread()`.
+     * Otherwise it is not modified.
+     * \return the number of elements actually added
+     */
+    unsigned int IRQputMany(const T *elems, unsigned int n, bool& hppw)
+    {
+        return IRQputMany(elems,n,&hppw);
+    }
+
+    /**
+     * Get an element from the queue, only if the queue is not empty.
+     * Consumer side, never blocks and never disables interrupts.
+     * \param elem an element from the queue. The element is valid only if the
+     * return value is true
+     * \return true if the queue was not empty
+     */
+    bool tryGet(T& elem) { return tryGetMany(&elem,1)!=0; }
+
+    /**
+     * Get as many elements as are available, up to n, moving them out in at
+     * most two contiguous spans. Consumer side, never blocks and never
+     * disables interrupts.
+     * \param elems elements are stored here
+     * \param n maximum number of elements to get
+     * \return the number of elements actually retrieved
+     */
+    unsigned int tryGetMany(T *elems, unsigned int n);
+
+    /**
+     * Get an element from the queue. If the queue is empty, then sleep until
+     * an element becomes available. Consumer side, cannot be called inside
+     * an IRQ.
+     * \param elem an element from the queue
+     */
+    void get(T& elem)
+    {
+        while(tryGet(elem)==false) waitUntilNotEmpty();
+    }
+
+    /**
+     * Get up to n elements from the queue. If the queue is empty, then sleep
+     * until at least one element becomes available. Consumer side, cannot be
+     * called inside an IRQ.
+     * \param elems elements are stored here
+     * \param n maximum number of elements to get, must be greater than zero
+     * \return the number of elements actually retrieved, at least one
+     */
+    unsigned int getMany(T *elems, unsigned int n)
+    {
+        unsigned int result;
+        while((result=tryGetMany(elems,n))==0) waitUntilNotEmpty();
+        return result;
+    }
+
+    /**
+     * Clear all items in the queue. Consumer side, the discarded elements
+     * are left in the buffer and overwritten by subsequent puts.
+     */
+    void reset()
+    {
+        getPos.store(putPos.load(std::memory_order_acquire),
+                     std::memory_order_release);
+    }
+
+    //Unwanted methods
+    SpscQueueBase(const SpscQueueBase& s) = delete;
+    SpscQueueBase& operator= (const SpscQueueBase& s) = delete;
+
+private:
+    /**
+     * \param from a position
+     * \param to a position not lagging behind from
+     * \return the number of elements between the two positions
+     */
+    unsigned int distance(unsigned int from, unsigned int to) const
+    {
+        return to>=from ? to-from : to+2*buffer.size()-from;
+    }
+
+    /**
+     * \param pos a position
+     * \param n a number of elements not greater than the capacity
+     * \return pos advanced by n elements
+     */
+    unsigned int advance(unsigned int pos, unsigned int n) const
+    {
+        pos+=n;
+        return pos>=2*buffer.size() ? pos-2*buffer.size() : pos;
+    }
+
+    /**
+     * \param pos a position
+     * \return the buffer index corresponding to the position
+     */
+    unsigned int index(unsigned int pos) const
+    {
+        return pos>=buffer.size() ? pos-buffer.size() : pos;
+    }
+
+    /**
+     * Copy elements in the queue, without waking the consumer
+     * \param elems elements to add
+     * \param n number of elements to add
+     * \return the number of elements actually added
+     */
+    unsigned int putManyImpl(const T *elems, unsigned int n);
+
+    /**
+     * Put elements and wake the consumer
+     * \param elems elements to add
+     * \param n number of elements to add
+     * \param hppw if not nullptr, set to true if the woken consumer has a
+     * higher priority than the current thread
+     * \return the number of elements actually added
+     */
+    unsigned int IRQputMany(const T *elems, unsigned int n, bool *hppw)
+    {
+        unsigned int result=putManyImpl(elems,n);
+        if(result>0) IRQwakeConsumer(hppw);
+        return result;
+    }
+
+    /**
+     * Wake the consumer if it is blocked, from a thread with interrupts
+     * enabled. Does nothing if no thread is waiting.
+     */
+    void wakeConsumer();
+
+    /**
+     * Wake the consumer if it is blocked.
+     * Must be called when interrupts are disabled
+     * \param hppw if not nullptr, set to true if the woken consumer has a
+     * higher priority than the current thread
+     */
+    void IRQwakeConsumer(bool *hppw)
+    {
+        Thread *t=waiting.load(std::memory_order_relaxed);
+        if(t==nullptr) return;
+        if(hppw && Thread::IRQgetCurrentThread()->IRQgetPriority() <
+            t->IRQgetPriority()) *hppw=true;
+        t->IRQwakeup();
+        waiting.store(nullptr,std::memory_order_relaxed);
+    }
+
+    /**
+     * Block the consumer till the queue is not empty
+     */
+    void waitUntilNotEmpty();
+
+    //Queue data
+    BufferT buffer;///< queued elements are put here. Used as a ring buffer
+    std::atomic<Thread*> waiting;///< If not null holds the blocked consumer
+    std::atomic<unsigned int> putPos;///< Written only by the producer
+    std::atomic<unsigned int> getPos;///< Written only by the consumer
+};
+
+template <typename T, typename BufferT>
+unsigned int SpscQueueBase<T,BufferT>::putManyImpl(const T *elems,
+    unsigned int n)
+{
+    //The consumer only ever makes room, so stale free space is conservative
+    unsigned int p=putPos.load(std::memory_order_relaxed);
+    unsigned int g=getPos.load(std::memory_order_acquire);
+    n=std::min(n,buffer.size()-distance(g,p));
+    if(n==0) return 0;
+    unsigned int i=index(p);
+    unsigned int first=std::min(n,buffer.size()-i);
+    std::copy(elems,elems+first,buffer.data+i);
+    std::copy(elems+first,elems+n,buffer.data);
+    //Publish the elements only after they have been written
+    putPos.store(advance(p,n),std::memory_order_release);
+    return n;
+}
+
+template <typename T, typename BufferT>
+unsigned int SpscQueueBase<T,BufferT>::tryGetMany(T *elems, unsigned int n)
+{
+    //The producer only ever adds elements, so stale occupancy is conservative
+    unsigned int g=getPos.load(std::memory_order_relaxed);
+    unsigned int p=putPos.load(std::memory_order_acquire);
+    n=std::min(n,distance(g,p));
+    if(n==0) return 0;
+    unsigned int i=index(g);
+    unsigned int first=std::min(n,buffer.size()-i);
+    std::move(buffer.data+i,buffer.data+i+first,elems);
+    std::move(buffer.data,buffer.data+(n-first),elems+first);
+    //Give the slots back only after the elements have been read
+    getPos.store(advance(g,n),std::memory_order_release);
+    return n;
+}
+
+template <typename T, typename BufferT>
+void SpscQueueBase<T,BufferT>::wakeConsumer()
+{
+    //Pairs with the fence in waitUntilNotEmpty(): either the consumer sees
+    //the new putPos, or we see it waiting
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if(waiting.load(std::memory_order_relaxed)==nullptr) return;
+    FastInterruptDisableLock dLock;
+    IRQwakeConsumer(nullptr);
+}
+
+template <typename T, typename BufferT>
+void SpscQueueBase<T,BufferT>::waitUntilNotEmpty()
+{
+    FastInterruptDisableLock dLock;
+    waiting.store(Thread::IRQgetCurrentThread(),std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    //Interrupts are disabled, so an IRQ producer can't slip in between this
+    //check and the wait. A thread producer can, but it will see waiting set
+    if(isEmpty()) Thread::IRQenableIrqAndWait(dLock);
+    waiting.store(nullptr,std::memory_order_relaxed);
+}
+
 } // namespace internal
 
 /**
@@ -397,6 +754,31 @@ using Queue = internal::QueueBase<T,internal::StaticQueueBuffer<T,len>>;
 template<typename T>
 using DynQueue = internal::QueueBase<T,internal::DynamicQueueBuffer<T>>;
 
+/**
+ * A lock-free queue used to transfer data from exactly ONE producer to exactly
+ * ONE consumer, typically from an IRQ to a thread. Unlike Queue, putting and
+ * getting elements never disables interrupts, and the putMany()/tryGetMany()
+ * member functions transfer whole spans at once, making it suitable for
+ * high-rate streams such as serial ports or ADCs. Only the consumer can
+ * block, and only when the queue is empty. The producer can't block, when
+ * the queue is full put fails.<br>
+ * The capacity of the queue is fixed and determined at compile time.
+ *
+ * \tparam T the type of elements in the queue
+ * \tparam len the length of the queue. Value 0 is forbidden
+ */
+template<typename T, unsigned int len>
+using SpscQueue = internal::SpscQueueBase<T,internal::StaticQueueBuffer<T,len>>;
+
+/**
+ * Same as SpscQueue, but the capacity of the queue is fixed after
+ * instantiation.
+ *
+ * \tparam T the type of elements in the queue
+ */
+template<typename T>
+using DynSpscQueue = internal::SpscQueueBase<T,internal::DynamicQueueBuffer<T>>;
+
 /**
  * An unsynchronized circular buffer data structure with the storage dynamically
  * allocated on the heap.
@@ -41,7 +41,7 @@ namespace miosix {
 extern volatile Thread *runningThread;
 extern volatile int kernelRunning;
 extern volatile bool pendingWakeup;
-extern IntrusiveList<SleepData> sleepingList;
+extern SleepQueue<SleepData> sleepingList;
 
 //Internal
 static long long burstStart=0;
@@ -50,8 +50,7 @@ static long long nextPreemption=numeric_limits<long long>::max();
 // Should be called when the running thread is the idle thread
 static inline void IRQsetNextPreemptionForIdle()
 {
-    if(sleepingList.empty()) nextPreemption=numeric_limits<long long>::max();
-    else nextPreemption=sleepingList.front()->wakeupTime;
+    nextPreemption=sleepingList.nextWakeupTime();
     #ifdef WITH_CPU_TIME_COUNTER
     burstStart=IRQgetTime();
     #endif // WITH_CPU_TIME_COUNTER
@@ -63,9 +62,7 @@ static inline void IRQsetNextPreemptionForIdle()
 // Should be called for threads other than idle thread
 static inline void IRQsetNextPreemption(long long burst)
 {
-    long long firstWakeupInList;
-    if(sleepingList.empty()) firstWakeupInList=numeric_limits<long long>::max();
-    else firstWakeupInList=sleepingList.front()->wakeupTime;
+    long long firstWakeupInList=sleepingList.nextWakeupTime();
     burstStart=IRQgetTime();
     nextPreemption=min(firstWakeupInList,burstStart+burst);
     internal::IRQosTimerSetInterrupt(nextPreemption);
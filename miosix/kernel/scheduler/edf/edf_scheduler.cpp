@@ -41,7 +41,7 @@ namespace miosix {
 extern volatile Thread *runningThread;
 extern volatile int kernelRunning;
 extern volatile bool pendingWakeup;
-extern IntrusiveList<SleepData> sleepingList;
+extern SleepQueue<SleepData> sleepingList;
 
 //Static members
 static long long nextPreemption=numeric_limits<long long>::max();
@@ -53,7 +53,18 @@ static long long nextPreemption=numeric_limits<long long>::max();
 bool EDFScheduler::PKaddThread(Thread *thread, EDFSchedulerPriority priority)
 {
     thread->schedData.deadline=priority;
-    add(thread);
+    thread->schedData.next=head;
+    head=thread;
+    thread->schedData.rqEntry.t=thread;
+    //The ready queue is also modified by IRQwaitStatusHook within interrupts,
+    //so pausing the kernel is not enough. Not using a FastInterruptDisableLock
+    //as this is also called before the kernel is started
+    InterruptDisableLock dLock;
+    if(thread->flags.isReady())
+    {
+        IRQaddToReadyQueue(thread);
+        thread->schedData.lastReadyStatus=true;
+    }
     return true;
 }
 
@@ -100,15 +111,25 @@ void EDFScheduler::PKremoveDeadThreads()
 void EDFScheduler::PKsetPriority(Thread *thread,
         EDFSchedulerPriority newPriority)
 {
-    remove(thread);
-    thread->schedData.deadline=newPriority;
-    add(thread);
+    InterruptDisableLock dLock;
+    if(thread->schedData.lastReadyStatus)
+    {
+        IRQremoveFromReadyQueue(thread);
+        thread->schedData.deadline=newPriority;
+        IRQaddToReadyQueue(thread);
+    } else thread->schedData.deadline=newPriority;
 }
 
 void EDFScheduler::IRQsetIdleThread(Thread *idleThread)
 {
     idleThread->schedData.deadline=numeric_limits<long long>::max()-1;
-    add(idleThread);
+    idleThread->schedData.next=head;
+    head=idleThread;
+    idleThread->schedData.rqEntry.t=idleThread;
+    //The idle thread is always ready, and its deadline is the latest one among
+    //the valid ones, so the ready queue is never empty
+    IRQaddToReadyQueue(idleThread);
+    idleThread->schedData.lastReadyStatus=true;
 }
 
 long long EDFScheduler::IRQgetNextPreemption()
@@ -118,8 +139,7 @@ long long EDFScheduler::IRQgetNextPreemption()
 
 static void IRQsetNextPreemption()
 {
-    if(sleepingList.empty()) nextPreemption=numeric_limits<long long>::max();
-    else nextPreemption=sleepingList.front()->wakeupTime;
+    nextPreemption=sleepingList.nextWakeupTime();
 
     //We could not set an interrupt if the sleeping list is empty, but then we
     //would spuriously run the scheduler at every rollover of the hardware timer
@@ -137,87 +157,56 @@ void EDFScheduler::IRQfindNextThread()
     #ifdef WITH_CPU_TIME_COUNTER
     Thread *prev=const_cast<Thread*>(runningThread);
     #endif // WITH_CPU_TIME_COUNTER
-    Thread *walk=head;
-    for(;;)
+    //The first thread in the ready queue is the one with the earliest deadline
+    if(readyQueue.empty()) errorHandler(UNEXPECTED);
+    Thread *next=readyQueue.front()->t;
+    runningThread=next;
+    #ifdef WITH_PROCESSES
+    if(const_cast<Thread*>(runningThread)->flags.isInUserspace()==false)
     {
-        if(walk==nullptr) errorHandler(UNEXPECTED);
-        if(walk->flags.isReady())
-        {
-            runningThread=walk;
-            #ifdef WITH_PROCESSES
-            if(const_cast<Thread*>(runningThread)->flags.isInUserspace()==false)
-            {
-                ctxsave=runningThread->ctxsave;
-                MPUConfiguration::IRQdisable();
-            } else {
-                ctxsave=runningThread->userCtxsave;
-                //A kernel thread is never in userspace, so the cast is safe
-                static_cast<Process*>(runningThread->proc)->mpu.IRQenable();
-            }
-            #else //WITH_PROCESSES
-            ctxsave=runningThread->ctxsave;
-            #endif //WITH_PROCESSES
-            IRQsetNextPreemption();
-            #ifdef WITH_CPU_TIME_COUNTER
-            IRQprofileContextSwitch(prev->timeCounterData,walk->timeCounterData,
-                                    IRQgetTime());
-            #endif //WITH_CPU_TIME_COUNTER
-            return;
-        }
-        walk=walk->schedData.next;
+        ctxsave=runningThread->ctxsave;
+        MPUConfiguration::IRQdisable();
+    } else {
+        ctxsave=runningThread->userCtxsave;
+        //A kernel thread is never in userspace, so the cast is safe
+        static_cast<Process*>(runningThread->proc)->mpu.IRQenable();
     }
+    #else //WITH_PROCESSES
+    ctxsave=runningThread->ctxsave;
+    #endif //WITH_PROCESSES
+    IRQsetNextPreemption();
+    #ifdef WITH_CPU_TIME_COUNTER
+    IRQprofileContextSwitch(prev->timeCounterData,next->timeCounterData,
+                            IRQgetTime());
+    #endif //WITH_CPU_TIME_COUNTER
 }
 
-void EDFScheduler::add(Thread *thread)
+void EDFScheduler::IRQwaitStatusHook(Thread *t)
 {
-    long long newDeadline=thread->schedData.deadline.get();
-    if(head==nullptr)
-    {
-        head=thread;
-        return;
-    }
-    if(newDeadline<=head->schedData.deadline.get())
-    {
-        thread->schedData.next=head;
-        head=thread;
-        return;
-    }
-    Thread *walk=head;
-    for(;;)
+    if(t->flags.isReady() && !t->schedData.lastReadyStatus)
     {
-        if(walk->schedData.next==nullptr || newDeadline<=
-           walk->schedData.next->schedData.deadline.get())
-        {
-            thread->schedData.next=walk->schedData.next;
-            walk->schedData.next=thread;
-            break;
-        }
-        walk=walk->schedData.next;
+        IRQaddToReadyQueue(t);
+        t->schedData.lastReadyStatus=true;
+    } else if(!t->flags.isReady() && t->schedData.lastReadyStatus) {
+        IRQremoveFromReadyQueue(t);
+        t->schedData.lastReadyStatus=false;
     }
 }
 
-void EDFScheduler::remove(Thread *thread)
+void EDFScheduler::IRQaddToReadyQueue(Thread *thread)
 {
-    if(head==nullptr) errorHandler(UNEXPECTED);
-    if(head==thread)
-    {
-        head=head->schedData.next;
-        return;
-    }
-    Thread *walk=head;
-    for(;;)
-    {
-        if(walk->schedData.next==nullptr) errorHandler(UNEXPECTED);
-        if(walk->schedData.next==thread)
-        {
-            walk->schedData.next=walk->schedData.next->schedData.next;
-            break;
-        }
-        walk=walk->schedData.next;
-    }
+    thread->schedData.rqEntry.wakeupTime=thread->schedData.deadline.get();
+    readyQueue.insert(&thread->schedData.rqEntry);
+}
+
+void EDFScheduler::IRQremoveFromReadyQueue(Thread *thread)
+{
+    if(readyQueue.removeFast(&thread->schedData.rqEntry)==false)
+        errorHandler(UNEXPECTED);
 }
 
 Thread *EDFScheduler::head=nullptr;
+SleepQueue<EDFReadyQueueItem,PairingHeapSleepQueueBase> EDFScheduler::readyQueue;
 
 } //namespace miosix
 
@@ -110,7 +110,7 @@ public:
      * its running status. For example when a thread become sleeping, waiting,
      * deleted or if it exits the sleeping or waiting status
      */
-    static void IRQwaitStatusHook(Thread *t) {}
+    static void IRQwaitStatusHook(Thread *t);
 
     /**
      * This function is used to develop interrupt driven peripheral drivers.<br>
@@ -135,18 +135,21 @@ public:
     
 private:
     /**
-     * Add a thread to the list of threads, keeping the list ordered by deadline
+     * Add a thread to the ready queue, using its current deadline
      * \param thread thread to add
      */
-    static void add(Thread *thread);
+    static void IRQaddToReadyQueue(Thread *thread);
 
     /**
-     * Remove a thread to the list of threads.
+     * Remove a thread from the ready queue
      * \param thread thread to remove
      */
-    static void remove(Thread *thread);
+    static void IRQremoveFromReadyQueue(Thread *thread);
 
-    static Thread *head;///<\internal Head of threads list, ordered by deadline
+    static Thread *head;///<\internal Head of threads list, unordered
+    ///\internal Ready threads, ordered by deadline. Blocked threads are only
+    ///in the threads list
+    static SleepQueue<EDFReadyQueueItem,PairingHeapSleepQueueBase> readyQueue;
 };
 
 } //namespace miosix
@@ -28,6 +28,7 @@
 #pragma once
 
 #include "config/miosix_settings.h"
+#include "kernel/sleep_queue.h"
 #include <limits>
 
 #ifdef SCHED_TYPE_EDF
@@ -130,6 +131,19 @@ inline bool operator!=(EDFSchedulerPriority a, EDFSchedulerPriority b)
     return a.get() != b.get();
 }
 
+/**
+ * \internal
+ * Item of the EDF ready queue. The ready queue is a pairing heap that reuses
+ * the SleepQueue implementation, with the thread deadline stored as wakeupTime
+ */
+class EDFReadyQueueItem : public SleepQueueItem
+{
+public:
+    EDFReadyQueueItem() : SleepQueueItem(0) {}
+
+    Thread *t=nullptr; ///<\internal thread to which the item belongs
+};
+
 /**
  * \internal
  * An instance of this class is embedded in every Thread class. It contains all
@@ -139,7 +153,9 @@ class EDFSchedulerData
 {
 public:
     EDFSchedulerPriority deadline; ///<\internal thread deadline
-    Thread *next=nullptr; ///<\internal list of threads, ordered by deadline
+    Thread *next=nullptr; ///<\internal list of all threads, unordered
+    EDFReadyQueueItem rqEntry; ///<\internal entry in the ready queue
+    bool lastReadyStatus=false;///<\internal true if in the ready queue
 };
 
 } //namespace miosix
@@ -38,11 +38,13 @@ namespace miosix {
 extern volatile Thread *runningThread;
 extern volatile int kernelRunning;
 extern volatile bool pendingWakeup;
-extern IntrusiveList<SleepData> sleepingList;
+extern SleepQueue<SleepData> sleepingList;
 
 //Internal data
 static long long nextPeriodicPreemption=std::numeric_limits<long long>::max();
 
+static_assert(PRIORITY_MAX<=32,"readyBitmap can't handle more than 32 priorities");
+
 //
 // class PriorityScheduler
 //
@@ -59,6 +61,16 @@ bool PriorityScheduler::PKaddThread(Thread *thread,
         thread->schedData.next=threadList[priority.get()]->schedData.next;
         threadList[priority.get()]->schedData.next=thread;
     }
+    thread->schedData.rqEntry.t=thread;
+    //The ready queues are also modified by IRQwaitStatusHook within interrupts,
+    //so pausing the kernel is not enough. Not using a FastInterruptDisableLock
+    //as this is also called before the kernel is started
+    InterruptDisableLock dLock;
+    if(thread->flags.isReady())
+    {
+        IRQaddToReadyQueue(thread);
+        thread->schedData.lastReadyStatus=true;
+    }
     return true;
 }
 
@@ -142,8 +154,16 @@ void PriorityScheduler::PKsetPriority(Thread *thread,
         PrioritySchedulerPriority newPriority)
 {
     PrioritySchedulerPriority oldPriority=thread->PKgetPriority();
-    //First set priority to the new value
-    thread->schedData.priority=newPriority;
+    //First move the thread to the ready queue of the new priority, if ready
+    {
+        InterruptDisableLock dLock;
+        if(thread->schedData.lastReadyStatus)
+        {
+            IRQremoveFromReadyQueue(thread);
+            thread->schedData.priority=newPriority;
+            IRQaddToReadyQueue(thread);
+        } else thread->schedData.priority=newPriority;
+    }
     //Then remove the thread from its old list
     if(threadList[oldPriority.get()]==thread)
     {
@@ -199,6 +219,22 @@ void PriorityScheduler::IRQsetIdleThread(Thread *idleThread)
     idle=idleThread;
 }
 
+void PriorityScheduler::IRQwaitStatusHook(Thread* t)
+{
+    //The idle thread is not in any ready queue, it is run when all are empty
+    if(t==idle) return;
+    if(t->flags.isReady() && !t->schedData.lastReadyStatus)
+    {
+        //The thread has become ready -> put it in the ready queue
+        IRQaddToReadyQueue(t);
+        t->schedData.lastReadyStatus=true;
+    } else if(!t->flags.isReady() && t->schedData.lastReadyStatus) {
+        //The thread is no longer ready -> remove it from the ready queue
+        IRQremoveFromReadyQueue(t);
+        t->schedData.lastReadyStatus=false;
+    }
+}
+
 long long PriorityScheduler::IRQgetNextPreemption()
 {
     return nextPeriodicPreemption;
@@ -206,9 +242,7 @@ long long PriorityScheduler::IRQgetNextPreemption()
 
 static long long IRQsetNextPreemption(bool runningIdleThread)
 {
-    long long first;
-    if(sleepingList.empty()) first=std::numeric_limits<long long>::max();
-    else first=sleepingList.front()->wakeupTime;
+    long long first=sleepingList.nextWakeupTime();
 
     long long t=IRQgetTime();
     if(runningIdleThread) nextPeriodicPreemption=first;
@@ -230,42 +264,39 @@ void PriorityScheduler::IRQfindNextThread()
     #ifdef WITH_CPU_TIME_COUNTER
     Thread *prev=const_cast<Thread*>(runningThread);
     #endif // WITH_CPU_TIME_COUNTER
-    for(int i=PRIORITY_MAX-1;i>=0;i--)
+    if(readyBitmap!=0)
     {
-        if(threadList[i]==nullptr) continue;
-        Thread *temp=threadList[i]->schedData.next;
-        for(;;)
+        //Highest priority with at least one ready thread
+        int i=31-__builtin_clz(readyBitmap);
+        Thread *temp=readyQueue[i].front()->t;
+        //Rotate the ready queue so that next time a different thread, if
+        //available, will be chosen first
+        if(readyQueue[i].front()!=readyQueue[i].back())
         {
-            if(temp->flags.isReady())
-            {
-                //Found a READY thread, so run this one
-                runningThread=temp;
-                #ifdef WITH_PROCESSES
-                if(const_cast<Thread*>(runningThread)->flags.isInUserspace()==false)
-                {
-                    ctxsave=runningThread->ctxsave;
-                    MPUConfiguration::IRQdisable();
-                } else {
-                    ctxsave=runningThread->userCtxsave;
-                    //A kernel thread is never in userspace, so the cast is safe
-                    static_cast<Process*>(runningThread->proc)->mpu.IRQenable();
-                }
-                #else //WITH_PROCESSES
-                ctxsave=temp->ctxsave;
-                #endif //WITH_PROCESSES
-                //Rotate to next thread so that next time the list is walked
-                //a different thread, if available, will be chosen first
-                threadList[i]=temp;
-                #ifndef WITH_CPU_TIME_COUNTER
-                IRQsetNextPreemption(false);
-                #else //WITH_CPU_TIME_COUNTER
-                auto t=IRQsetNextPreemption(false);
-                IRQprofileContextSwitch(prev->timeCounterData,temp->timeCounterData,t);
-                #endif //WITH_CPU_TIME_COUNTER
-                return;
-            } else temp=temp->schedData.next;
-            if(temp==threadList[i]->schedData.next) break;
+            readyQueue[i].pop_front();
+            readyQueue[i].push_back(&temp->schedData.rqEntry);
         }
+        runningThread=temp;
+        #ifdef WITH_PROCESSES
+        if(const_cast<Thread*>(runningThread)->flags.isInUserspace()==false)
+        {
+            ctxsave=runningThread->ctxsave;
+            MPUConfiguration::IRQdisable();
+        } else {
+            ctxsave=runningThread->userCtxsave;
+            //A kernel thread is never in userspace, so the cast is safe
+            static_cast<Process*>(runningThread->proc)->mpu.IRQenable();
+        }
+        #else //WITH_PROCESSES
+        ctxsave=temp->ctxsave;
+        #endif //WITH_PROCESSES
+        #ifndef WITH_CPU_TIME_COUNTER
+        IRQsetNextPreemption(false);
+        #else //WITH_CPU_TIME_COUNTER
+        auto t=IRQsetNextPreemption(false);
+        IRQprofileContextSwitch(prev->timeCounterData,temp->timeCounterData,t);
+        #endif //WITH_CPU_TIME_COUNTER
+        return;
     }
     //No thread found, run the idle thread
     runningThread=idle;
@@ -281,7 +312,23 @@ void PriorityScheduler::IRQfindNextThread()
     #endif //WITH_CPU_TIME_COUNTER
 }
 
+void PriorityScheduler::IRQaddToReadyQueue(Thread *thread)
+{
+    int i=thread->schedData.priority.get();
+    readyQueue[i].push_back(&thread->schedData.rqEntry);
+    readyBitmap|=1<<i;
+}
+
+void PriorityScheduler::IRQremoveFromReadyQueue(Thread *thread)
+{
+    int i=thread->schedData.priority.get();
+    readyQueue[i].removeFast(&thread->schedData.rqEntry);
+    if(readyQueue[i].empty()) readyBitmap&=~(1<<i);
+}
+
 Thread *PriorityScheduler::threadList[PRIORITY_MAX]={nullptr};
+IntrusiveList<PriorityReadyListItem> PriorityScheduler::readyQueue[PRIORITY_MAX];
+unsigned int PriorityScheduler::readyBitmap=0;
 Thread *PriorityScheduler::idle=nullptr;
 
 } //namespace miosix
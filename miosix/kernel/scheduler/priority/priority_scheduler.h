@@ -111,7 +111,7 @@ public:
      * its running status. For example when a thread become sleeping, waiting,
      * deleted or if it exits the sleeping or waiting status
      */
-    static void IRQwaitStatusHook(Thread* t) {}
+    static void IRQwaitStatusHook(Thread* t);
 
     /**
      * \internal
@@ -137,10 +137,34 @@ public:
 
 private:
 
+    /**
+     * \internal
+     * Add a thread to the ready queue of its priority.
+     * Can only be called with interrupts disabled or within an interrupt.
+     * \param thread thread to add
+     */
+    static void IRQaddToReadyQueue(Thread *thread);
+
+    /**
+     * \internal
+     * Remove a thread from the ready queue of its priority.
+     * Can only be called with interrupts disabled or within an interrupt.
+     * \param thread thread to remove
+     */
+    static void IRQremoveFromReadyQueue(Thread *thread);
+
     ///\internal Vector of lists of threads, there's one list for each priority
     ///Each list s a circular list.
     static Thread *threadList[PRIORITY_MAX];
 
+    ///\internal Vector of lists of ready threads, one for each priority.
+    ///Blocked threads are not in these lists, so selecting the next thread to
+    ///run does not depend on the number of blocked threads
+    static IntrusiveList<PriorityReadyListItem> readyQueue[PRIORITY_MAX];
+
+    ///\internal Bit i is set if readyQueue[i] is not empty
+    static unsigned int readyBitmap;
+
     ///\internal idle thread
     static Thread *idle;
 };
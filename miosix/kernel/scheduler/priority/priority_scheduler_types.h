@@ -28,6 +28,7 @@
 #pragma once
 
 #include "config/miosix_settings.h"
+#include "kernel/intrusive.h"
 
 #ifdef SCHED_TYPE_PRIORITY
 
@@ -116,6 +117,15 @@ inline bool operator!=(PrioritySchedulerPriority a, PrioritySchedulerPriority b)
     return a.get() != b.get();
 }
 
+/**
+ * \internal
+ * Entry of a thread in the ready queue of its priority
+ */
+struct PriorityReadyListItem : public IntrusiveListItem
+{
+    Thread *t=nullptr;
+};
+
 /**
  * \internal
  * An instance of this class is embedded in every Thread class. It contains all
@@ -130,6 +140,8 @@ public:
     ///list to the new priority list.
     PrioritySchedulerPriority priority;
     Thread *next;///<Pointer to next thread of the same priority. CIRCULAR list
+    PriorityReadyListItem rqEntry;///<Entry in the ready queue of its priority
+    bool lastReadyStatus=false;///<True if the thread is in a ready queue
 };
 
 } //namespace miosix
@@ -32,6 +32,8 @@
 #include "kernel/scheduler/control/control_scheduler.h"
 #include "kernel/scheduler/edf/edf_scheduler.h"
 #include "kernel/cpu_time_counter.h"
+#include "kernel/latency_stats.h"
+#include "kernel/trace.h"
 
 namespace miosix {
 
@@ -165,7 +167,24 @@ public:
      */
     static void IRQfindNextThread()
     {
+        #if !defined(WITH_LATENCY_STATS) && !defined(WITH_KERNEL_TRACE)
         T::IRQfindNextThread();
+        #else //WITH_LATENCY_STATS || WITH_KERNEL_TRACE
+        #ifdef WITH_LATENCY_STATS
+        unsigned int start=CycleCounter::IRQget();
+        #endif //WITH_LATENCY_STATS
+        Thread *prev=Thread::IRQgetCurrentThread();
+        T::IRQfindNextThread();
+        #ifdef WITH_LATENCY_STATS
+        LatencyStats::IRQthreadScheduled(prev,start);
+        #endif //WITH_LATENCY_STATS
+        #ifdef WITH_KERNEL_TRACE
+        Thread *next=Thread::IRQgetCurrentThread();
+        if(next!=prev) KernelTrace::IRQrecord(TraceEventType::ContextSwitch,0,
+            reinterpret_cast<unsigned int>(prev),
+            reinterpret_cast<unsigned int>(next));
+        #endif //WITH_KERNEL_TRACE
+        #endif //WITH_LATENCY_STATS || WITH_KERNEL_TRACE
     }
     
     /**
@@ -35,6 +35,9 @@ namespace miosix {
 //This is a function that is part of the internal implementation of the kernel
 //and is defined in kernel.cpp. User code should not know about these nor try to use them.
 extern bool IRQwakeThreads(long long currentTime);///\internal Do not use outside the kernel
+#ifdef WITH_TIMERS
+extern void IRQrearmOsTimer();///\internal Defined in timer.cpp
+#endif //WITH_TIMERS
 
 /**
  * Performs thread wakeup and preemption in response to a scheduled timer
@@ -53,6 +56,11 @@ inline bool IRQtimerInterrupt(long long currentTime)
         Scheduler::IRQfindNextThread();//If the kernel is running, preempt
         return false;
     }
+    #ifdef WITH_TIMERS
+    //Timers are started and periodic timers rearmed without a context switch,
+    //so the OS timer may have to fire again before the next preemption
+    IRQrearmOsTimer();
+    #endif //WITH_TIMERS
     return true;
 }
 
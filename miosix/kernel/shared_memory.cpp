@@ -0,0 +1,127 @@
+/***************************************************************************
+ *   Copyright (C) 2024 by Terraneo Federico                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+#include "shared_memory.h"
+#include "process_pool.h"
+#include "libsyscalls/include/sys/ipc.h"
+#include <cstring>
+#include <climits>
+#include <tuple>
+#include <errno.h>
+
+using namespace std;
+
+#ifdef WITH_PROCESSES
+
+namespace miosix {
+
+SharedMemoryTable& SharedMemoryTable::instance()
+{
+    static SharedMemoryTable table;
+    return table;
+}
+
+int SharedMemoryTable::get(int key, unsigned int size, int flags)
+{
+    Lock<FastMutex> l(mutex);
+    if(key!=IPC_PRIVATE)
+    {
+        for(auto& s : segments)
+        {
+            if(s.removed || s.key!=key) continue;
+            if((flags & IPC_CREAT) && (flags & IPC_EXCL)) return -EEXIST;
+            if(size>s.size) return -EINVAL;
+            return s.id;
+        }
+        if((flags & IPC_CREAT)==0) return -ENOENT;
+    }
+    if(size==0) return -EINVAL;
+    if(nextId==INT_MAX) return -ENOSPC;
+    Segment s={};
+    try {
+        tie(s.base,s.size)=ProcessPool::instance().allocate(size);
+        s.id=nextId;
+        s.key=key;
+        segments.push_back(s);
+    } catch(bad_alloc&) {
+        if(s.base) ProcessPool::instance().deallocate(s.base);
+        return -ENOMEM;
+    }
+    //Don't leak the previous content of the process pool to processes
+    memset(s.base,0,s.size);
+    return nextId++;
+}
+
+int SharedMemoryTable::attach(int id, unsigned int *& base, unsigned int& size)
+{
+    Lock<FastMutex> l(mutex);
+    for(auto& s : segments)
+    {
+        if(s.id!=id || s.removed) continue;
+        s.attachCount++;
+        base=s.base;
+        size=s.size;
+        return 0;
+    }
+    return -EINVAL;
+}
+
+void SharedMemoryTable::detach(unsigned int *base)
+{
+    Lock<FastMutex> l(mutex);
+    for(auto it=segments.begin();it!=segments.end();++it)
+    {
+        if(it->base!=base) continue;
+        it->attachCount--;
+        freeIfUnused(it);
+        return;
+    }
+}
+
+int SharedMemoryTable::remove(int id)
+{
+    Lock<FastMutex> l(mutex);
+    for(auto it=segments.begin();it!=segments.end();++it)
+    {
+        if(it->id!=id || it->removed) continue;
+        it->removed=true;
+        freeIfUnused(it);
+        return 0;
+    }
+    return -EINVAL;
+}
+
+void SharedMemoryTable::freeIfUnused(list<Segment>::iterator it)
+{
+    if(it->removed==false || it->attachCount>0) return;
+    ProcessPool::instance().deallocate(it->base);
+    segments.erase(it);
+}
+
+} //namespace miosix
+
+#endif //WITH_PROCESSES
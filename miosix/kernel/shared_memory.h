@@ -0,0 +1,117 @@
+/***************************************************************************
+ *   Copyright (C) 2024 by Terraneo Federico                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+#pragma once
+
+#include "config/miosix_settings.h"
+#include "sync.h"
+#include <list>
+
+#ifdef WITH_PROCESSES
+
+namespace miosix {
+
+/**
+ * \internal
+ * The table of System V shared memory segments. Segments are allocated from
+ * the process pool, so they are aligned to their size and can be mapped in a
+ * process with a single MPU region.
+ */
+class SharedMemoryTable
+{
+public:
+    /**
+     * \return an instance of the shared memory table (singleton)
+     */
+    static SharedMemoryTable& instance();
+
+    /**
+     * Get a shared memory segment, possibly creating it
+     * \param key segment key, or IPC_PRIVATE
+     * \param size segment size
+     * \param flags IPC_CREAT, IPC_EXCL
+     * \return the segment id, or a negative error code
+     */
+    int get(int key, unsigned int size, int flags);
+
+    /**
+     * Increment the attach count of a segment
+     * \param id segment id
+     * \param base the segment base address is returned here
+     * \param size the segment size, rounded as required by the MPU, is
+     * returned here
+     * \return 0 on success, or a negative error code
+     */
+    int attach(int id, unsigned int *& base, unsigned int& size);
+
+    /**
+     * Decrement the attach count of a segment, freeing the segment if it was
+     * removed and this was the last attachment
+     * \param base segment base address
+     */
+    void detach(unsigned int *base);
+
+    /**
+     * Mark a segment as removed, it will be freed once no longer attached
+     * \param id segment id
+     * \return 0 on success, or a negative error code
+     */
+    int remove(int id);
+
+private:
+    SharedMemoryTable() {}
+    SharedMemoryTable(const SharedMemoryTable&)=delete;
+    SharedMemoryTable& operator=(const SharedMemoryTable&)=delete;
+
+    /**
+     * A shared memory segment
+     */
+    class Segment
+    {
+    public:
+        int id;             ///< Segment id
+        int key;            ///< Key, or IPC_PRIVATE
+        unsigned int *base; ///< Base address, within the process pool
+        unsigned int size;  ///< Size, as allocated in the process pool
+        int attachCount;    ///< Number of processes the segment is attached to
+        bool removed;       ///< True if no longer found by key
+    };
+
+    /**
+     * Free a segment, if it was removed and is no longer attached
+     * \param it segment to check
+     */
+    void freeIfUnused(std::list<Segment>::iterator it);
+
+    std::list<Segment> segments; ///< All existing segments
+    int nextId=1;                ///< Id to assign to the next segment
+    FastMutex mutex;             ///< Mutex to guard concurrent access
+};
+
+} //namespace miosix
+
+#endif //WITH_PROCESSES
@@ -0,0 +1,296 @@
+/***************************************************************************
+ *   Copyright (C) 2024 by Terraneo Federico                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+#include "sleep_queue.h"
+
+#ifdef TEST_ALGORITHM
+#include <iostream>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <cassert>
+
+using namespace std;
+#endif //TEST_ALGORITHM
+
+namespace miosix {
+
+//
+// class SortedListSleepQueueBase
+//
+
+void SortedListSleepQueueBase::insert(SleepQueueItem *item)
+{
+    if(head==nullptr || head->wakeupTime>=item->wakeupTime)
+    {
+        item->next=head;
+        if(head) head->prev=item;
+        head=item;
+    } else {
+        SleepQueueItem *cur=head;
+        while(cur->next && cur->next->wakeupTime<item->wakeupTime) cur=cur->next;
+        item->prev=cur;
+        item->next=cur->next;
+        if(cur->next) cur->next->prev=item;
+        cur->next=item;
+    }
+}
+
+void SortedListSleepQueueBase::pop_front()
+{
+    SleepQueueItem *removedItem=head;
+    head=removedItem->next;
+    if(head) head->prev=nullptr;
+    removedItem->next=nullptr;
+}
+
+bool SortedListSleepQueueBase::removeFast(SleepQueueItem *item)
+{
+    if(item->prev==nullptr)
+    {
+        if(head!=item) return false;
+        pop_front();
+        return true;
+    }
+    item->prev->next=item->next;
+    if(item->next) item->next->prev=item->prev;
+    item->prev=nullptr;
+    item->next=nullptr;
+    return true;
+}
+
+//
+// class PairingHeapSleepQueueBase
+//
+
+void PairingHeapSleepQueueBase::insert(SleepQueueItem *item)
+{
+    root= root ? meld(root,item) : item;
+}
+
+void PairingHeapSleepQueueBase::pop_front()
+{
+    SleepQueueItem *removedItem=root;
+    root=mergePairs(removedItem->child);
+    removedItem->child=nullptr;
+}
+
+bool PairingHeapSleepQueueBase::removeFast(SleepQueueItem *item)
+{
+    //Only the root has no prev pointer among the items in the heap
+    if(item->prev==nullptr)
+    {
+        if(root!=item) return false;
+        pop_front();
+        return true;
+    }
+    //Detach the subtree rooted at item, prev is either the parent (if item
+    //is the leftmost child) or the left sibling
+    if(item->prev->child==item) item->prev->child=item->next;
+    else item->prev->next=item->next;
+    if(item->next) item->next->prev=item->prev;
+    item->prev=nullptr;
+    item->next=nullptr;
+    //Then meld back its children
+    SleepQueueItem *subtree=mergePairs(item->child);
+    item->child=nullptr;
+    if(subtree) root=meld(root,subtree);
+    return true;
+}
+
+SleepQueueItem *PairingHeapSleepQueueBase::meld(SleepQueueItem *a,
+                                                SleepQueueItem *b)
+{
+    if(b->wakeupTime<a->wakeupTime) { SleepQueueItem *t=a; a=b; b=t; }
+    //b becomes the leftmost child of a
+    b->prev=a;
+    b->next=a->child;
+    if(a->child) a->child->prev=b;
+    a->child=b;
+    return a;
+}
+
+SleepQueueItem *PairingHeapSleepQueueBase::mergePairs(SleepQueueItem *first)
+{
+    if(first==nullptr) return nullptr;
+    //First pass, left to right: meld siblings in pairs, pushing the resulting
+    //heaps in a stack linked through the next pointer
+    SleepQueueItem *stack=nullptr;
+    while(first)
+    {
+        SleepQueueItem *a=first;
+        SleepQueueItem *b=a->next;
+        first= b ? b->next : nullptr;
+        a->prev=a->next=nullptr;
+        if(b)
+        {
+            b->prev=b->next=nullptr;
+            a=meld(a,b);
+        }
+        a->next=stack;
+        stack=a;
+    }
+    //Second pass, right to left: meld the stack into a single heap
+    SleepQueueItem *result=stack;
+    stack=stack->next;
+    result->next=nullptr;
+    while(stack)
+    {
+        SleepQueueItem *a=stack;
+        stack=stack->next;
+        a->next=nullptr;
+        result=meld(result,a);
+    }
+    return result;
+}
+
+} //namespace miosix
+
+//Testsuite and microbenchmark for SleepQueue. Compile with:
+//g++ -DTEST_ALGORITHM -fsanitize=address -std=c++14 -Wall -O2
+//    -o test sleep_queue.cpp; ./test
+//Remove -fsanitize=address for meaningful benchmark figures
+#ifdef TEST_ALGORITHM
+
+using namespace miosix;
+
+struct Item : public SleepQueueItem
+{
+    Item() : SleepQueueItem(0) {}
+};
+
+/**
+ * Check that items come out of the queue in order, and that removeFast()
+ * correctly reports whether an item is present
+ */
+template<typename Base>
+void testQueue(unsigned int seed)
+{
+    const int n=1000;
+    mt19937 rng(seed);
+    uniform_int_distribution<long long> dist(0,n/2); //Force duplicates
+    vector<Item> items(n);
+    SleepQueue<Item,Base> q;
+    assert(q.empty());
+    assert(q.nextWakeupTime()==numeric_limits<long long>::max());
+    assert(q.removeFast(&items[0])==false); //Not present, queue empty
+    for(auto& it : items) { it.wakeupTime=dist(rng); q.insert(&it); }
+    assert(q.empty()==false);
+    Item notInserted;
+    assert(q.removeFast(&notInserted)==false); //Not present, queue not empty
+    //Remove the front and then about one third of the items in random order
+    vector<bool> removed(n,false);
+    Item *first=q.front();
+    assert(q.removeFast(first)==true);
+    removed[first-items.data()]=true;
+    for(int i=0;i<n/3;i++)
+    {
+        int j=rng()%n;
+        assert(q.removeFast(&items[j])==!removed[j]);
+        removed[j]=true;
+    }
+    //The remaining items must come out sorted
+    long long last=numeric_limits<long long>::min();
+    while(!q.empty())
+    {
+        Item *front=q.front();
+        assert(front->wakeupTime==q.nextWakeupTime());
+        assert(front->wakeupTime>=last);
+        last=front->wakeupTime;
+        q.pop_front();
+        assert(q.removeFast(front)==false); //Already removed
+    }
+    assert(q.nextWakeupTime()==numeric_limits<long long>::max());
+    //The items must be reusable after having been removed
+    for(int i=0;i<10;i++) { items[i].wakeupTime=10-i; q.insert(&items[i]); }
+    for(int i=9;i>=0;i--) { assert(q.front()==&items[i]); q.pop_front(); }
+    assert(q.empty());
+}
+
+/**
+ * Benchmark a queue with numSleepers sleepers. Measures the cost of inserting
+ * all sleepers and of expiring them in order, then the cost of expiring the
+ * first one and inserting it back with a later wakeupTime, which is what
+ * periodic threads do
+ */
+template<typename Base>
+void benchmarkQueue(const char *name, int numSleepers)
+{
+    using namespace std::chrono;
+    const int iterations=1000000;
+    mt19937 rng(numSleepers);
+    uniform_int_distribution<long long> period(1000000,10000000);
+    vector<Item> items(numSleepers);
+    SleepQueue<Item,Base> q;
+    int rounds=iterations/numSleepers;
+    steady_clock::duration insertTime(0), expireTime(0);
+    for(int i=0;i<rounds;i++)
+    {
+        for(auto& it : items) it.wakeupTime=period(rng);
+        auto t0=steady_clock::now();
+        for(auto& it : items) q.insert(&it);
+        auto t1=steady_clock::now();
+        while(!q.empty()) q.pop_front();
+        auto t2=steady_clock::now();
+        insertTime+=t1-t0;
+        expireTime+=t2-t1;
+    }
+    for(auto& it : items) { it.wakeupTime=period(rng); q.insert(&it); }
+    auto t0=steady_clock::now();
+    for(int i=0;i<iterations;i++)
+    {
+        Item *front=q.front();
+        q.pop_front();
+        front->wakeupTime+=1000000+(front-items.data())*1000;
+        q.insert(front);
+    }
+    auto t1=steady_clock::now();
+    int n=rounds*numSleepers;
+    cout<<name<<" sleepers="<<numSleepers
+        <<" insert="<<duration<double,nano>(insertTime).count()/n<<"ns"
+        <<" expire="<<duration<double,nano>(expireTime).count()/n<<"ns"
+        <<" periodic="<<duration<double,nano>(t1-t0).count()/iterations<<"ns"
+        <<endl;
+}
+
+int main()
+{
+    for(unsigned int seed=0;seed<10;seed++)
+    {
+        testQueue<SortedListSleepQueueBase>(seed);
+        testQueue<PairingHeapSleepQueueBase>(seed);
+    }
+    cout<<"Test passed"<<endl;
+    for(int n : {10,100,1000})
+    {
+        benchmarkQueue<SortedListSleepQueueBase>("list",n);
+        benchmarkQueue<PairingHeapSleepQueueBase>("heap",n);
+    }
+    return 0;
+}
+
+#endif //TEST_ALGORITHM
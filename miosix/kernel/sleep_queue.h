@@ -0,0 +1,204 @@
+/***************************************************************************
+ *   Copyright (C) 2024 by Terraneo Federico                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+#pragma once
+
+#include <limits>
+#ifndef TEST_ALGORITHM
+#include "config/miosix_settings.h"
+#endif //TEST_ALGORITHM
+
+namespace miosix {
+
+class SortedListSleepQueueBase;
+class PairingHeapSleepQueueBase;
+
+/**
+ * \internal
+ * Base class from which all items to be put in a SleepQueue must derive.
+ * The same link fields are shared by all the SleepQueue implementations, so
+ * that the implementation can be selected at compile time without changing
+ * the code that uses it.
+ */
+class SleepQueueItem
+{
+public:
+    /**
+     * Constructor
+     * \param wakeupTime absolute time in nanoseconds when the item expires
+     */
+    SleepQueueItem(long long wakeupTime) : wakeupTime(wakeupTime) {}
+
+    ///\internal When this number becomes equal to the kernel tick,
+    ///the item expires
+    long long wakeupTime;
+
+private:
+    SleepQueueItem *prev=nullptr;  ///< List: previous item, heap: parent or left sibling
+    SleepQueueItem *next=nullptr;  ///< List: next item, heap: right sibling
+    SleepQueueItem *child=nullptr; ///< List: unused, heap: leftmost child
+
+    friend class SortedListSleepQueueBase;
+    friend class PairingHeapSleepQueueBase;
+};
+
+/**
+ * \internal
+ * SleepQueue implementation as a doubly linked list sorted by wakeupTime.
+ * Insertion is O(n), all other operations are O(1). This is the fastest
+ * implementation when only a few threads sleep at the same time.
+ */
+class SortedListSleepQueueBase
+{
+protected:
+    SortedListSleepQueueBase() : head(nullptr) {}
+
+    void insert(SleepQueueItem *item);
+
+    void pop_front();
+
+    bool removeFast(SleepQueueItem *item);
+
+    SleepQueueItem *front() const { return head; }
+
+    bool empty() const { return head==nullptr; }
+
+private:
+    SleepQueueItem *head;
+};
+
+/**
+ * \internal
+ * SleepQueue implementation as an intrusive pairing heap ordered by wakeupTime.
+ * Insertion and access to the first item are O(1), while pop_front() and
+ * removeFast() are O(log(n)) amortized. This implementation scales better
+ * when hundreds of threads sleep at the same time.
+ */
+class PairingHeapSleepQueueBase
+{
+protected:
+    PairingHeapSleepQueueBase() : root(nullptr) {}
+
+    void insert(SleepQueueItem *item);
+
+    void pop_front();
+
+    bool removeFast(SleepQueueItem *item);
+
+    SleepQueueItem *front() const { return root; }
+
+    bool empty() const { return root==nullptr; }
+
+private:
+    /**
+     * Meld two heaps
+     * \param a root of the first heap, must not be nullptr
+     * \param b root of the second heap, must not be nullptr
+     * \return the root of the melded heap
+     */
+    static SleepQueueItem *meld(SleepQueueItem *a, SleepQueueItem *b);
+
+    /**
+     * Meld a list of sibling heaps with the two pass pairing strategy
+     * \param first leftmost heap of the sibling list, can be nullptr
+     * \return the root of the melded heap, or nullptr if the list was empty
+     */
+    static SleepQueueItem *mergePairs(SleepQueueItem *first);
+
+    SleepQueueItem *root;
+};
+
+#if defined(SLEEP_QUEUE_TYPE_HEAP)
+typedef PairingHeapSleepQueueBase SleepQueueBase;
+#else //SLEEP_QUEUE_TYPE_LIST
+typedef SortedListSleepQueueBase SleepQueueBase;
+#endif
+
+/**
+ * \internal
+ * A queue of items sorted by expiration time, used by the kernel to keep
+ * the list of sleeping threads. It only accepts objects that derive from
+ * SleepQueueItem and, like IntrusiveList, it never allocates memory and
+ * an item can belong to at most one SleepQueue.
+ *
+ * The implementation is selected in miosix_settings.h
+ * \tparam T type of the items, must derive from SleepQueueItem
+ * \tparam Base implementation, defaults to the one selected in the settings
+ */
+template<typename T, typename Base=SleepQueueBase>
+class SleepQueue : private Base
+{
+public:
+    /**
+     * Constructor, produces an empty queue
+     */
+    SleepQueue() {}
+
+    SleepQueue(const SleepQueue&)=delete;
+    SleepQueue& operator=(const SleepQueue&)=delete;
+
+    /**
+     * Add an item to the queue
+     * \param item item to add, must not be already in a queue
+     */
+    void insert(T *item) { Base::insert(item); }
+
+    /**
+     * Remove the item with the lowest wakeupTime. The queue must not be empty
+     */
+    void pop_front() { Base::pop_front(); }
+
+    /**
+     * Remove an item, if present
+     * \param item item to remove, must not be nullptr
+     * \return true if the item was removed, false if the item was not present
+     * in the queue
+     */
+    bool removeFast(T *item) { return Base::removeFast(item); }
+
+    /**
+     * \return the item with the lowest wakeupTime. The queue must not be empty
+     */
+    T *front() const { return static_cast<T*>(Base::front()); }
+
+    /**
+     * \return true if the queue is empty
+     */
+    bool empty() const { return Base::empty(); }
+
+    /**
+     * \return the lowest wakeupTime in the queue, or the maximum representable
+     * time if the queue is empty. Complexity is O(1)
+     */
+    long long nextWakeupTime() const
+    {
+        if(Base::empty()) return std::numeric_limits<long long>::max();
+        return Base::front()->wakeupTime;
+    }
+};
+
+} //namespace miosix
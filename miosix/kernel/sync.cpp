@@ -29,23 +29,13 @@
 #include "kernel.h"
 #include "error.h"
 #include "pthread_private.h"
+#include "trace.h"
 #include <algorithm>
 
 using namespace std;
 
 namespace miosix {
 
-/**
- * Helper lambda to sort threads in a min heap to implement priority inheritance
- * \param lhs first thread to compare
- * \param rhs second thread to compare
- * \return true if lhs->getPriority() < rhs->getPriority()
- */
-static auto PKlowerPriority=[](Thread *lhs, Thread *rhs)
-{
-    return lhs->PKgetPriority().mutexLessOp(rhs->PKgetPriority());
-};
-
 //
 // class FastMutex
 //
@@ -66,7 +56,7 @@ FastMutex::FastMutex(Options opt)
 // class Mutex
 //
 
-Mutex::Mutex(Options opt): owner(nullptr), next(nullptr), waiting()
+Mutex::Mutex(Options opt): owner(nullptr), next(nullptr)
 {
     recursiveDepth= opt==RECURSIVE ? 0 : -1;
 }
@@ -98,9 +88,15 @@ void Mutex::PKlock(PauseKernelLock& dLock)
         } else errorHandler(MUTEX_DEADLOCK); //Bad, deadlock
     }
 
+    #ifdef WITH_KERNEL_TRACE
+    KernelTrace::IRQrecord(TraceEventType::MutexBlock,0,
+        reinterpret_cast<unsigned int>(this),
+        reinterpret_cast<unsigned int>(owner));
+    #endif //WITH_KERNEL_TRACE
+
     //Add thread to mutex' waiting queue
-    waiting.push_back(p);
-    push_heap(waiting.begin(),waiting.end(),PKlowerPriority);
+    WaitToken token(p);
+    PKenqueue(&token);
 
     //Handle priority inheritance
     if(p->mutexWaiting!=nullptr) errorHandler(UNEXPECTED);
@@ -112,8 +108,7 @@ void Mutex::PKlock(PauseKernelLock& dLock)
         {
             Scheduler::PKsetPriority(walk,p->PKgetPriority());
             if(walk->mutexWaiting==nullptr) break;
-            make_heap(walk->mutexWaiting->waiting.begin(),
-                      walk->mutexWaiting->waiting.end(),PKlowerPriority);
+            walk->mutexWaiting->PKrequeue(walk);
             walk=walk->mutexWaiting->owner;
         }
     }
@@ -150,9 +145,15 @@ void Mutex::PKlockToDepth(PauseKernelLock& dLock, unsigned int depth)
         } else errorHandler(MUTEX_DEADLOCK); //Bad, deadlock
     }
 
+    #ifdef WITH_KERNEL_TRACE
+    KernelTrace::IRQrecord(TraceEventType::MutexBlock,0,
+        reinterpret_cast<unsigned int>(this),
+        reinterpret_cast<unsigned int>(owner));
+    #endif //WITH_KERNEL_TRACE
+
     //Add thread to mutex' waiting queue
-    waiting.push_back(p);
-    push_heap(waiting.begin(),waiting.end(),PKlowerPriority);
+    WaitToken token(p);
+    PKenqueue(&token);
 
     //Handle priority inheritance
     if(p->mutexWaiting!=nullptr) errorHandler(UNEXPECTED);
@@ -164,8 +165,7 @@ void Mutex::PKlockToDepth(PauseKernelLock& dLock, unsigned int depth)
         {
             Scheduler::PKsetPriority(walk,p->PKgetPriority());
             if(walk->mutexWaiting==nullptr) break;
-            make_heap(walk->mutexWaiting->waiting.begin(),
-                      walk->mutexWaiting->waiting.end(),PKlowerPriority);
+            walk->mutexWaiting->PKrequeue(walk);
             walk=walk->mutexWaiting->owner;
         }
     }
@@ -241,8 +241,8 @@ bool Mutex::PKunlock(PauseKernelLock& dLock)
         while(walk!=nullptr)
         {
             if(walk->waiting.empty()==false)
-                if(pr.mutexLessOp(walk->waiting.front()->PKgetPriority()))
-                    pr=walk->waiting.front()->PKgetPriority();
+                if(pr.mutexLessOp(walk->waiting.front()->thread->PKgetPriority()))
+                    pr=walk->waiting.front()->thread->PKgetPriority();
             walk=walk->next;
         }
         if(pr!=owner->PKgetPriority()) Scheduler::PKsetPriority(owner,pr);
@@ -252,9 +252,8 @@ bool Mutex::PKunlock(PauseKernelLock& dLock)
     if(waiting.empty()==false)
     {
         //There is at least another thread waiting
-        owner=waiting.front();
-        pop_heap(waiting.begin(),waiting.end(),PKlowerPriority);
-        waiting.pop_back();
+        owner=waiting.front()->thread;
+        waiting.pop_front();
         if(owner->mutexWaiting!=this) errorHandler(UNEXPECTED);
         owner->mutexWaiting=nullptr;
         owner->PKwakeup();
@@ -264,12 +263,11 @@ bool Mutex::PKunlock(PauseKernelLock& dLock)
         owner->mutexLocked=this;
         //Handle priority inheritance of new owner
         if(waiting.empty()==false &&
-                owner->PKgetPriority().mutexLessOp(waiting.front()->PKgetPriority()))
-                Scheduler::PKsetPriority(owner,waiting.front()->PKgetPriority());
+                owner->PKgetPriority().mutexLessOp(waiting.front()->thread->PKgetPriority()))
+                Scheduler::PKsetPriority(owner,waiting.front()->thread->PKgetPriority());
         return p->PKgetPriority().mutexLessOp(owner->PKgetPriority());
     } else {
         owner=nullptr; //No threads waiting
-        std::vector<Thread *>().swap(waiting); //Save some RAM
         return false;
     }
 }
@@ -312,8 +310,8 @@ unsigned int Mutex::PKunlockAllDepthLevels(PauseKernelLock& dLock)
         while(walk!=nullptr)
         {
             if(walk->waiting.empty()==false)
-                if(pr.mutexLessOp(walk->waiting.front()->PKgetPriority()))
-                    pr=walk->waiting.front()->PKgetPriority();
+                if(pr.mutexLessOp(walk->waiting.front()->thread->PKgetPriority()))
+                    pr=walk->waiting.front()->thread->PKgetPriority();
             walk=walk->next;
         }
         if(pr!=owner->PKgetPriority()) Scheduler::PKsetPriority(owner,pr);
@@ -323,9 +321,8 @@ unsigned int Mutex::PKunlockAllDepthLevels(PauseKernelLock& dLock)
     if(waiting.empty()==false)
     {
         //There is at least another thread waiting
-        owner=waiting.front();
-        pop_heap(waiting.begin(),waiting.end(),PKlowerPriority);
-        waiting.pop_back();
+        owner=waiting.front()->thread;
+        waiting.pop_front();
         if(owner->mutexWaiting!=this) errorHandler(UNEXPECTED);
         owner->mutexWaiting=nullptr;
         owner->PKwakeup();
@@ -335,11 +332,10 @@ unsigned int Mutex::PKunlockAllDepthLevels(PauseKernelLock& dLock)
         owner->mutexLocked=this;
         //Handle priority inheritance of new owner
         if(waiting.empty()==false &&
-                owner->PKgetPriority().mutexLessOp(waiting.front()->PKgetPriority()))
-                Scheduler::PKsetPriority(owner,waiting.front()->PKgetPriority());
+                owner->PKgetPriority().mutexLessOp(waiting.front()->thread->PKgetPriority()))
+                Scheduler::PKsetPriority(owner,waiting.front()->thread->PKgetPriority());
     } else {
         owner=nullptr; //No threads waiting
-        std::vector<Thread *>().swap(waiting); //Save some RAM
     }
     
     if(recursiveDepth<0) return 0;
@@ -348,6 +344,35 @@ unsigned int Mutex::PKunlockAllDepthLevels(PauseKernelLock& dLock)
     return result;
 }
 
+void Mutex::PKenqueue(WaitToken *token)
+{
+    //Scan from the back, as in the common case of threads having the same
+    //priority the insertion point is found immediately
+    Priority pr=token->thread->PKgetPriority();
+    auto it=waiting.end();
+    while(it!=waiting.begin())
+    {
+        auto prev=it;
+        --prev;
+        if((*prev)->thread->PKgetPriority().mutexLessOp(pr)==false) break;
+        it=prev;
+    }
+    waiting.insert(it,token);
+}
+
+void Mutex::PKrequeue(Thread *t)
+{
+    for(auto it=waiting.begin();it!=waiting.end();++it)
+    {
+        if((*it)->thread!=t) continue;
+        WaitToken *token=*it;
+        waiting.erase(it);
+        PKenqueue(token);
+        return;
+    }
+    errorHandler(UNEXPECTED); //Thread not in the waiting list? impossible
+}
+
 //
 // class ConditionVariable
 //
@@ -522,4 +547,90 @@ TimedWaitResult Semaphore::timedWait(long long absTime)
     return TimedWaitResult::NoTimeout;
 }
 
+//
+// class PollWaiter
+//
+
+void PollWaiter::wait()
+{
+    FastInterruptDisableLock dLock;
+    while(woken==false) Thread::IRQenableIrqAndWait(dLock);
+}
+
+TimedWaitResult PollWaiter::timedWait(long long absTime)
+{
+    FastInterruptDisableLock dLock;
+    while(woken==false)
+    {
+        if(Thread::IRQenableIrqAndTimedWait(dLock,absTime)==TimedWaitResult::Timeout)
+            return woken ? TimedWaitResult::NoTimeout : TimedWaitResult::Timeout;
+    }
+    return TimedWaitResult::NoTimeout;
+}
+
+//
+// class PollEntry
+//
+
+PollEntry::~PollEntry()
+{
+    PollQueue::remove(this);
+}
+
+//
+// class PollQueue
+//
+
+void PollQueue::IRQadd(PollEntry *entry)
+{
+    if(entry==nullptr || entry->queue==this) return;
+    //An entry can only be in one queue, if it was in another one move it
+    if(entry->queue) entry->queue->entries.removeFast(entry);
+    entry->queue=this;
+    entries.push_back(entry);
+}
+
+void PollQueue::remove(PollEntry *entry)
+{
+    FastInterruptDisableLock dLock;
+    if(entry->queue==nullptr) return;
+    entry->queue->entries.removeFast(entry);
+    entry->queue=nullptr;
+}
+
+void PollQueue::IRQwakeup(bool& hppw)
+{
+    //Entries are not removed, the waiting thread removes them when done
+    Thread *cur=Thread::IRQgetCurrentThread();
+    for(auto entry : entries)
+    {
+        PollWaiter *waiter=entry->waiter;
+        if(waiter==nullptr || waiter->woken) continue;
+        waiter->woken=true;
+        waiter->thread->IRQwakeup();
+        if(cur->IRQgetPriority()<waiter->thread->IRQgetPriority()) hppw=true;
+    }
+}
+
+void PollQueue::wakeup()
+{
+    bool hppw=false;
+    {
+        FastInterruptDisableLock dLock;
+        IRQwakeup(hppw);
+    }
+    if(hppw) Thread::yield();
+}
+
+PollQueue::~PollQueue()
+{
+    FastInterruptDisableLock dLock;
+    while(entries.empty()==false)
+    {
+        PollEntry *entry=entries.front();
+        entries.pop_front();
+        entry->queue=nullptr;
+    }
+}
+
 } //namespace miosix
@@ -32,6 +32,8 @@
 #include "kernel/scheduler/scheduler.h"
 #include "intrusive.h"
 #include <vector>
+#include <limits>
+#include <algorithm>
 
 namespace miosix {
 
@@ -244,6 +246,33 @@ private:
      */
     unsigned int PKunlockAllDepthLevels(PauseKernelLock& dLock);
 
+    /**
+     * \internal Element of the waiting list, allocated on the waiting thread's
+     * stack so that blocking on a mutex never allocates memory
+     */
+    class WaitToken : public IntrusiveListItem
+    {
+    public:
+        WaitToken(Thread *thread) : thread(thread) {}
+        Thread *thread; ///<\internal Waiting thread
+    };
+
+    /**
+     * Add a thread to the waiting list, after all threads with higher or equal
+     * priority, so that threads with the same priority are served in FIFO
+     * order. Can be called only with the kernel paused.
+     * \param token waiting list element of the thread
+     */
+    void PKenqueue(WaitToken *token);
+
+    /**
+     * Move a waiting thread to the position in the waiting list corresponding
+     * to its current priority, called when its priority changes because of
+     * priority inheritance. Can be called only with the kernel paused.
+     * \param t thread waiting on this mutex
+     */
+    void PKrequeue(Thread *t);
+
     /// Thread currently inside critical section, if NULL the critical section
     /// is free
     Thread *owner;
@@ -252,8 +281,8 @@ private:
     /// thread that owns this mutex. This field is necessary to make the list.
     Mutex *next;
 
-    /// Waiting thread are stored in this min-heap, sorted by priority
-    std::vector<Thread *> waiting;
+    /// Waiting threads, sorted by decreasing priority
+    IntrusiveList<WaitToken> waiting;
 
     /// Used to hold nesting depth for recursive mutexes, -1 if not recursive
     int recursiveDepth;
@@ -690,6 +719,195 @@ private:
     IntrusiveList<WaitToken> fifo; ///< List of waiting threads
 };
 
+class PollQueue;
+
+/**
+ * The object a thread blocks on while waiting for any of multiple PollQueue
+ * to be woken, used to implement poll(). The waiting thread registers one
+ * PollEntry pointing to the same PollWaiter in each PollQueue it is
+ * interested in.
+ * \since Miosix 3.0
+ */
+class PollWaiter
+{
+public:
+    /**
+     * Constructor, the waiting thread is the one constructing the object
+     */
+    PollWaiter() : thread(Thread::getCurrentThread()), woken(false),
+        recheckTime(std::numeric_limits<long long>::max()) {}
+
+    /**
+     * Clear the woken flag and the recheck time. Must be called before
+     * checking the condition to wait for, so that wakeups occurring between
+     * the check and the wait are not lost.
+     */
+    void reset()
+    {
+        woken=false;
+        recheckTime=std::numeric_limits<long long>::max();
+    }
+
+    /**
+     * Ask the waiting thread to check again the condition it waits for at the
+     * given time even if no wakeup occurs. Meant for polled objects that can't
+     * wake their PollQueue on all the changes of their readiness.
+     * \param absTime absolute time in nanoseconds
+     */
+    void requestRecheck(long long absTime)
+    {
+        recheckTime=std::min(recheckTime,absTime);
+    }
+
+    /**
+     * \return the earliest time passed to requestRecheck() since the last call
+     * to reset(), or the maximum representable time if none
+     */
+    long long getRecheckTime() const { return recheckTime; }
+
+    /**
+     * Wait until one of the PollQueue this waiter is registered on is woken.
+     * Returns immediately if a wakeup occurred since the last call to reset().
+     */
+    void wait();
+
+    /**
+     * Wait until one of the PollQueue this waiter is registered on is woken,
+     * or a timeout occurs.
+     * \param absTime absolute timeout time in nanoseconds
+     * \return whether the return was due to a timeout or wakeup
+     */
+    TimedWaitResult timedWait(long long absTime);
+
+    PollWaiter(const PollWaiter&)=delete;
+    PollWaiter& operator=(const PollWaiter&)=delete;
+
+private:
+    friend class PollQueue;
+
+    Thread *thread;         ///< Waiting thread
+    volatile bool woken;    ///< Set when a PollQueue is woken
+    long long recheckTime;  ///< Set by requestRecheck()
+};
+
+/**
+ * Registration of a PollWaiter in a PollQueue
+ * \since Miosix 3.0
+ */
+class PollEntry : public IntrusiveListItem
+{
+public:
+    /**
+     * Constructor
+     * \param waiter waiter to wake when the PollQueue is woken
+     */
+    explicit PollEntry(PollWaiter *waiter=nullptr)
+        : waiter(waiter), queue(nullptr) {}
+
+    /**
+     * Set the waiter, can only be called while the entry is not registered
+     * \param waiter waiter to wake when the PollQueue is woken
+     */
+    void setWaiter(PollWaiter *waiter) { this->waiter=waiter; }
+
+    /**
+     * \return the waiter
+     */
+    PollWaiter *getWaiter() const { return waiter; }
+
+    /**
+     * Destructor, unregisters the entry from its PollQueue, if any
+     */
+    ~PollEntry();
+
+    PollEntry(const PollEntry&)=delete;
+    PollEntry& operator=(const PollEntry&)=delete;
+
+private:
+    friend class PollQueue;
+
+    PollWaiter *waiter; ///< Waiter to wake
+    PollQueue *queue;   ///< Queue the entry is registered in, or nullptr
+};
+
+/**
+ * Readiness notification queue, used to implement poll(). Every object that
+ * can be polled, such as a pipe or a device driver, owns a PollQueue and
+ * wakes it every time it may have become readable or writable. Can be woken
+ * from interrupt handlers using the IRQ-prefixed member functions.
+ * \since Miosix 3.0
+ */
+class PollQueue
+{
+public:
+    /**
+     * Constructor
+     */
+    PollQueue() {}
+
+    /**
+     * Register an entry in this queue. The entry stays registered until it is
+     * destroyed or remove() is called, so that the same entry can be woken
+     * multiple times.
+     * \param entry entry to register, if nullptr nothing is done. Registering
+     * an entry already registered in this queue has no effect.
+     */
+    void add(PollEntry *entry)
+    {
+        FastInterruptDisableLock dLock;
+        IRQadd(entry);
+    }
+
+    /**
+     * Register an entry in this queue. Only for use in IRQ handlers or with
+     * interrupts disabled.
+     * \param entry entry to register, if nullptr nothing is done.
+     */
+    void IRQadd(PollEntry *entry);
+
+    /**
+     * Unregister an entry from the queue it is registered in, if any
+     * \param entry entry to unregister
+     */
+    static void remove(PollEntry *entry);
+
+    /**
+     * Wake all the registered waiters without triggering a reschedule.
+     * Only for use in IRQ handlers or with interrupts disabled.
+     * \param hppw is set to `true' if a scheduler update is necessary to
+     * wake up a formerly sleeping thread with `Scheduler::IRQfindNextThread()`.
+     * Otherwise it is not modified.
+     */
+    void IRQwakeup(bool& hppw);
+
+    /**
+     * Wake all the registered waiters.
+     * Only for use in IRQ handlers.
+     */
+    void IRQwakeup()
+    {
+        bool hppw=false;
+        IRQwakeup(hppw);
+        if(hppw) Scheduler::IRQfindNextThread();
+    }
+
+    /**
+     * Wake all the registered waiters.
+     */
+    void wakeup();
+
+    /**
+     * Destructor, unregisters all entries
+     */
+    ~PollQueue();
+
+    PollQueue(const PollQueue&)=delete;
+    PollQueue& operator=(const PollQueue&)=delete;
+
+private:
+    IntrusiveList<PollEntry> entries; ///< Registered entries
+};
+
 /**
  * \}
  */
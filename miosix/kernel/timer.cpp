@@ -0,0 +1,159 @@
+/***************************************************************************
+ *   Copyright (C) 2024 by Terraneo Federico                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+#include "timer.h"
+
+#ifdef WITH_TIMERS
+
+#include "sync.h"
+#include "error.h"
+#include "kernel/scheduler/scheduler.h"
+#include "interfaces/os_timer.h"
+#include <algorithm>
+
+using namespace std;
+
+namespace miosix {
+
+extern SleepQueue<SleepData> sleepingList; //Defined in kernel.cpp
+
+///\internal Timers whose callback is waiting for the service thread
+static IntrusiveList<Timer> pendingTimers;
+///\internal The timer service thread, created on demand
+static Thread *service=nullptr;
+///\internal Serializes the creation of the service thread
+static FastMutex serviceMutex;
+
+void IRQrearmOsTimer()
+{
+    internal::IRQosTimerSetInterrupt(min(sleepingList.nextWakeupTime(),
+                                         Scheduler::IRQgetNextPreemption()));
+}
+
+//
+// class Timer
+//
+
+Timer::Timer(void (*callback)(void *), void *arg, TimerContext context)
+    : callback(callback), arg(arg), context(context)
+{
+    if(context!=TimerContext::ServiceThread) return;
+    Lock<FastMutex> l(serviceMutex);
+    if(service) return;
+    service=Thread::create(serviceThread,TIMER_SERVICE_STACK_SIZE,
+                           TIMER_SERVICE_PRIORITY);
+    if(service==nullptr) errorHandler(OUT_OF_MEMORY);
+}
+
+void Timer::IRQstartAt(long long absoluteTimeNs, long long periodNs)
+{
+    IRQstop();
+    period=periodNs;
+    wakeupTime=absoluteTimeNs;
+    #ifdef WITH_TIMER_SLACK
+    earliestWakeupTime=absoluteTimeNs;
+    #endif //WITH_TIMER_SLACK
+    active=true;
+    sleepingList.insert(this);
+    //Unlike a sleeping thread, starting a timer causes no context switch, so
+    //if it is now the first to expire the OS timer is programmed here
+    if(sleepingList.front()==this) IRQrearmOsTimer();
+}
+
+bool Timer::IRQstop()
+{
+    if(pending)
+    {
+        pendingTimers.removeFast(this);
+        pending=false;
+    }
+    if(active==false) return false;
+    sleepingList.removeFast(this);
+    active=false;
+    return true;
+}
+
+bool Timer::IRQexpire(SleepData *item, long long currentTime)
+{
+    Timer *t=static_cast<Timer*>(item);
+    if(t->period>0)
+    {
+        //Reinsert before calling the callback so that it can stop the timer
+        long long next=t->wakeupTime+t->period;
+        if(next<=currentTime)
+        {
+            long long missed=(currentTime-next)/t->period+1;
+            t->overruns+=missed;
+            next+=missed*t->period;
+        }
+        t->wakeupTime=next;
+        #ifdef WITH_TIMER_SLACK
+        t->earliestWakeupTime=next;
+        #endif //WITH_TIMER_SLACK
+        sleepingList.insert(t);
+    } else t->active=false;
+
+    if(t->context==TimerContext::Interrupt)
+    {
+        t->callback(t->arg);
+        return true; //The callback may have woken a thread, run the scheduler
+    }
+    if(t->pending)
+    {
+        t->overruns++;
+        return false;
+    }
+    t->pending=true;
+    pendingTimers.push_back(t);
+    service->IRQwakeup();
+    return Thread::IRQgetCurrentThread()->IRQgetPriority()<
+           service->IRQgetPriority();
+}
+
+void Timer::serviceThread(void *)
+{
+    for(;;)
+    {
+        void (*callback)(void *);
+        void *arg;
+        {
+            FastInterruptDisableLock dLock;
+            while(pendingTimers.empty()) Thread::IRQenableIrqAndWait(dLock);
+            Timer *t=pendingTimers.front();
+            pendingTimers.pop_front();
+            t->pending=false;
+            //Copied so that the timer can be restarted from the callback
+            callback=t->callback;
+            arg=t->arg;
+        }
+        callback(arg);
+    }
+}
+
+} //namespace miosix
+
+#endif //WITH_TIMERS
@@ -0,0 +1,232 @@
+/***************************************************************************
+ *   Copyright (C) 2024 by Terraneo Federico                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+#pragma once
+
+#include "config/miosix_settings.h"
+
+#ifdef WITH_TIMERS
+
+#include "kernel/kernel.h"
+#include "kernel/intrusive.h"
+
+namespace miosix {
+
+/**
+ * \addtogroup Kernel
+ * \{
+ */
+
+/**
+ * Context in which the callback of a Timer is called
+ */
+enum class TimerContext
+{
+    /// The callback is called from the OS timer interrupt, with interrupts
+    /// disabled. It must be short and can only call IRQ functions, such as
+    /// Thread::IRQwakeup() or FixedEventQueue::IRQpost()
+    Interrupt,
+    /// The callback is called by the timer service thread, a single kernel
+    /// thread shared by all timers, so it can block and call any function.
+    /// A callback that takes long delays the callbacks of the other timers
+    ServiceThread
+};
+
+/**
+ * A software timer, calling a function after a given time, or periodically.
+ * It replaces threads that only call Thread::sleep() in a loop, without
+ * requiring a stack for each of them, and is enabled only if the symbol
+ * `WITH_TIMERS` has been defined in config/miosix_settings.h.
+ *
+ * Timers are kept in the same queue as sleeping threads, so the kernel
+ * programs the OS timer for the first of them and wakes them in the same
+ * interrupt, also when in deep sleep. start() and stop() never allocate
+ * memory, and their complexity is that of the sleep queue selected in
+ * config/miosix_settings.h: O(1) and O(log(n)) with SLEEP_QUEUE_TYPE_HEAP.
+ *
+ * Periodic timers are drift free: each expiration is scheduled one period
+ * after the previous one, not after the callback has run. If expirations are
+ * missed, because interrupts were disabled for too long, or because the
+ * previous callback is still running in the service thread, they are skipped
+ * and counted in getOverruns().
+ *
+ * \code
+ * void blink(void*) { led::toggle(); }
+ * Timer t(blink);
+ * t.start(500000000,500000000); //Blink every 500ms
+ * \endcode
+ *
+ * To post an event to a FixedEventQueue on expiration, use EventTimer in e20.
+ */
+class Timer : private SleepData, public IntrusiveListItem
+{
+public:
+    /**
+     * Constructor, the timer is initially stopped
+     * \param callback function to call when the timer expires
+     * \param arg argument passed to callback
+     * \param context context in which the callback is called. If it is
+     * TimerContext::ServiceThread and the timer service thread does not yet
+     * exist, it is created
+     */
+    Timer(void (*callback)(void *), void *arg=nullptr,
+          TimerContext context=TimerContext::ServiceThread);
+
+    /**
+     * Start the timer, or restart it if it was already active
+     * \param delayNs time from now in nanoseconds after which the timer expires
+     * \param periodNs if nonzero, the timer expires again every periodNs
+     * nanoseconds after the first expiration, until stopped
+     */
+    void start(long long delayNs, long long periodNs=0)
+    {
+        FastInterruptDisableLock dLock;
+        IRQstart(delayNs,periodNs);
+    }
+
+    /**
+     * Same as start(), but can be called with interrupts disabled, or from
+     * a timer callback
+     */
+    void IRQstart(long long delayNs, long long periodNs=0)
+    {
+        delay=delayNs;
+        IRQstartAt(IRQgetTime()+delayNs,periodNs);
+    }
+
+    /**
+     * Start the timer at an absolute time, or restart it if it was already
+     * active
+     * \param absoluteTimeNs time in nanoseconds, as returned by getTime(),
+     * when the timer expires
+     * \param periodNs if nonzero, the timer expires again every periodNs
+     * nanoseconds after the first expiration, until stopped
+     */
+    void startAt(long long absoluteTimeNs, long long periodNs=0)
+    {
+        FastInterruptDisableLock dLock;
+        IRQstartAt(absoluteTimeNs,periodNs);
+    }
+
+    /**
+     * Same as startAt(), but can be called with interrupts disabled, or from
+     * a timer callback
+     */
+    void IRQstartAt(long long absoluteTimeNs, long long periodNs=0);
+
+    /**
+     * Restart the timer with the delay and period of the last call to start(),
+     * like a watchdog that is kicked before it expires
+     */
+    void restart()
+    {
+        FastInterruptDisableLock dLock;
+        IRQrestart();
+    }
+
+    /**
+     * Same as restart(), but can be called with interrupts disabled, or from
+     * a timer callback
+     */
+    void IRQrestart() { IRQstart(delay,period); }
+
+    /**
+     * Stop the timer. If the callback was due to run in the service thread it
+     * is not called, but a callback that is already running is not waited for
+     * \return true if the timer was active
+     */
+    bool stop()
+    {
+        FastInterruptDisableLock dLock;
+        return IRQstop();
+    }
+
+    /**
+     * Same as stop(), but can be called with interrupts disabled, or from
+     * a timer callback
+     */
+    bool IRQstop();
+
+    /**
+     * \return true if the timer will expire in the future
+     */
+    bool isActive() const { return active; }
+
+    /**
+     * \return the number of expirations of a periodic timer that were skipped
+     * because they were late by more than one period, or because the
+     * previous callback was still pending in the service thread
+     */
+    unsigned int getOverruns() const { return overruns; }
+
+    /**
+     * Destructor, stops the timer. The timer must not be destroyed while its
+     * callback is running in the service thread
+     */
+    ~Timer() { stop(); }
+
+    Timer(const Timer&)=delete;
+    Timer& operator=(const Timer&)=delete;
+
+private:
+    /**
+     * \internal
+     * Called by IRQwakeThreads() when a timer is removed from the sleep queue
+     * \param item item removed from the sleep queue, must be a Timer
+     * \param currentTime current time
+     * \return true if the scheduler needs to run, because the callback ran in
+     * the interrupt and may have woken a thread, or because the service thread
+     * was woken and has higher priority than the current thread
+     */
+    static bool IRQexpire(SleepData *item, long long currentTime);
+
+    /**
+     * \internal
+     * Entry point of the timer service thread
+     */
+    static void serviceThread(void *);
+
+    void (*callback)(void *);  ///< Function to call on expiration
+    void *arg;                 ///< Argument of callback
+    long long delay=0;         ///< Delay passed to the last start()
+    long long period=0;        ///< Period, or zero for a one shot timer
+    unsigned int overruns=0;   ///< Skipped expirations
+    const TimerContext context;///< Where callback is called
+    bool active=false;         ///< True if in the sleep queue
+    bool pending=false;        ///< True if waiting for the service thread
+
+    //Needs access to IRQexpire()
+    friend bool IRQwakeThreads(long long);
+};
+
+/**
+ * \}
+ */
+
+} //namespace miosix
+
+#endif //WITH_TIMERS
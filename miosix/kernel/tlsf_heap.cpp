@@ -0,0 +1,641 @@
+/***************************************************************************
+ *   Copyright (C) 2024 by Terraneo Federico                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+#include "tlsf_heap.h"
+#include <cstring>
+#include <cstdint>
+#include <new>
+#include <algorithm>
+#ifndef TEST_ALLOC
+#include "kernel/kernel.h"
+#else //TEST_ALLOC
+#include <iostream>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <stdexcept>
+#include <cstdlib>
+#endif //TEST_ALLOC
+
+using namespace std;
+
+#ifdef WITH_TLSF_HEAP
+
+#ifdef TEST_ALLOC
+namespace miosix {
+class PauseKernelLock //Single threaded test, nothing to lock
+{
+public:
+    PauseKernelLock() {}
+};
+} //namespace miosix
+#endif //TEST_ALLOC
+
+namespace miosix {
+
+/**
+ * \param x a non zero value
+ * \return the index of the most significant bit set
+ */
+static inline unsigned int fls(size_t x)
+{
+    return sizeof(unsigned long)*8-1-__builtin_clzl(x);
+}
+
+/**
+ * \param x a non zero value
+ * \return the index of the least significant bit set
+ */
+static inline unsigned int ffs(unsigned int x)
+{
+    return __builtin_ctz(x);
+}
+
+static TlsfHeap *systemHeap=nullptr; ///< The heap malloc allocates from first
+
+//
+// class TlsfHeap
+//
+
+TlsfHeap::TlsfHeap(void *base, unsigned int size, const char *name)
+    : name(name)
+{
+    auto s=(reinterpret_cast<uintptr_t>(base)+alignment-1) & ~(alignment-1);
+    auto e=(reinterpret_cast<uintptr_t>(base)+size) & ~(alignment-1);
+    start=end=reinterpret_cast<char*>(s);
+    if(e<=s || e-s<2*headerSize+minBlockSize) return; //Too small, always full
+    //The heap is a single free block followed by a zero size allocated block
+    //that stops merging at the end of the heap
+    Block *first=reinterpret_cast<Block*>(s);
+    first->prevPhys=nullptr;
+    first->size=min<size_t>(e-s-2*headerSize,maxBlockSize) | freeFlag;
+    Block *sentinel=nextPhys(first);
+    sentinel->prevPhys=first;
+    sentinel->size=0;
+    end=reinterpret_cast<char*>(sentinel);
+    heapSize=end-start;
+    insertFree(first);
+}
+
+TlsfHeap& TlsfHeap::instance()
+{
+    //Not a function local static, as guarded initialization can't be used
+    //by the first malloc, which occurs before the kernel is started
+    alignas(TlsfHeap) static char storage[sizeof(TlsfHeap)];
+    if(systemHeap) return *systemHeap;
+    #ifndef TEST_ALLOC
+    //These are defined in the linker script
+    extern char _end asm("_end");
+    extern char _heap_end asm("_heap_end");
+    systemHeap=new (storage) TlsfHeap(&_end,&_heap_end-&_end,"heap");
+    #else //TEST_ALLOC
+    //Like a heap starting right after the .bss, not aligned
+    const unsigned int size=256*1024;
+    static char *memory=static_cast<char*>(malloc(size));
+    memset(memory,0,size); //Don't measure page faults in the benchmark
+    systemHeap=new (storage) TlsfHeap(memory+4,size-4,"heap");
+    #endif //TEST_ALLOC
+    return *systemHeap;
+}
+
+void TlsfHeap::addHeap(TlsfHeap *heap)
+{
+    PauseKernelLock dLock;
+    TlsfHeap *last=&instance();
+    while(last->next) last=last->next;
+    last->next=heap;
+}
+
+TlsfHeap *TlsfHeap::findHeap(const void *ptr)
+{
+    for(TlsfHeap *h=&instance();h;h=h->next) if(h->contains(ptr)) return h;
+    return nullptr;
+}
+
+void *TlsfHeap::allocate(size_t size)
+{
+    size_t adjusted=adjustSize(size);
+    Block *b=adjusted ? locateFree(adjusted) : nullptr;
+    if(b==nullptr)
+    {
+        failures++;
+        return nullptr;
+    }
+    return markUsed(b,adjusted);
+}
+
+void *TlsfHeap::allocateAligned(size_t align, size_t size)
+{
+    if(align<=alignment) return allocate(size);
+    //Look for a block with enough room to move the start to an aligned
+    //address, leaving a free block before it
+    size_t adjusted=adjustSize(size);
+    size_t withGap=adjusted && align<maxBlockSize ?
+        adjustSize(adjusted+align+sizeof(Block)) : 0;
+    Block *b=withGap ? locateFree(withGap) : nullptr;
+    if(b==nullptr)
+    {
+        failures++;
+        return nullptr;
+    }
+    auto p=reinterpret_cast<uintptr_t>(payload(b));
+    auto aligned=(p+align-1) & ~(align-1);
+    if(aligned!=p && aligned-p<sizeof(Block))
+        aligned=(p+sizeof(Block)+align-1) & ~(align-1);
+    size_t gap=aligned-p;
+    if(gap)
+    {
+        Block *nb=fromPayload(reinterpret_cast<void*>(aligned));
+        nb->prevPhys=b;
+        nb->size=(blockSize(b)-gap) | freeFlag;
+        nextPhys(nb)->prevPhys=nb;
+        b->size=(gap-headerSize) | freeFlag;
+        insertFree(b);
+        b=nb;
+    }
+    return markUsed(b,adjusted);
+}
+
+void *TlsfHeap::reallocate(void *ptr, size_t size)
+{
+    if(ptr==nullptr) return allocate(size);
+    if(size==0)
+    {
+        deallocate(ptr);
+        return nullptr;
+    }
+    size_t adjusted=adjustSize(size);
+    if(adjusted==0)
+    {
+        failures++;
+        return nullptr;
+    }
+    Block *b=fromPayload(ptr);
+    size_t current=blockSize(b);
+    if(adjusted>current)
+    {
+        Block *after=nextPhys(b);
+        if(isFree(after)==false || adjusted>current+headerSize+blockSize(after))
+        {
+            //Can't grow in place
+            void *result=allocate(size);
+            if(result==nullptr) return nullptr;
+            memcpy(result,ptr,current);
+            deallocate(ptr);
+            return result;
+        }
+        removeFree(after);
+        b->size+=headerSize+blockSize(after);
+        nextPhys(b)->prevPhys=b;
+    }
+    used-=current+headerSize;
+    allocations--;
+    return markUsed(b,adjusted);
+}
+
+void TlsfHeap::deallocate(void *ptr)
+{
+    if(ptr==nullptr) return;
+    Block *b=fromPayload(ptr);
+    if(isFree(b)) return; //Double free
+    used-=blockSize(b)+headerSize;
+    allocations--;
+    b->size|=freeFlag;
+    Block *prev=b->prevPhys;
+    if(prev && isFree(prev))
+    {
+        removeFree(prev);
+        prev->size+=headerSize+blockSize(b);
+        b=prev;
+    }
+    Block *after=nextPhys(b);
+    if(isFree(after))
+    {
+        removeFree(after);
+        b->size+=headerSize+blockSize(after);
+        after=nextPhys(b);
+    }
+    after->prevPhys=b;
+    insertFree(b);
+}
+
+size_t TlsfHeap::usableSize(const void *ptr)
+{
+    return blockSize(fromPayload(ptr));
+}
+
+HeapStats TlsfHeap::getStats() const
+{
+    HeapStats result;
+    result.size=heapSize;
+    result.used=used;
+    result.maxUsed=maxUsed;
+    result.allocations=allocations;
+    result.failures=failures;
+    if(flBitmap)
+    {
+        //The largest free block is in the last non empty list
+        unsigned int fl=fls(flBitmap);
+        unsigned int sl=fls(slBitmap[fl]);
+        for(Block *b=freeLists[fl][sl];b;b=b->nextFree)
+            result.largestFree=max<unsigned int>(result.largestFree,blockSize(b));
+        unsigned int free=heapSize-used;
+        result.fragmentation=100-static_cast<unsigned long long>(
+            result.largestFree+headerSize)*100/free;
+    }
+    return result;
+}
+
+size_t TlsfHeap::adjustSize(size_t size)
+{
+    if(size>maxBlockSize) return 0;
+    size=(size+alignment-1) & ~(alignment-1);
+    return max(size,minBlockSize);
+}
+
+void TlsfHeap::mapping(size_t size, unsigned int& fl, unsigned int& sl)
+{
+    if(size<smallBlockSize)
+    {
+        fl=0;
+        sl=size/(smallBlockSize/slCount);
+    } else {
+        unsigned int msb=fls(size);
+        sl=(size>>(msb-slLog2)) ^ slCount;
+        fl=msb-flShift+1;
+    }
+}
+
+void TlsfHeap::removeFree(Block *b)
+{
+    unsigned int fl,sl;
+    mapping(blockSize(b),fl,sl);
+    if(b->nextFree) b->nextFree->prevFree=b->prevFree;
+    if(b->prevFree) b->prevFree->nextFree=b->nextFree;
+    else {
+        freeLists[fl][sl]=b->nextFree;
+        if(b->nextFree==nullptr)
+        {
+            slBitmap[fl]&=~(1u<<sl);
+            if(slBitmap[fl]==0) flBitmap&=~(1u<<fl);
+        }
+    }
+}
+
+void TlsfHeap::insertFree(Block *b)
+{
+    unsigned int fl,sl;
+    mapping(blockSize(b),fl,sl);
+    Block *head=freeLists[fl][sl];
+    b->nextFree=head;
+    b->prevFree=nullptr;
+    if(head) head->prevFree=b;
+    freeLists[fl][sl]=b;
+    flBitmap|=1u<<fl;
+    slBitmap[fl]|=1u<<sl;
+}
+
+TlsfHeap::Block *TlsfHeap::locateFree(size_t size)
+{
+    //Round the size up to the next list, so that any block found is large
+    //enough without having to scan the list
+    if(size>=smallBlockSize) size+=(size_t(1)<<(fls(size)-slLog2))-1;
+    unsigned int fl,sl;
+    mapping(size,fl,sl);
+    if(fl>=flCount) return nullptr;
+    unsigned int slMap=slBitmap[fl] & (~0u<<sl);
+    if(slMap==0)
+    {
+        unsigned int flMap=flBitmap & (~0u<<fl<<1);
+        if(flMap==0) return nullptr;
+        fl=ffs(flMap);
+        slMap=slBitmap[fl];
+    }
+    Block *b=freeLists[fl][ffs(slMap)];
+    removeFree(b);
+    return b;
+}
+
+void TlsfHeap::split(Block *b, size_t size)
+{
+    if(blockSize(b)<size+sizeof(Block)) return;
+    Block *rest=reinterpret_cast<Block*>(payload(b)+size);
+    rest->prevPhys=b;
+    rest->size=(blockSize(b)-size-headerSize) | freeFlag;
+    b->size=size | (b->size & freeFlag);
+    Block *after=nextPhys(rest);
+    if(isFree(after))
+    {
+        removeFree(after);
+        rest->size+=headerSize+blockSize(after);
+        after=nextPhys(rest);
+    }
+    after->prevPhys=rest;
+    insertFree(rest);
+}
+
+void *TlsfHeap::markUsed(Block *b, size_t size)
+{
+    split(b,size);
+    b->size&=~freeFlag;
+    used+=blockSize(b)+headerSize;
+    maxUsed=max(maxUsed,used);
+    allocations++;
+    return payload(b);
+}
+
+#ifdef TEST_ALLOC
+void TlsfHeap::check() const
+{
+    //Walk the heap in address order
+    unsigned int freeBlocks=0, usedBlocks=0, usedBytes=0;
+    const Block *prev=nullptr;
+    auto b=reinterpret_cast<const Block*>(start);
+    while(reinterpret_cast<const char*>(b)<end)
+    {
+        if(b->prevPhys!=prev) throw runtime_error("wrong prevPhys");
+        if(blockSize(b)<minBlockSize || blockSize(b)%alignment)
+            throw runtime_error("wrong size");
+        if(isFree(b))
+        {
+            if(prev && isFree(prev)) throw runtime_error("unmerged blocks");
+            freeBlocks++;
+        } else {
+            usedBlocks++;
+            usedBytes+=blockSize(b)+headerSize;
+        }
+        prev=b;
+        b=reinterpret_cast<const Block*>(
+            reinterpret_cast<const char*>(b)+headerSize+blockSize(b));
+    }
+    if(reinterpret_cast<const char*>(b)!=end || (heapSize && b->prevPhys!=prev))
+        throw runtime_error("wrong sentinel");
+    if(usedBlocks!=allocations || usedBytes!=used)
+        throw runtime_error("wrong stats");
+    //Walk the free lists
+    for(unsigned int fl=0;fl<flCount;fl++)
+    {
+        if(((flBitmap>>fl) & 1)!=(slBitmap[fl]!=0))
+            throw runtime_error("wrong first level bitmap");
+        for(unsigned int sl=0;sl<slCount;sl++)
+        {
+            if(((slBitmap[fl]>>sl) & 1)!=(freeLists[fl][sl]!=nullptr))
+                throw runtime_error("wrong second level bitmap");
+            const Block *listPrev=nullptr;
+            for(const Block *f=freeLists[fl][sl];f;f=f->nextFree)
+            {
+                unsigned int flf,slf;
+                mapping(blockSize(f),flf,slf);
+                if(isFree(f)==false || flf!=fl || slf!=sl || f->prevFree!=listPrev)
+                    throw runtime_error("wrong free list");
+                listPrev=f;
+                freeBlocks--;
+            }
+        }
+    }
+    if(freeBlocks) throw runtime_error("free block not in free lists");
+}
+#endif //TEST_ALLOC
+
+//
+// Locked interface to all the heaps
+//
+
+void *heapAllocate(size_t size)
+{
+    PauseKernelLock dLock;
+    for(TlsfHeap *h=&TlsfHeap::instance();h;h=h->nextHeap())
+        if(void *result=h->allocate(size)) return result;
+    return nullptr;
+}
+
+void *heapAllocateAligned(size_t align, size_t size)
+{
+    PauseKernelLock dLock;
+    for(TlsfHeap *h=&TlsfHeap::instance();h;h=h->nextHeap())
+        if(void *result=h->allocateAligned(align,size)) return result;
+    return nullptr;
+}
+
+void *heapReallocate(void *ptr, size_t size)
+{
+    if(ptr==nullptr) return heapAllocate(size);
+    {
+        PauseKernelLock dLock;
+        TlsfHeap *heap=TlsfHeap::findHeap(ptr);
+        if(heap==nullptr) return nullptr;
+        if(void *result=heap->reallocate(ptr,size)) return result;
+        if(size==0) return nullptr;
+    }
+    //This heap is full, move the block to another one
+    void *result=heapAllocate(size);
+    if(result==nullptr) return nullptr;
+    memcpy(result,ptr,TlsfHeap::usableSize(ptr));
+    heapDeallocate(ptr);
+    return result;
+}
+
+void heapDeallocate(void *ptr)
+{
+    if(ptr==nullptr) return;
+    PauseKernelLock dLock;
+    if(TlsfHeap *heap=TlsfHeap::findHeap(ptr)) heap->deallocate(ptr);
+}
+
+} //namespace miosix
+
+#ifdef TEST_ALLOC
+//g++ -std=c++14 -O2 -o th -DTEST_ALLOC -DWITH_TLSF_HEAP tlsf_heap.cpp && ./th
+using namespace miosix;
+using namespace std::chrono;
+
+/**
+ * Random sizes, mostly small blocks like strings and list nodes
+ */
+static unsigned int randomSize(mt19937& rng)
+{
+    return rng()%(16<<(rng()%8))+1;
+}
+
+/**
+ * Check the allocator for overlapping blocks, lost data and leaks
+ */
+static void testAllocator(unsigned int seed)
+{
+    struct Allocation
+    {
+        unsigned char *ptr;
+        unsigned int size;
+        unsigned char fill;
+    };
+    //A small second heap, like core coupled memory
+    const unsigned int ccmSize=32*1024;
+    static char ccmMemory[ccmSize];
+    static TlsfHeap ccm(ccmMemory,ccmSize,"ccm");
+    TlsfHeap::addHeap(&ccm);
+    TlsfHeap& heap=TlsfHeap::instance();
+    const HeapStats initial=heap.getStats();
+    if(initial.fragmentation!=0 || initial.largestFree+sizeof(void*)*2!=initial.size)
+        throw runtime_error("wrong initial stats");
+    mt19937 rng(seed);
+    vector<Allocation> allocations;
+    unsigned int failures=0, ccmAllocations=0, maxFragmentation=0;
+    const int iterations=1000000;
+    for(int i=0;i<iterations;i++)
+    {
+        //Allocate or reallocate 50% of the times, less when the heap is full
+        unsigned int op=allocations.empty() ? 0 : rng()%(failures%4==0 ? 4 : 5);
+        if(op<2)
+        {
+            unsigned int size=randomSize(rng);
+            unsigned int align=op==1 ? 1<<(rng()%10) : 8;
+            void *p=op==1 ? heapAllocateAligned(align,size) : heapAllocate(size);
+            if(p==nullptr) { failures++; continue; }
+            auto ptr=reinterpret_cast<unsigned char*>(p);
+            if(reinterpret_cast<uintptr_t>(ptr) & (align-1))
+                throw runtime_error("not aligned");
+            if(TlsfHeap::usableSize(ptr)<size) throw runtime_error("too small");
+            if(TlsfHeap::findHeap(ptr)==&ccm) ccmAllocations++;
+            //Fill the block so that overlapping blocks are detected
+            unsigned char fill=rng();
+            memset(ptr,fill,size);
+            allocations.push_back({ptr,size,fill});
+        } else {
+            unsigned int index=rng()%allocations.size();
+            Allocation& a=allocations[index];
+            for(unsigned int j=0;j<a.size;j++)
+                if(a.ptr[j]!=a.fill) throw runtime_error("corrupted block");
+            if(op==2)
+            {
+                unsigned int size=randomSize(rng);
+                void *p=heapReallocate(a.ptr,size);
+                if(p==nullptr) { failures++; continue; }
+                a.ptr=reinterpret_cast<unsigned char*>(p);
+                for(unsigned int j=0;j<min(a.size,size);j++)
+                    if(a.ptr[j]!=a.fill) throw runtime_error("realloc lost data");
+                memset(a.ptr,a.fill,size);
+                a.size=size;
+            } else {
+                heapDeallocate(a.ptr);
+                allocations[index]=allocations.back();
+                allocations.pop_back();
+            }
+        }
+        maxFragmentation=max(maxFragmentation,heap.getStats().fragmentation);
+        if(i%10000==0) { heap.check(); ccm.check(); }
+    }
+    heap.check();
+    ccm.check();
+    for(auto *h=&heap;h;h=h->nextHeap())
+    {
+        HeapStats s=h->getStats();
+        cout<<h->getName()<<": size "<<s.size<<" used "<<s.used<<"/"<<s.maxUsed
+            <<" largest free "<<s.largestFree<<" fragmentation "
+            <<s.fragmentation<<"% blocks "<<s.allocations<<endl;
+    }
+    for(auto& a : allocations) heapDeallocate(a.ptr);
+    heap.check();
+    ccm.check();
+    HeapStats s=heap.getStats();
+    if(s.used!=0 || s.largestFree!=initial.largestFree || s.fragmentation!=0)
+        throw runtime_error("memory leak");
+    if(ccmAllocations==0) throw runtime_error("second heap not used");
+    cout<<"Failures "<<failures<<" allocations from ccm "<<ccmAllocations
+        <<" max fragmentation "<<maxFragmentation<<"%"<<endl;
+}
+
+/**
+ * Measure the time taken by each allocator operation replaying the same
+ * random sequence, and print the average, 99.99th percentile and worst case
+ */
+static void benchmark(const char *name, unsigned int seed,
+    void *(*allocate)(size_t), void *(*reallocate)(void *, size_t),
+    void (*deallocate)(void *))
+{
+    mt19937 rng(seed);
+    vector<void*> allocations;
+    vector<long long> times[3];
+    const int iterations=1000000;
+    //Sizes average about 256 bytes, so the live blocks take about 128KB, and
+    //the 256KB test heap leaves room for fragmentation and outliers
+    const unsigned int maxLive=500;
+    for(int i=0;i<iterations;i++)
+    {
+        unsigned int op=allocations.empty() ? 0 : rng()%3;
+        if(op==0 && allocations.size()>=maxLive) op=2;
+        unsigned int index=allocations.empty() ? 0 : rng()%allocations.size();
+        unsigned int size=randomSize(rng);
+        auto t=steady_clock::now();
+        switch(op)
+        {
+            case 0:
+                allocations.push_back(allocate(size));
+                break;
+            case 1:
+                allocations[index]=reallocate(allocations[index],size);
+                break;
+            case 2:
+                deallocate(allocations[index]);
+                break;
+        }
+        times[op].push_back(duration_cast<nanoseconds>(steady_clock::now()-t).count());
+        if((op==0 && allocations.back()==nullptr)
+            || (op==1 && allocations[index]==nullptr))
+            throw runtime_error("out of memory");
+        if(op==2)
+        {
+            allocations[index]=allocations.back();
+            allocations.pop_back();
+        }
+    }
+    for(auto p : allocations) deallocate(p);
+    const char *ops[]={"malloc","realloc","free"};
+    for(int i=0;i<3;i++)
+    {
+        auto& t=times[i];
+        long long sum=0;
+        for(auto x : t) sum+=x;
+        sort(t.begin(),t.end());
+        cout<<name<<" "<<ops[i]<<": average "<<sum/static_cast<long long>(t.size())
+            <<"ns 99.99% "<<t[t.size()*9999/10000]<<"ns worst "<<t.back()
+            <<"ns"<<endl;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned int seed=argc>1 ? atoi(argv[1]) : 0;
+    testAllocator(seed);
+    //The worst case includes preemption by the host OS, the 99.99th
+    //percentile is more representative
+    benchmark("tlsf",seed,heapAllocate,heapReallocate,heapDeallocate);
+    benchmark("libc",seed,malloc,realloc,free);
+    cout<<"Test passed"<<endl;
+}
+#endif //TEST_ALLOC
+
+#endif //WITH_TLSF_HEAP
@@ -0,0 +1,312 @@
+/***************************************************************************
+ *   Copyright (C) 2024 by Terraneo Federico                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+#pragma once
+
+#include <cstddef>
+
+#ifndef TEST_ALLOC
+#include "config/miosix_settings.h"
+#endif //TEST_ALLOC
+
+#ifdef WITH_TLSF_HEAP
+
+namespace miosix {
+
+/**
+ * Statistics of a TlsfHeap. All sizes are in bytes and include the per block
+ * overhead of the allocator
+ */
+struct HeapStats
+{
+    unsigned int size=0;          ///< Heap size
+    unsigned int used=0;          ///< Currently allocated memory
+    unsigned int maxUsed=0;       ///< Maximum allocated memory since creation
+    unsigned int largestFree=0;   ///< Largest block that can be allocated
+    unsigned int fragmentation=0; ///< Free memory not in the largest block, %
+    unsigned int allocations=0;   ///< Number of blocks currently allocated
+    unsigned int failures=0;      ///< Number of failed allocations
+};
+
+/**
+ * A Two Level Segregated Fit heap allocator.
+ *
+ * Free blocks are kept in lists indexed by size class, with a first level
+ * for power of two ranges and a second level dividing each range linearly.
+ * Two bitmaps record which lists are not empty, so allocate, deallocate and
+ * reallocate in place take constant time regardless of the number and size of
+ * allocated blocks, as required when allocating from real-time threads.
+ * Neighbouring free blocks are merged immediately, and a free block is
+ * always large enough for the request it is selected for (good fit), which
+ * keeps fragmentation low.
+ *
+ * This class is not thread safe, the heapAllocate() family of functions
+ * provide a locked interface to all the registered heaps.
+ */
+class TlsfHeap
+{
+public:
+    /**
+     * Constructor
+     * \param base start of the memory area, need not be aligned
+     * \param size size of the memory area in bytes
+     * \param name name of the heap, used when printing statistics
+     */
+    TlsfHeap(void *base, unsigned int size, const char *name);
+
+    /**
+     * \return the system heap, which spans the memory between the end of the
+     * .bss and the heap end set in the linker script. It is the first heap
+     * malloc allocates from
+     */
+    static TlsfHeap& instance();
+
+    /**
+     * Register an additional heap, for example in core coupled memory or
+     * external RAM. Malloc will allocate from it when the heaps registered
+     * before it are full. Heaps cannot be removed.
+     * \param heap heap to add, must not be destroyed
+     */
+    static void addHeap(TlsfHeap *heap);
+
+    /**
+     * \param ptr a pointer
+     * \return the registered heap the pointer belongs to, or nullptr
+     */
+    static TlsfHeap *findHeap(const void *ptr);
+
+    /**
+     * \return the next registered heap, or nullptr. Iteration starts from
+     * instance()
+     */
+    TlsfHeap *nextHeap() const { return next; }
+
+    /**
+     * Allocate memory, aligned to 8 bytes
+     * \param size size in bytes
+     * \return the allocated memory or nullptr if no block large enough exists
+     */
+    void *allocate(size_t size);
+
+    /**
+     * Allocate memory with a given alignment
+     * \param align requested alignment, must be a power of two
+     * \param size size in bytes
+     * \return the allocated memory or nullptr if no block large enough exists
+     */
+    void *allocateAligned(size_t align, size_t size);
+
+    /**
+     * Resize a block, moving it within this heap if it can't grow in place
+     * \param ptr block to resize, must belong to this heap or be nullptr
+     * \param size new size in bytes
+     * \return the resized block, or nullptr if not enough memory, in which
+     * case the original block is left untouched
+     */
+    void *reallocate(void *ptr, size_t size);
+
+    /**
+     * Deallocate memory
+     * \param ptr block to deallocate, must belong to this heap or be nullptr
+     */
+    void deallocate(void *ptr);
+
+    /**
+     * \param ptr a block allocated from a TlsfHeap
+     * \return the number of usable bytes in the block, which can be greater
+     * than the requested size
+     */
+    static size_t usableSize(const void *ptr);
+
+    /**
+     * \param ptr a pointer
+     * \return true if the pointer is within this heap
+     */
+    bool contains(const void *ptr) const
+    {
+        auto p=reinterpret_cast<const char*>(ptr);
+        return p>=start && p<end;
+    }
+
+    /**
+     * \return the heap statistics. Computing the largest free block requires
+     * scanning one of the free lists
+     */
+    HeapStats getStats() const;
+
+    /**
+     * \return the name of the heap
+     */
+    const char *getName() const { return name; }
+
+    #ifdef TEST_ALLOC
+    /**
+     * Check the consistency of the heap
+     * \throws runtime_error if the heap is corrupted
+     */
+    void check() const;
+    #endif //TEST_ALLOC
+
+    TlsfHeap(const TlsfHeap&)=delete;
+    TlsfHeap& operator=(const TlsfHeap&)=delete;
+
+private:
+    /**
+     * Header of a memory block. The block payload starts after the size field,
+     * while the free list pointers are only valid when the block is free, and
+     * overlap the payload
+     */
+    struct Block
+    {
+        Block *prevPhys; ///< Previous block in memory, nullptr for the first
+        size_t size;     ///< Payload size, the lowest bit is the free flag
+        Block *nextFree; ///< Next block in the same free list
+        Block *prevFree; ///< Previous block in the same free list
+    };
+
+    static const unsigned int alignLog2=3;
+    static const size_t alignment=1<<alignLog2;
+    static const unsigned int slLog2=4; ///< log2 of second level lists
+    static const unsigned int slCount=1<<slLog2;
+    static const unsigned int flShift=slLog2+alignLog2;
+    static const unsigned int flMax=28; ///< Blocks are less than 256MB
+    static const unsigned int flCount=flMax-flShift+1;
+    static const size_t smallBlockSize=1<<flShift;
+    static const size_t freeFlag=1;
+    static const size_t headerSize=offsetof(Block,nextFree);
+    static const size_t minBlockSize=sizeof(Block)-headerSize;
+    static const size_t maxBlockSize=(1<<flMax)-alignment;
+
+    static size_t blockSize(const Block *b) { return b->size & ~freeFlag; }
+    static bool isFree(const Block *b) { return b->size & freeFlag; }
+    static char *payload(Block *b)
+    {
+        return reinterpret_cast<char*>(b)+headerSize;
+    }
+    static Block *fromPayload(const void *ptr)
+    {
+        return reinterpret_cast<Block*>(
+            const_cast<char*>(reinterpret_cast<const char*>(ptr))-headerSize);
+    }
+    static Block *nextPhys(Block *b)
+    {
+        return reinterpret_cast<Block*>(payload(b)+blockSize(b));
+    }
+
+    /**
+     * \param size requested size
+     * \return size rounded to the alignment and the minimum block size,
+     * or 0 if too large
+     */
+    static size_t adjustSize(size_t size);
+
+    /**
+     * Compute the free list a block belongs to
+     */
+    static void mapping(size_t size, unsigned int& fl, unsigned int& sl);
+
+    /**
+     * Remove a free block from its free list
+     */
+    void removeFree(Block *b);
+
+    /**
+     * Add a free block to its free list
+     */
+    void insertFree(Block *b);
+
+    /**
+     * Find and remove from its list a free block of at least the given size
+     * \return the block or nullptr
+     */
+    Block *locateFree(size_t size);
+
+    /**
+     * Split a block if it is large enough to hold size bytes and another
+     * block, the second part is merged with the following block if free
+     * and added to the free lists
+     */
+    void split(Block *b, size_t size);
+
+    /**
+     * Mark a block as allocated, after giving back its unused tail
+     * \return the block payload
+     */
+    void *markUsed(Block *b, size_t size);
+
+    char *start;                      ///< Start of the heap
+    char *end;                        ///< End of the heap
+    const char *name;                 ///< Heap name
+    TlsfHeap *next=nullptr;           ///< Next registered heap
+    unsigned int flBitmap=0;          ///< Non empty first level ranges
+    unsigned int slBitmap[flCount]={};///< Non empty second level lists
+    Block *freeLists[flCount][slCount]={};
+    unsigned int heapSize=0;          ///< Heap size
+    unsigned int used=0;              ///< Currently allocated memory
+    unsigned int maxUsed=0;           ///< Peak allocated memory
+    unsigned int allocations=0;       ///< Currently allocated blocks
+    unsigned int failures=0;          ///< Failed allocations
+};
+
+/**
+ * Allocate from the system heap, and from the additional heaps in the order
+ * they were added if it is full. All the heapAllocate() family of functions
+ * are thread safe and pause the kernel only for the bounded time a TlsfHeap
+ * operation takes, but can't be called from interrupts.
+ * \param size size in bytes
+ * \return the allocated memory or nullptr
+ */
+void *heapAllocate(size_t size);
+
+/**
+ * Allocate aligned memory, like heapAllocate()
+ * \param align requested alignment, must be a power of two
+ * \param size size in bytes
+ * \return the allocated memory or nullptr
+ */
+void *heapAllocateAligned(size_t align, size_t size);
+
+/**
+ * Resize a block allocated by heapAllocate(), moving it to another heap if
+ * its heap is full
+ * \param ptr block to resize or nullptr
+ * \param size new size in bytes
+ * \return the resized block, or nullptr if not enough memory, in which
+ * case the original block is left untouched
+ */
+void *heapReallocate(void *ptr, size_t size);
+
+/**
+ * Deallocate a block allocated by heapAllocate(). Pointers not belonging to
+ * any heap are ignored
+ * \param ptr block to deallocate or nullptr
+ */
+void heapDeallocate(void *ptr);
+
+} //namespace miosix
+
+#endif //WITH_TLSF_HEAP
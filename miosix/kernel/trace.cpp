@@ -0,0 +1,126 @@
+/***************************************************************************
+ *   Copyright (C) 2024 by Terraneo Federico                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+#include "trace.h"
+#include "kernel/kernel.h"
+#include "interfaces/os_timer.h"
+#include <fcntl.h>
+#include <unistd.h>
+
+#ifdef WITH_KERNEL_TRACE
+
+namespace miosix {
+
+KernelTrace::Slot KernelTrace::ring[KERNEL_TRACE_EVENTS];
+volatile int KernelTrace::head=0;
+unsigned int KernelTrace::tail=0;
+volatile int KernelTrace::lost=0;
+
+unsigned int KernelTrace::read(TraceEvent *events, unsigned int maxEvents)
+{
+    unsigned int result=0;
+    if(maxEvents==0) return 0;
+    int l=atomicSwap(&lost,0);
+    if(l>0)
+    {
+        events[result].timestamp=CycleCounter::IRQget();
+        events[result].type=TraceEventType::Lost;
+        events[result].arg16=0;
+        events[result].a=l;
+        events[result].b=0;
+        result++;
+    }
+    while(result<maxEvents)
+    {
+        Slot& slot=ring[tail & (KERNEL_TRACE_EVENTS-1)];
+        //Either empty or a producer is still writing the event
+        if(slot.sequence!=tail+1) break;
+        events[result++]=slot.event;
+        asm volatile("":::"memory");
+        slot.sequence=tail+KERNEL_TRACE_EVENTS;
+        tail++;
+    }
+    return result;
+}
+
+TraceEvent KernelTrace::syncEvent()
+{
+    TraceEvent result;
+    long long t;
+    {
+        FastInterruptDisableLock dLock;
+        result.timestamp=CycleCounter::IRQget();
+        t=IRQgetTime();
+    }
+    result.type=TraceEventType::Sync;
+    result.arg16=0;
+    result.a=static_cast<unsigned int>(t);
+    result.b=static_cast<unsigned int>(t>>32);
+    return result;
+}
+
+void KernelTrace::drain(const char *path, long long nsInterval)
+{
+    int fd=open(path,O_WRONLY|O_CREAT|O_TRUNC,0644);
+    if(fd<0) return;
+    const unsigned int maxEvents=32;
+    TraceEvent events[maxEvents];
+    events[0].timestamp=CycleCounter::IRQget();
+    events[0].type=TraceEventType::Header;
+    events[0].arg16=traceVersion;
+    events[0].a=traceMagic;
+    events[0].b=sizeof(TraceEvent);
+    events[1]=syncEvent();
+    bool ok=write(fd,events,2*sizeof(TraceEvent))==2*sizeof(TraceEvent);
+    long long t=getTime();
+    while(ok && !Thread::testTerminate())
+    {
+        t+=nsInterval;
+        Thread::nanoSleepUntil(t);
+        unsigned int n;
+        while(ok && (n=read(events,maxEvents))>0)
+        {
+            ssize_t size=n*sizeof(TraceEvent);
+            ok=write(fd,events,size)==size;
+        }
+        events[0]=syncEvent();
+        if(ok) ok=write(fd,events,sizeof(TraceEvent))==sizeof(TraceEvent);
+    }
+    close(fd);
+}
+
+void KernelTrace::IRQinit()
+{
+    for(unsigned int i=0;i<KERNEL_TRACE_EVENTS;i++) ring[i].sequence=i;
+    head=0;
+    tail=0;
+    lost=0;
+}
+
+} //namespace miosix
+
+#endif //WITH_KERNEL_TRACE
@@ -0,0 +1,193 @@
+/***************************************************************************
+ *   Copyright (C) 2024 by Terraneo Federico                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+#pragma once
+
+#include "config/miosix_settings.h"
+
+#ifdef WITH_KERNEL_TRACE
+
+#include "kernel/trace_types.h"
+#include "kernel/cycle_counter.h"
+#include "interfaces/atomic_ops.h"
+
+namespace miosix {
+
+/**
+ * \addtogroup Kernel
+ * \{
+ */
+
+/**
+ * KernelTrace records kernel events, such as context switches, thread wakeups
+ * and sleeps, mutex contention, syscalls and interrupts, in a ring buffer of
+ * fixed size binary events. It is intended for debugging priority inversions
+ * and missed deadlines, and is enabled only if the symbol `WITH_KERNEL_TRACE`
+ * has been defined in config/miosix_settings.h.
+ *
+ * Recording an event is lock-free and can be done from any context. If the
+ * buffer is full the event is dropped, and a Lost event is later reported.
+ * The buffer is emptied by a single consumer, usually the drain() thread, that
+ * writes the events to a file or a serial port. The host program in
+ * _tools/kernel_trace converts the trace to Chrome trace JSON, that can be
+ * opened with Perfetto.
+ *
+ *      std::thread traceThread(KernelTrace::drain, "/sd/trace.bin", 100000000LL);
+ */
+class KernelTrace
+{
+public:
+    /**
+     * Record an event. Can be called from any context
+     * \param type event type
+     * \param arg16 small event argument
+     * \param a first event argument
+     * \param b second event argument
+     */
+    static inline void IRQrecord(TraceEventType type, unsigned short arg16,
+                                 unsigned int a, unsigned int b);
+
+    /**
+     * \internal
+     * Record a syscall, the exit event is recorded by the destructor
+     */
+    class SyscallScope
+    {
+    public:
+        SyscallScope(unsigned short id) : id(id)
+        {
+            IRQrecord(TraceEventType::SyscallEnter,id,0,0);
+        }
+
+        ~SyscallScope()
+        {
+            IRQrecord(TraceEventType::SyscallExit,id,0,0);
+        }
+
+        SyscallScope(const SyscallScope&)=delete;
+        SyscallScope& operator=(const SyscallScope&)=delete;
+
+    private:
+        unsigned short id;
+    };
+
+    /**
+     * Take the events recorded so far out of the buffer. If events were lost,
+     * a Lost event is returned first. Only one thread at a time can call this
+     * function
+     * \param events the events are copied here
+     * \param maxEvents maximum number of events to copy
+     * \return the number of events copied
+     */
+    static unsigned int read(TraceEvent *events, unsigned int maxEvents);
+
+    /**
+     * \return a Sync event, relating the current timestamp to IRQgetTime()
+     */
+    static TraceEvent syncEvent();
+
+    /**
+     * Continuously write the recorded events to a file or device, starting
+     * with a Header and a Sync event. A Sync event is written every time the
+     * buffer is emptied, so the decoder can convert timestamps to time.
+     * Returns once Thread::testTerminate() returns `true', or if the file can't
+     * be opened or written.
+     * \param path file or device where the trace is written, truncated if it
+     * already exists
+     * \param nsInterval interval at which the buffer is emptied, small enough
+     * that it does not overflow
+     */
+    static void drain(const char *path, long long nsInterval);
+
+    /**
+     * \internal
+     * Empty the buffer. Called by the kernel at boot
+     */
+    static void IRQinit();
+
+private:
+    KernelTrace()=delete;
+
+    /**
+     * \internal
+     * A slot of the ring buffer. The sequence number tells whether the slot is
+     * free or holds an event, allowing multiple producers without locking
+     */
+    struct Slot
+    {
+        volatile unsigned int sequence; ///< Position for which slot is free
+        TraceEvent event;
+    };
+
+    static_assert((KERNEL_TRACE_EVENTS & (KERNEL_TRACE_EVENTS-1))==0,
+                  "KERNEL_TRACE_EVENTS must be a power of two");
+
+    static Slot ring[KERNEL_TRACE_EVENTS];
+    static volatile int head; ///< Next position to be reserved by producers
+    static unsigned int tail; ///< Next position to be read by the consumer
+    static volatile int lost; ///< Events dropped since the last read()
+};
+
+inline void KernelTrace::IRQrecord(TraceEventType type, unsigned short arg16,
+                                   unsigned int a, unsigned int b)
+{
+    //The slot for position pos is free if its sequence is pos, and holds the
+    //event for pos if it is pos+1. Producers reserve a position by advancing
+    //head, the event becomes visible to the consumer when sequence is updated
+    unsigned int pos;
+    Slot *slot;
+    for(;;)
+    {
+        pos=head;
+        slot=&ring[pos & (KERNEL_TRACE_EVENTS-1)];
+        int diff=static_cast<int>(slot->sequence-pos);
+        if(diff<0)
+        {
+            //Slot still holds the event of a previous lap, the buffer is full
+            atomicAdd(&lost,1);
+            return;
+        }
+        if(diff>0) continue; //Another producer reserved pos, retry
+        int p=static_cast<int>(pos);
+        if(atomicCompareAndSwap(&head,p,p+1)==p) break;
+    }
+    slot->event.timestamp=CycleCounter::IRQget();
+    slot->event.type=type;
+    slot->event.arg16=arg16;
+    slot->event.a=a;
+    slot->event.b=b;
+    asm volatile("":::"memory");
+    slot->sequence=pos+1;
+}
+
+/**
+ * \}
+ */
+
+} //namespace miosix
+
+#endif //WITH_KERNEL_TRACE
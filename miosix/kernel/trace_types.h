@@ -0,0 +1,82 @@
+/***************************************************************************
+ *   Copyright (C) 2024 by Terraneo Federico                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+#pragma once
+
+/*
+ * This file only contains the binary format of kernel trace events, without
+ * dependencies, so that it can also be included by the host side decoder in
+ * _tools/kernel_trace
+ */
+
+namespace miosix {
+
+/**
+ * Types of kernel trace events. The meaning of the arg16, a and b fields of
+ * TraceEvent depends on the event type
+ */
+enum class TraceEventType : unsigned short
+{
+    Header=1,       ///< a=traceMagic, b=sizeof(TraceEvent), arg16=traceVersion
+    Sync,           ///< a,b=lower and upper 32 bits of IRQgetTime()
+    Lost,           ///< a=number of events dropped as the buffer was full
+    ContextSwitch,  ///< a=previous thread, b=next thread
+    Wakeup,         ///< a=woken thread
+    Sleep,          ///< a=thread starting a sleep
+    Wait,           ///< a=thread starting a wait
+    MutexBlock,     ///< a=mutex, b=owner thread
+    SyscallEnter,   ///< arg16=syscall id
+    SyscallExit,    ///< arg16=syscall id
+    IrqEnter,       ///< arg16=interrupt id
+    IrqExit         ///< arg16=interrupt id
+};
+
+/**
+ * A kernel trace event, as stored in the ring buffer and written to the trace
+ * file. Events are written in the target endianness. The running thread is not
+ * stored, the decoder knows it from ContextSwitch events.
+ */
+struct TraceEvent
+{
+    unsigned int timestamp; ///< CycleCounter value, converted using Sync events
+    TraceEventType type;    ///< Event type
+    unsigned short arg16;   ///< Small event argument
+    unsigned int a;         ///< First event argument
+    unsigned int b;         ///< Second event argument
+};
+
+static_assert(sizeof(TraceEvent)==16,"TraceEvent layout is part of the format");
+
+/// Value of the a field of the Header event, "MXTR"
+const unsigned int traceMagic=0x5254584d;
+/// Value of the arg16 field of the Header event
+const unsigned short traceVersion=1;
+/// Interrupt id of the os timer in IrqEnter and IrqExit events. Other
+/// interrupts use the hardware interrupt number
+const unsigned short traceOsTimerIrq=0xffff;
+
+} //namespace miosix
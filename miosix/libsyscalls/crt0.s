@@ -202,6 +202,95 @@ lseek:
 	blt  syscallfailed64
 	bx   lr
 
+/**
+ * pread
+ * \param fd file descriptor, passed in r0
+ * \param buf buffer where to store read data, passed in r1
+ * \param size buffer size, passed in r2
+ * \param pos read offset, passed in the stack as it is a long long
+ * \return number of bytes read on success, -1 on failure
+ */
+.section .text.pread
+.global pread
+.type pread, %function
+pread:
+	mov  r12, sp   /* Pointer to pos moved to 4th syscall parameter (r12) */
+	movs r3, #34
+	svc  0
+	cmp  r0, #0
+	blt  syscallfailed32
+	bx   lr
+
+/**
+ * pwrite
+ * \param fd file descriptor, passed in r0
+ * \param buf data to be written, passed in r1
+ * \param size buffer size, passed in r2
+ * \param pos write offset, passed in the stack as it is a long long
+ * \return number of bytes written on success, -1 on failure
+ */
+.section .text.pwrite
+.global pwrite
+.type pwrite, %function
+pwrite:
+	mov  r12, sp   /* Pointer to pos moved to 4th syscall parameter (r12) */
+	movs r3, #35
+	svc  0
+	cmp  r0, #0
+	blt  syscallfailed32
+	bx   lr
+
+/**
+ * readv
+ * \param fd file descriptor, passed in r0
+ * \param iov array of buffers where to store read data, passed in r1
+ * \param iovcnt number of elements in iov, passed in r2
+ * \return number of bytes read on success, -1 on failure
+ */
+.section .text.readv
+.global readv
+.type readv, %function
+readv:
+	movs r3, #36
+	svc  0
+	cmp  r0, #0
+	blt  syscallfailed32
+	bx   lr
+
+/**
+ * writev
+ * \param fd file descriptor, passed in r0
+ * \param iov array of buffers to be written, passed in r1
+ * \param iovcnt number of elements in iov, passed in r2
+ * \return number of bytes written on success, -1 on failure
+ */
+.section .text.writev
+.global writev
+.type writev, %function
+writev:
+	movs r3, #37
+	svc  0
+	cmp  r0, #0
+	blt  syscallfailed32
+	bx   lr
+
+/**
+ * poll
+ * \param fds array of struct pollfd, passed in r0
+ * \param nfds number of elements in fds, passed in r1
+ * \param timeout timeout in milliseconds, passed in r2
+ * \return number of ready file descriptors on success, -1 on failure
+ */
+.section .text.poll
+.global poll
+.type poll, %function
+poll:
+	movs r3, #59
+	svc  0
+	cmp  r0, #0
+	blt  syscallfailed32
+	bx   lr
+
 /**
  * stat
  * \param path path to file or directory
@@ -779,6 +868,175 @@ getppid:
 
 /* TODO: missing syscalls: getuid, getgid, geteuid, getegid, setuid, setgid */
 
+/**
+ * __thread_create, nonstandard syscall, used to implement pthread_create
+ * \param entry thread entry point
+ * \param arg argument passed to the entry point
+ * \param stack lowest address of the thread stack
+ * \param size stack size in bytes
+ * \return the thread id on success, a negative error code on failure
+ */
+.section .text.__thread_create
+.global __thread_create
+.type __thread_create, %function
+__thread_create:
+	mov  r12, r3
+	movs r3, #60
+	svc  0
+	bx   lr
+
+/**
+ * __thread_join, nonstandard syscall, used to implement pthread_join
+ * \param tid thread id returned by __thread_create
+ * \param result the thread return value is stored here, can be nullptr
+ * \return 0 on success, a negative error code on failure
+ */
+.section .text.__thread_join
+.global __thread_join
+.type __thread_join, %function
+__thread_join:
+	movs r3, #61
+	svc  0
+	bx   lr
+
+/**
+ * __thread_exit, nonstandard syscall, used to implement pthread_exit
+ * \param result thread return value
+ * Does not return, except when called by the main thread, in which case it
+ * returns 0 once all other threads have exited
+ */
+.section .text.__thread_exit
+.global __thread_exit
+.type __thread_exit, %function
+__thread_exit:
+	movs r3, #62
+	svc  0
+	bx   lr
+
+/**
+ * __futex_wait, nonstandard syscall
+ * \param addr address of the futex word
+ * \param expected block only if *addr is still equal to this value
+ * \return 0 if woken up, a negative error code otherwise
+ */
+.section .text.__futex_wait
+.global __futex_wait
+.type __futex_wait, %function
+__futex_wait:
+	movs r3, #63
+	svc  0
+	bx   lr
+
+/**
+ * __futex_wake, nonstandard syscall
+ * \param addr address of the futex word
+ * \param count maximum number of threads to wake
+ * \return the number of threads woken up
+ */
+.section .text.__futex_wake
+.global __futex_wake
+.type __futex_wake, %function
+__futex_wake:
+	movs r3, #64
+	svc  0
+	bx   lr
+
+/**
+ * shmget, get a shared memory segment
+ * \param key segment key
+ * \param size segment size
+ * \param shmflg flags
+ * \return the segment id on success, -1 on failure
+ */
+.section .text.shmget
+.global shmget
+.type shmget, %function
+shmget:
+	movs r3, #65
+	svc  0
+	cmp  r0, #0
+	blt  syscallfailed32
+	bx   lr
+
+/**
+ * shmat, attach a shared memory segment
+ * \param shmid segment id
+ * \param shmaddr must be nullptr
+ * \param shmflg flags
+ * \return the segment address on success, (void*)-1 on failure
+ */
+.section .text.shmat
+.global shmat
+.type shmat, %function
+shmat:
+	movs r3, #66
+	svc  0
+	cmp  r0, #0
+	blt  syscallfailed32
+	movs r0, r1         @ Address is returned in r1, as it may look negative
+	bx   lr
+
+/**
+ * shmdt, detach a shared memory segment
+ * \param shmaddr segment address
+ * \return 0 on success, -1 on failure
+ */
+.section .text.shmdt
+.global shmdt
+.type shmdt, %function
+shmdt:
+	movs r3, #67
+	svc  0
+	cmp  r0, #0
+	blt  syscallfailed32
+	bx   lr
+
+/**
+ * shmctl, shared memory control operations
+ * \param shmid segment id
+ * \param cmd command, only IPC_RMID is supported
+ * \param buf ignored
+ * \return 0 on success, -1 on failure
+ */
+.section .text.shmctl
+.global shmctl
+.type shmctl, %function
+shmctl:
+	movs r3, #68
+	svc  0
+	cmp  r0, #0
+	blt  syscallfailed32
+	bx   lr
+
+/**
+ * __mmap, nonstandard syscall, map a file stored in memory
+ * \param fd file descriptor, passed in r0
+ * \param off offset into the file, passed in r1 as a 32 bit value
+ * \param len mapping length, passed in r2
+ * \return a 64 bit value, the low word (r0) is 0 on success or a negative
+ * error code, the high word (r1) is the mapping address
+ */
+.section .text.__mmap
+.global __mmap
+.type __mmap, %function
+__mmap:
+	movs r3, #69
+	svc  0
+	bx   lr
+
+/**
+ * __munmap, nonstandard syscall, unmap a file mapped by __mmap
+ * \param addr mapping address
+ * \return 0 on success, or a negative error code
+ */
+.section .text.__munmap
+.global __munmap
+.type __munmap, %function
+__munmap:
+	movs r3, #70
+	svc  0
+	bx   lr
+
 /* common jump target for all failing syscalls with 32 bit return value */
 .section .text.__seterrno32
 syscallfailed32:
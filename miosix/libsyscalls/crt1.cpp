@@ -28,6 +28,7 @@
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <climits>
 #include <errno.h>
 #include <unistd.h>
 #include <pthread.h>
@@ -37,8 +38,10 @@
 #include <sys/fcntl.h>
 #include <sys/ioctl.h>
 #include <sys/wait.h>
+#include <sys/mman.h>
 #include <reent.h>
 #include <cxxabi.h>
+#include <miosix_limits.h>
 
 constexpr int numAtexitEntries=2; ///< Number of entries per AtexitBlock
 
@@ -57,12 +60,69 @@ static AtexitBlock *head = nullptr; ///< Head of the AtexitBlock list
 /// Mutex to protect the heap
 static pthread_mutex_t mallocMutex=PTHREAD_MUTEX_RECURSIVE_INITIALIZER_NP;
 
-/// TODO: to avoid mutex contention we'll need to extend the pthread_mutex_t
-/// struct with a per-mutex flag
-static int globalFlag=0;
+/// Maximum number of threads per process, shared with the kernel
+constexpr int maxThreads=MIOSIX_MAX_THREADS_PER_PROCESS;
+
+/// Stack size of threads created without specifying it in pthread_attr_t
+constexpr unsigned int defaultStackSize=2048;
+
+/**
+ * Per-thread data of threads created with pthread_create. The thread stack is
+ * allocated in the same heap block, right after this struct
+ */
+struct ThreadControlBlock
+{
+    char *stackBottom;         ///< Lowest address of the thread stack
+    char *stackTop;            ///< One past the highest stack address
+    int tid;                   ///< Thread id used by the kernel
+    void *(*start)(void *);    ///< Thread entry point
+    void *arg;                 ///< Entry point argument
+    struct _reent reent;       ///< Per-thread C library reentrancy data
+    unsigned int ehGlobals[4]; ///< Per-thread C++ exception handling data
+};
+
+/// Threads of the process, the pthread_t of a thread is its index. Index 0 is
+/// the main thread, that does not need a ThreadControlBlock. Entries are only
+/// modified with threadTableMutex locked, but read locklessly
+static ThreadControlBlock * volatile threadTable[maxThreads]={nullptr};
+
+/// Mutex to protect the allocation of threadTable entries
+static pthread_mutex_t threadTableMutex=PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * \internal
+ * Threads are identified by their stack pointer, as the stack of each thread
+ * is a distinct memory area. This requires no syscall
+ * \return the threadTable index of the calling thread
+ */
+static int currentThreadIndex()
+{
+    char *sp;
+    asm volatile("mov %0, sp" : "=r"(sp));
+    for(int i=1;i<maxThreads;i++)
+    {
+        ThreadControlBlock *tcb=threadTable[i];
+        if(tcb && sp>=tcb->stackBottom && sp<tcb->stackTop) return i;
+    }
+    return 0; //Not a thread created with pthread_create, so the main thread
+}
 
 extern "C" {
 
+//Thread syscalls, defined in crt0.s. Return negative error codes on failure
+int __thread_create(void (*entry)(ThreadControlBlock*), ThreadControlBlock *arg,
+                    void *stack, unsigned int size);
+int __thread_join(int tid, void **result);
+int __thread_exit(void *result);
+int __futex_wait(volatile int *addr, int expected);
+int __futex_wake(volatile int *addr, int count);
+
+//Memory mapped file syscalls, defined in crt0.s
+//The offset is 32 bit, as a 64 bit off_t would be passed in r2:r3 and the
+//stack, not in the registers where the kernel expects the parameters
+unsigned long long __mmap(int fd, unsigned int off, size_t len);
+int __munmap(void *addr);
+
 /**
  * \internal
  * This function is called from crt0.s when syscalls returning a 32 bit int fail.
@@ -248,8 +308,9 @@ void __malloc_unlock()
  */
 struct _reent *__getreent()
 {
-    // For now processes can't have threads, so always return the global one
-    return _GLOBAL_REENT;
+    int index=currentThreadIndex();
+    if(index==0) return _GLOBAL_REENT;
+    return &threadTable[index]->reent;
 }
 
 
@@ -432,6 +493,105 @@ pid_t wait(int *status)
     return waitpid(-1,status,0);
 }
 
+/**
+ * Header of the heap copies that mmap() makes of files that the kernel can't
+ * map, so that munmap() knows which mappings to free
+ */
+struct alignas(8) MmapCopy
+{
+    MmapCopy *next; ///< Next copy in the list
+};
+
+static MmapCopy *mmapCopies=nullptr; ///< Heap copies made by mmap()
+static pthread_mutex_t mmapMutex=PTHREAD_MUTEX_INITIALIZER; ///< Guards mmapCopies
+
+void *mmap(void *addr, size_t len, int prot, int flags, int fd, off_t off)
+{
+    int mapType=flags & (MAP_SHARED | MAP_PRIVATE);
+    if(addr!=nullptr || len==0 || off<0 || (flags & MAP_FIXED)
+        || (mapType!=MAP_SHARED && mapType!=MAP_PRIVATE))
+    {
+        errno=EINVAL;
+        return MAP_FAILED;
+    }
+    if(prot!=PROT_READ)
+    {
+        errno=ENOTSUP;
+        return MAP_FAILED;
+    }
+    //Files stored in memory are smaller than 4GB, larger offsets can only be
+    //valid for other files, that are handled by the heap copy fallback
+    int result=-ENODEV;
+    if(off<=static_cast<off_t>(UINT_MAX))
+    {
+        //Result in r0, address in r1, as it may look negative
+        unsigned long long r=__mmap(fd,static_cast<unsigned int>(off),len);
+        result=static_cast<int>(r);
+        if(result==0)
+            return reinterpret_cast<void*>(static_cast<unsigned int>(r>>32));
+    }
+    //The file is not stored in memory, or the process already uses the only
+    //memory protection region for mapped files, fall back to a heap copy
+    if(result!=-ENODEV && result!=-ENOMEM)
+    {
+        errno=-result;
+        return MAP_FAILED;
+    }
+    struct stat st;
+    if(fstat(fd,&st)) return MAP_FAILED;
+    if(off>=st.st_size || static_cast<off_t>(len)>st.st_size-off)
+    {
+        errno=ENXIO;
+        return MAP_FAILED;
+    }
+    auto copy=reinterpret_cast<MmapCopy*>(malloc(sizeof(MmapCopy)+len));
+    if(copy==nullptr)
+    {
+        errno=ENOMEM;
+        return MAP_FAILED;
+    }
+    char *data=reinterpret_cast<char*>(copy+1);
+    for(size_t done=0;done<len;)
+    {
+        ssize_t readBytes=pread(fd,data+done,len-done,off+done);
+        if(readBytes<=0)
+        {
+            free(copy);
+            if(readBytes==0) errno=ENXIO;
+            return MAP_FAILED;
+        }
+        done+=readBytes;
+    }
+    pthread_mutex_lock(&mmapMutex);
+    copy->next=mmapCopies;
+    mmapCopies=copy;
+    pthread_mutex_unlock(&mmapMutex);
+    return data;
+}
+
+int munmap(void *addr, size_t len)
+{
+    MmapCopy *copy=nullptr;
+    pthread_mutex_lock(&mmapMutex);
+    for(MmapCopy **it=&mmapCopies;*it;it=&(*it)->next)
+    {
+        if(reinterpret_cast<char*>(*it+1)!=addr) continue;
+        copy=*it;
+        *it=copy->next;
+        break;
+    }
+    pthread_mutex_unlock(&mmapMutex);
+    if(copy)
+    {
+        free(copy);
+        return 0;
+    }
+    int result=__munmap(addr);
+    if(result==0) return 0;
+    errno=-result;
+    return -1;
+}
+
 static int __LDREXW(volatile int *addr)
 {
     int result;
@@ -461,59 +621,46 @@ static int atomicCompareAndSwap(volatile int *p, int prev, int next)
     return result;
 }
 
-static void enterCriticalSection(pthread_mutex_t *m)
-{
-    //TODO: when we add the flag in the mutex stop using the global flag
-    while(atomicCompareAndSwap(&globalFlag,0,1)!=0) pthread_yield();
-}
-
-static void leaveCriticalSection(pthread_mutex_t *m)
+static int atomicSwap(volatile int *p, int v)
 {
-    //TODO: when we add the flag in the mutex stop using the global flag
-    globalFlag=0;
+    int result;
+    do {
+        result=__LDREXW(p);
+    } while(__STREXW(v,p));
     asm volatile("":::"memory");
+    return result;
 }
 
-class CriticalSectionUnlock; //Forward decl
-
-class CriticalSectionLock
-{
-public:
-    CriticalSectionLock(pthread_mutex_t *mutex) : m(mutex) { enterCriticalSection(m); }
-    ~CriticalSectionLock() { leaveCriticalSection(m); }
-private:
-    friend class CriticalSectionUnlock;
-    pthread_mutex_t *m;
-};
+/*
+ * Mutexes are implemented on top of the futex syscalls, using the owner field
+ * of pthread_mutex_t as the futex word, which can be
+ * - 0 if the mutex is unlocked
+ * - the ownerId() of the thread that locked it
+ * - the ownerId() with contendedBit set if other threads may be waiting
+ * so that locking and unlocking a mutex without contention needs no syscall.
+ * The first, last fields of pthread_mutex_t are unused.
+ */
 
-class CriticalSectionUnlock
-{
-public:
-    CriticalSectionUnlock(CriticalSectionLock l) :m(l.m) { leaveCriticalSection(m); }
-    ~CriticalSectionUnlock() { enterCriticalSection(m); }
-private:
-    pthread_mutex_t *m;
-};
+constexpr int contendedBit=1;
 
-void *getCurrentThread()
+/**
+ * \return a nonzero value with contendedBit clear identifying the current thread
+ */
+static int ownerId()
 {
-    return reinterpret_cast<void*>(1); //TODO: stub we need a syscall for that
+    return (currentThreadIndex()+1)<<1;
 }
 
 int pthread_mutex_lock(pthread_mutex_t *mutex)
 {
-    CriticalSectionLock lock(mutex);
-    void *p=getCurrentThread();
-    if(mutex->owner==nullptr)
-    {
-        mutex->owner=p;
-        return 0;
-    }
+    volatile int *futex=reinterpret_cast<volatile int*>(&mutex->owner);
+    int self=ownerId();
+    int prev=atomicCompareAndSwap(futex,0,self);
+    if(prev==0) return 0;
 
     //This check is very important. Without this attempting to lock the same
-    //mutex twice won't cause a deadlock because the wait is enclosed in a
-    //while(owner!=p) which is immeditely false.
-    if(mutex->owner==p)
+    //mutex twice won't cause a deadlock as the mutex is already ours
+    if((prev & ~contendedBit)==self)
     {
         if(mutex->recursive>=0)
         {
@@ -522,62 +669,215 @@ int pthread_mutex_lock(pthread_mutex_t *mutex)
         } else exit(1); //Bad, deadlock
     }
 
-    WaitingList waiting; //Element of a linked list on stack
-    waiting.thread=p;
-    waiting.next=nullptr; //Putting this thread last on the list (lifo policy)
-    if(mutex->first==nullptr)
+    //A thread that had to wait acquires the mutex with contendedBit set, as
+    //it can't know whether other threads are still waiting
+    for(;;)
     {
-        mutex->first=&waiting;
-        mutex->last=&waiting;
-    } else {
-        mutex->last->next=&waiting;
-        mutex->last=&waiting;
+        prev=atomicCompareAndSwap(futex,0,self | contendedBit);
+        if(prev==0) return 0;
+        if((prev & contendedBit)==0)
+        {
+            //If the owner changed in the meantime retry
+            if(atomicCompareAndSwap(futex,prev,prev | contendedBit)!=prev)
+                continue;
+        }
+        //Returns immediately if the mutex was unlocked in the meantime
+        __futex_wait(futex,prev | contendedBit);
     }
+}
 
-    //The while is necessary to protect against spurious wakeups
-    while(mutex->owner!=p)
+int pthread_mutex_trylock(pthread_mutex_t *mutex)
+{
+    volatile int *futex=reinterpret_cast<volatile int*>(&mutex->owner);
+    int self=ownerId();
+    int prev=atomicCompareAndSwap(futex,0,self);
+    if(prev==0) return 0;
+    if((prev & ~contendedBit)==self && mutex->recursive>=0)
     {
-        CriticalSectionUnlock unlock(lock);
-        //TODO: to improve performance we need
-        //1) a syscall to ask the OS to block the thread
-        //2) a way to atomically exit the critical section and block, otherwise
-        //   we have a race condition if the wakeup occurs in between
-        pthread_yield();
+        mutex->recursive++;
+        return 0;
     }
-    return 0;
+    return EBUSY;
 }
+
 int pthread_mutex_unlock(pthread_mutex_t *mutex)
 {
-    CriticalSectionLock lock(mutex);
     if(mutex->recursive>0)
     {
         mutex->recursive--;
         return 0;
     }
-    if(mutex->first!=nullptr)
+    volatile int *futex=reinterpret_cast<volatile int*>(&mutex->owner);
+    asm volatile("":::"memory");
+    if(atomicSwap(futex,0) & contendedBit) __futex_wake(futex,1);
+    return 0;
+}
+
+/**
+ * \internal
+ * Entry point of threads created with pthread_create
+ */
+static void threadLauncher(ThreadControlBlock *tcb)
+{
+    pthread_exit(tcb->start(tcb->arg));
+}
+
+int pthread_create(pthread_t *pthread, const pthread_attr_t *attr,
+                   void *(*start)(void *), void *arg)
+{
+    unsigned int stackSize=defaultStackSize;
+    if(attr)
     {
-        //TODO: once the code to block a thread in pthread_mutex_lock is added
-        //here we need to call the syscall to wake it up
-        mutex->owner=mutex->first->thread;
-        mutex->first=mutex->first->next;
-        return 0;
+        //Detached threads are unsupported, as the stack is freed on join
+        if(attr->detachstate==PTHREAD_CREATE_DETACHED) return EINVAL;
+        stackSize=attr->stacksize;
+    }
+    //The stack must be 8 byte aligned at both ends, and malloc returns 8 byte
+    //aligned blocks
+    stackSize=(stackSize+7) & ~7;
+    unsigned int tcbSize=(sizeof(ThreadControlBlock)+7) & ~7;
+    char *block=reinterpret_cast<char*>(malloc(tcbSize+stackSize));
+    if(block==nullptr) return EAGAIN;
+    auto tcb=reinterpret_cast<ThreadControlBlock*>(block);
+    tcb->stackBottom=block+tcbSize;
+    tcb->stackTop=tcb->stackBottom+stackSize;
+    tcb->start=start;
+    tcb->arg=arg;
+    _REENT_INIT_PTR(&tcb->reent);
+    memset(tcb->ehGlobals,0,sizeof(tcb->ehGlobals));
+
+    //The entry must be in threadTable before the thread starts, as the thread
+    //uses it to find its own reentrancy data
+    pthread_mutex_lock(&threadTableMutex);
+    int index=1;
+    while(index<maxThreads && threadTable[index]!=nullptr) index++;
+    if(index<maxThreads) threadTable[index]=tcb;
+    pthread_mutex_unlock(&threadTableMutex);
+    if(index>=maxThreads)
+    {
+        free(block);
+        return EAGAIN;
+    }
+    int tid=__thread_create(threadLauncher,tcb,tcb->stackBottom,stackSize);
+    if(tid<0)
+    {
+        threadTable[index]=nullptr;
+        free(block);
+        return -tid;
     }
-    mutex->owner=nullptr;
+    tcb->tid=tid;
+    *pthread=index;
+    return 0;
+}
+
+int pthread_join(pthread_t pthread, void **value)
+{
+    if(pthread==0 || pthread>=maxThreads) return ESRCH;
+    ThreadControlBlock *tcb=threadTable[pthread];
+    if(tcb==nullptr) return ESRCH;
+    int result=__thread_join(tcb->tid,value);
+    if(result<0) return -result;
+    //The thread has exited, its stack and data can be freed, including the
+    //buffers the C library may have allocated in its reentrancy structure
+    threadTable[pthread]=nullptr;
+    _reclaim_reent(&tcb->reent);
+    free(tcb);
+    return 0;
+}
+
+void pthread_exit(void *value)
+{
+    __thread_exit(value);
+    //Only the main thread gets here, after all other threads have exited
+    exit(0);
+}
+
+pthread_t pthread_self()
+{
+    return currentThreadIndex();
+}
+
+int pthread_equal(pthread_t t1, pthread_t t2)
+{
+    return t1==t2;
+}
+
+int pthread_attr_init(pthread_attr_t *attr)
+{
+    memset(attr,0,sizeof(pthread_attr_t));
+    attr->is_initialized=1;
+    attr->stacksize=defaultStackSize;
+    attr->detachstate=PTHREAD_CREATE_JOINABLE;
+    return 0;
+}
+
+int pthread_attr_destroy(pthread_attr_t *attr) { return 0; }
+
+int pthread_attr_getstacksize(const pthread_attr_t *attr, size_t *stacksize)
+{
+    *stacksize=attr->stacksize;
+    return 0;
+}
+
+int pthread_attr_setstacksize(pthread_attr_t *attr, size_t stacksize)
+{
+    attr->stacksize=stacksize;
+    return 0;
+}
+
+int pthread_attr_getdetachstate(const pthread_attr_t *attr, int *detachstate)
+{
+    *detachstate=attr->detachstate;
+    return 0;
+}
+
+int pthread_attr_setdetachstate(pthread_attr_t *attr, int detachstate)
+{
+    //Detached threads are unsupported
+    if(detachstate!=PTHREAD_CREATE_JOINABLE) return EINVAL;
+    attr->detachstate=detachstate;
     return 0;
 }
 
 int pthread_mutex_destroy(pthread_mutex_t *mutex) { return 0; }
 int pthread_setcancelstate(int state, int *oldstate) { return 0; }
 
+/*
+ * The init_executed field of pthread_once_t is used as a futex word, which can
+ * be
+ * - 0 if func was not called, or it has thrown
+ * - 1 while a thread is calling func
+ * - 3 while a thread is calling func, and other threads may be waiting
+ * - 2 after func returned
+ */
+
 int pthread_once(pthread_once_t *once, void (*func)())
 {
-    //TODO: make thread-safe when processes can spawn threads
     if(once==nullptr || func==nullptr || once->is_initialized!=1) return EINVAL;
-    if(once->init_executed==0)
+
+    volatile int *futex=reinterpret_cast<volatile int*>(&once->init_executed);
+    for(;;)
     {
+        int prev=atomicCompareAndSwap(futex,0,1);
+        if(prev==0) break; //We're the first ones (or previous call has thrown)
+        if(prev==2) return 0; //Already called, return immediately
+        //Call started but not ended, wait for the calling thread to wake us
+        if(prev==1 && atomicCompareAndSwap(futex,1,3)!=1) continue;
+        __futex_wait(futex,3);
+    }
+
+    #ifdef __NO_EXCEPTIONS
+    func();
+    #else //__NO_EXCEPTIONS
+    try {
         func();
-        once->init_executed=2; //We succeeded
+    } catch(...) {
+        //We failed, let some other thread try
+        if(atomicSwap(futex,0)==3) __futex_wake(futex,INT_MAX);
+        throw;
     }
+    #endif //__NO_EXCEPTIONS
+    if(atomicSwap(futex,2)==3) __futex_wake(futex,INT_MAX); //We succeeded
     return 0;
 }
 
@@ -611,36 +911,68 @@ struct __cxa_eh_globals
 
 static __cxa_eh_globals eh = { 0 };
 
+static_assert(sizeof(__cxa_eh_globals)<=sizeof(ThreadControlBlock::ehGlobals),
+              "ehGlobals too small");
+
 extern "C" __cxa_eh_globals* __cxa_get_globals_fast()
 {
-    return &eh; //TODO: one per-thread when processes can spawn threads
+    int index=currentThreadIndex();
+    if(index==0) return &eh;
+    return reinterpret_cast<__cxa_eh_globals*>(threadTable[index]->ehGlobals);
 }
 
 extern "C" __cxa_eh_globals* __cxa_get_globals()
 {
-    return &eh; //TODO: one per-thread when processes can spawn threads
+    return __cxa_get_globals_fast();
 }
 
+/*
+ * Static objects are initialized holding guardMutex, taken in
+ * __cxa_guard_acquire() and released in __cxa_guard_release() or
+ * __cxa_guard_abort(). It is recursive as the constructor of a static object
+ * may initialize other static objects. The guard flag is
+ * - 0 if the object is not initialized
+ * - 2 while the thread holding guardMutex initializes it
+ * - 1 once it is initialized
+ */
+static pthread_mutex_t guardMutex=PTHREAD_MUTEX_RECURSIVE_INITIALIZER_NP;
+
 extern "C" int __cxa_guard_acquire(__guard *g)
 {
-    //TODO: make thread-safe when processes can spawn threads
     volatile MiosixGuard *guard=reinterpret_cast<volatile MiosixGuard*>(g);
     if(guard->flag==1) return 0; //Object already initialized, good
+
+    pthread_mutex_lock(&guardMutex);
+    //Another thread may have initialized the object while we were waiting
+    if(guard->flag==1)
+    {
+        pthread_mutex_unlock(&guardMutex);
+        return 0;
+    }
+    //Only the thread holding guardMutex can find the object being initialized,
+    //so we have a recursive initialization error. Not throwing an exception to
+    //avoid pulling in exceptions even with -fno-exception
+    if(guard->flag==2)
+    {
+        write(STDERR_FILENO,"Recursive initialization\n",25);
+        _exit(1);
+    }
+    guard->flag=2;
     return 1;
 }
 
 extern "C" void __cxa_guard_release(__guard *g) noexcept
 {
-    //TODO: make thread-safe when processes can spawn threads
     volatile MiosixGuard *guard=reinterpret_cast<volatile MiosixGuard*>(g);
     guard->flag=1;
+    pthread_mutex_unlock(&guardMutex);
 }
 
 extern "C" void __cxa_guard_abort(__guard *g) noexcept
 {
-    //TODO: make thread-safe when processes can spawn threads
     volatile MiosixGuard *guard=reinterpret_cast<volatile MiosixGuard*>(g);
     guard->flag=0;
+    pthread_mutex_unlock(&guardMutex);
 }
 
 } //namespace __cxxabiv1
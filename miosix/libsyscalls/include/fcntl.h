@@ -0,0 +1,48 @@
+/***************************************************************************
+ *   Copyright (C) 2024 by Terraneo Federico                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+/*
+ * Adds to the newlib <fcntl.h> the Linux specific fcntl() commands supported
+ * by Miosix. Processes are compiled with -I libsyscalls/include, so this header
+ * is found before the newlib one, while the kernel includes it explicitly as
+ * "libsyscalls/include/fcntl.h". In both cases #include_next pulls in the
+ * newlib header.
+ */
+
+#include_next <fcntl.h>
+
+#ifndef _MIOSIX_FCNTL_H_
+#define _MIOSIX_FCNTL_H_
+
+#ifndef F_SETPIPE_SZ
+/// Set the capacity of a pipe, returns the new capacity
+#define F_SETPIPE_SZ 1031
+/// Get the capacity of a pipe
+#define F_GETPIPE_SZ 1032
+#endif //F_SETPIPE_SZ
+
+#endif //_MIOSIX_FCNTL_H_
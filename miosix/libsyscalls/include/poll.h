@@ -0,0 +1,70 @@
+/***************************************************************************
+ *   Copyright (C) 2024 by Terraneo Federico                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+/*
+ * The newlib shipped with the Miosix compiler does not provide <poll.h>,
+ * this header adds it. Both the kernel and process Makefiles add
+ * libsyscalls/include to the include path.
+ */
+
+#ifndef _POLL_H_
+#define _POLL_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define POLLIN     0x0001 ///< Data other than high priority data can be read
+#define POLLPRI    0x0002 ///< High priority data can be read
+#define POLLOUT    0x0004 ///< Data can be written
+#define POLLERR    0x0008 ///< An error occurred, output only
+#define POLLHUP    0x0010 ///< The other end has been closed, output only
+#define POLLNVAL   0x0020 ///< Invalid file descriptor, output only
+#define POLLRDNORM 0x0040 ///< Normal data can be read
+#define POLLRDBAND 0x0080 ///< Priority data can be read
+#define POLLWRNORM 0x0100 ///< Normal data can be written
+#define POLLWRBAND 0x0200 ///< Priority data can be written
+
+/**
+ * File descriptor to poll, and events to wait for
+ */
+struct pollfd
+{
+    int fd;        ///< File descriptor, negative values are ignored
+    short events;  ///< Requested events
+    short revents; ///< Returned events
+};
+
+typedef unsigned int nfds_t;
+
+int poll(struct pollfd *fds, nfds_t nfds, int timeout);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //_POLL_H_
@@ -0,0 +1,51 @@
+/***************************************************************************
+ *   Copyright (C) 2024 by Terraneo Federico                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+/*
+ * The newlib shipped with the Miosix compiler does not provide <sys/ipc.h>,
+ * this header adds the subset needed for System V shared memory. Processes
+ * are compiled with -I libsyscalls/include and include it as <sys/ipc.h>,
+ * while the kernel includes it explicitly as "libsyscalls/include/sys/ipc.h".
+ */
+
+#ifndef _SYS_IPC_H_
+#define _SYS_IPC_H_
+
+#include <sys/types.h>
+
+//Recent newlib versions already define key_t in <sys/types.h>
+#if !defined(_KEY_T_DECLARED) && !defined(__key_t_defined)
+typedef long key_t;
+#define _KEY_T_DECLARED
+#endif
+
+#define IPC_PRIVATE ((key_t)0) ///< Key that always creates a new object
+#define IPC_CREAT   01000      ///< Create the object if it does not exist
+#define IPC_EXCL    02000      ///< Fail if the object already exists
+#define IPC_RMID    0          ///< Remove the object
+
+#endif //_SYS_IPC_H_
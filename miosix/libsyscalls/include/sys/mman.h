@@ -0,0 +1,86 @@
+/***************************************************************************
+ *   Copyright (C) 2024 by Terraneo Federico                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+/*
+ * The newlib shipped with the Miosix compiler does not provide <sys/mman.h>,
+ * this header adds read-only memory mapped files. Processes are compiled with
+ * -I libsyscalls/include and include it as <sys/mman.h>, while the kernel
+ * includes it explicitly as "libsyscalls/include/sys/mman.h".
+ *
+ * Miosix has no virtual memory, so files can be mapped without copying them
+ * only if the filesystem stores them contiguously in memory, as RomFs does.
+ * In this case mmap() returns a pointer to the file content. Processes access
+ * it through a memory protection unit region, so a process can have only one
+ * such mapping at a time. For other files, or if the region is already in use,
+ * mmap() allocates a private copy of the file content in the heap.
+ */
+
+#ifndef _SYS_MMAN_H_
+#define _SYS_MMAN_H_
+
+#include <sys/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PROT_NONE  0x0 ///< Not supported
+#define PROT_READ  0x1 ///< Pages can be read
+#define PROT_WRITE 0x2 ///< Not supported, mappings are read-only
+#define PROT_EXEC  0x4 ///< Not supported
+
+#define MAP_SHARED  0x01 ///< Share the mapping, the same as MAP_PRIVATE
+#define MAP_PRIVATE 0x02 ///< Private mapping
+#define MAP_FIXED   0x10 ///< Not supported
+
+#define MAP_FAILED ((void*)-1) ///< Returned by mmap() on failure
+
+/**
+ * Map a file in memory
+ * \param addr must be nullptr, as the address of a mapping can't be chosen
+ * \param len length of the mapping in bytes, must not exceed the file size
+ * \param prot must be PROT_READ
+ * \param flags either MAP_SHARED or MAP_PRIVATE
+ * \param fd file descriptor of the file to map
+ * \param off offset into the file where the mapping starts
+ * \return the address of the mapping, or MAP_FAILED on failure
+ */
+void *mmap(void *addr, size_t len, int prot, int flags, int fd, off_t off);
+
+/**
+ * Unmap a file
+ * \param addr address returned by mmap()
+ * \param len length of the mapping, ignored
+ * \return 0 on success, -1 on failure
+ */
+int munmap(void *addr, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //_SYS_MMAN_H_
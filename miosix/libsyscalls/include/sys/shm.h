@@ -0,0 +1,94 @@
+/***************************************************************************
+ *   Copyright (C) 2024 by Terraneo Federico                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+/*
+ * The newlib shipped with the Miosix compiler does not provide <sys/shm.h>,
+ * this header adds System V shared memory. Processes are compiled with
+ * -I libsyscalls/include and include it as <sys/shm.h>, while the kernel
+ * includes it explicitly as "libsyscalls/include/sys/shm.h".
+ *
+ * Miosix processes have no virtual memory, so a shared memory segment is
+ * attached at the same address in all processes, and pointers into it can
+ * be exchanged between processes. Each segment uses a memory protection unit
+ * region, so a process can have only one segment attached at a time.
+ */
+
+#ifndef _SYS_SHM_H_
+#define _SYS_SHM_H_
+
+#include "ipc.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SHM_RDONLY 010000 ///< Attach the segment read-only
+
+struct shmid_ds; //Not supported, shmctl only supports IPC_RMID
+
+/**
+ * Get a shared memory segment, creating it if needed. The memory of a newly
+ * created segment is zeroed.
+ * \param key key identifying the segment, or IPC_PRIVATE
+ * \param size segment size in bytes
+ * \param shmflg IPC_CREAT, IPC_EXCL, permission bits are ignored
+ * \return the segment id, or -1 on failure
+ */
+int shmget(key_t key, size_t size, int shmflg);
+
+/**
+ * Attach a shared memory segment to the calling process
+ * \param shmid segment id
+ * \param shmaddr must be nullptr, as the address of a segment can't be chosen
+ * \param shmflg 0 or SHM_RDONLY
+ * \return the segment address, or (void*)-1 on failure
+ */
+void *shmat(int shmid, const void *shmaddr, int shmflg);
+
+/**
+ * Detach a shared memory segment from the calling process
+ * \param shmaddr address returned by shmat
+ * \return 0 on success, -1 on failure. Fails with EBUSY if other threads of
+ * the process are blocked in a syscall, as they may be using the segment
+ */
+int shmdt(const void *shmaddr);
+
+/**
+ * Shared memory control operations
+ * \param shmid segment id
+ * \param cmd only IPC_RMID is supported, which marks the segment to be freed
+ * once detached by all processes
+ * \param buf ignored
+ * \return 0 on success, -1 on failure
+ */
+int shmctl(int shmid, int cmd, struct shmid_ds *buf);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //_SYS_SHM_H_
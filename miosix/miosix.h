@@ -40,6 +40,7 @@
 #include <kernel/sync.h>
 #include <kernel/queue.h>
 #include <kernel/cpu_time_counter.h>
+#include <kernel/timer.h>
 /* Utilities */
 #include <util/util.h>
 /* Settings */
@@ -30,6 +30,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdarg.h>
+#include <malloc.h>
 #include <unistd.h>
 #include <dirent.h>
 #include <reent.h>
@@ -37,6 +38,9 @@
 #include <sys/stat.h>
 #include <sys/fcntl.h>
 #include <sys/times.h>
+#include "libsyscalls/include/sys/uio.h"
+#include "libsyscalls/include/sys/mman.h"
+#include "libsyscalls/include/poll.h"
 //// Settings
 #include "config/miosix_settings.h"
 //// Filesystem
@@ -46,6 +50,7 @@
 //// kernel interface
 #include "kernel/kernel.h"
 #include "kernel/process.h"
+#include "kernel/tlsf_heap.h"
 #include "interfaces/bsp.h"
 #include "interfaces/os_timer.h"
 
@@ -160,6 +165,11 @@ void _exit(int n)
  */
 void *_sbrk_r(struct _reent *ptr, ptrdiff_t incr)
 {
+    #ifdef WITH_TLSF_HEAP
+    //The heap memory is managed by TlsfHeap
+    ptr->_errno=ENOMEM;
+    return reinterpret_cast<void*>(-1);
+    #else //WITH_TLSF_HEAP
     //This is the absolute start of the heap
     extern char _end asm("_end"); //defined in the linker script
     //This is the absolute end of the heap
@@ -192,6 +202,7 @@ void *_sbrk_r(struct _reent *ptr, ptrdiff_t incr)
         miosix::maxHeapEnd=reinterpret_cast<unsigned int>(curHeapEnd);
     
     return reinterpret_cast<void*>(prevHeapEnd);
+    #endif //WITH_TLSF_HEAP
 }
 
 void *sbrk(ptrdiff_t incr)
@@ -199,6 +210,90 @@ void *sbrk(ptrdiff_t incr)
     return _sbrk_r(miosix::getReent(),incr);
 }
 
+#ifdef WITH_TLSF_HEAP
+
+/*
+ * When the TLSF heap is enabled newlib's malloc is replaced by the following
+ * functions, and the heap memory is managed by miosix::TlsfHeap instead of
+ * being requested through _sbrk_r
+ */
+
+/**
+ * \internal
+ * Handle a failed allocation
+ */
+static void *allocationFailed(struct _reent *ptr)
+{
+    #ifdef __NO_EXCEPTIONS
+    //Same as _sbrk_r, reboot as operator new can't return nullptr
+    errorLog("\n***Heap overflow\n");
+    _exit(1);
+    #else //__NO_EXCEPTIONS
+    ptr->_errno=ENOMEM;
+    return nullptr;
+    #endif //__NO_EXCEPTIONS
+}
+
+void *_malloc_r(struct _reent *ptr, size_t size)
+{
+    void *result=miosix::heapAllocate(size);
+    if(result==nullptr) return allocationFailed(ptr);
+    return result;
+}
+
+void *_calloc_r(struct _reent *ptr, size_t nmemb, size_t size)
+{
+    size_t total;
+    if(__builtin_mul_overflow(nmemb,size,&total))
+        return allocationFailed(ptr);
+    void *result=miosix::heapAllocate(total);
+    if(result==nullptr) return allocationFailed(ptr);
+    memset(result,0,total);
+    return result;
+}
+
+void *_realloc_r(struct _reent *ptr, void *p, size_t size)
+{
+    void *result=miosix::heapReallocate(p,size);
+    if(result==nullptr && size!=0) return allocationFailed(ptr);
+    return result;
+}
+
+void *_memalign_r(struct _reent *ptr, size_t align, size_t size)
+{
+    void *result=miosix::heapAllocateAligned(align,size);
+    if(result==nullptr) return allocationFailed(ptr);
+    return result;
+}
+
+void _free_r(struct _reent *ptr, void *p)
+{
+    miosix::heapDeallocate(p);
+}
+
+size_t _malloc_usable_size_r(struct _reent *ptr, void *p)
+{
+    return p ? miosix::TlsfHeap::usableSize(p) : 0;
+}
+
+struct mallinfo _mallinfo_r(struct _reent *ptr)
+{
+    struct mallinfo result;
+    memset(&result,0,sizeof(result));
+    miosix::PauseKernelLock dLock;
+    for(auto h=&miosix::TlsfHeap::instance();h;h=h->nextHeap())
+    {
+        miosix::HeapStats stats=h->getStats();
+        result.arena+=stats.size;
+        result.usmblks+=stats.maxUsed;
+        result.uordblks+=stats.used;
+        result.fordblks+=stats.size-stats.used;
+    }
+    return result;
+}
+
+#endif //WITH_TLSF_HEAP
+
 /**
  * \internal
  * __malloc_lock, called by malloc to ensure no context switch happens during
@@ -427,6 +522,173 @@ off_t lseek(int fd, off_t pos, int whence)
     return _lseek_r(miosix::getReent(),fd,pos,whence);
 }
 
+/**
+ * \internal
+ * _pwrite_r, write data at a given position without changing the file pointer
+ */
+ssize_t _pwrite_r(struct _reent *ptr, int fd, const void *buf, size_t size, off_t pos)
+{
+    #ifdef WITH_FILESYSTEM
+
+    #ifndef __NO_EXCEPTIONS
+    try {
+    #endif //__NO_EXCEPTIONS
+        ssize_t result=miosix::getFileDescriptorTable().pwrite(fd,buf,size,pos);
+        if(result>=0) return result;
+        ptr->_errno=-result;
+        return -1;
+    #ifndef __NO_EXCEPTIONS
+    } catch(exception& e) {
+        ptr->_errno=ENOMEM;
+        return -1;
+    }
+    #endif //__NO_EXCEPTIONS
+    
+    #else //WITH_FILESYSTEM
+    ptr->_errno=EBADF;
+    return -1;
+    #endif //WITH_FILESYSTEM
+}
+
+ssize_t pwrite(int fd, const void *buf, size_t size, off_t pos)
+{
+    return _pwrite_r(miosix::getReent(),fd,buf,size,pos);
+}
+
+/**
+ * \internal
+ * _pread_r, read data from a given position without changing the file pointer
+ */
+ssize_t _pread_r(struct _reent *ptr, int fd, void *buf, size_t size, off_t pos)
+{
+    #ifdef WITH_FILESYSTEM
+
+    #ifndef __NO_EXCEPTIONS
+    try {
+    #endif //__NO_EXCEPTIONS
+        ssize_t result=miosix::getFileDescriptorTable().pread(fd,buf,size,pos);
+        if(result>=0) return result;
+        ptr->_errno=-result;
+        return -1;
+    #ifndef __NO_EXCEPTIONS
+    } catch(exception& e) {
+        ptr->_errno=ENOMEM;
+        return -1;
+    }
+    #endif //__NO_EXCEPTIONS
+    
+    #else //WITH_FILESYSTEM
+    ptr->_errno=EBADF;
+    return -1;
+    #endif //WITH_FILESYSTEM
+}
+
+ssize_t pread(int fd, void *buf, size_t size, off_t pos)
+{
+    return _pread_r(miosix::getReent(),fd,buf,size,pos);
+}
+
+/**
+ * \internal
+ * _writev_r, write data from multiple buffers
+ */
+ssize_t _writev_r(struct _reent *ptr, int fd, const struct iovec *iov,
+        int iovcnt)
+{
+    #ifdef WITH_FILESYSTEM
+
+    #ifndef __NO_EXCEPTIONS
+    try {
+    #endif //__NO_EXCEPTIONS
+        ssize_t result=miosix::getFileDescriptorTable().writev(fd,iov,iovcnt);
+        if(result>=0) return result;
+        ptr->_errno=-result;
+        return -1;
+    #ifndef __NO_EXCEPTIONS
+    } catch(exception& e) {
+        ptr->_errno=ENOMEM;
+        return -1;
+    }
+    #endif //__NO_EXCEPTIONS
+    
+    #else //WITH_FILESYSTEM
+    ptr->_errno=EBADF;
+    return -1;
+    #endif //WITH_FILESYSTEM
+}
+
+ssize_t writev(int fd, const struct iovec *iov, int iovcnt)
+{
+    return _writev_r(miosix::getReent(),fd,iov,iovcnt);
+}
+
+/**
+ * \internal
+ * _readv_r, read data into multiple buffers
+ */
+ssize_t _readv_r(struct _reent *ptr, int fd, const struct iovec *iov,
+        int iovcnt)
+{
+    #ifdef WITH_FILESYSTEM
+
+    #ifndef __NO_EXCEPTIONS
+    try {
+    #endif //__NO_EXCEPTIONS
+        ssize_t result=miosix::getFileDescriptorTable().readv(fd,iov,iovcnt);
+        if(result>=0) return result;
+        ptr->_errno=-result;
+        return -1;
+    #ifndef __NO_EXCEPTIONS
+    } catch(exception& e) {
+        ptr->_errno=ENOMEM;
+        return -1;
+    }
+    #endif //__NO_EXCEPTIONS
+    
+    #else //WITH_FILESYSTEM
+    ptr->_errno=EBADF;
+    return -1;
+    #endif //WITH_FILESYSTEM
+}
+
+ssize_t readv(int fd, const struct iovec *iov, int iovcnt)
+{
+    return _readv_r(miosix::getReent(),fd,iov,iovcnt);
+}
+
+/**
+ * \internal
+ * _poll_r, wait for file descriptors to become ready
+ */
+int _poll_r(struct _reent *ptr, struct pollfd *fds, nfds_t nfds, int timeout)
+{
+    #ifdef WITH_FILESYSTEM
+
+    #ifndef __NO_EXCEPTIONS
+    try {
+    #endif //__NO_EXCEPTIONS
+        int result=miosix::getFileDescriptorTable().poll(fds,nfds,timeout);
+        if(result>=0) return result;
+        ptr->_errno=-result;
+        return -1;
+    #ifndef __NO_EXCEPTIONS
+    } catch(exception& e) {
+        ptr->_errno=ENOMEM;
+        return -1;
+    }
+    #endif //__NO_EXCEPTIONS
+    
+    #else //WITH_FILESYSTEM
+    ptr->_errno=ENOSYS;
+    return -1;
+    #endif //WITH_FILESYSTEM
+}
+
+int poll(struct pollfd *fds, nfds_t nfds, int timeout)
+{
+    return _poll_r(miosix::getReent(),fds,nfds,timeout);
+}
+
 /**
  * \internal
  * _fstat_r, return file info
@@ -617,9 +879,11 @@ int fcntl(int fd, int cmd, ...)
         case F_DUPFD:
         case F_SETFD:
         case F_SETFL:
+        case F_SETPIPE_SZ:
             va_start(arg,cmd);
             result=_fcntl_r(r,fd,cmd,va_arg(arg,int));
             va_end(arg);
+            break;
         default:
             result=_fcntl_r(r,fd,cmd,0);
     }
@@ -951,6 +1215,112 @@ int ftruncate(int fd, off_t size)
     #endif //WITH_FILESYSTEM
 }
 
+#ifdef WITH_FILESYSTEM
+/**
+ * Header of the heap copies that mmap() makes of files that are not stored in
+ * memory, so that munmap() knows which mappings to free
+ */
+struct alignas(8) MmapCopy
+{
+    MmapCopy *next; ///< Next copy in the list
+};
+
+static MmapCopy *mmapCopies=nullptr; ///< Heap copies made by mmap()
+static miosix::FastMutex mmapMutex;  ///< Guards mmapCopies
+#endif //WITH_FILESYSTEM
+
+/**
+ * mmap, map a file in memory, read-only
+ */
+void *mmap(void *addr, size_t len, int prot, int flags, int fd, off_t off)
+{
+    #ifdef WITH_FILESYSTEM
+    auto ptr=miosix::getReent();
+    int mapType=flags & (MAP_SHARED | MAP_PRIVATE);
+    if(addr!=nullptr || len==0 || off<0 || (flags & MAP_FIXED)
+        || (mapType!=MAP_SHARED && mapType!=MAP_PRIVATE))
+    {
+        ptr->_errno=EINVAL;
+        return MAP_FAILED;
+    }
+    if(prot!=PROT_READ)
+    {
+        ptr->_errno=ENOTSUP;
+        return MAP_FAILED;
+    }
+    auto& fdt=miosix::getFileDescriptorTable();
+    auto file=fdt.getFile(fd);
+    if(!file)
+    {
+        ptr->_errno=EBADF;
+        return MAP_FAILED;
+    }
+    struct stat st;
+    if(int result=file->fstat(&st))
+    {
+        ptr->_errno=-result;
+        return MAP_FAILED;
+    }
+    if(off>=st.st_size || static_cast<off_t>(len)>st.st_size-off)
+    {
+        ptr->_errno=ENXIO;
+        return MAP_FAILED;
+    }
+    //Kernel code has no memory protection, files stored in memory need no copy
+    miosix::MemoryMappedFile mm=file->getFileFromMemory();
+    if(mm.isValid()) return const_cast<char*>(
+        reinterpret_cast<const char*>(mm.data)+off);
+    auto copy=reinterpret_cast<MmapCopy*>(malloc(sizeof(MmapCopy)+len));
+    if(copy==nullptr)
+    {
+        ptr->_errno=ENOMEM;
+        return MAP_FAILED;
+    }
+    char *data=reinterpret_cast<char*>(copy+1);
+    for(size_t done=0;done<len;)
+    {
+        ssize_t result=fdt.pread(fd,data+done,len-done,off+done);
+        if(result<=0)
+        {
+            free(copy);
+            ptr->_errno=result<0 ? -result : ENXIO;
+            return MAP_FAILED;
+        }
+        done+=result;
+    }
+    miosix::Lock<miosix::FastMutex> l(mmapMutex);
+    copy->next=mmapCopies;
+    mmapCopies=copy;
+    return data;
+    #else //WITH_FILESYSTEM
+    miosix::getReent()->_errno=EBADF;
+    return MAP_FAILED;
+    #endif //WITH_FILESYSTEM
+}
+
+/**
+ * munmap, unmap a file
+ */
+int munmap(void *addr, size_t len)
+{
+    #ifdef WITH_FILESYSTEM
+    MmapCopy *copy=nullptr;
+    {
+        miosix::Lock<miosix::FastMutex> l(mmapMutex);
+        for(MmapCopy **it=&mmapCopies;*it;it=&(*it)->next)
+        {
+            if(reinterpret_cast<char*>(*it+1)!=addr) continue;
+            copy=*it;
+            *it=copy->next;
+            break;
+        }
+    }
+    //Not a copy, files mapped directly need no unmapping
+    free(copy);
+    #endif //WITH_FILESYSTEM
+    return 0;
+}
+
 /**
  * \internal
  * _rename_r, rename a file or directory
@@ -34,6 +34,7 @@
 #include "util.h"
 #include "kernel/kernel.h"
 #include "stdlib_integration/libc_integration.h"
+#include "kernel/tlsf_heap.h"
 #include "config/miosix_settings.h" //For WATERMARK_FILL and STACK_FILL
 
 using namespace std;
@@ -65,6 +66,20 @@ void MemoryProfiling::print()
             curFreeStack,absFreeStack,
             heapSize,heapSize-curFreeHeap,heapSize-absFreeHeap,
             curFreeHeap,absFreeHeap);
+    #ifdef WITH_TLSF_HEAP
+    for(auto h=&TlsfHeap::instance();h;h=h->nextHeap())
+    {
+        HeapStats stats;
+        {
+            PauseKernelLock dLock;
+            stats=h->getStats();
+        }
+        iprintf("Heap %s: size %u used %u/%u blocks %u largest free %u "
+                "fragmentation %u%% failures %u\n",h->getName(),stats.size,
+                stats.used,stats.maxUsed,stats.allocations,stats.largestFree,
+                stats.fragmentation,stats.failures);
+    }
+    #endif //WITH_TLSF_HEAP
 }
 
 unsigned int MemoryProfiling::getStackSize()
@@ -116,6 +131,10 @@ unsigned int MemoryProfiling::getHeapSize()
 
 unsigned int MemoryProfiling::getAbsoluteFreeHeap()
 {
+    #ifdef WITH_TLSF_HEAP
+    PauseKernelLock dLock;
+    return getHeapSize()-TlsfHeap::instance().getStats().maxUsed;
+    #else //WITH_TLSF_HEAP
     //This extern variable is defined in the linker script
     //Pointer to end of heap
     extern char _heap_end asm("_heap_end");
@@ -123,12 +142,18 @@ unsigned int MemoryProfiling::getAbsoluteFreeHeap()
     unsigned int maxHeap=getMaxHeap();
 
     return reinterpret_cast<unsigned int>(&_heap_end) - maxHeap;
+    #endif //WITH_TLSF_HEAP
 }
 
 unsigned int MemoryProfiling::getCurrentFreeHeap()
 {
+    #ifdef WITH_TLSF_HEAP
+    PauseKernelLock dLock;
+    return getHeapSize()-TlsfHeap::instance().getStats().used;
+    #else //WITH_TLSF_HEAP
     struct mallinfo mallocData=_mallinfo_r(__getreent());
     return getHeapSize()-mallocData.uordblks;
+    #endif //WITH_TLSF_HEAP
 }
 
 /**
@@ -295,4 +320,69 @@ void CPUProfiler::thread(long long nsInterval)
 
 #endif // WITH_CPU_TIME_COUNTER
 
+#ifdef WITH_LATENCY_STATS
+
+//
+// LatencyProfiler class
+//
+
+long long LatencyProfiler::update()
+{
+    lastSnapshotIndex ^= 1;
+    Snapshot& snap = snapshots[lastSnapshotIndex];
+    snap.time = getTime();
+    for(int i = 0; i < LatencyStats::NUM_KINDS; i++)
+        LatencyStats::get(static_cast<LatencyStats::Kind>(i), snap.data[i]);
+    return snap.time;
+}
+
+void LatencyProfiler::print()
+{
+    Snapshot& oldSnap = snapshots[lastSnapshotIndex ^ 1];
+    Snapshot& newSnap = snapshots[lastSnapshotIndex];
+    iprintf("Latency, last interval %lld ns\n", newSnap.time - oldSnap.time);
+    for(int i = 0; i < LatencyStats::NUM_KINDS; i++)
+    {
+        auto kind = static_cast<LatencyStats::Kind>(i);
+        const LatencyStats::Histogram& o = oldSnap.data[i];
+        const LatencyStats::Histogram& n = newSnap.data[i];
+        // After a reset, the whole new histogram belongs to this interval
+        bool wasReset = n.generation != o.generation;
+        unsigned int count = wasReset ? n.count : n.count - o.count;
+        const char *unit = LatencyStats::unit(kind);
+        iprintf("%s: %u samples, min %u %s, max %u %s\n",
+            LatencyStats::name(kind), count, n.min, unit, n.max, unit);
+        if(count == 0) continue;
+        for(unsigned int j = 0; j < LatencyStats::numBuckets; j++)
+        {
+            unsigned int c = wasReset ? n.bucket[j] : n.bucket[j] - o.bucket[j];
+            if(c == 0) continue;
+            // Bucket j holds [2^(j-1), 2^j), bucket 0 only holds zero
+            int perc = static_cast<int>(1000ULL * c / count);
+            if(j == LatencyStats::numBuckets - 1)
+                iprintf("  >= %10u %10u (%2d.%1d%%)\n", 1u << (j - 1), c,
+                    perc / 10, perc % 10);
+            else
+                iprintf("  <  %10u %10u (%2d.%1d%%)\n", 1u << j, c,
+                    perc / 10, perc % 10);
+        }
+    }
+}
+
+void LatencyProfiler::thread(long long nsInterval)
+{
+    LatencyProfiler profiler;
+    long long t = profiler.update();
+    while(!Thread::testTerminate())
+    {
+        t += nsInterval;
+        Thread::nanoSleepUntil(t);
+        profiler.update();
+        profiler.print();
+        iprintf("\n");
+    }
+}
+
+#endif // WITH_LATENCY_STATS
+
 } //namespace miosix
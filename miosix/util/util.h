@@ -34,6 +34,7 @@
 #define UTIL_H
 
 #include "kernel/cpu_time_counter.h"
+#include "kernel/latency_stats.h"
 #include <vector>
 
 namespace miosix {
@@ -53,6 +54,7 @@ public:
 
     /**
      * Prints a summary of the information that can be gathered from this class.
+     * With WITH_TLSF_HEAP the statistics of each heap are also printed.
      */
     static void print();
 
@@ -76,7 +78,10 @@ public:
     static unsigned int getCurrentFreeStack();
 
     /**
-     * \return heap size which is defined in the linker script.<br>The heap is
+     * \return heap size which is defined in the linker script.<br>
+     * When WITH_TLSF_HEAP is defined, this and the other heap functions refer
+     * to the system heap only, not to heaps added with TlsfHeap::addHeap().
+     * <br>The heap is
      * shared among all threads, therefore this function returns the same value
      * regardless which thread is called in.
      */
@@ -204,6 +209,72 @@ private:
 
 #endif // WITH_CPU_TIME_COUNTER
 
+#ifdef WITH_LATENCY_STATS
+
+/**
+ * This class prints the kernel latency histograms collected by LatencyStats,
+ * and therefore requires `WITH_LATENCY_STATS` to be defined in
+ * config/miosix_settings.h.
+ *
+ * Like CPUProfiler, it can be integrated in an existing update loop by calling
+ * update() and print() at regular intervals, in which case the printed
+ * histograms only contain the samples collected in the last interval, or
+ * it can be run as a thread that prints them periodically:
+ *
+ *      std::thread profThread(LatencyProfiler::thread, 1000000000LL);
+ *
+ * Minimum and maximum latency are not per interval, they are the extremes
+ * since boot or the last LatencyStats::reset().
+ */
+class LatencyProfiler
+{
+public:
+    /**
+     * Construct a new profiler object.
+     */
+    LatencyProfiler() {}
+
+    /**
+     * Update the profiler status with the latest histograms.
+     * \returns the time (in nanoseconds) at which the data was collected.
+     */
+    long long update();
+
+    /**
+     * Prints the non empty buckets of the histograms of the last interval.
+     */
+    void print();
+
+    /**
+     * Continuously collects and prints the latency histograms.
+     * Returns once Thread::testTerminate() returns `true'.
+     * \param nsInterval The interval between subsequent printouts.
+     * \warning The current implementation can wait up to `nsInterval'
+     * nanoseconds before the thread termination condition is noticed.
+     */
+    static void thread(long long nsInterval);
+
+private:
+    /**
+     * \internal
+     * Histograms collected at a given time
+     */
+    struct Snapshot
+    {
+        /// The histograms, one per LatencyStats::Kind
+        LatencyStats::Histogram data[LatencyStats::NUM_KINDS];
+        /// The time (in ns) at which the snapshot was collected
+        long long time = 0;
+    };
+
+    /// Two snapshots, the difference between them is printed
+    Snapshot snapshots[2] = {};
+    /// Which of the two snapshots is the last one collected.
+    unsigned int lastSnapshotIndex = 0;
+};
+
+#endif // WITH_LATENCY_STATS
+
 /**
  * \}
  */